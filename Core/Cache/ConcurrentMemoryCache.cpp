@@ -0,0 +1,267 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "ConcurrentMemoryCache.h"
+
+#include "../Logging.h"
+#include "../OrthancException.h"
+
+namespace Orthanc
+{
+  ConcurrentMemoryCache::Page& ConcurrentMemoryCache::Pin(const std::string& id)
+  {
+    // WARNING: The global mutex must be locked
+
+    Pages::iterator found = pages_.find(id);
+
+    if (found != pages_.end())
+    {
+      Page& page = *found->second;
+
+      if (page.pins_ == 0)
+      {
+        unpinned_.Invalidate(id);
+      }
+
+      if (page.content_.get() == NULL)
+      {
+        misses_++;   // The page is still being loaded by another thread
+      }
+      else
+      {
+        hits_++;
+      }
+
+      page.pins_++;
+      return page;
+    }
+    else
+    {
+      std::auto_ptr<Page> page(new Page);
+      page->id_ = id;
+      page->size_ = 0;
+      page->pins_ = 1;
+      page->valid_ = true;
+
+      misses_++;
+
+      Page* p = page.release();
+      pages_[id] = p;
+      return *p;
+    }
+  }
+
+
+  void ConcurrentMemoryCache::Unpin(Page& page)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    assert(page.pins_ > 0);
+    page.pins_--;
+
+    if (page.pins_ > 0)
+    {
+      return;
+    }
+
+    if (!page.valid_)
+    {
+      // This page was already removed from "pages_" by "Invalidate()"
+      delete &page;
+    }
+    else if (page.content_.get() == NULL)
+    {
+      // The provider has failed, forget about this page
+      pages_.erase(page.id_);
+      delete &page;
+    }
+    else
+    {
+      unpinned_.Add(page.id_);
+      Recycle();
+    }
+  }
+
+
+  void ConcurrentMemoryCache::Recycle()
+  {
+    // WARNING: The global mutex must be locked
+
+    while (currentSize_ > maximumSize_ &&
+           !unpinned_.IsEmpty())
+    {
+      std::string oldest = unpinned_.RemoveOldest();
+
+      Pages::iterator page = pages_.find(oldest);
+      assert(page != pages_.end() &&
+             page->second->pins_ == 0);
+
+      VLOG(1) << "Dropping the oldest cache page";
+
+      currentSize_ -= page->second->size_;
+      delete page->second;
+      pages_.erase(page);
+      evictions_++;
+    }
+  }
+
+
+  ConcurrentMemoryCache::Accessor::Accessor(ConcurrentMemoryCache& that,
+                                            const std::string& id) :
+    that_(that),
+    page_(NULL)
+  {
+    {
+      boost::mutex::scoped_lock lock(that_.mutex_);
+      page_ = &that_.Pin(id);
+    }
+
+    // From this point, the page cannot be recycled. Wait for the
+    // other accessors to the same page to be released.
+    page_->mutex_.lock();
+
+    if (page_->content_.get() == NULL)
+    {
+      // The global mutex is not locked during the call to the
+      // provider, so that other pages can be accessed meanwhile
+      std::auto_ptr<IDynamicObject> content;
+      size_t size = 0;
+
+      try
+      {
+        content.reset(that_.provider_.Provide(size, id));
+
+        if (content.get() == NULL)
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+      }
+      catch (...)
+      {
+        page_->mutex_.unlock();
+        that_.Unpin(*page_);
+        throw;
+      }
+
+      boost::mutex::scoped_lock lock(that_.mutex_);
+      page_->content_ = content;
+      page_->size_ = size;
+
+      if (page_->valid_)
+      {
+        that_.currentSize_ += size;
+      }
+    }
+  }
+
+
+  ConcurrentMemoryCache::Accessor::~Accessor()
+  {
+    page_->mutex_.unlock();
+    that_.Unpin(*page_);
+  }
+
+
+  ConcurrentMemoryCache::ConcurrentMemoryCache(IPageProvider& provider,
+                                               size_t maximumSize) :
+    provider_(provider),
+    maximumSize_(maximumSize),
+    currentSize_(0),
+    hits_(0),
+    misses_(0),
+    evictions_(0)
+  {
+  }
+
+
+  ConcurrentMemoryCache::~ConcurrentMemoryCache()
+  {
+    // All the accessors must have been released at this point
+    for (Pages::iterator it = pages_.begin(); it != pages_.end(); ++it)
+    {
+      assert(it->second->pins_ == 0);
+      delete it->second;
+    }
+  }
+
+
+  void ConcurrentMemoryCache::SetMaximumSize(size_t maximumSize)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    maximumSize_ = maximumSize;
+    Recycle();
+  }
+
+
+  void ConcurrentMemoryCache::Invalidate(const std::string& id)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Pages::iterator page = pages_.find(id);
+    if (page == pages_.end())
+    {
+      return;
+    }
+
+    if (page->second->content_.get() != NULL)
+    {
+      currentSize_ -= page->second->size_;
+    }
+
+    if (page->second->pins_ == 0)
+    {
+      unpinned_.Invalidate(id);
+      delete page->second;
+    }
+    else
+    {
+      // The page will be deleted once its last accessor is released
+      page->second->valid_ = false;
+    }
+
+    pages_.erase(page);
+  }
+
+
+  void ConcurrentMemoryCache::GetStatistics(Statistics& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    target.hits_ = hits_;
+    target.misses_ = misses_;
+    target.evictions_ = evictions_;
+    target.countPages_ = pages_.size();
+    target.currentSize_ = currentSize_;
+    target.maximumSize_ = maximumSize_;
+  }
+}
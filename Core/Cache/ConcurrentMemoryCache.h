@@ -0,0 +1,138 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "LeastRecentlyUsedIndex.h"
+#include "../IDynamicObject.h"
+
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <boost/thread.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Thread-safe cache whose total size is bounded by a number of
+   * bytes, with least recently used (LRU) recycling policy. A page is
+   * pinned as long as one accessor to it is alive: It cannot be
+   * recycled, and its content is exclusively owned by this
+   * accessor. The global mutex is only held for bookkeeping, so
+   * accessors to different pages run in parallel (including while
+   * the pages are loaded by the provider).
+   **/
+  class ConcurrentMemoryCache : public boost::noncopyable
+  {
+  public:
+    class IPageProvider : public boost::noncopyable
+    {
+    public:
+      virtual ~IPageProvider()
+      {
+      }
+
+      // "size" must receive an estimate of the memory used by the page
+      virtual IDynamicObject* Provide(size_t& size,
+                                      const std::string& id) = 0;
+    };
+
+    struct Statistics
+    {
+      uint64_t  hits_;
+      uint64_t  misses_;
+      uint64_t  evictions_;
+      size_t    countPages_;
+      size_t    currentSize_;
+      size_t    maximumSize_;
+    };
+
+  private:
+    struct Page : public boost::noncopyable
+    {
+      std::string                    id_;
+      boost::mutex                   mutex_;    // Protects the content
+      std::auto_ptr<IDynamicObject>  content_;
+      size_t                         size_;
+      unsigned int                   pins_;
+      bool                           valid_;    // "false" once invalidated
+    };
+
+    typedef std::map<std::string, Page*>  Pages;
+
+    IPageProvider&  provider_;
+    boost::mutex    mutex_;
+    size_t          maximumSize_;
+    size_t          currentSize_;
+    Pages           pages_;
+    LeastRecentlyUsedIndex<std::string>  unpinned_;   // The pages that can be recycled
+    uint64_t        hits_;
+    uint64_t        misses_;
+    uint64_t        evictions_;
+
+    Page& Pin(const std::string& id);
+
+    void Unpin(Page& page);
+
+    void Recycle();
+
+  public:
+    class Accessor : public boost::noncopyable
+    {
+    private:
+      ConcurrentMemoryCache&  that_;
+      Page*                   page_;
+
+    public:
+      Accessor(ConcurrentMemoryCache& that,
+               const std::string& id);
+
+      ~Accessor();
+
+      IDynamicObject& GetItem() const
+      {
+        return *page_->content_;
+      }
+    };
+
+    ConcurrentMemoryCache(IPageProvider& provider,
+                          size_t maximumSize);
+
+    ~ConcurrentMemoryCache();
+
+    void SetMaximumSize(size_t maximumSize);
+
+    void Invalidate(const std::string& id);
+
+    void GetStatistics(Statistics& target);
+  };
+}
@@ -158,9 +158,16 @@ namespace Orthanc
     writer_.Open();
   }
 
+  HierarchicalZipWriter::HierarchicalZipWriter(ZipWriter::IOutputStream& stream)
+  {
+    // The archive is opened by the first file, so that the format
+    // can still be changed by "SetZip64()"
+    writer_.SetOutputStream(stream);
+  }
+
   HierarchicalZipWriter::~HierarchicalZipWriter()
   {
-    writer_.Close();
+    // The destructor of "writer_" closes the archive
   }
 
   void HierarchicalZipWriter::OpenFile(const char* name)
@@ -92,8 +92,17 @@ namespace Orthanc
   public:
     HierarchicalZipWriter(const char* path);
 
+    HierarchicalZipWriter(ZipWriter::IOutputStream& stream);
+
     ~HierarchicalZipWriter();
 
+    // Writes the central directory. With streams, this must be
+    // invoked explicitly, otherwise the archive is left truncated.
+    void Close()
+    {
+      writer_.Close();
+    }
+
     void SetZip64(bool isZip64)
     {
       writer_.SetZip64(isZip64);
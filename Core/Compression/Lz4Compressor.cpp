@@ -0,0 +1,381 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "Lz4Compressor.h"
+
+#include "../OrthancException.h"
+#include "../Logging.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace Orthanc
+{
+  // Constants of the LZ4 block format
+  static const size_t    MIN_MATCH = 4;
+  static const size_t    LAST_LITERALS = 5;   // The last 5 bytes are always literals
+  static const size_t    MF_LIMIT = 12;       // The last match starts 12 bytes before the end
+  static const size_t    MAX_DISTANCE = 65535;
+  static const unsigned int HASH_LOG = 14;
+  static const unsigned int SKIP_TRIGGER = 6;
+
+
+  static inline uint32_t Read32(const uint8_t* p)
+  {
+    uint32_t value;
+    memcpy(&value, p, sizeof(uint32_t));
+    return value;
+  }
+
+
+  static inline uint32_t Hash(uint32_t sequence)
+  {
+    return (sequence * 2654435761U) >> (32 - HASH_LOG);
+  }
+
+
+  static inline void WriteLength(uint8_t*& target,
+                                 size_t length)
+  {
+    // Bytes that follow a token whose nibble is 15
+    while (length >= 255)
+    {
+      *target++ = 255;
+      length -= 255;
+    }
+
+    *target++ = static_cast<uint8_t>(length);
+  }
+
+
+  static inline size_t ReadLength(const uint8_t* source,
+                                  size_t sourceSize,
+                                  size_t& position)
+  {
+    size_t length = 0;
+
+    for (;;)
+    {
+      if (position >= sourceSize ||
+          length > sourceSize * 255)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+      uint8_t b = source[position++];
+      length += b;
+
+      if (b != 255)
+      {
+        return length;
+      }
+    }
+  }
+
+
+  static void EncodeBlock(std::string& target,
+                          size_t offset,
+                          const uint8_t* source,
+                          size_t size)
+  {
+    // Worst case of LZ4, as given by "LZ4_compressBound()"
+    target.resize(offset + size + size / 255 + 16);
+
+    uint8_t* const start = reinterpret_cast<uint8_t*>(&target[0]) + offset;
+    uint8_t* op = start;
+
+    size_t anchor = 0;
+
+    if (size >= MF_LIMIT + 1)
+    {
+      std::vector<uint32_t> table(1 << HASH_LOG, 0);
+
+      const size_t matchLimit = size - LAST_LITERALS;
+      const size_t inputLimit = size - MF_LIMIT;
+
+      size_t ip = 1;
+      table[Hash(Read32(source))] = 0;
+
+      while (ip <= inputLimit)
+      {
+        const uint32_t sequence = Read32(source + ip);
+        const uint32_t h = Hash(sequence);
+        size_t candidate = table[h];
+        table[h] = static_cast<uint32_t>(ip);
+
+        if (candidate >= ip ||
+            ip - candidate > MAX_DISTANCE ||
+            Read32(source + candidate) != sequence)
+        {
+          // No match: Skip faster and faster over incompressible data
+          ip += 1 + ((ip - anchor) >> SKIP_TRIGGER);
+          continue;
+        }
+
+        // Extend the match backward, then forward
+        while (ip > anchor &&
+               candidate > 0 &&
+               source[ip - 1] == source[candidate - 1])
+        {
+          ip--;
+          candidate--;
+        }
+
+        size_t length = MIN_MATCH;
+        while (ip + length < matchLimit &&
+               source[candidate + length] == source[ip + length])
+        {
+          length++;
+        }
+
+        // Emit the sequence: token, literals, offset, match length
+        const size_t literals = ip - anchor;
+        const size_t matchCode = length - MIN_MATCH;
+
+        uint8_t* token = op++;
+        *token = static_cast<uint8_t>(((literals >= 15 ? 15 : literals) << 4) |
+                                      (matchCode >= 15 ? 15 : matchCode));
+
+        if (literals >= 15)
+        {
+          WriteLength(op, literals - 15);
+        }
+
+        memcpy(op, source + anchor, literals);
+        op += literals;
+
+        const size_t distance = ip - candidate;
+        *op++ = static_cast<uint8_t>(distance & 0xff);
+        *op++ = static_cast<uint8_t>(distance >> 8);
+
+        if (matchCode >= 15)
+        {
+          WriteLength(op, matchCode - 15);
+        }
+
+        ip += length;
+        anchor = ip;
+
+        if (ip <= inputLimit)
+        {
+          // Index the position right before the next one
+          table[Hash(Read32(source + ip - 2))] = static_cast<uint32_t>(ip - 2);
+        }
+      }
+    }
+
+    // Last sequence, made of literals only
+    const size_t literals = size - anchor;
+    *op++ = static_cast<uint8_t>((literals >= 15 ? 15 : literals) << 4);
+
+    if (literals >= 15)
+    {
+      WriteLength(op, literals - 15);
+    }
+
+    memcpy(op, source + anchor, literals);
+    op += literals;
+
+    target.resize(offset + (op - start));
+  }
+
+
+  static void DecodeBlock(void* target,
+                          size_t targetSize,
+                          const void* source,
+                          size_t sourceSize)
+  {
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(source);
+    uint8_t* out = reinterpret_cast<uint8_t*>(target);
+
+    size_t ip = 0;
+    size_t op = 0;
+
+    for (;;)
+    {
+      if (ip >= sourceSize)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+      const uint8_t token = in[ip++];
+
+      size_t literals = (token >> 4);
+      if (literals == 15)
+      {
+        literals += ReadLength(in, sourceSize, ip);
+      }
+
+      if (literals > sourceSize - ip ||
+          literals > targetSize - op)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+      memcpy(out + op, in + ip, literals);
+      ip += literals;
+      op += literals;
+
+      if (ip == sourceSize)
+      {
+        break;  // End of the block, that finishes with literals
+      }
+
+      if (sourceSize - ip < 2)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+      const size_t distance = static_cast<size_t>(in[ip]) | (static_cast<size_t>(in[ip + 1]) << 8);
+      ip += 2;
+
+      if (distance == 0 ||
+          distance > op)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+      size_t length = (token & 0x0f);
+      if (length == 15)
+      {
+        length += ReadLength(in, sourceSize, ip);
+      }
+
+      length += MIN_MATCH;
+
+      if (length > targetSize - op)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+      const uint8_t* match = out + op - distance;
+
+      if (distance >= length)
+      {
+        memcpy(out + op, match, length);
+      }
+      else
+      {
+        // Overlapping copy, that repeats the last "distance" bytes
+        for (size_t i = 0; i < length; i++)
+        {
+          out[op + i] = match[i];
+        }
+      }
+
+      op += length;
+    }
+
+    if (op != targetSize)
+    {
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+  }
+
+
+  void Lz4Compressor::Compress(std::string& compressed,
+                               const void* uncompressed,
+                               size_t uncompressedSize)
+  {
+    if (uncompressedSize == 0)
+    {
+      compressed.clear();
+      return;
+    }
+
+    try
+    {
+      EncodeBlock(compressed, sizeof(uint64_t),
+                  reinterpret_cast<const uint8_t*>(uncompressed), uncompressedSize);
+    }
+    catch (std::bad_alloc&)
+    {
+      compressed.clear();
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    uint64_t s = static_cast<uint64_t>(uncompressedSize);
+    memcpy(&compressed[0], &s, sizeof(uint64_t));
+  }
+
+
+  void Lz4Compressor::Uncompress(std::string& uncompressed,
+                                 const void* compressed,
+                                 size_t compressedSize)
+  {
+    if (compressedSize == 0)
+    {
+      uncompressed.clear();
+      return;
+    }
+
+    if (compressedSize <= sizeof(uint64_t))
+    {
+      LOG(ERROR) << "The compressed buffer is ill-formed";
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+
+    uint64_t uncompressedSize;
+    memcpy(&uncompressedSize, compressed, sizeof(uint64_t));
+
+    // LZ4 cannot expand its input by more than a factor 255
+    if (uncompressedSize == 0 ||
+        uncompressedSize / 255 > static_cast<uint64_t>(compressedSize))
+    {
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+
+    try
+    {
+      uncompressed.resize(static_cast<size_t>(uncompressedSize));
+    }
+    catch (...)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    try
+    {
+      DecodeBlock(&uncompressed[0], uncompressed.size(),
+                  reinterpret_cast<const uint8_t*>(compressed) + sizeof(uint64_t),
+                  compressedSize - sizeof(uint64_t));
+    }
+    catch (OrthancException&)
+    {
+      uncompressed.clear();
+      throw;
+    }
+  }
+}
@@ -39,10 +39,13 @@
 #include "ZipWriter.h"
 
 #include <limits>
+#include <string.h>
+#include <vector>
 #include <boost/filesystem.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include "../../Resources/ThirdParty/minizip/zip.h"
+#include <zlib.h>
 #include "../OrthancException.h"
 #include "../Logging.h"
 
@@ -73,14 +76,363 @@ static void PrepareFileInfo(zip_fileinfo& zfi)
 }
 
 
+static void EncodeDosDateTime(uint16_t& dosDate,
+                              uint16_t& dosTime,
+                              const zip_fileinfo& zfi)
+{
+  const tm_zip& t = zfi.tmz_date;
+
+  dosDate = static_cast<uint16_t>(((t.tm_year - 1980) << 9) | ((t.tm_mon + 1) << 5) | t.tm_mday);
+  dosTime = static_cast<uint16_t>((t.tm_hour << 11) | (t.tm_min << 5) | (t.tm_sec / 2));
+}
+
+
+static void Append16(std::string& target,
+                     uint16_t value)
+{
+  target.push_back(static_cast<char>(value & 0xff));
+  target.push_back(static_cast<char>((value >> 8) & 0xff));
+}
+
+
+static void Append32(std::string& target,
+                     uint32_t value)
+{
+  Append16(target, static_cast<uint16_t>(value & 0xffff));
+  Append16(target, static_cast<uint16_t>((value >> 16) & 0xffff));
+}
+
+
+static void Append64(std::string& target,
+                     uint64_t value)
+{
+  Append32(target, static_cast<uint32_t>(value & 0xffffffff));
+  Append32(target, static_cast<uint32_t>((value >> 32) & 0xffffffff));
+}
+
+
 
 namespace Orthanc
 {
+  /**
+   * Writer of a ZIP archive into a stream. The local header of each
+   * file has the bit 3 of its flags set, meaning that its CRC and its
+   * sizes are given by the data descriptor that follows its content.
+   * The ZIP64 extensions are used in the local headers, in the data
+   * descriptors and in the central directory if requested.
+   * https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+   **/
+  class ZipWriter::StreamWriter : public boost::noncopyable
+  {
+  private:
+    static const size_t BUFFER_SIZE = 64 * 1024;
+
+    static const uint16_t FLAG_DATA_DESCRIPTOR = 0x0008;
+    static const uint16_t VERSION_DEFAULT = 20;
+    static const uint16_t VERSION_ZIP64 = 45;
+
+    struct Entry
+    {
+      std::string  path_;
+      uint16_t     dosDate_;
+      uint16_t     dosTime_;
+      uint32_t     crc32_;
+      uint64_t     compressedSize_;
+      uint64_t     uncompressedSize_;
+      uint64_t     offset_;
+    };
+
+    IOutputStream&      stream_;
+    bool                isZip64_;
+    uint64_t            position_;   // Number of bytes written so far
+    std::string         buffer_;
+    std::vector<Entry>  entries_;
+    bool                hasEntry_;
+    Entry               current_;
+    z_stream            zlib_;
+
+    void Flush()
+    {
+      if (!buffer_.empty())
+      {
+        stream_.Write(buffer_);
+        buffer_.clear();
+      }
+    }
+
+    void Emit(const std::string& data)
+    {
+      buffer_.append(data);
+      position_ += data.size();
+
+      if (buffer_.size() >= BUFFER_SIZE)
+      {
+        Flush();
+      }
+    }
+
+    void Deflate(int flush)
+    {
+      char chunk[16384];
+
+      do
+      {
+        zlib_.next_out = reinterpret_cast<Bytef*>(chunk);
+        zlib_.avail_out = sizeof(chunk);
+
+        if (deflate(&zlib_, flush) == Z_STREAM_ERROR)
+        {
+          throw OrthancException(ErrorCode_CannotWriteFile);
+        }
+
+        size_t size = sizeof(chunk) - zlib_.avail_out;
+        current_.compressedSize_ += size;
+        Emit(std::string(chunk, size));
+      }
+      while (zlib_.avail_out == 0);
+    }
+
+    void CloseEntry()
+    {
+      if (!hasEntry_)
+      {
+        return;
+      }
+
+      zlib_.next_in = NULL;
+      zlib_.avail_in = 0;
+      Deflate(Z_FINISH);
+      deflateEnd(&zlib_);
+      hasEntry_ = false;
+
+      std::string descriptor;
+      Append32(descriptor, 0x08074b50);
+      Append32(descriptor, current_.crc32_);
+
+      if (isZip64_)
+      {
+        Append64(descriptor, current_.compressedSize_);
+        Append64(descriptor, current_.uncompressedSize_);
+      }
+      else if (current_.compressedSize_ > 0xffffffffu ||
+               current_.uncompressedSize_ > 0xffffffffu)
+      {
+        LOG(ERROR) << "This file is too large for ZIP32, use ZIP64: " << current_.path_;
+        throw OrthancException(ErrorCode_CannotWriteFile);
+      }
+      else
+      {
+        Append32(descriptor, static_cast<uint32_t>(current_.compressedSize_));
+        Append32(descriptor, static_cast<uint32_t>(current_.uncompressedSize_));
+      }
+
+      Emit(descriptor);
+      entries_.push_back(current_);
+    }
+
+  public:
+    StreamWriter(IOutputStream& stream,
+                 bool isZip64) :
+      stream_(stream),
+      isZip64_(isZip64),
+      position_(0),
+      hasEntry_(false)
+    {
+    }
+
+    ~StreamWriter()
+    {
+      if (hasEntry_)
+      {
+        deflateEnd(&zlib_);
+      }
+    }
+
+    void OpenFile(const char* path,
+                  uint8_t compressionLevel)
+    {
+      CloseEntry();
+
+      zip_fileinfo zfi;
+      PrepareFileInfo(zfi);
+
+      current_.path_ = path;
+      EncodeDosDateTime(current_.dosDate_, current_.dosTime_, zfi);
+      current_.crc32_ = crc32(0L, Z_NULL, 0);
+      current_.compressedSize_ = 0;
+      current_.uncompressedSize_ = 0;
+      current_.offset_ = position_;
+
+      memset(&zlib_, 0, sizeof(zlib_));
+
+      // Negative window bits produce a raw deflate stream, as expected by ZIP
+      if (deflateInit2(&zlib_, compressionLevel, Z_DEFLATED, -MAX_WBITS, 
+                       8 /* default memory level */, Z_DEFAULT_STRATEGY) != Z_OK)
+      {
+        throw OrthancException(ErrorCode_NotEnoughMemory);
+      }
+
+      hasEntry_ = true;
+
+      std::string header;
+      Append32(header, 0x04034b50);
+      Append16(header, isZip64_ ? VERSION_ZIP64 : VERSION_DEFAULT);
+      Append16(header, FLAG_DATA_DESCRIPTOR);
+      Append16(header, Z_DEFLATED);
+      Append16(header, current_.dosTime_);
+      Append16(header, current_.dosDate_);
+      Append32(header, 0);  // CRC, in the data descriptor
+      Append32(header, isZip64_ ? 0xffffffffu : 0);  // Compressed size
+      Append32(header, isZip64_ ? 0xffffffffu : 0);  // Uncompressed size
+      Append16(header, static_cast<uint16_t>(current_.path_.size()));
+      Append16(header, isZip64_ ? 20 : 0);  // Size of the extra field
+      header.append(current_.path_);
+
+      if (isZip64_)
+      {
+        // ZIP64 extended information, the sizes are in the data descriptor
+        Append16(header, 0x0001);
+        Append16(header, 16);
+        Append64(header, 0);
+        Append64(header, 0);
+      }
+
+      Emit(header);
+    }
+
+    void Write(const char* data,
+               size_t length)
+    {
+      if (!hasEntry_)
+      {
+        LOG(ERROR) << "Call first OpenFile()";
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      const size_t maxBytesInAStep = std::numeric_limits<int32_t>::max();
+
+      while (length > 0)
+      {
+        uInt bytes = static_cast<uInt>(length <= maxBytesInAStep ? length : maxBytesInAStep);
+
+        current_.crc32_ = crc32(current_.crc32_, reinterpret_cast<const Bytef*>(data), bytes);
+        current_.uncompressedSize_ += bytes;
+
+        zlib_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        zlib_.avail_in = bytes;
+        Deflate(Z_NO_FLUSH);
+
+        data += bytes;
+        length -= bytes;
+      }
+    }
+
+    void Close()
+    {
+      CloseEntry();
+
+      if (!isZip64_ &&
+          (entries_.size() >= 0xffff ||
+           position_ > 0xffffffffu))
+      {
+        LOG(ERROR) << "Too many files or too large archive for ZIP32, use ZIP64";
+        throw OrthancException(ErrorCode_CannotWriteFile);
+      }
+
+      const uint64_t directoryOffset = position_;
+
+      for (size_t i = 0; i < entries_.size(); i++)
+      {
+        const Entry& entry = entries_[i];
+
+        std::string header;
+        Append32(header, 0x02014b50);
+        Append16(header, isZip64_ ? VERSION_ZIP64 : VERSION_DEFAULT);  // Version made by
+        Append16(header, isZip64_ ? VERSION_ZIP64 : VERSION_DEFAULT);  // Version needed to extract
+        Append16(header, FLAG_DATA_DESCRIPTOR);
+        Append16(header, Z_DEFLATED);
+        Append16(header, entry.dosTime_);
+        Append16(header, entry.dosDate_);
+        Append32(header, entry.crc32_);
+        Append32(header, isZip64_ ? 0xffffffffu : static_cast<uint32_t>(entry.compressedSize_));
+        Append32(header, isZip64_ ? 0xffffffffu : static_cast<uint32_t>(entry.uncompressedSize_));
+        Append16(header, static_cast<uint16_t>(entry.path_.size()));
+        Append16(header, isZip64_ ? 28 : 0);  // Size of the extra field
+        Append16(header, 0);  // Size of the comment
+        Append16(header, 0);  // Disk number
+        Append16(header, 0);  // Internal attributes
+        Append32(header, 0);  // External attributes
+        Append32(header, isZip64_ ? 0xffffffffu : static_cast<uint32_t>(entry.offset_));
+        header.append(entry.path_);
+
+        if (isZip64_)
+        {
+          Append16(header, 0x0001);
+          Append16(header, 24);
+          Append64(header, entry.uncompressedSize_);
+          Append64(header, entry.compressedSize_);
+          Append64(header, entry.offset_);
+        }
+
+        Emit(header);
+      }
+
+      const uint64_t directorySize = position_ - directoryOffset;
+
+      std::string end;
+
+      if (isZip64_)
+      {
+        const uint64_t zip64Offset = position_;
+
+        // ZIP64 end of central directory record
+        Append32(end, 0x06064b50);
+        Append64(end, 44);  // Size of the remaining record
+        Append16(end, VERSION_ZIP64);
+        Append16(end, VERSION_ZIP64);
+        Append32(end, 0);   // Number of this disk
+        Append32(end, 0);   // Disk with the central directory
+        Append64(end, entries_.size());
+        Append64(end, entries_.size());
+        Append64(end, directorySize);
+        Append64(end, directoryOffset);
+
+        // ZIP64 end of central directory locator
+        Append32(end, 0x07064b50);
+        Append32(end, 0);
+        Append64(end, zip64Offset);
+        Append32(end, 1);   // Total number of disks
+      }
+
+      static const char* COMMENT = "Created by Orthanc";
+
+      Append32(end, 0x06054b50);
+      Append16(end, 0);   // Number of this disk
+      Append16(end, 0);   // Disk with the central directory
+      Append16(end, isZip64_ ? 0xffff : static_cast<uint16_t>(entries_.size()));
+      Append16(end, isZip64_ ? 0xffff : static_cast<uint16_t>(entries_.size()));
+      Append32(end, isZip64_ ? 0xffffffffu : static_cast<uint32_t>(directorySize));
+      Append32(end, isZip64_ ? 0xffffffffu : static_cast<uint32_t>(directoryOffset));
+      Append16(end, static_cast<uint16_t>(strlen(COMMENT)));
+      end.append(COMMENT);
+
+      Emit(end);
+      Flush();
+    }
+  };
+
+
   struct ZipWriter::PImpl
   {
     zipFile file_;
-
-    PImpl() : file_(NULL)
+    IOutputStream* stream_;
+    std::auto_ptr<StreamWriter> streamWriter_;
+    bool streamClosed_;
+
+    PImpl() : 
+      file_(NULL),
+      stream_(NULL),
+      streamClosed_(false)
     {
     }
   };
@@ -96,12 +448,39 @@ namespace Orthanc
 
   ZipWriter::~ZipWriter()
   {
-    Close();
+    if (IsOutputStream())
+    {
+      // An archive that is written to a stream must be explicitly
+      // closed: If an error has occurred, the stream is left
+      // truncated, so that it cannot be mistaken for a full archive
+      pimpl_->streamWriter_.reset(NULL);
+    }
+    else
+    {
+      Close();
+    }
   }
 
   void ZipWriter::Close()
   {
-    if (IsOpen())
+    if (IsOutputStream())
+    {
+      if (!pimpl_->streamClosed_)
+      {
+        if (pimpl_->streamWriter_.get() == NULL)
+        {
+          // Write an empty archive
+          pimpl_->streamWriter_.reset(new StreamWriter(*pimpl_->stream_, isZip64_));
+        }
+
+        // Release the stream writer even if the stream fails
+        std::auto_ptr<StreamWriter> writer(pimpl_->streamWriter_.release());
+        pimpl_->streamClosed_ = true;
+        hasFileInZip_ = false;
+        writer->Close();
+      }
+    }
+    else if (pimpl_->file_ != NULL)
     {
       zipClose(pimpl_->file_, "Created by Orthanc");
       pimpl_->file_ = NULL;
@@ -111,7 +490,8 @@ namespace Orthanc
 
   bool ZipWriter::IsOpen() const
   {
-    return pimpl_->file_ != NULL;
+    return (pimpl_->file_ != NULL ||
+            pimpl_->streamWriter_.get() != NULL);
   }
 
   void ZipWriter::Open()
@@ -121,14 +501,31 @@ namespace Orthanc
       return;
     }
 
+    hasFileInZip_ = false;
+
+    if (pimpl_->stream_ != NULL)
+    {
+      if (pimpl_->streamClosed_)
+      {
+        LOG(ERROR) << "A ZIP archive has already been written to this stream";
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      if (append_)
+      {
+        throw OrthancException(ErrorCode_NotImplemented);
+      }
+
+      pimpl_->streamWriter_.reset(new StreamWriter(*pimpl_->stream_, isZip64_));
+      return;
+    }
+
     if (path_.size() == 0)
     {
       LOG(ERROR) << "Please call SetOutputPath() before creating the file";
       throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
 
-    hasFileInZip_ = false;
-
     int mode = APPEND_STATUS_CREATE;
     if (append_ && 
         boost::filesystem::exists(path_))
@@ -155,11 +552,37 @@ namespace Orthanc
   {
     Close();
     path_ = path;
+    pimpl_->stream_ = NULL;
   }
 
-  void ZipWriter::SetZip64(bool isZip64)
+  void ZipWriter::SetOutputStream(IOutputStream& stream)
   {
     Close();
+    path_.clear();
+    pimpl_->stream_ = &stream;
+    pimpl_->streamClosed_ = false;
+  }
+
+  bool ZipWriter::IsOutputStream() const
+  {
+    return pimpl_->stream_ != NULL;
+  }
+
+  void ZipWriter::SetZip64(bool isZip64)
+  {
+    if (IsOutputStream())
+    {
+      if (IsOpen())
+      {
+        // The format cannot change in the middle of a stream
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+    }
+    else
+    {
+      Close();
+    }
+
     isZip64_ = isZip64;
   }
 
@@ -171,7 +594,12 @@ namespace Orthanc
       throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
 
-    Close();
+    if (!IsOutputStream())
+    {
+      Close();
+    }
+
+    // With a stream, the new level applies to the next files
     compressionLevel_ = level;
   }
 
@@ -179,6 +607,13 @@ namespace Orthanc
   {
     Open();
 
+    if (pimpl_->streamWriter_.get() != NULL)
+    {
+      pimpl_->streamWriter_->OpenFile(path, compressionLevel_);
+      hasFileInZip_ = true;
+      return;
+    }
+
     zip_fileinfo zfi;
     PrepareFileInfo(zfi);
 
@@ -231,6 +666,12 @@ namespace Orthanc
       throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
 
+    if (pimpl_->streamWriter_.get() != NULL)
+    {
+      pimpl_->streamWriter_->Write(data, length);
+      return;
+    }
+
     const size_t maxBytesInAStep = std::numeric_limits<int32_t>::max();
 
     while (length > 0)
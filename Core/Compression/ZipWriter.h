@@ -34,6 +34,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
 
 #if ORTHANC_BUILD_UNIT_TESTS == 1
@@ -44,7 +45,26 @@ namespace Orthanc
 {
   class ZipWriter
   {
+  public:
+    /**
+     * Target of a ZIP archive that is written as a stream, without
+     * seeking backward (e.g. the body of a HTTP answer). The sizes
+     * and the CRC of each file are written in a data descriptor that
+     * follows its content, then the central directory is written by
+     * "Close()".
+     **/
+    class IOutputStream : public boost::noncopyable
+    {
+    public:
+      virtual ~IOutputStream()
+      {
+      }
+
+      virtual void Write(const std::string& chunk) = 0;
+    };
+
   private:
+    class StreamWriter;
     struct PImpl;
     boost::shared_ptr<PImpl> pimpl_;
 
@@ -93,6 +113,11 @@ namespace Orthanc
       return path_;
     }
 
+    // Once the archive is closed, a stream cannot be opened again
+    void SetOutputStream(IOutputStream& stream);
+
+    bool IsOutputStream() const;
+
     void OpenFile(const char* path);
 
     void Write(const char* data, size_t length);
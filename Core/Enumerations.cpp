@@ -718,6 +718,25 @@ namespace Orthanc
   }
 
 
+  const char* EnumerationToString(CompressionType compression)
+  {
+    switch (compression)
+    {
+      case CompressionType_None:
+        return "None";
+
+      case CompressionType_ZlibWithSize:
+        return "Zlib";
+
+      case CompressionType_Lz4WithSize:
+        return "Lz4";
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
   Encoding StringToEncoding(const char* encoding)
   {
     std::string s(encoding);
@@ -868,6 +887,28 @@ namespace Orthanc
   }
 
 
+  CompressionType StringToCompressionType(const char* compression)
+  {
+    std::string s(compression);
+    Toolbox::ToUpperCase(s);
+
+    if (s == "NONE")
+    {
+      return CompressionType_None;
+    }
+    else if (s == "ZLIB")
+    {
+      return CompressionType_ZlibWithSize;
+    }
+    else if (s == "LZ4")
+    {
+      return CompressionType_Lz4WithSize;
+    }
+
+    throw OrthancException(ErrorCode_ParameterOutOfRange);
+  }
+
+
   unsigned int GetBytesPerPixel(PixelFormat format)
   {
     switch (format)
@@ -401,7 +401,16 @@ namespace Orthanc
      * buffer is non-empty, the buffer is compatible with the
      * "deflate" HTTP compression.
      **/
-    CompressionType_ZlibWithSize = 2
+    CompressionType_ZlibWithSize = 2,
+
+    /**
+     * Buffer that is compressed using the LZ4 block format, prefixed
+     * with a "uint64_t" (8 bytes) that encodes the size of the
+     * uncompressed buffer. If the compressed buffer is empty, its
+     * represents an empty uncompressed buffer. This format is
+     * internal to Orthanc (new in Orthanc mainline).
+     **/
+    CompressionType_Lz4WithSize = 3
   };
 
   enum FileContentType
@@ -411,6 +420,7 @@ namespace Orthanc
     FileContentType_Unknown = 0,
     FileContentType_Dicom = 1,
     FileContentType_DicomAsJson = 2,
+    FileContentType_Preview = 3,       // New in Orthanc mainline
 
     // Make sure that the value "65535" can be stored into this enumeration
     FileContentType_StartUser = 1024,
@@ -444,6 +454,8 @@ namespace Orthanc
 
   const char* EnumerationToString(RequestOrigin origin);
 
+  const char* EnumerationToString(CompressionType compression);
+
   Encoding StringToEncoding(const char* encoding);
 
   ResourceType StringToResourceType(const char* type);
@@ -452,6 +464,8 @@ namespace Orthanc
 
   LogLevel StringToLogLevel(const char* format);
 
+  CompressionType StringToCompressionType(const char* compression);
+
   unsigned int GetBytesPerPixel(PixelFormat format);
 
   bool GetDicomEncoding(Encoding& encoding,
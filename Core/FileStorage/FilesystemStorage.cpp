@@ -56,6 +56,55 @@ static std::string ToString(const boost::filesystem::path& p)
 
 namespace Orthanc
 {
+  namespace
+  {
+    class FileRangeReader : public IStorageArea::IRangeReader
+    {
+    private:
+      boost::filesystem::ifstream  f_;
+      uint64_t                     fileSize_;
+
+    public:
+      explicit FileRangeReader(const boost::filesystem::path& path)
+      {
+        f_.open(path, std::ifstream::in | std::ios::binary);
+        if (!f_.good())
+        {
+          throw OrthancException(ErrorCode_InexistentFile);
+        }
+
+        f_.seekg(0, std::ios::end);
+        fileSize_ = static_cast<uint64_t>(f_.tellg());
+      }
+
+      virtual void Read(std::string& content,
+                        uint64_t start,
+                        size_t size)
+      {
+        if (start > fileSize_ ||
+            size > fileSize_ - start)
+        {
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+
+        content.resize(size);
+
+        if (size != 0)
+        {
+          f_.seekg(static_cast<std::streamoff>(start), std::ios::beg);
+          f_.read(&content[0], size);
+
+          if (!f_.good() ||
+              static_cast<size_t>(f_.gcount()) != size)
+          {
+            throw OrthancException(ErrorCode_CorruptedFile);
+          }
+        }
+      }
+    };
+  }
+
+
   boost::filesystem::path FilesystemStorage::GetPath(const std::string& uuid) const
   {
     namespace fs = boost::filesystem;
@@ -147,6 +196,24 @@ namespace Orthanc
   }
 
 
+  void FilesystemStorage::ReadRange(std::string& content,
+                                    const std::string& uuid,
+                                    FileContentType /*type*/,
+                                    uint64_t start,
+                                    size_t size)
+  {
+    FileRangeReader reader(GetPath(uuid));
+    reader.Read(content, start, size);
+  }
+
+
+  IStorageArea::IRangeReader* FilesystemStorage::OpenRangeReader(const std::string& uuid,
+                                                                 FileContentType /*type*/)
+  {
+    return new FileRangeReader(GetPath(uuid));
+  }
+
+
   uintmax_t FilesystemStorage::GetSize(const std::string& uuid) const
   {
     boost::filesystem::path path = GetPath(uuid);
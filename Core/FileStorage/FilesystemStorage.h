@@ -66,6 +66,21 @@ namespace Orthanc
     virtual void Remove(const std::string& uuid,
                         FileContentType type);
 
+    virtual bool HasReadRange() const
+    {
+      return true;
+    }
+
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           size_t size);
+
+    // The file is opened once, and its parts are read sequentially
+    virtual IRangeReader* OpenRangeReader(const std::string& uuid,
+                                          FileContentType type);
+
     void ListAllFiles(std::set<std::string>& result) const;
 
     uintmax_t GetSize(const std::string& uuid) const;
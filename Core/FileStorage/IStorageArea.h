@@ -33,7 +33,9 @@
 #pragma once
 
 #include "../Enumerations.h"
+#include "../OrthancException.h"
 
+#include <stdint.h>
 #include <string>
 #include <boost/noncopyable.hpp>
 
@@ -41,6 +43,47 @@ namespace Orthanc
 {
   class IStorageArea : public boost::noncopyable
   {
+  public:
+    // Reads successive parts of one file, that is kept open by the
+    // storage areas that are able to do so
+    class IRangeReader : public boost::noncopyable
+    {
+    public:
+      virtual ~IRangeReader()
+      {
+      }
+
+      virtual void Read(std::string& content,
+                        uint64_t start,
+                        size_t size) = 0;
+    };
+
+  private:
+    class DefaultRangeReader : public IRangeReader
+    {
+    private:
+      IStorageArea&    area_;
+      std::string      uuid_;
+      FileContentType  type_;
+
+    public:
+      DefaultRangeReader(IStorageArea& area,
+                         const std::string& uuid,
+                         FileContentType type) :
+        area_(area),
+        uuid_(uuid),
+        type_(type)
+      {
+      }
+
+      virtual void Read(std::string& content,
+                        uint64_t start,
+                        size_t size)
+      {
+        area_.ReadRange(content, uuid_, type_, start, size);
+      }
+    };
+
   public:
     virtual ~IStorageArea()
     {
@@ -57,5 +100,40 @@ namespace Orthanc
 
     virtual void Remove(const std::string& uuid,
                         FileContentType type) = 0;
+
+    // Tells whether "ReadRange()" is able to read a part of a file
+    // without loading the whole file into memory
+    virtual bool HasReadRange() const
+    {
+      return false;
+    }
+
+    // Reads the "size" bytes of the file that start at offset
+    // "start". The default implementation reads the whole file.
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           size_t size)
+    {
+      std::string whole;
+      Read(whole, uuid, type);
+
+      if (start > whole.size() ||
+          size > whole.size() - start)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      content.assign(whole, static_cast<size_t>(start), size);
+    }
+
+    // The default implementation calls "ReadRange()" for each part.
+    // The caller takes the ownership of the returned object.
+    virtual IRangeReader* OpenRangeReader(const std::string& uuid,
+                                          FileContentType type)
+    {
+      return new DefaultRangeReader(*this, uuid, type);
+    }
   };
 }
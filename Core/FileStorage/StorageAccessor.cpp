@@ -33,12 +33,155 @@
 #include "../PrecompiledHeaders.h"
 #include "StorageAccessor.h"
 
+#include "../Compression/Lz4Compressor.h"
 #include "../Compression/ZlibCompressor.h"
 #include "../OrthancException.h"
 #include "../HttpServer/HttpStreamTranscoder.h"
+#include "../HttpServer/HttpToolbox.h"
+
+#include <string.h>
+#include <zlib.h>
+
+static const size_t  CHUNK_SIZE = 1024 * 1024;   // Use 1MB chunks
 
 namespace Orthanc
 {
+  /**
+   * Compresses the buffer with zlib (using the "ZlibWithSize" format
+   * of "ZlibCompressor"), and computes the MD5 of the uncompressed
+   * and of the compressed data during the same pass over the memory.
+   **/
+  static void CompressWithMD5(std::string& compressed,
+                              std::string& uncompressedMD5,
+                              std::string& compressedMD5,
+                              const void* data,
+                              size_t size,
+                              uint8_t level,
+                              bool storeMd5)
+  {
+    static const size_t STEP = 64 * 1024;
+
+    std::auto_ptr<Toolbox::IncrementalMD5> md5, md5Compressed;
+
+    if (storeMd5)
+    {
+      md5.reset(new Toolbox::IncrementalMD5);
+      md5Compressed.reset(new Toolbox::IncrementalMD5);
+    }
+
+    if (size == 0)
+    {
+      // Same convention as "ZlibCompressor::Compress()"
+      compressed.clear();
+    }
+    else
+    {
+      z_stream stream;
+      memset(&stream, 0, sizeof(stream));
+
+      if (deflateInit(&stream, level) != Z_OK)
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      const size_t prefix = sizeof(uint64_t);
+
+      try
+      {
+        compressed.resize(prefix + deflateBound(&stream, size) + 1024 /* security margin */);
+      }
+      catch (...)
+      {
+        deflateEnd(&stream);
+        throw OrthancException(ErrorCode_NotEnoughMemory);
+      }
+
+      uint64_t s = static_cast<uint64_t>(size);
+      memcpy(&compressed[0], &s, prefix);
+
+      if (md5Compressed.get() != NULL)
+      {
+        md5Compressed->Append(&compressed[0], prefix);
+      }
+
+      const uint8_t* source = reinterpret_cast<const uint8_t*>(data);
+      uint8_t* target = reinterpret_cast<uint8_t*>(&compressed[0]);
+      size_t position = 0;
+      size_t written = prefix;
+
+      stream.next_out = target + prefix;
+      stream.avail_out = static_cast<uInt>(compressed.size() - prefix);
+
+      int error = Z_OK;
+
+      while (error == Z_OK)
+      {
+        size_t chunk = (size - position > STEP ? STEP : size - position);
+
+        if (md5.get() != NULL &&
+            chunk > 0)
+        {
+          md5->Append(source + position, chunk);
+        }
+
+        stream.next_in = const_cast<Bytef*>(source + position);
+        stream.avail_in = static_cast<uInt>(chunk);
+        position += chunk;
+
+        error = deflate(&stream, position == size ? Z_FINISH : Z_NO_FLUSH);
+
+        if (error == Z_OK &&
+            stream.avail_in != 0)
+        {
+          // Cannot happen, as the output buffer is large enough
+          error = Z_BUF_ERROR;
+        }
+
+        size_t produced = compressed.size() - stream.avail_out;
+        if (md5Compressed.get() != NULL &&
+            produced > written)
+        {
+          md5Compressed->Append(target + written, produced - written);
+        }
+
+        written = produced;
+      }
+
+      deflateEnd(&stream);
+
+      if (error != Z_STREAM_END)
+      {
+        compressed.clear();
+        throw OrthancException(error == Z_MEM_ERROR ? ErrorCode_NotEnoughMemory : ErrorCode_InternalError);
+      }
+
+      compressed.resize(written);
+    }
+
+    if (storeMd5)
+    {
+      md5->Finish(uncompressedMD5);
+      md5Compressed->Finish(compressedMD5);
+    }
+    else
+    {
+      uncompressedMD5.clear();
+      compressedMD5.clear();
+    }
+  }
+
+
+  void StorageAccessor::SetCompressionLevel(uint8_t level)
+  {
+    if (level > 9)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    compressionLevel_ = level;
+  }
+
+
   FileInfo StorageAccessor::Write(const void* data,
                                   size_t size,
                                   FileContentType type,
@@ -47,32 +190,49 @@ namespace Orthanc
   {
     std::string uuid = Toolbox::GenerateUuid();
 
-    std::string md5;
-
-    if (storeMd5)
-    {
-      Toolbox::ComputeMD5(md5, data, size);
-    }
-
     switch (compression)
     {
       case CompressionType_None:
       {
+        std::string md5;
+
+        if (storeMd5)
+        {
+          Toolbox::ComputeMD5(md5, data, size);
+        }
+
         area_.Create(uuid, data, size, type);
         return FileInfo(uuid, type, size, md5);
       }
 
       case CompressionType_ZlibWithSize:
       {
-        ZlibCompressor zlib;
+        std::string compressed, md5, compressedMD5;
+        CompressWithMD5(compressed, md5, compressedMD5, data, size, compressionLevel_, storeMd5);
 
-        std::string compressed;
-        zlib.Compress(compressed, data, size);
+        if (compressed.size() > 0)
+        {
+          area_.Create(uuid, &compressed[0], compressed.size(), type);
+        }
+        else
+        {
+          area_.Create(uuid, NULL, 0, type);
+        }
+
+        return FileInfo(uuid, type, size, md5,
+                        CompressionType_ZlibWithSize, compressed.size(), compressedMD5);
+      }
+
+      case CompressionType_Lz4WithSize:
+      {
+        std::string compressed, md5, compressedMD5;
+
+        Lz4Compressor lz4;
+        lz4.Compress(compressed, data, size);
 
-        std::string compressedMD5;
-      
         if (storeMd5)
         {
+          Toolbox::ComputeMD5(md5, data, size);
           Toolbox::ComputeMD5(compressedMD5, compressed);
         }
 
@@ -86,7 +246,7 @@ namespace Orthanc
         }
 
         return FileInfo(uuid, type, size, md5,
-                        CompressionType_ZlibWithSize, compressed.size(), compressedMD5);
+                        CompressionType_Lz4WithSize, compressed.size(), compressedMD5);
       }
 
       default:
@@ -116,6 +276,16 @@ namespace Orthanc
         break;
       }
 
+      case CompressionType_Lz4WithSize:
+      {
+        Lz4Compressor lz4;
+
+        std::string compressed;
+        area_.Read(compressed, info.GetUuid(), info.GetContentType());
+        IBufferCompressor::Uncompress(content, lz4, compressed);
+        break;
+      }
+
       default:
       {
         throw OrthancException(ErrorCode_NotImplemented);
@@ -140,13 +310,76 @@ namespace Orthanc
   }
 
 
-  void StorageAccessor::SetupSender(BufferHttpSender& sender,
-                                    const FileInfo& info,
-                                    const std::string& mime)
+  namespace
   {
-    area_.Read(sender.GetBuffer(), info.GetUuid(), info.GetContentType());
-    sender.SetContentType(mime);
+    /**
+     * Sends a range of an uncompressed attachment by reading it chunk
+     * by chunk from the storage area, so that large files are never
+     * fully loaded into memory. The file is opened once for all the
+     * chunks.
+     **/
+    class StorageAreaHttpSender : public HttpFileSender
+    {
+    private:
+      std::auto_ptr<IStorageArea::IRangeReader>  reader_;
+      uint64_t                                   start_;
+      uint64_t                                   end_;
+      uint64_t                                   position_;
+      std::string                                chunk_;
+
+    public:
+      StorageAreaHttpSender(IStorageArea& area,
+                            const FileInfo& info,
+                            uint64_t start,
+                            uint64_t length) :
+        reader_(area.OpenRangeReader(info.GetUuid(), info.GetContentType())),
+        start_(start),
+        end_(start + length),
+        position_(start)
+      {
+      }
+
+      virtual uint64_t GetContentLength()
+      {
+        return end_ - start_;
+      }
+
+      virtual bool ReadNextChunk()
+      {
+        if (position_ >= end_)
+        {
+          return false;
+        }
+
+        uint64_t remaining = end_ - position_;
+        size_t size = (remaining < CHUNK_SIZE ? static_cast<size_t>(remaining) : CHUNK_SIZE);
+
+        reader_->Read(chunk_, position_, size);
+
+        if (chunk_.size() != size)
+        {
+          throw OrthancException(ErrorCode_CorruptedFile);
+        }
+
+        position_ += size;
+        return true;
+      }
+
+      virtual const char* GetChunkContent()
+      {
+        return chunk_.c_str();
+      }
+
+      virtual size_t GetChunkSize()
+      {
+        return chunk_.size();
+      }
+    };
+  }
 
+
+  static std::string GetContentFilename(const FileInfo& info)
+  {
     const char* extension;
     switch (info.GetContentType())
     {
@@ -163,7 +396,24 @@ namespace Orthanc
         extension = "";
     }
 
-    sender.SetContentFilename(info.GetUuid() + std::string(extension));
+    return info.GetUuid() + std::string(extension);
+  }
+
+
+  bool StorageAccessor::IsStreamable(const FileInfo& info) const
+  {
+    return (info.GetCompressionType() == CompressionType_None &&
+            area_.HasReadRange());
+  }
+
+
+  void StorageAccessor::SetupSender(BufferHttpSender& sender,
+                                    const FileInfo& info,
+                                    const std::string& mime)
+  {
+    area_.Read(sender.GetBuffer(), info.GetUuid(), info.GetContentType());
+    sender.SetContentType(mime);
+    sender.SetContentFilename(GetContentFilename(info));
   }
 
 
@@ -171,11 +421,21 @@ namespace Orthanc
                                    const FileInfo& info,
                                    const std::string& mime)
   {
-    BufferHttpSender sender;
-    SetupSender(sender, info, mime);
+    if (IsStreamable(info))
+    {
+      StorageAreaHttpSender sender(area_, info, 0, info.GetUncompressedSize());
+      sender.SetContentType(mime);
+      sender.SetContentFilename(GetContentFilename(info));
+      output.Answer(sender);
+    }
+    else
+    {
+      BufferHttpSender sender;
+      SetupSender(sender, info, mime);
   
-    HttpStreamTranscoder transcoder(sender, info.GetCompressionType());
-    output.Answer(transcoder);
+      HttpStreamTranscoder transcoder(sender, info.GetCompressionType());
+      output.Answer(transcoder);
+    }
   }
 
 
@@ -183,10 +443,71 @@ namespace Orthanc
                                    const FileInfo& info,
                                    const std::string& mime)
   {
-    BufferHttpSender sender;
-    SetupSender(sender, info, mime);
+    if (IsStreamable(info))
+    {
+      StorageAreaHttpSender sender(area_, info, 0, info.GetUncompressedSize());
+      sender.SetContentType(mime);
+      sender.SetContentFilename(GetContentFilename(info));
+      output.AnswerStream(sender);
+    }
+    else
+    {
+      BufferHttpSender sender;
+      SetupSender(sender, info, mime);
   
-    HttpStreamTranscoder transcoder(sender, info.GetCompressionType());
-    output.AnswerStream(transcoder);
+      HttpStreamTranscoder transcoder(sender, info.GetCompressionType());
+      output.AnswerStream(transcoder);
+    }
+  }
+
+
+  void StorageAccessor::AnswerFileRange(RestApiOutput& output,
+                                        const FileInfo& info,
+                                        const std::string& mime,
+                                        const std::string& range)
+  {
+    const uint64_t size = info.GetUncompressedSize();
+
+    // Let the clients discover that ranges are supported
+    output.AddHeader("Accept-Ranges", "bytes");
+
+    uint64_t start, length;
+    if (range.empty() ||
+        !HttpToolbox::ParseRange(start, length, range, size))
+    {
+      AnswerFile(output, info, mime);
+      return;
+    }
+
+    if (length == 0)
+    {
+      output.SignalRangeNotSatisfiable(size);
+      return;
+    }
+
+    if (IsStreamable(info))
+    {
+      StorageAreaHttpSender sender(area_, info, start, length);
+      sender.SetContentType(mime);
+      sender.SetContentFilename(GetContentFilename(info));
+      output.AnswerStreamRange(sender, start, size);
+    }
+    else
+    {
+      // The compressed attachments must be fully uncompressed
+      std::string content;
+      Read(content, info);
+
+      if (content.size() != size)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+      BufferHttpSender sender;
+      sender.GetBuffer().assign(content, static_cast<size_t>(start), static_cast<size_t>(length));
+      sender.SetContentType(mime);
+      sender.SetContentFilename(GetContentFilename(info));
+      output.AnswerStreamRange(sender, start, size);
+    }
   }
 }
@@ -49,14 +49,28 @@ namespace Orthanc
   {
   private:
     IStorageArea&  area_;
+    uint8_t        compressionLevel_;
 
     void SetupSender(BufferHttpSender& sender,
                      const FileInfo& info,
                      const std::string& mime);
 
+    bool IsStreamable(const FileInfo& info) const;
+
   public:
-    StorageAccessor(IStorageArea& area) : area_(area)
+    StorageAccessor(IStorageArea& area) : 
+      area_(area),
+      compressionLevel_(6)
+    {
+    }
+
+    // Level of the zlib compression, between 0 (none) and 9 (best),
+    // which is ignored by LZ4
+    void SetCompressionLevel(uint8_t level);
+
+    uint8_t GetCompressionLevel() const
     {
+      return compressionLevel_;
     }
 
     FileInfo Write(const void* data,
@@ -92,5 +106,11 @@ namespace Orthanc
     void AnswerFile(RestApiOutput& output,
                     const FileInfo& info,
                     const std::string& mime);
+
+    // Honors the "Range" HTTP header, if not empty
+    void AnswerFileRange(RestApiOutput& output,
+                         const FileInfo& info,
+                         const std::string& mime,
+                         const std::string& range);
   };
 }
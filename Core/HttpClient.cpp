@@ -81,6 +81,7 @@ namespace Orthanc
   {
     CURL* curl_;
     struct curl_slist *postHeaders_;
+    struct curl_slist *userHeaders_;   // "postHeaders_" + the user-defined headers
   };
 
 
@@ -116,6 +117,19 @@ namespace Orthanc
   }
 
 
+  static void AppendHeader(struct curl_slist*& headers,
+                           const std::string& header)
+  {
+    struct curl_slist* tmp = curl_slist_append(headers, header.c_str());
+    if (tmp == NULL)
+    {
+      throw OrthancException(ErrorCode_NotEnoughMemory);
+    }
+
+    headers = tmp;
+  }
+
+
   static size_t CurlCallback(void *buffer, size_t size, size_t nmemb, void *payload)
   {
     std::string& target = *(static_cast<std::string*>(payload));
@@ -135,6 +149,7 @@ namespace Orthanc
 
   void HttpClient::Setup()
   {
+    pimpl_->userHeaders_ = NULL;
     pimpl_->postHeaders_ = NULL;
     if ((pimpl_->postHeaders_ = curl_slist_append(pimpl_->postHeaders_, "Expect:")) == NULL)
     {
@@ -192,6 +207,11 @@ namespace Orthanc
   {
     curl_easy_cleanup(pimpl_->curl_);
     curl_slist_free_all(pimpl_->postHeaders_);
+
+    if (pimpl_->userHeaders_ != NULL)
+    {
+      curl_slist_free_all(pimpl_->userHeaders_);
+    }
   }
 
 
@@ -261,20 +281,55 @@ namespace Orthanc
       CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_PROXY, proxy_.c_str()));
     }
 
+    // Prepare the list of the HTTP headers
+    if (pimpl_->userHeaders_ != NULL)
+    {
+      curl_slist_free_all(pimpl_->userHeaders_);
+      pimpl_->userHeaders_ = NULL;
+    }
+
+    struct curl_slist* headers = pimpl_->postHeaders_;
+
+    if (!headers_.empty())
+    {
+      for (struct curl_slist* it = pimpl_->postHeaders_; it != NULL; it = it->next)
+      {
+        AppendHeader(pimpl_->userHeaders_, it->data);
+      }
+
+      for (std::map<std::string, std::string>::const_iterator
+             it = headers_.begin(); it != headers_.end(); ++it)
+      {
+        AppendHeader(pimpl_->userHeaders_, it->first + ": " + it->second);
+      }
+
+      headers = pimpl_->userHeaders_;
+    }
+
     switch (method_)
     {
     case HttpMethod_Get:
       CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HTTPGET, 1L));
+
+      if (!headers_.empty())
+      {
+        CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HTTPHEADER, headers));
+      }
       break;
 
     case HttpMethod_Post:
       CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_POST, 1L));
-      CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HTTPHEADER, pimpl_->postHeaders_));
+      CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HTTPHEADER, headers));
       break;
 
     case HttpMethod_Delete:
       CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_NOBODY, 1L));
       CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_CUSTOMREQUEST, "DELETE"));
+
+      if (!headers_.empty())
+      {
+        CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HTTPHEADER, headers));
+      }
       break;
 
     case HttpMethod_Put:
@@ -284,7 +339,7 @@ namespace Orthanc
       // CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_PUT, 1L));
 
       curl_easy_setopt(pimpl_->curl_, CURLOPT_CUSTOMREQUEST, "PUT"); /* !!! */
-      CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HTTPHEADER, pimpl_->postHeaders_));      
+      CheckCode(curl_easy_setopt(pimpl_->curl_, CURLOPT_HTTPHEADER, headers));
       break;
 
     default:
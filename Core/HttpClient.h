@@ -34,6 +34,7 @@
 
 #include "Enumerations.h"
 
+#include <map>
 #include <string>
 #include <boost/shared_ptr.hpp>
 #include <json/json.h>
@@ -56,6 +57,7 @@ namespace Orthanc
     std::string proxy_;
     bool verifyPeers_;
     std::string caCertificates_;
+    std::map<std::string, std::string> headers_;
 
     void Setup();
 
@@ -118,6 +120,18 @@ namespace Orthanc
       return body_;
     }
 
+    // Additional HTTP headers that are sent with the next requests
+    void AddHeader(const std::string& key,
+                   const std::string& value)
+    {
+      headers_[key] = value;
+    }
+
+    void ClearHeaders()
+    {
+      headers_.clear();
+    }
+
     void SetVerbose(bool isVerbose);
 
     bool IsVerbose() const
@@ -42,6 +42,7 @@
 #include <iostream>
 #include <vector>
 #include <stdio.h>
+#include <string.h>
 #include <boost/lexical_cast.hpp>
 
 
@@ -155,7 +156,8 @@ namespace Orthanc
       }
     }
 
-    if (state_ == State_WritingMultipart)
+    if (state_ == State_WritingMultipart ||
+        state_ == State_WritingStream)
     {
       throw OrthancException(ErrorCode_InternalError);
     }
@@ -182,7 +184,8 @@ namespace Orthanc
         s += *it;
       }
 
-      if (status_ != HttpStatus_200_Ok)
+      if (status_ != HttpStatus_200_Ok &&
+          status_ != HttpStatus_206_PartialContent)
       {
         hasContentLength_ = false;
       }
@@ -242,6 +245,10 @@ namespace Orthanc
         LOG(ERROR) << "Cannot invoke CloseBody() with multipart outputs";
         throw OrthancException(ErrorCode_BadSequenceOfCalls);
 
+      case State_WritingStream:
+        LOG(ERROR) << "Cannot invoke CloseBody() with streamed outputs";
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+
       case State_Done:
         return;  // Ignore
 
@@ -323,6 +330,14 @@ namespace Orthanc
     stateMachine_.SendBody(NULL, 0);
   }
 
+  void HttpOutput::SendRangeNotSatisfiable(uint64_t resourceSize)
+  {
+    stateMachine_.ClearHeaders();
+    stateMachine_.SetHttpStatus(HttpStatus_416_RequestedRangeNotSatisfiable);
+    stateMachine_.AddHeader("Content-Range", "bytes */" + boost::lexical_cast<std::string>(resourceSize));
+    stateMachine_.SendBody(NULL, 0);
+  }
+
   void HttpOutput::Answer(const void* buffer, 
                           size_t length)
   {
@@ -536,6 +551,82 @@ namespace Orthanc
   }
 
 
+  void HttpOutput::StateMachine::StartStream(const std::string& contentType)
+  {
+    if (state_ != State_WritingHeader)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (status_ != HttpStatus_200_Ok)
+    {
+      SendBody(NULL, 0);
+      return;
+    }
+
+    stream_.OnHttpStatusReceived(status_);
+
+    std::string header = "HTTP/1.1 200 OK\r\n";
+
+    if (keepAlive_)
+    {
+      header += "Connection: keep-alive\r\n";
+    }
+
+    for (std::list<std::string>::const_iterator
+           it = headers_.begin(); it != headers_.end(); ++it)
+    {
+      header += *it;
+    }
+
+    header += "Content-Type: " + contentType + "\r\n";
+    header += "Transfer-Encoding: chunked\r\n\r\n";
+
+    stream_.Send(true, header.c_str(), header.size());
+    state_ = State_WritingStream;
+  }
+
+
+  void HttpOutput::StateMachine::SendStreamItem(const void* item,
+                                                size_t length)
+  {
+    if (state_ != State_WritingStream)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (length == 0)
+    {
+      // An empty chunk would terminate the body
+      return;
+    }
+
+    // The framing of the chunks is flagged as a header, so that the
+    // outputs that only keep the body (such as "StringHttpOutput")
+    // receive the raw content
+    char size[32];
+    sprintf(size, "%lx\r\n", static_cast<unsigned long>(length));
+
+    stream_.Send(true, size, strlen(size));
+    stream_.Send(false, item, length);
+    stream_.Send(true, "\r\n", 2);
+    contentPosition_ += length;
+  }
+
+
+  void HttpOutput::StateMachine::CloseStream()
+  {
+    if (state_ != State_WritingStream)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    // The last chunk has a size of zero, and no trailer is sent
+    stream_.Send(true, "0\r\n\r\n", 5);
+    state_ = State_Done;
+  }
+
+
   void HttpOutput::Answer(IHttpStreamAnswer& stream)
   {
     HttpCompression compression = stream.SetupHttpCompression(isGzipAllowed_, isDeflateAllowed_);
@@ -582,4 +673,28 @@ namespace Orthanc
     stateMachine_.CloseBody();
   }
 
+
+  void HttpOutput::AnswerRange(IHttpStreamAnswer& stream,
+                               uint64_t start,
+                               uint64_t resourceSize)
+  {
+    uint64_t length = stream.GetContentLength();
+
+    if (length == 0 ||
+        start > resourceSize ||
+        length > resourceSize - start)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    char range[96];
+    sprintf(range, "bytes %llu-%llu/%llu",
+            static_cast<unsigned long long>(start),
+            static_cast<unsigned long long>(start + length - 1),
+            static_cast<unsigned long long>(resourceSize));
+
+    stateMachine_.SetHttpStatus(HttpStatus_206_PartialContent);
+    stateMachine_.AddHeader("Content-Range", range);
+    Answer(stream);
+  }
 }
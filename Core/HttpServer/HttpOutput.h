@@ -55,6 +55,7 @@ namespace Orthanc
         State_WritingHeader,      
         State_WritingBody,
         State_WritingMultipart,
+        State_WritingStream,
         State_Done
       };
 
@@ -105,6 +106,13 @@ namespace Orthanc
 
       void CloseMultipart();
 
+      void StartStream(const std::string& contentType);
+
+      void SendStreamItem(const void* item,
+                          size_t length);
+
+      void CloseStream();
+
       void CloseBody();
 
       State GetState() const
@@ -198,6 +206,10 @@ namespace Orthanc
 
     void SendUnauthorized(const std::string& realm);
 
+    // Answers with "416 Requested Range Not Satisfiable", together
+    // with the size of the resource (cf. RFC 7233, Section 4.4)
+    void SendRangeNotSatisfiable(uint64_t resourceSize);
+
     void StartMultipart(const std::string& subType,
                         const std::string& contentType)
     {
@@ -221,6 +233,39 @@ namespace Orthanc
       return stateMachine_.GetState() == StateMachine::State_WritingMultipart;
     }
 
+    /**
+     * Streams a body whose size is not known in advance, using the
+     * "chunked" transfer encoding of HTTP/1.1. Each item is sent as
+     * one chunk as soon as it is available. If the handler fails
+     * before "CloseStream()", the HTTP server closes the connection.
+     **/
+    void StartStream(const std::string& contentType)
+    {
+      stateMachine_.StartStream(contentType);
+    }
+
+    void SendStreamItem(const void* item,
+                        size_t size)
+    {
+      stateMachine_.SendStreamItem(item, size);
+    }
+
+    void CloseStream()
+    {
+      stateMachine_.CloseStream();
+    }
+
+    bool IsWritingStream() const
+    {
+      return stateMachine_.GetState() == StateMachine::State_WritingStream;
+    }
+
     void Answer(IHttpStreamAnswer& stream);
+
+    // Answers with "206 Partial Content": The stream only contains
+    // the bytes of the resource that start at offset "start"
+    void AnswerRange(IHttpStreamAnswer& stream,
+                     uint64_t start,
+                     uint64_t resourceSize);
   };
 }
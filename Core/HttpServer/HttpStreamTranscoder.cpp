@@ -34,6 +34,7 @@
 #include "HttpStreamTranscoder.h"
 
 #include "../OrthancException.h"
+#include "../Compression/Lz4Compressor.h"
 #include "../Compression/ZlibCompressor.h"
 
 #include <string.h>   // For memcpy()
@@ -109,6 +110,21 @@ namespace Orthanc
   }
 
 
+  HttpCompression HttpStreamTranscoder::SetupLz4Compression()
+  {
+    // No HTTP client understands LZ4: Always uncompress
+    std::string compressed;
+    ReadSource(compressed);
+
+    uncompressed_.reset(new BufferHttpSender);
+
+    Lz4Compressor compressor;
+    IBufferCompressor::Uncompress(uncompressed_->GetBuffer(), compressor, compressed);
+
+    return HttpCompression_None;
+  }
+
+
   HttpCompression HttpStreamTranscoder::SetupHttpCompression(bool gzipAllowed,
                                                              bool deflateAllowed)
   {
@@ -127,6 +143,9 @@ namespace Orthanc
       case CompressionType_ZlibWithSize:
         return SetupZlibCompression(deflateAllowed);
 
+      case CompressionType_Lz4WithSize:
+        return SetupLz4Compression();
+
       default:
         throw OrthancException(ErrorCode_NotImplemented);
     }
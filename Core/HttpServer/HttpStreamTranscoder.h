@@ -54,6 +54,8 @@ namespace Orthanc
 
     HttpCompression SetupZlibCompression(bool deflateAllowed);
 
+    HttpCompression SetupLz4Compression();
+
   public:
     HttpStreamTranscoder(IHttpStreamAnswer& source,
                          CompressionType compression) : 
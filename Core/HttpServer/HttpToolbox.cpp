@@ -36,9 +36,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <iostream>
+#include <boost/lexical_cast.hpp>
 
 #include "HttpOutput.h"
 #include "StringHttpOutput.h"
+#include "../OrthancException.h"
+#include "../Toolbox.h"
+
+#include <algorithm>
 
 
 static const char* LOCALHOST = "localhost";
@@ -198,6 +203,211 @@ namespace Orthanc
   }
 
 
+  static bool ParseRangeBound(uint64_t& result,
+                              const std::string& s)
+  {
+    if (s.empty() ||
+        s.find_first_not_of("0123456789") != std::string::npos)
+    {
+      return false;
+    }
+
+    try
+    {
+      result = boost::lexical_cast<uint64_t>(s);
+      return true;
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      return false;
+    }
+  }
+
+
+  bool HttpToolbox::ParseRange(uint64_t& start,
+                               uint64_t& length,
+                               const std::string& header,
+                               uint64_t size)
+  {
+    std::string s = Toolbox::StripSpaces(header);
+
+    if (s.compare(0, 6, "bytes=") != 0)
+    {
+      return false;
+    }
+
+    s = Toolbox::StripSpaces(s.substr(6));
+
+    size_t dash = s.find('-');
+    if (dash == std::string::npos ||
+        s.find(',') != std::string::npos)   // Multiple ranges are not supported
+    {
+      return false;
+    }
+
+    std::string first = Toolbox::StripSpaces(s.substr(0, dash));
+    std::string last = Toolbox::StripSpaces(s.substr(dash + 1));
+
+    uint64_t a, b;
+
+    if (first.empty())
+    {
+      // Suffix range, e.g. "bytes=-500" for the last 500 bytes
+      if (!ParseRangeBound(b, last))
+      {
+        return false;
+      }
+
+      if (b > size)
+      {
+        b = size;
+      }
+
+      start = size - b;
+      length = b;
+      return true;
+    }
+
+    if (!ParseRangeBound(a, first))
+    {
+      return false;
+    }
+
+    if (last.empty())
+    {
+      b = size;
+    }
+    else if (!ParseRangeBound(b, last))
+    {
+      return false;
+    }
+    else if (b < a)
+    {
+      return false;
+    }
+    else if (b >= size)
+    {
+      b = size;
+    }
+    else
+    {
+      b += 1;   // The last byte position is inclusive
+    }
+
+    if (a >= size)
+    {
+      // Not satisfiable
+      start = 0;
+      length = 0;
+    }
+    else
+    {
+      start = a;
+      length = b - a;
+    }
+
+    return true;
+  }
+
+
+  bool HttpToolbox::ParseMultipartBoundary(std::string& boundary,
+                                           const std::string& contentType)
+  {
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, contentType, ';');
+
+    if (tokens.empty() ||
+        Toolbox::StripSpaces(tokens[0]).compare(0, 10, "multipart/") != 0)
+    {
+      return false;
+    }
+
+    for (size_t i = 1; i < tokens.size(); i++)
+    {
+      std::string token = Toolbox::StripSpaces(tokens[i]);
+      if (token.compare(0, 9, "boundary=") == 0)
+      {
+        boundary = token.substr(9);
+
+        // Remove the optional quotes
+        if (boundary.size() >= 2 &&
+            boundary[0] == '"' &&
+            boundary[boundary.size() - 1] == '"')
+        {
+          boundary = boundary.substr(1, boundary.size() - 2);
+        }
+
+        return !boundary.empty();
+      }
+    }
+
+    return false;
+  }
+
+
+  void HttpToolbox::ParseMultipartBody(std::vector<MultipartPart>& parts,
+                                       const void* body,
+                                       size_t size,
+                                       const std::string& boundary)
+  {
+    parts.clear();
+
+    if (boundary.empty())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    const char* start = reinterpret_cast<const char*>(body);
+    const char* end = start + size;
+
+    // Locate the first delimiter, that might be preceded by a preamble
+    const std::string delimiter = "--" + boundary;
+    const char* current = std::search(start, end, delimiter.begin(), delimiter.end());
+
+    const std::string nextDelimiter = "\r\n" + delimiter;
+    const std::string headersEnd = "\r\n\r\n";
+
+    for (;;)
+    {
+      if (current == end)
+      {
+        throw OrthancException(ErrorCode_BadRequest);
+      }
+
+      current += delimiter.size();
+
+      if (end - current >= 2 &&
+          current[0] == '-' &&
+          current[1] == '-')
+      {
+        return;  // Final delimiter
+      }
+
+      // Skip the headers of the part (they are not used)
+      const char* headers = std::search(current, end, headersEnd.begin(), headersEnd.end());
+      if (headers == end)
+      {
+        throw OrthancException(ErrorCode_BadRequest);
+      }
+
+      const char* content = headers + headersEnd.size();
+      current = std::search(content, end, nextDelimiter.begin(), nextDelimiter.end());
+
+      if (current == end)
+      {
+        throw OrthancException(ErrorCode_BadRequest);
+      }
+
+      MultipartPart part;
+      part.data_ = content;
+      part.size_ = current - content;
+      parts.push_back(part);
+
+      current += 2;  // Skip the CR-LF before the delimiter
+    }
+  }
+
+
   bool HttpToolbox::SimpleGet(std::string& result,
                               IHttpHandler& handler,
                               RequestOrigin origin,
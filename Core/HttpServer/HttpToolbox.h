@@ -34,11 +34,20 @@
 
 #include "IHttpHandler.h"
 
+#include <vector>
+
 namespace Orthanc
 {
   class HttpToolbox
   {
   public:
+    // Part of a multipart body, as a pointer into this body
+    struct MultipartPart
+    {
+      const char*  data_;
+      size_t       size_;
+    };
+
     static void ParseGetArguments(IHttpHandler::GetArguments& result, 
                                   const char* query);
 
@@ -60,6 +69,30 @@ namespace Orthanc
     static void CompileGetArguments(IHttpHandler::Arguments& compiled,
                                     const IHttpHandler::GetArguments& source);
 
+    /**
+     * Parses the "Range" HTTP header for a resource of "size" bytes.
+     * Only one range of bytes is supported. Returns "false" if the
+     * header must be ignored (the whole resource is then sent). If the
+     * range cannot be satisfied, "true" is returned with "length == 0".
+     **/
+    static bool ParseRange(uint64_t& start,
+                           uint64_t& length,
+                           const std::string& header,
+                           uint64_t size);
+
+    /**
+     * Extracts the boundary from the "Content-Type" HTTP header of a
+     * multipart body (RFC 2046). Returns "false" if the body is not
+     * multipart.
+     **/
+    static bool ParseMultipartBoundary(std::string& boundary,
+                                       const std::string& contentType);
+
+    static void ParseMultipartBody(std::vector<MultipartPart>& parts,
+                                   const void* body,
+                                   size_t size,
+                                   const std::string& boundary);
+
     static bool SimpleGet(std::string& result,
                           IHttpHandler& handler,
                           RequestOrigin origin,
@@ -575,6 +575,36 @@ namespace Orthanc
   }
 
 
+  static void CloseConnectionAfterAnswer(const struct mg_request_info *request)
+  {
+    /**
+     * Once the callback has returned, Mongoose decides whether to keep
+     * the connection alive by looking at the "Connection" header and
+     * at the HTTP version of the request. Rewrite them, so that the
+     * socket is closed even if the client asked for keep-alive.
+     **/
+    static char connectionClose[] = "close";
+    static char http10[] = "1.0";
+
+    struct mg_request_info* info = const_cast<struct mg_request_info*>(request);
+
+    bool found = false;
+    for (int i = 0; i < info->num_headers; i++)
+    {
+      if (boost::iequals(info->http_headers[i].name, "Connection"))
+      {
+        info->http_headers[i].value = connectionClose;
+        found = true;
+      }
+    }
+
+    if (!found)
+    {
+      info->http_version = http10;
+    }
+  }
+
+
   static void InternalCallback(struct mg_connection *connection,
                                const struct mg_request_info *request)
   {
@@ -767,6 +797,16 @@ namespace Orthanc
         // was already set by the HTTP handler.
       }
 
+      if (output.IsWritingStream())
+      {
+        // The chunked body cannot be terminated, as the client would
+        // take the truncated answer as complete. Closing the
+        // connection is the only way to signal the error, and the
+        // next requests of a keep-alive client would be out of sync.
+        LOG(ERROR) << "Closing the HTTP connection, as the streamed answer was interrupted: " << request->uri;
+        CloseConnectionAfterAnswer(request);
+      }
+
       return;
     }
   }
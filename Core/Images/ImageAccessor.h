@@ -119,5 +119,12 @@ namespace Orthanc
                         void *buffer);
 
     void ToMatlabString(std::string& target) const; 
+
+    // Returns a view (without copy) over a rectangular region of
+    // this image, that shares the buffer and the read-only flag
+    ImageAccessor GetRegion(unsigned int x,
+                            unsigned int y,
+                            unsigned int width,
+                            unsigned int height) const;
   };
 }
@@ -37,13 +37,344 @@
 
 #include <boost/math/special_functions/round.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <string.h>
 #include <limits>
+#include <vector>
 #include <stdint.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+// SSE2 is part of the baseline of all the x86_64 CPUs, and can
+// therefore be used without any runtime detection
+#  define ORTHANC_IMAGE_PROCESSING_USE_SSE2  1
+#  include <emmintrin.h>
+#else
+#  define ORTHANC_IMAGE_PROCESSING_USE_SSE2  0
+#endif
+
 namespace Orthanc
 {
+  /**
+   * The "...Vectorized()" functions below process the beginning of
+   * one row of pixels, and return the number of pixels they have
+   * processed. The remaining pixels are processed by the scalar
+   * loops. The generic versions process no pixel at all, which
+   * makes the scalar loops the fallback for the platforms and the
+   * pixel formats that have no vectorized kernel.
+   **/
+
+  template <typename TargetType, typename SourceType>
+  static unsigned int ConvertVectorized(TargetType* target,
+                                        const SourceType* source,
+                                        unsigned int width)
+  {
+    return 0;
+  }
+
+
+  template <typename PixelType>
+  static unsigned int GetMinMaxValueVectorized(PixelType& minValue,
+                                               PixelType& maxValue,
+                                               const PixelType* source,
+                                               unsigned int width)
+  {
+    return 0;
+  }
+
+
+  template <typename TargetType, typename SourceType>
+  static unsigned int ShiftScaleVectorized(TargetType* target,
+                                           const SourceType* source,
+                                           unsigned int width,
+                                           float offset,
+                                           float scaling,
+                                           float minValue,
+                                           float maxValue)
+  {
+    return 0;
+  }
+
+
+#if ORTHANC_IMAGE_PROCESSING_USE_SSE2 == 1
+  static inline __m128i LoadSSE2(const void* p)
+  {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+
+
+  static inline void StoreSSE2(void* p,
+                               __m128i v)
+  {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+  }
+
+
+  // Expands 8 pixels of 16bpp as two vectors of 4 floats
+  static inline void ExpandSSE2(__m128& low,
+                                __m128& high,
+                                const uint16_t* source)
+  {
+    const __m128i v = LoadSSE2(source);
+    const __m128i zero = _mm_setzero_si128();
+    low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+    high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero));
+  }
+
+
+  static inline void ExpandSSE2(__m128& low,
+                                __m128& high,
+                                const int16_t* source)
+  {
+    // Sign extension of the 16bpp values to 32bpp
+    const __m128i v = LoadSSE2(source);
+    low = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+    high = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+  }
+
+
+  // Packs 8 integers that are known to fit the range of the target
+  static inline void NarrowSSE2(uint8_t* target,
+                                __m128i low,
+                                __m128i high)
+  {
+    const __m128i v = _mm_packs_epi32(low, high);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(target), _mm_packus_epi16(v, v));
+  }
+
+
+  static inline void NarrowSSE2(int16_t* target,
+                                __m128i low,
+                                __m128i high)
+  {
+    StoreSSE2(target, _mm_packs_epi32(low, high));
+  }
+
+
+  static inline void NarrowSSE2(uint16_t* target,
+                                __m128i low,
+                                __m128i high)
+  {
+    // SSE2 has no unsigned saturation from 32bpp to 16bpp: Go
+    // through the signed range
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(-32768);
+    const __m128i v = _mm_packs_epi32(_mm_sub_epi32(low, bias32), _mm_sub_epi32(high, bias32));
+    StoreSSE2(target, _mm_xor_si128(v, bias16));
+  }
+
+
+  /**
+   * Rounds to the nearest integer, halfway cases away from zero,
+   * exactly as "boost::math::iround()". The values must fit the
+   * range of "int32_t". This does not depend on the rounding mode
+   * of the FPU.
+   **/
+  static inline __m128i RoundSSE2(__m128 v)
+  {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 a = _mm_andnot_ps(signMask, v);   // Absolute value
+    const __m128i t = _mm_cvttps_epi32(a);         // Truncation
+
+    // The fractional part is computed exactly. Comparison masks are
+    // equal to -1, hence the subtraction to round upward.
+    const __m128 half = _mm_cmpge_ps(_mm_sub_ps(a, _mm_cvtepi32_ps(t)), _mm_set1_ps(0.5f));
+    const __m128i r = _mm_sub_epi32(t, _mm_castps_si128(half));
+
+    // Restore the sign: (r ^ s) - s negates "r" iff "s == -1"
+    const __m128i s = _mm_srai_epi32(_mm_castps_si128(v), 31);
+    return _mm_sub_epi32(_mm_xor_si128(r, s), s);
+  }
+
+
+  template <typename TargetType, typename SourceType>
+  static unsigned int ShiftScaleVectorized16(TargetType* target,
+                                             const SourceType* source,
+                                             unsigned int width,
+                                             float offset,
+                                             float scaling,
+                                             float minValue,
+                                             float maxValue)
+  {
+    const __m128 o = _mm_set1_ps(offset);
+    const __m128 s = _mm_set1_ps(scaling);
+    const __m128 a = _mm_set1_ps(minValue);
+    const __m128 b = _mm_set1_ps(maxValue);
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      __m128 low, high;
+      ExpandSSE2(low, high, source + x);
+
+      // Same operations, in the same order, as in the scalar loop
+      low = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(low, o), s), a), b);
+      high = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_add_ps(high, o), s), a), b);
+
+      NarrowSSE2(target + x, RoundSSE2(low), RoundSSE2(high));
+    }
+
+    return x;
+  }
+
+
+#define ORTHANC_SHIFT_SCALE_VECTORIZED(TargetType, SourceType)          \
+  template <>                                                           \
+  unsigned int ShiftScaleVectorized<TargetType, SourceType>(TargetType* target, \
+                                                            const SourceType* source, \
+                                                            unsigned int width, \
+                                                            float offset, \
+                                                            float scaling, \
+                                                            float minValue, \
+                                                            float maxValue) \
+  {                                                                     \
+    return ShiftScaleVectorized16<TargetType, SourceType>               \
+      (target, source, width, offset, scaling, minValue, maxValue);     \
+  }
+
+  ORTHANC_SHIFT_SCALE_VECTORIZED(uint8_t, uint16_t)
+  ORTHANC_SHIFT_SCALE_VECTORIZED(uint8_t, int16_t)
+  ORTHANC_SHIFT_SCALE_VECTORIZED(uint16_t, uint16_t)
+  ORTHANC_SHIFT_SCALE_VECTORIZED(int16_t, int16_t)
+
+#undef ORTHANC_SHIFT_SCALE_VECTORIZED
+
+
+  template <>
+  unsigned int ConvertVectorized<uint8_t, int16_t>(uint8_t* target,
+                                                   const int16_t* source,
+                                                   unsigned int width)
+  {
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      // Saturation of signed 16bpp values to the [0,255] range
+      StoreSSE2(target + x, _mm_packus_epi16(LoadSSE2(source + x), LoadSSE2(source + x + 8)));
+    }
+
+    return x;
+  }
+
+
+  template <>
+  unsigned int ConvertVectorized<uint8_t, uint16_t>(uint8_t* target,
+                                                    const uint16_t* source,
+                                                    unsigned int width)
+  {
+    // "v - subs(v, 255)" equals "min(v, 255)" for unsigned values,
+    // which are then in the range of the signed saturation
+    const __m128i c = _mm_set1_epi16(255);
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      __m128i a = LoadSSE2(source + x);
+      __m128i b = LoadSSE2(source + x + 8);
+      a = _mm_sub_epi16(a, _mm_subs_epu16(a, c));
+      b = _mm_sub_epi16(b, _mm_subs_epu16(b, c));
+      StoreSSE2(target + x, _mm_packus_epi16(a, b));
+    }
+
+    return x;
+  }
+
+
+  template <>
+  unsigned int GetMinMaxValueVectorized<uint8_t>(uint8_t& minValue,
+                                                 uint8_t& maxValue,
+                                                 const uint8_t* source,
+                                                 unsigned int width)
+  {
+    if (width < 16)
+    {
+      return 0;
+    }
+
+    __m128i a = _mm_set1_epi8(static_cast<char>(minValue));
+    __m128i b = _mm_set1_epi8(static_cast<char>(maxValue));
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+      const __m128i v = LoadSSE2(source + x);
+      a = _mm_min_epu8(a, v);
+      b = _mm_max_epu8(b, v);
+    }
+
+    uint8_t tmpMin[16], tmpMax[16];
+    StoreSSE2(tmpMin, a);
+    StoreSSE2(tmpMax, b);
+
+    for (unsigned int i = 0; i < 16; i++)
+    {
+      minValue = std::min(minValue, tmpMin[i]);
+      maxValue = std::max(maxValue, tmpMax[i]);
+    }
+
+    return x;
+  }
+
+
+  // SSE2 only provides the signed min/max on 16bpp: Unsigned values
+  // are biased by 32768 by flipping their most significant bit
+  template <typename PixelType, int16_t bias>
+  static unsigned int GetMinMaxValueVectorized16(PixelType& minValue,
+                                                 PixelType& maxValue,
+                                                 const PixelType* source,
+                                                 unsigned int width)
+  {
+    if (width < 8)
+    {
+      return 0;
+    }
+
+    const __m128i c = _mm_set1_epi16(bias);
+    __m128i a = _mm_xor_si128(_mm_set1_epi16(static_cast<int16_t>(minValue)), c);
+    __m128i b = _mm_xor_si128(_mm_set1_epi16(static_cast<int16_t>(maxValue)), c);
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+      const __m128i v = _mm_xor_si128(LoadSSE2(source + x), c);
+      a = _mm_min_epi16(a, v);
+      b = _mm_max_epi16(b, v);
+    }
+
+    PixelType tmpMin[8], tmpMax[8];
+    StoreSSE2(tmpMin, _mm_xor_si128(a, c));
+    StoreSSE2(tmpMax, _mm_xor_si128(b, c));
+
+    for (unsigned int i = 0; i < 8; i++)
+    {
+      minValue = std::min(minValue, tmpMin[i]);
+      maxValue = std::max(maxValue, tmpMax[i]);
+    }
+
+    return x;
+  }
+
+
+  template <>
+  unsigned int GetMinMaxValueVectorized<uint16_t>(uint16_t& minValue,
+                                                  uint16_t& maxValue,
+                                                  const uint16_t* source,
+                                                  unsigned int width)
+  {
+    return GetMinMaxValueVectorized16<uint16_t, -32768>(minValue, maxValue, source, width);
+  }
+
+
+  template <>
+  unsigned int GetMinMaxValueVectorized<int16_t>(int16_t& minValue,
+                                                 int16_t& maxValue,
+                                                 const int16_t* source,
+                                                 unsigned int width)
+  {
+    return GetMinMaxValueVectorized16<int16_t, 0>(minValue, maxValue, source, width);
+  }
+#endif
+
+
   template <typename TargetType, typename SourceType>
   static void ConvertInternal(ImageAccessor& target,
                               const ImageAccessor& source)
@@ -56,7 +387,11 @@ namespace Orthanc
       TargetType* t = reinterpret_cast<TargetType*>(target.GetRow(y));
       const SourceType* s = reinterpret_cast<const SourceType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < source.GetWidth(); x++, t++, s++)
+      unsigned int x = ConvertVectorized<TargetType, SourceType>(t, s, source.GetWidth());
+      t += x;
+      s += x;
+
+      for (; x < source.GetWidth(); x++, t++, s++)
       {
         if (static_cast<int32_t>(*s) < static_cast<int32_t>(minValue))
         {
@@ -150,7 +485,10 @@ namespace Orthanc
     {
       const PixelType* p = reinterpret_cast<const PixelType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < source.GetWidth(); x++, p++)
+      unsigned int x = GetMinMaxValueVectorized<PixelType>(minValue, maxValue, p, source.GetWidth());
+      p += x;
+
+      for (; x < source.GetWidth(); x++, p++)
       {
         if (*p < minValue)
         {
@@ -205,70 +543,149 @@ namespace Orthanc
 
 
 
-  template <typename PixelType>
-  void MultiplyConstantInternal(ImageAccessor& image,
-                                float factor)
+  template <typename TargetType, typename SourceType>
+  static void ShiftScaleInternal(ImageAccessor& target,
+                                 const ImageAccessor& source,
+                                 float offset,
+                                 float scaling)
   {
-    if (std::abs(factor - 1.0f) <= std::numeric_limits<float>::epsilon())
-    {
-      return;
-    }
-
-    const int64_t minValue = std::numeric_limits<PixelType>::min();
-    const int64_t maxValue = std::numeric_limits<PixelType>::max();
+    const float minValue = static_cast<float>(std::numeric_limits<TargetType>::min());
+    const float maxValue = static_cast<float>(std::numeric_limits<TargetType>::max());
 
-    for (unsigned int y = 0; y < image.GetHeight(); y++)
+    for (unsigned int y = 0; y < source.GetHeight(); y++)
     {
-      PixelType* p = reinterpret_cast<PixelType*>(image.GetRow(y));
+      TargetType* t = reinterpret_cast<TargetType*>(target.GetRow(y));
+      const SourceType* s = reinterpret_cast<const SourceType*>(source.GetConstRow(y));
 
-      for (unsigned int x = 0; x < image.GetWidth(); x++, p++)
+      unsigned int x = ShiftScaleVectorized<TargetType, SourceType>
+        (t, s, source.GetWidth(), offset, scaling, minValue, maxValue);
+      t += x;
+      s += x;
+
+      for (; x < source.GetWidth(); x++, t++, s++)
       {
-        int64_t v = boost::math::llround(static_cast<float>(*p) * factor);
+        float v = (static_cast<float>(*s) + offset) * scaling;
 
         if (v > maxValue)
         {
-          *p = std::numeric_limits<PixelType>::max();
+          *t = std::numeric_limits<TargetType>::max();
         }
         else if (v < minValue)
         {
-          *p = std::numeric_limits<PixelType>::min();
+          *t = std::numeric_limits<TargetType>::min();
         }
         else
         {
-          *p = static_cast<PixelType>(v);
+          *t = static_cast<TargetType>(boost::math::iround(v));
         }
       }
     }
   }
 
 
-  template <typename PixelType>
-  void ShiftScaleInternal(ImageAccessor& image,
-                          float offset,
-                          float scaling)
+  template <typename TargetType>
+  static void ShiftScaleInternal(ImageAccessor& target,
+                                 const ImageAccessor& source,
+                                 float offset,
+                                 float scaling)
   {
-    const float minValue = static_cast<float>(std::numeric_limits<PixelType>::min());
-    const float maxValue = static_cast<float>(std::numeric_limits<PixelType>::max());
+    switch (source.GetFormat())
+    {
+      case PixelFormat_Grayscale8:
+        ShiftScaleInternal<TargetType, uint8_t>(target, source, offset, scaling);
+        return;
 
-    for (unsigned int y = 0; y < image.GetHeight(); y++)
+      case PixelFormat_Grayscale16:
+        ShiftScaleInternal<TargetType, uint16_t>(target, source, offset, scaling);
+        return;
+
+      case PixelFormat_SignedGrayscale16:
+        ShiftScaleInternal<TargetType, int16_t>(target, source, offset, scaling);
+        return;
+
+      default:
+        throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
+
+
+  // Range of the source samples that are averaged to compute each
+  // target sample, along one dimension
+  static void ComputeResizeRanges(std::vector<unsigned int>& start,
+                                  std::vector<unsigned int>& end,
+                                  unsigned int sourceSize,
+                                  unsigned int targetSize)
+  {
+    start.resize(targetSize);
+    end.resize(targetSize);
+
+    for (unsigned int i = 0; i < targetSize; i++)
     {
-      PixelType* p = reinterpret_cast<PixelType*>(image.GetRow(y));
+      start[i] = static_cast<unsigned int>(static_cast<uint64_t>(i) * sourceSize / targetSize);
+      end[i] = static_cast<unsigned int>(static_cast<uint64_t>(i + 1) * sourceSize / targetSize);
 
-      for (unsigned int x = 0; x < image.GetWidth(); x++, p++)
+      if (end[i] <= start[i])
       {
-        float v = (static_cast<float>(*p) + offset) * scaling;
+        // Upsampling: Nearest neighbor
+        end[i] = start[i] + 1;
+      }
 
-        if (v > maxValue)
-        {
-          *p = std::numeric_limits<PixelType>::max();
-        }
-        else if (v < minValue)
+      assert(end[i] <= sourceSize);
+    }
+  }
+
+
+  template <typename PixelType, 
+            unsigned int Channels>
+  static void ResizeInternal(ImageAccessor& target,
+                             const ImageAccessor& source)
+  {
+    std::vector<unsigned int> startX, endX, startY, endY;
+    ComputeResizeRanges(startX, endX, source.GetWidth(), target.GetWidth());
+    ComputeResizeRanges(startY, endY, source.GetHeight(), target.GetHeight());
+
+    std::vector<int64_t> sums(target.GetWidth() * Channels);
+
+    for (unsigned int y = 0; y < target.GetHeight(); y++)
+    {
+      std::fill(sums.begin(), sums.end(), 0);
+
+      for (unsigned int sy = startY[y]; sy < endY[y]; sy++)
+      {
+        const PixelType* s = reinterpret_cast<const PixelType*>(source.GetConstRow(sy));
+        int64_t* sum = &sums[0];
+
+        for (unsigned int x = 0; x < target.GetWidth(); x++, sum += Channels)
         {
-          *p = std::numeric_limits<PixelType>::min();
+          for (const PixelType* p = s + startX[x] * Channels; p < s + endX[x] * Channels; p += Channels)
+          {
+            for (unsigned int c = 0; c < Channels; c++)
+            {
+              sum[c] += static_cast<int64_t>(p[c]);
+            }
+          }
         }
-        else
+      }
+
+      PixelType* t = reinterpret_cast<PixelType*>(target.GetRow(y));
+      const int64_t* sum = &sums[0];
+
+      for (unsigned int x = 0; x < target.GetWidth(); x++, sum += Channels, t += Channels)
+      {
+        const int64_t count = (static_cast<int64_t>(endX[x] - startX[x]) *
+                               static_cast<int64_t>(endY[y] - startY[y]));
+
+        for (unsigned int c = 0; c < Channels; c++)
         {
-          *p = static_cast<PixelType>(boost::math::iround(v));
+          // Round to the nearest integer, halfway cases away from zero
+          if (sum[c] >= 0)
+          {
+            t[c] = static_cast<PixelType>((sum[c] + count / 2) / count);
+          }
+          else
+          {
+            t[c] = static_cast<PixelType>(-((-sum[c] + count / 2) / count));
+          }
         }
       }
     }
@@ -547,18 +964,51 @@ namespace Orthanc
   void ImageProcessing::MultiplyConstant(ImageAccessor& image,
                                          float factor)
   {
-    switch (image.GetFormat())
+    if (std::abs(factor - 1.0f) <= std::numeric_limits<float>::epsilon())
+    {
+      return;
+    }
+
+    /**
+     * Rounding then saturating the product (as done in the previous
+     * versions of Orthanc) is equivalent to saturating then rounding
+     * it, which is what "ShiftScale()" does with a zero offset.
+     **/
+    ShiftScale(image, image, 0.0f, factor);
+  }
+
+
+  void ImageProcessing::ShiftScale(ImageAccessor& image,
+                                   float offset,
+                                   float scaling)
+  {
+    ShiftScale(image, image, offset, scaling);
+  }
+
+
+  void ImageProcessing::ShiftScale(ImageAccessor& target,
+                                   const ImageAccessor& source,
+                                   float offset,
+                                   float scaling)
+  {
+    if (target.GetWidth() != source.GetWidth() ||
+        target.GetHeight() != source.GetHeight())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    switch (target.GetFormat())
     {
       case PixelFormat_Grayscale8:
-        MultiplyConstantInternal<uint8_t>(image, factor);
+        ShiftScaleInternal<uint8_t>(target, source, offset, scaling);
         return;
 
       case PixelFormat_Grayscale16:
-        MultiplyConstantInternal<uint16_t>(image, factor);
+        ShiftScaleInternal<uint16_t>(target, source, offset, scaling);
         return;
 
       case PixelFormat_SignedGrayscale16:
-        MultiplyConstantInternal<int16_t>(image, factor);
+        ShiftScaleInternal<int16_t>(target, source, offset, scaling);
         return;
 
       default:
@@ -567,26 +1017,89 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::ShiftScale(ImageAccessor& image,
-                                   float offset,
-                                   float scaling)
+  void ImageProcessing::Resize(ImageAccessor& target,
+                               const ImageAccessor& source)
   {
-    switch (image.GetFormat())
+    if (target.GetFormat() != source.GetFormat())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageFormat);
+    }
+
+    if (target.GetWidth() == 0 ||
+        target.GetHeight() == 0)
+    {
+      return;
+    }
+
+    if (source.GetWidth() == 0 ||
+        source.GetHeight() == 0)
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    if (target.GetWidth() == source.GetWidth() &&
+        target.GetHeight() == source.GetHeight())
+    {
+      Copy(target, source);
+      return;
+    }
+
+    switch (source.GetFormat())
     {
       case PixelFormat_Grayscale8:
-        ShiftScaleInternal<uint8_t>(image, offset, scaling);
+        ResizeInternal<uint8_t, 1>(target, source);
         return;
 
       case PixelFormat_Grayscale16:
-        ShiftScaleInternal<uint16_t>(image, offset, scaling);
+        ResizeInternal<uint16_t, 1>(target, source);
         return;
 
       case PixelFormat_SignedGrayscale16:
-        ShiftScaleInternal<int16_t>(image, offset, scaling);
+        ResizeInternal<int16_t, 1>(target, source);
+        return;
+
+      case PixelFormat_RGB24:
+        ResizeInternal<uint8_t, 3>(target, source);
+        return;
+
+      case PixelFormat_RGBA32:
+        ResizeInternal<uint8_t, 4>(target, source);
         return;
 
       default:
         throw OrthancException(ErrorCode_NotImplemented);
     }
   }
+
+
+  void ImageProcessing::ApplyWindowing(ImageAccessor& target,
+                                       const ImageAccessor& source,
+                                       float windowCenter,
+                                       float windowWidth,
+                                       float rescaleSlope,
+                                       float rescaleIntercept)
+  {
+    if (target.GetFormat() != PixelFormat_Grayscale8)
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageFormat);
+    }
+
+    if (windowWidth < 1.0f ||
+        std::abs(rescaleSlope) <= std::numeric_limits<float>::epsilon())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    /**
+     * The VOI LUT maps the modality value "m" to "(m - low) * 255 /
+     * (width - 1)", with "low = center - 0.5 - (width - 1) / 2",
+     * saturated to [0,255]. As "m = slope * stored + intercept", the
+     * whole transform is one single "ShiftScale()" of the stored
+     * values.
+     **/
+    const float range = (windowWidth > 1.0f ? windowWidth - 1.0f : 1.0f);
+    const float low = windowCenter - 0.5f - (windowWidth - 1.0f) / 2.0f;
+
+    ShiftScale(target, source, (rescaleIntercept - low) / rescaleSlope, 255.0f * rescaleSlope / range);
+  }
 }
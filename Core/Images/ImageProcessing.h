@@ -66,5 +66,29 @@ namespace Orthanc
     static void ShiftScale(ImageAccessor& image,
                            float offset,
                            float scaling);
+
+    // Same as "ShiftScale()", but the result is written to another
+    // image, whose pixel format gives the range of saturation
+    static void ShiftScale(ImageAccessor& target,
+                           const ImageAccessor& source,
+                           float offset,
+                           float scaling);
+
+    // Area averaging if the target is smaller than the source
+    // (nearest neighbor otherwise). Both images must have the same
+    // pixel format.
+    static void Resize(ImageAccessor& target,
+                       const ImageAccessor& source);
+
+    // Linear VOI LUT of DICOM (PS 3.3 C.11.2.1.2) applied to the
+    // stored values of a grayscale image, after their conversion
+    // through the modality LUT (slope and intercept). The target
+    // must be grayscale 8bpp.
+    static void ApplyWindowing(ImageAccessor& target,
+                               const ImageAccessor& source,
+                               float windowCenter,
+                               float windowWidth,
+                               float rescaleSlope,
+                               float rescaleIntercept);
   };
 }
@@ -44,46 +44,88 @@ namespace Orthanc
     class Worker
     {
     private:
-      const bool&           continue_;
-      SharedMessageQueue&   queue_;
-      boost::thread         thread_;
+      PImpl&         pool_;
+      bool           finished_;   // Protected by the mutex of the pool
+      boost::thread  thread_;
  
       static void WorkerThread(Worker* that)
       {
-        while (that->continue_)
+        PImpl& pool = that->pool_;
+        unsigned int idle = 0;  // Milliseconds since the last runnable
+
+        while (pool.continue_)
         {
-          std::auto_ptr<IDynamicObject>  obj(that->queue_.Dequeue(100));
-          if (obj.get() != NULL)
+          std::auto_ptr<IDynamicObject>  obj(pool.queue_.Dequeue(100));
+          if (obj.get() == NULL)
+          {
+            idle += 100;
+
+            boost::mutex::scoped_lock lock(pool.mutex_);
+
+            if (idle >= pool.idleTimeout_ &&
+                pool.countWorkers_ > pool.minWorkers_ &&
+                pool.countWorkers_ > pool.countRunnables_)
+            {
+              // This worker is not needed anymore
+              pool.countWorkers_--;
+              that->finished_ = true;
+              return;
+            }
+          }
+          else
           {
+            idle = 0;
+
+            {
+              boost::mutex::scoped_lock lock(pool.mutex_);
+              pool.countActive_++;
+            }
+
+            bool wishToContinue = false;
+
             try
             {
               IRunnableBySteps& runnable = *dynamic_cast<IRunnableBySteps*>(obj.get());
             
-              bool wishToContinue = runnable.Step();
+              wishToContinue = runnable.Step();
+            }
+            catch (OrthancException& e)
+            {
+              LOG(ERROR) << "Exception in a pool of working threads: " << e.What();
+            }
+
+            {
+              boost::mutex::scoped_lock lock(pool.mutex_);
+              pool.countActive_--;
 
-              if (wishToContinue)
+              if (!wishToContinue)
               {
-                // The runnable wishes to continue, reinsert it at the beginning of the queue
-                that->queue_.Enqueue(obj.release());
+                pool.countRunnables_--;
               }
             }
-            catch (OrthancException& e)
+
+            if (wishToContinue)
             {
-              LOG(ERROR) << "Exception in a pool of working threads: " << e.What();
+              // The runnable wishes to continue, reinsert it at the beginning of the queue
+              pool.queue_.Enqueue(obj.release());
             }
           }
         }
       }
 
     public:
-      Worker(const bool& globalContinue,
-             SharedMessageQueue& queue) : 
-        continue_(globalContinue),
-        queue_(queue)
+      Worker(PImpl& pool) : 
+        pool_(pool),
+        finished_(false)
       {
         thread_ = boost::thread(WorkerThread, this);
       }
 
+      bool IsFinished() const
+      {
+        return finished_;
+      }
+
       void Join()
       {
         if (thread_.joinable())
@@ -94,28 +136,85 @@ namespace Orthanc
     };
 
 
+    typedef std::list<Worker*>  Workers;
+
+    boost::mutex          mutex_;
     bool                  continue_;
-    std::vector<Worker*>  workers_;
+    Workers               workers_;
+    size_t                minWorkers_;
+    size_t                maxWorkers_;
+    size_t                countWorkers_;    // Number of workers that are not finished
+    size_t                countRunnables_;
+    size_t                countActive_;
+    unsigned int          idleTimeout_;     // In milliseconds
     SharedMessageQueue    queue_;
-  };
 
 
+    void StartWorker()
+    {
+      // WARNING: The mutex must be locked
+      workers_.push_back(new Worker(*this));
+      countWorkers_++;
+    }
 
-  RunnableWorkersPool::RunnableWorkersPool(size_t countWorkers) : pimpl_(new PImpl)
-  {
-    pimpl_->continue_ = true;
 
-    if (countWorkers == 0)
+    void RemoveFinishedWorkers()
     {
-      throw OrthancException(ErrorCode_ParameterOutOfRange);
+      // WARNING: The mutex must be locked
+      Workers::iterator it = workers_.begin();
+      while (it != workers_.end())
+      {
+        if ((*it)->IsFinished())
+        {
+          (*it)->Join();
+          delete *it;
+          it = workers_.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
     }
 
-    pimpl_->workers_.resize(countWorkers);
 
-    for (size_t i = 0; i < countWorkers; i++)
+    void Setup(size_t minWorkers,
+               size_t maxWorkers)
     {
-      pimpl_->workers_[i] = new PImpl::Worker(pimpl_->continue_, pimpl_->queue_);
+      if (maxWorkers == 0 ||
+          minWorkers > maxWorkers)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      continue_ = true;
+      minWorkers_ = minWorkers;
+      maxWorkers_ = maxWorkers;
+      countWorkers_ = 0;
+      countRunnables_ = 0;
+      countActive_ = 0;
+      idleTimeout_ = 10000;  // 10 seconds
+
+      boost::mutex::scoped_lock lock(mutex_);
+      for (size_t i = 0; i < minWorkers; i++)
+      {
+        StartWorker();
+      }
     }
+  };
+
+
+
+  RunnableWorkersPool::RunnableWorkersPool(size_t countWorkers) : pimpl_(new PImpl)
+  {
+    pimpl_->Setup(countWorkers, countWorkers);
+  }
+
+
+  RunnableWorkersPool::RunnableWorkersPool(size_t minWorkers,
+                                           size_t maxWorkers) : pimpl_(new PImpl)
+  {
+    pimpl_->Setup(minWorkers, maxWorkers);
   }
 
 
@@ -125,15 +224,19 @@ namespace Orthanc
     {
       pimpl_->continue_ = false;
 
-      for (size_t i = 0; i < pimpl_->workers_.size(); i++)
+      // No worker can be started anymore, as "Add()" would fail. The
+      // workers are joined without the mutex, that they might need.
+      PImpl::Workers workers;
+
       {
-        PImpl::Worker* worker = pimpl_->workers_[i];
+        boost::mutex::scoped_lock lock(pimpl_->mutex_);
+        workers.swap(pimpl_->workers_);
+      }
 
-        if (worker != NULL)
-        {
-          worker->Join();
-          delete worker;
-        }
+      for (PImpl::Workers::iterator it = workers.begin(); it != workers.end(); ++it)
+      {
+        (*it)->Join();
+        delete *it;
       }
     }
   }
@@ -152,6 +255,40 @@ namespace Orthanc
       throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
 
+    {
+      boost::mutex::scoped_lock lock(pimpl_->mutex_);
+
+      pimpl_->RemoveFinishedWorkers();
+      pimpl_->countRunnables_++;
+
+      if (pimpl_->countRunnables_ > pimpl_->countWorkers_ &&
+          pimpl_->countWorkers_ < pimpl_->maxWorkers_)
+      {
+        pimpl_->StartWorker();
+      }
+    }
+
     pimpl_->queue_.Enqueue(runnable);
   }
+
+
+  void RunnableWorkersPool::SetIdleTimeout(unsigned int milliseconds)
+  {
+    boost::mutex::scoped_lock lock(pimpl_->mutex_);
+    pimpl_->idleTimeout_ = milliseconds;
+  }
+
+
+  void RunnableWorkersPool::GetStatistics(Statistics& target)
+  {
+    boost::mutex::scoped_lock lock(pimpl_->mutex_);
+
+    pimpl_->RemoveFinishedWorkers();
+
+    target.countWorkers_ = pimpl_->countWorkers_;
+    target.minWorkers_ = pimpl_->minWorkers_;
+    target.maxWorkers_ = pimpl_->maxWorkers_;
+    target.countRunnables_ = pimpl_->countRunnables_;
+    target.countActive_ = pimpl_->countActive_;
+  }
 }
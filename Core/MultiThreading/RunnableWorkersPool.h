@@ -38,8 +38,25 @@
 
 namespace Orthanc
 {
+  /**
+   * Pool of threads that run the steps of the runnables. The number
+   * of workers ranges between a minimum and a maximum: A worker is
+   * started whenever there are more runnables than workers (until the
+   * maximum is reached), and a worker stops once it has been idle for
+   * longer than the idle timeout (until the minimum is reached).
+   **/
   class RunnableWorkersPool : public boost::noncopyable
   {
+  public:
+    struct Statistics
+    {
+      size_t  countWorkers_;
+      size_t  minWorkers_;
+      size_t  maxWorkers_;
+      size_t  countRunnables_;  // Runnables that are not finished yet
+      size_t  countActive_;     // Runnables whose step is being run
+    };
+
   private:
     struct PImpl;
     boost::shared_ptr<PImpl> pimpl_;
@@ -47,10 +64,18 @@ namespace Orthanc
     void Stop();
 
   public:
+    // Pool with a fixed number of workers
     RunnableWorkersPool(size_t countWorkers);
 
+    RunnableWorkersPool(size_t minWorkers,
+                        size_t maxWorkers);
+
     ~RunnableWorkersPool();
 
     void Add(IRunnableBySteps* runnable);  // Takes the ownership
+
+    void SetIdleTimeout(unsigned int milliseconds);
+
+    void GetStatistics(Statistics& target);
   };
 }
@@ -63,6 +63,6 @@ namespace Orthanc
       condition_.wait(lock);
     }
 
-    count_++;
+    count_--;
   }
 }
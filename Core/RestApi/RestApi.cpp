@@ -213,6 +213,11 @@ namespace Orthanc
     Arguments compiled;
     HttpToolbox::CompileGetArguments(compiled, getArguments);
 
+    if (compiled.find("pretty") != compiled.end())
+    {
+      wrappedOutput.SetPrettyPrint(true);
+    }
+
     HttpHandlerVisitor visitor(*this, wrappedOutput, origin, remoteIp, username, 
                                method, headers, compiled, bodyData, bodySize);
 
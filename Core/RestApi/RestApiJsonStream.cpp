@@ -0,0 +1,296 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "RestApiJsonStream.h"
+
+#include "../OrthancException.h"
+
+namespace Orthanc
+{
+  // Size of the chunks that are sent to the HTTP client
+  static const size_t FLUSH_SIZE = 64 * 1024;
+
+
+  RestApiJsonStream::RestApiJsonStream(RestApiOutput& output) :
+    output_(output),
+    streamed_(!output.IsConvertJsonToXml() && !output.IsPrettyPrint()),
+    started_(false),
+    hasRoot_(false),
+    hasKey_(false),
+    closed_(false)
+  {
+  }
+
+
+  void RestApiJsonStream::Flush()
+  {
+    if (!buffer_.empty())
+    {
+      if (!started_)
+      {
+        output_.StartStream("application/json", "");
+        started_ = true;
+      }
+
+      output_.SendStreamItem(buffer_.c_str(), buffer_.size());
+      buffer_.clear();
+    }
+  }
+
+
+  void RestApiJsonStream::Write(const std::string& s)
+  {
+    buffer_.append(s);
+
+    if (buffer_.size() >= FLUSH_SIZE)
+    {
+      Flush();
+    }
+  }
+
+
+  Json::Value& RestApiJsonStream::AddNode(const Json::Value& value)
+  {
+    if (levels_.empty())
+    {
+      root_ = value;
+      return root_;
+    }
+    else if (levels_.back().isObject_)
+    {
+      Json::Value& node = (*levels_.back().node_) [key_];
+      node = value;
+      return node;
+    }
+    else
+    {
+      return levels_.back().node_->append(value);
+    }
+  }
+
+
+  void RestApiJsonStream::StartItem()
+  {
+    if (closed_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (levels_.empty())
+    {
+      if (hasRoot_)
+      {
+        // Only one root value can be written
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      hasRoot_ = true;
+    }
+    else if (levels_.back().isObject_)
+    {
+      if (!hasKey_)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      // The separator was written together with the key
+      hasKey_ = false;
+    }
+    else
+    {
+      if (streamed_ && !levels_.back().isEmpty_)
+      {
+        Write(",");
+      }
+
+      levels_.back().isEmpty_ = false;
+    }
+  }
+
+
+  void RestApiJsonStream::WriteFlat(const Json::Value& value)
+  {
+    StartItem();
+
+    if (streamed_)
+    {
+      Json::FastWriter writer;
+      std::string s = writer.write(value);
+
+      // Remove the trailing end-of-line added by "FastWriter"
+      if (!s.empty() &&
+          s[s.size() - 1] == '\n')
+      {
+        s.resize(s.size() - 1);
+      }
+
+      Write(s);
+    }
+    else
+    {
+      AddNode(value);
+    }
+  }
+
+
+  void RestApiJsonStream::StartContainer(bool isObject)
+  {
+    StartItem();
+
+    Level level;
+    level.isObject_ = isObject;
+    level.isEmpty_ = true;
+    level.node_ = NULL;
+
+    if (streamed_)
+    {
+      Write(isObject ? "{" : "[");
+    }
+    else
+    {
+      level.node_ = &AddNode(isObject ? Json::objectValue : Json::arrayValue);
+    }
+
+    levels_.push_back(level);
+  }
+
+
+  void RestApiJsonStream::EndContainer(bool isObject)
+  {
+    if (levels_.empty() ||
+        levels_.back().isObject_ != isObject ||
+        hasKey_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    levels_.pop_back();
+
+    if (streamed_)
+    {
+      Write(isObject ? "}" : "]");
+    }
+  }
+
+
+  void RestApiJsonStream::WriteKey(const std::string& key)
+  {
+    if (closed_ ||
+        levels_.empty() ||
+        !levels_.back().isObject_ ||
+        hasKey_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (streamed_)
+    {
+      if (!levels_.back().isEmpty_)
+      {
+        Write(",");
+      }
+
+      Write(Json::valueToQuotedString(key.c_str()) + ":");
+    }
+    else
+    {
+      key_ = key;
+    }
+
+    levels_.back().isEmpty_ = false;
+    hasKey_ = true;
+  }
+
+
+  void RestApiJsonStream::WriteValue(const Json::Value& value)
+  {
+    if (!streamed_)
+    {
+      WriteFlat(value);
+    }
+    else if (value.type() == Json::objectValue)
+    {
+      Json::Value::Members members = value.getMemberNames();
+
+      StartObject();
+      for (size_t i = 0; i < members.size(); i++)
+      {
+        WriteKey(members[i]);
+        WriteFlat(value[members[i]]);
+      }
+      EndObject();
+    }
+    else if (value.type() == Json::arrayValue)
+    {
+      StartArray();
+      for (Json::Value::ArrayIndex i = 0; i < value.size(); i++)
+      {
+        WriteFlat(value[i]);
+      }
+      EndArray();
+    }
+    else
+    {
+      WriteFlat(value);
+    }
+  }
+
+
+  void RestApiJsonStream::Close()
+  {
+    if (closed_ ||
+        !hasRoot_ ||
+        !levels_.empty())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    closed_ = true;
+
+    if (!streamed_)
+    {
+      output_.AnswerJson(root_);
+    }
+    else if (started_)
+    {
+      Flush();
+      output_.CloseStream();
+    }
+    else
+    {
+      // The answer is small enough to be sent at once
+      output_.AnswerBuffer(buffer_, "application/json");
+    }
+  }
+}
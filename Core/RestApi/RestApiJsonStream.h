@@ -0,0 +1,129 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "RestApiOutput.h"
+
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * Incremental writer of a JSON answer. The answer is rendered in
+   * its compact form and sent to the HTTP client as soon as enough
+   * bytes are available, through the "chunked" transfer encoding:
+   * Only the item being written is kept in memory, never the full
+   * answer. Small answers are sent at once, as with
+   * "RestApiOutput::AnswerJson()". If the client asks for XML or for
+   * pretty-printing, the JSON tree is built in memory instead, and
+   * answered with "RestApiOutput::AnswerJson()" on "Close()".
+   *
+   * If an error occurs once the first chunk is sent, the answer
+   * cannot be turned into an error status anymore: The HTTP server
+   * closes the connection, so that the client notices the truncated
+   * document.
+   **/
+  class RestApiJsonStream : public boost::noncopyable
+  {
+  private:
+    struct Level
+    {
+      bool          isObject_;
+      bool          isEmpty_;
+      Json::Value*  node_;   // Only used if the answer is not streamed
+    };
+
+    RestApiOutput&      output_;
+    bool                streamed_;
+    bool                started_;
+    bool                hasRoot_;
+    bool                hasKey_;
+    bool                closed_;
+    std::string         key_;
+    std::string         buffer_;
+    std::vector<Level>  levels_;
+    Json::Value         root_;
+
+    void Flush();
+
+    void Write(const std::string& s);
+
+    Json::Value& AddNode(const Json::Value& value);
+
+    void StartItem();
+
+    void WriteFlat(const Json::Value& value);
+
+    void StartContainer(bool isObject);
+
+    void EndContainer(bool isObject);
+
+  public:
+    explicit RestApiJsonStream(RestApiOutput& output);
+
+    bool IsStreamed() const
+    {
+      return streamed_;
+    }
+
+    void StartObject()
+    {
+      StartContainer(true);
+    }
+
+    void EndObject()
+    {
+      EndContainer(true);
+    }
+
+    void StartArray()
+    {
+      StartContainer(false);
+    }
+
+    void EndArray()
+    {
+      EndContainer(false);
+    }
+
+    // Must precede each value written inside an object
+    void WriteKey(const std::string& key);
+
+    // The members of an object or an array are rendered one by one
+    void WriteValue(const Json::Value& value);
+
+    void Close();
+  };
+}
@@ -45,7 +45,8 @@ namespace Orthanc
                                HttpMethod method) : 
     output_(output),
     method_(method),
-    convertJsonToXml_(false)
+    convertJsonToXml_(false),
+    prettyPrint_(false)
   {
     alreadySent_ = false;
   }
@@ -56,6 +57,14 @@ namespace Orthanc
 
   void RestApiOutput::Finalize()
   {
+    if (output_.IsWritingStream())
+    {
+      // The handler has returned without closing its streamed answer:
+      // Report an error, so that the HTTP server closes the connection
+      LOG(ERROR) << "A streamed answer was not closed by the REST handler";
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
     if (!alreadySent_)
     {
       if (method_ == HttpMethod_Post)
@@ -85,6 +94,40 @@ namespace Orthanc
     alreadySent_ = true;
   }
 
+  void RestApiOutput::AnswerStreamRange(IHttpStreamAnswer& stream,
+                                        uint64_t start,
+                                        uint64_t resourceSize)
+  {
+    CheckStatus();
+    output_.AnswerRange(stream, start, resourceSize);
+    alreadySent_ = true;
+  }
+
+  void RestApiOutput::StartStream(const std::string& contentType,
+                                  const std::string& filename)
+  {
+    CheckStatus();
+
+    if (!filename.empty())
+    {
+      output_.SetContentFilename(filename.c_str());
+    }
+
+    output_.StartStream(contentType);
+    alreadySent_ = true;
+  }
+
+  void RestApiOutput::SendStreamItem(const void* item,
+                                     size_t size)
+  {
+    output_.SendStreamItem(item, size);
+  }
+
+  void RestApiOutput::CloseStream()
+  {
+    output_.CloseStream();
+  }
+
   void RestApiOutput::AnswerJson(const Json::Value& value)
   {
     CheckStatus();
@@ -101,12 +144,18 @@ namespace Orthanc
       throw OrthancException(ErrorCode_InternalError);
 #endif
     }
-    else
+    else if (prettyPrint_)
     {
       Json::StyledWriter writer;
       output_.SetContentType("application/json");
       output_.Answer(writer.write(value));
     }
+    else
+    {
+      Json::FastWriter writer;
+      output_.SetContentType("application/json");
+      output_.Answer(writer.write(value));
+    }
 
     alreadySent_ = true;
   }
@@ -142,7 +191,8 @@ namespace Orthanc
     if (status != HttpStatus_400_BadRequest &&
         status != HttpStatus_403_Forbidden &&
         status != HttpStatus_500_InternalServerError &&
-        status != HttpStatus_415_UnsupportedMediaType)
+        status != HttpStatus_415_UnsupportedMediaType &&
+        status != HttpStatus_416_RequestedRangeNotSatisfiable)
     {
       throw OrthancException(ErrorCode_BadHttpStatusInRest);
     }
@@ -163,6 +213,20 @@ namespace Orthanc
     SignalErrorInternal(status, message.c_str(), message.size());
   }
 
+  void RestApiOutput::SignalRangeNotSatisfiable(uint64_t resourceSize)
+  {
+    CheckStatus();
+    output_.SendRangeNotSatisfiable(resourceSize);
+    alreadySent_ = true;
+  }
+
+  void RestApiOutput::AddHeader(const std::string& key,
+                                const std::string& value)
+  {
+    CheckStatus();
+    output_.AddHeader(key, value);
+  }
+
   void RestApiOutput::SetCookie(const std::string& name,
                                 const std::string& value,
                                 unsigned int maxAge)
@@ -46,6 +46,7 @@ namespace Orthanc
     HttpMethod   method_;
     bool         alreadySent_;
     bool         convertJsonToXml_;
+    bool         prettyPrint_;
 
     void CheckStatus();
 
@@ -69,8 +70,32 @@ namespace Orthanc
       return convertJsonToXml_;
     }
 
+    // The JSON answers are compact, unless pretty-printing is asked
+    void SetPrettyPrint(bool pretty)
+    {
+      prettyPrint_ = pretty;
+    }
+
+    bool IsPrettyPrint() const
+    {
+      return prettyPrint_;
+    }
+
     void AnswerStream(IHttpStreamAnswer& stream);
 
+    void AnswerStreamRange(IHttpStreamAnswer& stream,
+                           uint64_t start,
+                           uint64_t resourceSize);
+
+    // Answer with a body of unknown size ("chunked" transfer encoding)
+    void StartStream(const std::string& contentType,
+                     const std::string& filename);
+
+    void SendStreamItem(const void* item,
+                        size_t size);
+
+    void CloseStream();
+
     void AnswerJson(const Json::Value& value);
 
     void AnswerBuffer(const std::string& buffer,
@@ -85,6 +110,11 @@ namespace Orthanc
     void SignalError(HttpStatus status,
 		     const std::string& message);
 
+    void SignalRangeNotSatisfiable(uint64_t resourceSize);
+
+    void AddHeader(const std::string& key,
+                   const std::string& value);
+
     void Redirect(const std::string& path);
 
     void SetCookie(const std::string& name,
@@ -57,7 +57,13 @@ namespace Orthanc
 {
   namespace SQLite
   {
+    // Default size of the cache of the statements whose SQL is
+    // generated at runtime
+    static const size_t DEFAULT_MAX_DYNAMIC_STATEMENTS = 64;
+
+
     Connection::Connection() :
+      maxDynamicStatements_(DEFAULT_MAX_DYNAMIC_STATEMENTS),
       db_(NULL),
       transactionNesting_(0),
       needsRollback_(false)
@@ -79,14 +85,15 @@ namespace Orthanc
       }
     }
 
-    void Connection::Open(const std::string& path)
+    void Connection::OpenInternal(const std::string& path,
+                                  int flags)
     {
       if (db_) 
       {
         throw OrthancSQLiteException(ErrorCode_SQLiteAlreadyOpened);
       }
 
-      int err = sqlite3_open(path.c_str(), &db_);
+      int err = sqlite3_open_v2(path.c_str(), &db_, flags, NULL);
       if (err != SQLITE_OK) 
       {
         Close();
@@ -100,6 +107,16 @@ namespace Orthanc
       Execute("PRAGMA RECURSIVE_TRIGGERS=ON;");
     }
 
+    void Connection::Open(const std::string& path)
+    {
+      OpenInternal(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    }
+
+    void Connection::OpenReadOnly(const std::string& path)
+    {
+      OpenInternal(path, SQLITE_OPEN_READONLY);
+    }
+
     void Connection::OpenInMemory()
     {
       Open(":memory:");
@@ -126,6 +143,16 @@ namespace Orthanc
       }
 
       cachedStatements_.clear();
+
+      for (DynamicStatements::iterator 
+             it = dynamicStatements_.begin(); 
+           it != dynamicStatements_.end(); ++it)
+      {
+        delete it->second.statement_;
+      }
+
+      dynamicStatements_.clear();
+      dynamicStatementsOrder_.clear();
     }
 
 
@@ -151,6 +178,84 @@ namespace Orthanc
     }
 
 
+    StatementReference& Connection::GetDynamicStatement(const std::string& sql)
+    {
+      DynamicStatements::iterator found = dynamicStatements_.find(sql);
+      if (found != dynamicStatements_.end())
+      {
+        if (found->second.statement_->GetReferenceCount() >= 1)
+        {
+          throw OrthancSQLiteException(ErrorCode_SQLiteStatementAlreadyUsed);
+        }
+
+        // Move the statement at the front of the LRU order
+        dynamicStatementsOrder_.splice(dynamicStatementsOrder_.begin(), 
+                                       dynamicStatementsOrder_, found->second.position_);
+        return *found->second.statement_;
+      }
+
+      // The statement is prepared before modifying the cache, as this
+      // fails on invalid SQL
+      std::auto_ptr<StatementReference> statement(new StatementReference(db_, sql.c_str()));
+
+      dynamicStatementsOrder_.push_front(sql);
+
+      DynamicStatement& item = dynamicStatements_[sql];
+      item.statement_ = statement.release();
+      item.position_ = dynamicStatementsOrder_.begin();
+
+      EvictDynamicStatements();
+
+      return *item.statement_;
+    }
+
+
+    void Connection::EvictDynamicStatements()
+    {
+      if (dynamicStatementsOrder_.empty())
+      {
+        return;
+      }
+
+      // Walk from the least recently used statement, never evicting
+      // the most recent one (that is about to be used) nor the
+      // statements that are currently in use
+      DynamicStatementsOrder::iterator current = dynamicStatementsOrder_.end();
+      --current;
+
+      while (dynamicStatements_.size() > maxDynamicStatements_ &&
+             current != dynamicStatementsOrder_.begin())
+      {
+        DynamicStatementsOrder::iterator previous = current;
+        --previous;
+
+        DynamicStatements::iterator item = dynamicStatements_.find(*current);
+        assert(item != dynamicStatements_.end());
+
+        if (item->second.statement_->GetReferenceCount() == 0)
+        {
+          delete item->second.statement_;
+          dynamicStatements_.erase(item);
+          dynamicStatementsOrder_.erase(current);
+        }
+
+        current = previous;
+      }
+    }
+
+
+    void Connection::SetDynamicStatementsCacheSize(size_t size)
+    {
+      if (size == 0)
+      {
+        throw OrthancSQLiteException(ErrorCode_ParameterOutOfRange);
+      }
+
+      maxDynamicStatements_ = size;
+      EvictDynamicStatements();
+    }
+
+
     bool Connection::Execute(const char* sql) 
     {
 #if ORTHANC_SQLITE_STANDALONE != 1
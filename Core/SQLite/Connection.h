@@ -42,11 +42,13 @@
 
 #include <string>
 #include <map>
+#include <list>
 
 struct sqlite3;
 struct sqlite3_stmt;
 
 #define SQLITE_FROM_HERE ::Orthanc::SQLite::StatementId(__FILE__, __LINE__)
+#define SQLITE_DYNAMIC ::Orthanc::SQLite::DynamicStatementId()
 
 namespace Orthanc
 {
@@ -63,6 +65,22 @@ namespace Orthanc
       typedef std::map<StatementId, StatementReference*>  CachedStatements;
       CachedStatements cachedStatements_;
 
+      // The statements whose SQL is generated at runtime are cached
+      // according to their SQL text. As the number of such statements
+      // is not bounded, the least recently used ones are evicted.
+      typedef std::list<std::string>  DynamicStatementsOrder;  // Most recent first
+
+      struct DynamicStatement
+      {
+        StatementReference*               statement_;
+        DynamicStatementsOrder::iterator  position_;
+      };
+
+      typedef std::map<std::string, DynamicStatement>  DynamicStatements;
+      DynamicStatements       dynamicStatements_;
+      DynamicStatementsOrder  dynamicStatementsOrder_;
+      size_t                  maxDynamicStatements_;
+
       // The actual sqlite database. Will be NULL before Init has been called or if
       // Init resulted in an error.
       sqlite3* db_;
@@ -87,11 +105,18 @@ namespace Orthanc
       StatementReference& GetCachedStatement(const StatementId& id,
                                              const char* sql);
 
+      StatementReference& GetDynamicStatement(const std::string& sql);
+
+      void EvictDynamicStatements();
+
       bool DoesTableOrIndexExist(const char* name, 
                                  const char* type) const;
 
       void DoRollback();
 
+      void OpenInternal(const std::string& path,
+                        int flags);
+
     public:
       // The database is opened by calling Open[InMemory](). Any uncommitted
       // transactions will be rolled back when this object is deleted.
@@ -100,6 +125,9 @@ namespace Orthanc
 
       void Open(const std::string& path);
 
+      // Any attempt to write to the database fails. The database must exist.
+      void OpenReadOnly(const std::string& path);
+
       void OpenInMemory();
 
       void Close();
@@ -115,6 +143,14 @@ namespace Orthanc
 
       IScalarFunction* Register(IScalarFunction* func);  // Takes the ownership of the function
 
+      // Maximum number of statements in the cache of "SQLITE_DYNAMIC"
+      void SetDynamicStatementsCacheSize(size_t size);
+
+      size_t GetDynamicStatementsCacheSize() const
+      {
+        return maxDynamicStatements_;
+      }
+
       // Info querying -------------------------------------------------------------
 
       // Used to check a |sql| statement for syntactic validity. If the
@@ -162,6 +198,16 @@ namespace Orthanc
         return cachedStatements_.find(id) != cachedStatements_.end();
       }
 
+      bool HasDynamicStatement(const std::string& sql) const
+      {
+        return dynamicStatements_.find(sql) != dynamicStatements_.end();
+      }
+
+      size_t GetDynamicStatementsCount() const
+      {
+        return dynamicStatements_.size();
+      }
+
       int GetTransactionNesting() const
       {
         return transactionNesting_;
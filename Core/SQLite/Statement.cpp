@@ -115,6 +115,15 @@ namespace Orthanc
     }
 
 
+    Statement::Statement(Connection& database,
+                         const DynamicStatementId& id,
+                         const std::string& sql) : 
+      reference_(database.GetDynamicStatement(sql))
+    {
+      Reset(true);
+    }
+
+
     Statement::Statement(Connection& database,
                          const std::string& sql) :
       reference_(database.GetWrappedObject(), sql.c_str())
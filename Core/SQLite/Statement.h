@@ -107,6 +107,11 @@ namespace Orthanc
                 const StatementId& id,
                 const char* sql);
 
+      // For SQL that is generated at runtime: "SQLITE_DYNAMIC"
+      Statement(Connection& database,
+                const DynamicStatementId& id,
+                const std::string& sql);
+
       ~Statement()
       {
         Reset();
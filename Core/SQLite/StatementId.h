@@ -56,5 +56,12 @@ namespace Orthanc
 
       bool operator< (const StatementId& other) const;
     };
+
+
+    // Identifies the statements whose SQL is generated at runtime:
+    // They are cached by the connection according to their SQL text
+    class DynamicStatementId
+    {
+    };
   }
 }
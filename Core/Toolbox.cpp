@@ -496,18 +496,62 @@ namespace Orthanc
                            const void* data,
                            size_t size)
   {
-    md5_state_s state;
-    md5_init(&state);
+    IncrementalMD5 md5;
+    md5.Append(data, size);
+    md5.Finish(result);
+  }
 
-    if (size > 0)
+
+  struct Toolbox::IncrementalMD5::PImpl
+  {
+    md5_state_s  state_;
+    bool         finished_;
+  };
+
+
+  Toolbox::IncrementalMD5::IncrementalMD5() : pimpl_(new PImpl)
+  {
+    md5_init(&pimpl_->state_);
+    pimpl_->finished_ = false;
+  }
+
+
+  Toolbox::IncrementalMD5::~IncrementalMD5()
+  {
+    delete pimpl_;
+  }
+
+
+  void Toolbox::IncrementalMD5::Append(const void* data,
+                                       size_t size)
+  {
+    if (pimpl_->finished_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    // "md5_append()" takes an "int" as the size of the buffer
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    while (size > 0)
+    {
+      size_t s = (size > (1u << 30) ? (1u << 30) : size);
+      md5_append(&pimpl_->state_, reinterpret_cast<const md5_byte_t*>(p), static_cast<int>(s));
+      p += s;
+      size -= s;
+    }
+  }
+
+
+  void Toolbox::IncrementalMD5::Finish(std::string& result)
+  {
+    if (pimpl_->finished_)
     {
-      md5_append(&state, 
-                 reinterpret_cast<const md5_byte_t*>(data), 
-                 static_cast<int>(size));
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
 
     md5_byte_t actualHash[16];
-    md5_finish(&state, actualHash);
+    md5_finish(&pimpl_->state_, actualHash);
+    pimpl_->finished_ = true;
 
     result.resize(32);
     for (unsigned int i = 0; i < 16; i++)
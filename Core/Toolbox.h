@@ -101,6 +101,29 @@ namespace Orthanc
     void ComputeMD5(std::string& result,
                     const void* data,
                     size_t size);
+
+    // Computes the MD5 of a buffer that is received by pieces
+    class IncrementalMD5
+    {
+    private:
+      struct PImpl;
+      PImpl* pimpl_;
+
+      // Forbid copy
+      IncrementalMD5(const IncrementalMD5&);
+      IncrementalMD5& operator= (const IncrementalMD5&);
+
+    public:
+      IncrementalMD5();
+
+      ~IncrementalMD5();
+
+      void Append(const void* data,
+                  size_t size);
+
+      // Can only be called once
+      void Finish(std::string& result);
+    };
 #endif
 
     void ComputeSHA1(std::string& result,
@@ -38,6 +38,7 @@
 #include "../Core/Uuid.h"
 #include "EmbeddedResources.h"
 #include "ServerToolbox.h"
+#include "Search/LookupIdentifierQuery.h"
 
 #include <stdio.h>
 #include <boost/lexical_cast.hpp>
@@ -260,29 +261,70 @@ namespace Orthanc
     listener_(NULL), 
     base_(db_),
     signalRemainingAncestor_(NULL),
-    version_(0)
+    version_(0),
+    path_(path),
+    exclusiveLocking_(true),
+    isOpen_(false)
   {
     db_.Open(path);
   }
 
+  DatabaseWrapper::DatabaseWrapper(const std::string& path,
+                                   unsigned int version) : 
+    listener_(NULL), 
+    base_(db_),
+    signalRemainingAncestor_(NULL),
+    version_(version),
+    path_(path),
+    exclusiveLocking_(false),
+    isOpen_(false)
+  {
+    db_.OpenReadOnly(path);
+  }
+
   DatabaseWrapper::DatabaseWrapper() : 
     listener_(NULL), 
     base_(db_),
     signalRemainingAncestor_(NULL),
-    version_(0)
+    version_(0),
+    exclusiveLocking_(true),
+    isOpen_(false)
   {
     db_.OpenInMemory();
   }
 
+  void DatabaseWrapper::SetExclusiveLocking(bool exclusive)
+  {
+    if (isOpen_)
+    {
+      // "Open()" has already been called: In WAL mode, the locking
+      // mode cannot be changed once the database has been accessed
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    exclusiveLocking_ = exclusive;
+  }
+
   void DatabaseWrapper::Open()
   {
+    isOpen_ = true;
+
     db_.Execute("PRAGMA ENCODING=\"UTF-8\";");
 
     // Performance tuning of SQLite with PRAGMAs
     // http://www.sqlite.org/pragma.html
     db_.Execute("PRAGMA SYNCHRONOUS=NORMAL;");
     db_.Execute("PRAGMA JOURNAL_MODE=WAL;");
-    db_.Execute("PRAGMA LOCKING_MODE=EXCLUSIVE;");
+
+    if (exclusiveLocking_)
+    {
+      db_.Execute("PRAGMA LOCKING_MODE=EXCLUSIVE;");
+    }
+    else
+    {
+      db_.Execute("PRAGMA LOCKING_MODE=NORMAL;");
+    }
+
     db_.Execute("PRAGMA WAL_AUTOCHECKPOINT=1000;");
     //db_.Execute("PRAGMA TEMP_STORE=memory");
 
@@ -385,6 +427,23 @@ namespace Orthanc
   }
 
 
+  IDatabaseWrapper* DatabaseWrapper::OpenReadOnlyConnection()
+  {
+    if (path_.empty() ||     // In-memory databases cannot be shared
+        exclusiveLocking_)
+    {
+      return NULL;
+    }
+
+    /**
+     * The reader is opened in read-only mode, and "Open()" is not
+     * called: The writer has already configured the database and
+     * created or upgraded its schema.
+     **/
+    return new DatabaseWrapper(path_, version_);
+  }
+
+
   void DatabaseWrapper::SetListener(IDatabaseListener& listener)
   {
     listener_ = &listener;
@@ -487,4 +546,119 @@ namespace Orthanc
     }
   }
 
+
+  static const char* GetIdentifierOperator(IdentifierConstraintType type)
+  {
+    switch (type)
+    {
+      case IdentifierConstraintType_Equal:
+        return "=";
+
+      case IdentifierConstraintType_GreaterOrEqual:
+        return ">=";
+
+      case IdentifierConstraintType_SmallerOrEqual:
+        return "<=";
+
+      case IdentifierConstraintType_Wildcard:
+        return " GLOB ";
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  void DatabaseWrapper::LookupIdentifiers(std::list<int64_t>& result,
+                                          const LookupIdentifierQuery& query)
+  {
+    // Each constraint uses 3 parameters, and SQLite accepts at most
+    // 999 parameters by default ("SQLITE_MAX_VARIABLE_NUMBER")
+    static const size_t MAX_COMBINED_CONSTRAINTS = 256;
+
+    result.clear();
+
+    if (query.GetSize() == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < query.GetSize(); i++)
+    {
+      if (query.GetDisjunction(i).GetSize() == 0)
+      {
+        return;  // An empty disjunction matches no resource
+      }
+
+      count += query.GetDisjunction(i).GetSize();
+    }
+
+    if (count > MAX_COMBINED_CONSTRAINTS)
+    {
+      SetOfResources resources(*this, query.GetLevel());
+      query.ApplySeparately(resources, *this);
+      resources.Flatten(result);
+      return;
+    }
+
+    // One "SELECT" per disjunction, combined with "INTERSECT". Only
+    // the first "SELECT" is restricted to the level of the query,
+    // which is enough for the intersection. The SQL only depends on
+    // the structure of the query, not on the values, so that the
+    // statement is reused by the next similar queries.
+    std::string sql;
+
+    for (size_t i = 0; i < query.GetSize(); i++)
+    {
+      const LookupIdentifierQuery::Disjunction& disjunction = query.GetDisjunction(i);
+
+      if (i == 0)
+      {
+        sql = ("SELECT d.id FROM DicomIdentifiers AS d, Resources AS r WHERE "
+               "d.id=r.internalId AND r.resourceType=? AND (");
+      }
+      else
+      {
+        sql += " INTERSECT SELECT d.id FROM DicomIdentifiers AS d WHERE (";
+      }
+
+      for (size_t j = 0; j < disjunction.GetSize(); j++)
+      {
+        if (j > 0)
+        {
+          sql += " OR ";
+        }
+
+        sql += "(d.tagGroup=? AND d.tagElement=? AND d.value";
+        sql += GetIdentifierOperator(disjunction.GetConstraint(j).GetType());
+        sql += "?)";
+      }
+
+      sql += ")";
+    }
+
+    SQLite::Statement s(db_, SQLITE_DYNAMIC, sql);
+
+    int parameter = 0;
+    s.BindInt(parameter++, query.GetLevel());
+
+    for (size_t i = 0; i < query.GetSize(); i++)
+    {
+      const LookupIdentifierQuery::Disjunction& disjunction = query.GetDisjunction(i);
+
+      for (size_t j = 0; j < disjunction.GetSize(); j++)
+      {
+        const LookupIdentifierQuery::Constraint& constraint = disjunction.GetConstraint(j);
+        s.BindInt(parameter++, constraint.GetTag().GetGroup());
+        s.BindInt(parameter++, constraint.GetTag().GetElement());
+        s.BindString(parameter++, constraint.GetValue());
+      }
+    }
+
+    while (s.Step())
+    {
+      result.push_back(s.ColumnInt64(0));
+    }
+  }
 }
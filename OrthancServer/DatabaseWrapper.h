@@ -58,14 +58,26 @@ namespace Orthanc
     DatabaseWrapperBase base_;
     Internals::SignalRemainingAncestor* signalRemainingAncestor_;
     unsigned int version_;
+    std::string path_;
+    bool exclusiveLocking_;
+    bool isOpen_;
 
     void ClearTable(const std::string& tableName);
 
+    // Read-only connection, cf. "OpenReadOnlyConnection()"
+    DatabaseWrapper(const std::string& path,
+                    unsigned int version);
+
   public:
     DatabaseWrapper(const std::string& path);
 
     DatabaseWrapper();
 
+    // By default, the SQLite database is locked in exclusive mode,
+    // which prevents other connections (cf. "OpenReadOnlyConnection()"
+    // below). This method must be called before "Open()".
+    void SetExclusiveLocking(bool exclusive);
+
     virtual void Open();
 
     virtual void Close()
@@ -191,6 +203,44 @@ namespace Orthanc
       base_.GetMainDicomTags(map, id);
     }
 
+    virtual void GetMainDicomTags(const std::vector<DicomMap*>& target,
+                                  const std::vector<int64_t>& ids)
+    {
+      base_.GetMainDicomTags(target, ids);
+    }
+
+    virtual void LookupResources(std::map<std::string, int64_t>& target,
+                                 ResourceType type,
+                                 const std::vector<std::string>& publicIds)
+    {
+      base_.LookupResources(target, type, publicIds);
+    }
+
+    virtual void LookupParentsPublicId(std::map<int64_t, std::string>& target,
+                                       const std::vector<int64_t>& ids)
+    {
+      base_.LookupParentsPublicId(target, ids);
+    }
+
+    virtual void GetChildren(std::map<int64_t, std::list<std::pair<int64_t, std::string> > >& target,
+                             const std::vector<int64_t>& ids)
+    {
+      base_.GetChildren(target, ids);
+    }
+
+    virtual void GetAllMetadata(std::map<int64_t, std::map<MetadataType, std::string> >& target,
+                                const std::vector<int64_t>& ids)
+    {
+      base_.GetAllMetadata(target, ids);
+    }
+
+    virtual void LookupAttachments(std::map<int64_t, FileInfo>& target,
+                                   FileContentType contentType,
+                                   const std::vector<int64_t>& ids)
+    {
+      base_.LookupAttachments(target, contentType, ids);
+    }
+
     virtual void GetChildrenPublicId(std::list<std::string>& target,
                                      int64_t id)
     {
@@ -269,6 +319,14 @@ namespace Orthanc
       base_.GetAllPublicIds(target, resourceType, since, limit);
     }
 
+    virtual void GetPublicIdsAfter(std::list< std::pair<int64_t, std::string> >& target,
+                                   ResourceType resourceType,
+                                   int64_t after,
+                                   size_t limit)
+    {
+      base_.GetPublicIdsAfter(target, resourceType, after, limit);
+    }
+
     virtual bool SelectPatientToRecycle(int64_t& internalId)
     {
       return base_.SelectPatientToRecycle(internalId);
@@ -306,6 +364,8 @@ namespace Orthanc
       return true;
     }
 
+    virtual IDatabaseWrapper* OpenReadOnlyConnection();
+
     virtual void ClearChanges()
     {
       ClearTable("Changes");
@@ -330,6 +390,9 @@ namespace Orthanc
       base_.LookupIdentifier(result, level, tag, type, value);
     }
 
+    virtual void LookupIdentifiers(std::list<int64_t>& result,
+                                   const LookupIdentifierQuery& query);
+
     virtual void GetAllMetadata(std::map<MetadataType, std::string>& target,
                                 int64_t id);
 
@@ -33,11 +33,73 @@
 #include "PrecompiledHeadersServer.h"
 #include "DatabaseWrapperBase.h"
 
+#include "../Core/OrthancException.h"
+
 #include <stdio.h>
 #include <memory>
 
 namespace Orthanc
 {
+  /**
+   * Number of resources per SQL query in the bulk methods. The
+   * queries always have the same number of parameters, so that they
+   * can be cached: Unused parameters are bound to an invalid value.
+   **/
+  static const size_t BULK_CHUNK_SIZE = 64;
+
+
+  // Returns "prefix(?,?,...,?)suffix", with "BULK_CHUNK_SIZE" parameters
+  static std::string FormatBulkQuery(const std::string& prefix,
+                                     const std::string& suffix)
+  {
+    std::string sql = prefix + "(?";
+    for (size_t i = 1; i < BULK_CHUNK_SIZE; i++)
+    {
+      sql += ",?";
+    }
+
+    return sql + ")" + suffix;
+  }
+
+
+  static void BindBulkChunk(SQLite::Statement& s,
+                            int firstParameter,
+                            const std::vector<int64_t>& ids,
+                            size_t start)
+  {
+    for (size_t i = 0; i < BULK_CHUNK_SIZE; i++)
+    {
+      if (start + i < ids.size())
+      {
+        s.BindInt64(firstParameter + i, ids[start + i]);
+      }
+      else
+      {
+        s.BindInt64(firstParameter + i, -1);
+      }
+    }
+  }
+
+
+  static void BindBulkChunk(SQLite::Statement& s,
+                            int firstParameter,
+                            const std::vector<std::string>& publicIds,
+                            size_t start)
+  {
+    for (size_t i = 0; i < BULK_CHUNK_SIZE; i++)
+    {
+      if (start + i < publicIds.size())
+      {
+        s.BindString(firstParameter + i, publicIds[start + i]);
+      }
+      else
+      {
+        s.BindString(firstParameter + i, "");
+      }
+    }
+  }
+
+
   void DatabaseWrapperBase::SetGlobalProperty(GlobalProperty property,
                                               const std::string& value)
   {
@@ -355,6 +417,164 @@ namespace Orthanc
   }
 
 
+  void DatabaseWrapperBase::GetMainDicomTags(const std::vector<DicomMap*>& target,
+                                             const std::vector<int64_t>& ids)
+  {
+    if (target.size() != ids.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    std::map<int64_t, DicomMap*> maps;
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      if (target[i] == NULL ||
+          maps.find(ids[i]) != maps.end())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      target[i]->Clear();
+      maps[ids[i]] = target[i];
+    }
+
+    const std::string sql = FormatBulkQuery("SELECT * FROM MainDicomTags WHERE id IN ", "");
+
+    for (size_t start = 0; start < ids.size(); start += BULK_CHUNK_SIZE)
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, sql);
+      BindBulkChunk(s, 0, ids, start);
+
+      while (s.Step())
+      {
+        std::map<int64_t, DicomMap*>::iterator found = maps.find(s.ColumnInt64(0));
+        if (found != maps.end())
+        {
+          found->second->SetValue(s.ColumnInt(1),
+                                  s.ColumnInt(2),
+                                  s.ColumnString(3));
+        }
+      }
+    }
+  }
+
+
+  void DatabaseWrapperBase::LookupResources(std::map<std::string, int64_t>& target,
+                                            ResourceType type,
+                                            const std::vector<std::string>& publicIds)
+  {
+    target.clear();
+
+    const std::string sql = FormatBulkQuery
+      ("SELECT publicId, internalId FROM Resources WHERE resourceType=? AND publicId IN ", "");
+
+    for (size_t start = 0; start < publicIds.size(); start += BULK_CHUNK_SIZE)
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, sql);
+      s.BindInt(0, type);
+      BindBulkChunk(s, 1, publicIds, start);
+
+      while (s.Step())
+      {
+        target[s.ColumnString(0)] = s.ColumnInt64(1);
+      }
+    }
+  }
+
+
+  void DatabaseWrapperBase::LookupParentsPublicId(std::map<int64_t, std::string>& target,
+                                                  const std::vector<int64_t>& ids)
+  {
+    target.clear();
+
+    const std::string sql = FormatBulkQuery
+      ("SELECT a.internalId, b.publicId FROM Resources AS a, Resources AS b "
+       "WHERE a.parentId = b.internalId AND a.internalId IN ", "");
+
+    for (size_t start = 0; start < ids.size(); start += BULK_CHUNK_SIZE)
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, sql);
+      BindBulkChunk(s, 0, ids, start);
+
+      while (s.Step())
+      {
+        target[s.ColumnInt64(0)] = s.ColumnString(1);
+      }
+    }
+  }
+
+
+  void DatabaseWrapperBase::GetChildren(std::map<int64_t, std::list<std::pair<int64_t, std::string> > >& target,
+                                        const std::vector<int64_t>& ids)
+  {
+    target.clear();
+
+    const std::string sql = FormatBulkQuery
+      ("SELECT parentId, internalId, publicId FROM Resources WHERE parentId IN ", "");
+
+    for (size_t start = 0; start < ids.size(); start += BULK_CHUNK_SIZE)
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, sql);
+      BindBulkChunk(s, 0, ids, start);
+
+      while (s.Step())
+      {
+        target[s.ColumnInt64(0)].push_back(std::make_pair(s.ColumnInt64(1), s.ColumnString(2)));
+      }
+    }
+  }
+
+
+  void DatabaseWrapperBase::GetAllMetadata(std::map<int64_t, std::map<MetadataType, std::string> >& target,
+                                           const std::vector<int64_t>& ids)
+  {
+    target.clear();
+
+    const std::string sql = FormatBulkQuery("SELECT id, type, value FROM Metadata WHERE id IN ", "");
+
+    for (size_t start = 0; start < ids.size(); start += BULK_CHUNK_SIZE)
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, sql);
+      BindBulkChunk(s, 0, ids, start);
+
+      while (s.Step())
+      {
+        target[s.ColumnInt64(0)][static_cast<MetadataType>(s.ColumnInt(1))] = s.ColumnString(2);
+      }
+    }
+  }
+
+
+  void DatabaseWrapperBase::LookupAttachments(std::map<int64_t, FileInfo>& target,
+                                              FileContentType contentType,
+                                              const std::vector<int64_t>& ids)
+  {
+    target.clear();
+
+    const std::string sql = FormatBulkQuery
+      ("SELECT id, uuid, uncompressedSize, compressionType, compressedSize, uncompressedMD5, "
+       "compressedMD5 FROM AttachedFiles WHERE fileType=? AND id IN ", "");
+
+    for (size_t start = 0; start < ids.size(); start += BULK_CHUNK_SIZE)
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, sql);
+      s.BindInt(0, contentType);
+      BindBulkChunk(s, 1, ids, start);
+
+      while (s.Step())
+      {
+        target[s.ColumnInt64(0)] = FileInfo(s.ColumnString(1),
+                                            contentType,
+                                            s.ColumnInt64(2),
+                                            s.ColumnString(5),
+                                            static_cast<CompressionType>(s.ColumnInt(3)),
+                                            s.ColumnInt64(4),
+                                            s.ColumnString(6));
+      }
+    }
+  }
+
+
 
   void DatabaseWrapperBase::GetChildrenPublicId(std::list<std::string>& target,
                                                 int64_t id)
@@ -584,6 +804,35 @@ namespace Orthanc
   }
 
 
+  void DatabaseWrapperBase::GetPublicIdsAfter(std::list< std::pair<int64_t, std::string> >& target,
+                                              ResourceType resourceType,
+                                              int64_t after,
+                                              size_t limit)
+  {
+    target.clear();
+
+    if (limit == 0)
+    {
+      return;
+    }
+
+    // "internalId" is the rowid of "Resources", so "ResourceTypeIndex"
+    // is implicitly sorted by (resourceType, internalId): The page is
+    // a range scan over this index, whatever its position
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, 
+                        "SELECT internalId, publicId FROM Resources WHERE resourceType=? "
+                        "AND internalId>? ORDER BY internalId LIMIT ?");
+    s.BindInt(0, resourceType);
+    s.BindInt64(1, after);
+    s.BindInt64(2, limit);
+
+    while (s.Step())
+    {
+      target.push_back(std::make_pair(s.ColumnInt64(0), s.ColumnString(1)));
+    }
+  }
+
+
   uint64_t DatabaseWrapperBase::GetResourceCount(ResourceType resourceType)
   {
     SQLite::Statement s(db_, SQLITE_FROM_HERE, 
@@ -691,25 +940,26 @@ namespace Orthanc
                                  "d.id = r.internalId AND r.resourceType=? AND "
                                  "d.tagGroup=? AND d.tagElement=? AND ");
 
+    // Each kind of constraint has its own cached statement
     std::auto_ptr<SQLite::Statement> s;
 
     switch (type)
     {
       case IdentifierConstraintType_GreaterOrEqual:
-        s.reset(new SQLite::Statement(db_, std::string(COMMON) + "d.value>=?"));
+        s.reset(new SQLite::Statement(db_, SQLITE_FROM_HERE, std::string(COMMON) + "d.value>=?"));
         break;
 
       case IdentifierConstraintType_SmallerOrEqual:
-        s.reset(new SQLite::Statement(db_, std::string(COMMON) + "d.value<=?"));
+        s.reset(new SQLite::Statement(db_, SQLITE_FROM_HERE, std::string(COMMON) + "d.value<=?"));
         break;
 
       case IdentifierConstraintType_Wildcard:
-        s.reset(new SQLite::Statement(db_, std::string(COMMON) + "d.value GLOB ?"));
+        s.reset(new SQLite::Statement(db_, SQLITE_FROM_HERE, std::string(COMMON) + "d.value GLOB ?"));
         break;
 
       case IdentifierConstraintType_Equal:
       default:
-        s.reset(new SQLite::Statement(db_, std::string(COMMON) + "d.value=?"));
+        s.reset(new SQLite::Statement(db_, SQLITE_FROM_HERE, std::string(COMMON) + "d.value=?"));
         break;
     }
 
@@ -42,6 +42,7 @@
 #include "ServerEnumerations.h"
 
 #include <list>
+#include <vector>
 
 
 namespace Orthanc
@@ -139,6 +140,26 @@ namespace Orthanc
     void GetMainDicomTags(DicomMap& map,
                           int64_t id);
 
+    void GetMainDicomTags(const std::vector<DicomMap*>& target,
+                          const std::vector<int64_t>& ids);
+
+    void LookupResources(std::map<std::string, int64_t>& target,
+                         ResourceType type,
+                         const std::vector<std::string>& publicIds);
+
+    void LookupParentsPublicId(std::map<int64_t, std::string>& target,
+                               const std::vector<int64_t>& ids);
+
+    void GetChildren(std::map<int64_t, std::list<std::pair<int64_t, std::string> > >& target,
+                     const std::vector<int64_t>& ids);
+
+    void GetAllMetadata(std::map<int64_t, std::map<MetadataType, std::string> >& target,
+                        const std::vector<int64_t>& ids);
+
+    void LookupAttachments(std::map<int64_t, FileInfo>& target,
+                           FileContentType contentType,
+                           const std::vector<int64_t>& ids);
+
     void GetChildrenPublicId(std::list<std::string>& target,
                              int64_t id);
 
@@ -179,6 +200,11 @@ namespace Orthanc
                          size_t since,
                          size_t limit);
 
+    void GetPublicIdsAfter(std::list< std::pair<int64_t, std::string> >& target,
+                           ResourceType resourceType,
+                           int64_t after,
+                           size_t limit);
+
     uint64_t GetResourceCount(ResourceType resourceType);
 
     bool SelectPatientToRecycle(int64_t& internalId);
@@ -98,6 +98,8 @@ namespace Orthanc
     applicationEntityFilter_ = NULL;
     checkCalledAet_ = true;
     clientTimeout_ = 30;
+    minThreads_ = 4;
+    maxThreads_ = 4;
     continue_ = false;
   }
 
@@ -133,6 +135,31 @@ namespace Orthanc
   }
 
 
+  void DicomServer::SetThreadsCount(size_t minimum,
+                                    size_t maximum)
+  {
+    if (maximum == 0 ||
+        minimum > maximum)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    Stop();
+    minThreads_ = minimum;
+    maxThreads_ = maximum;
+  }
+
+  size_t DicomServer::GetMinimumThreadsCount() const
+  {
+    return minThreads_;
+  }
+
+  size_t DicomServer::GetMaximumThreadsCount() const
+  {
+    return maxThreads_;
+  }
+
+
   void DicomServer::SetCalledApplicationEntityTitleCheck(bool check)
   {
     Stop();
@@ -306,7 +333,7 @@ namespace Orthanc
     }
 
     continue_ = true;
-    pimpl_->workers_.reset(new RunnableWorkersPool(4));   // Use 4 workers - TODO as a parameter?
+    pimpl_->workers_.reset(new RunnableWorkersPool(minThreads_, maxThreads_));
     pimpl_->thread_ = boost::thread(ServerThread, this);
   }
 
@@ -346,4 +373,21 @@ namespace Orthanc
     return Configuration::IsSameAETitle(aet, GetApplicationEntityTitle());
   }
 
+
+  void DicomServer::GetStatistics(RunnableWorkersPool::Statistics& target)
+  {
+    if (continue_ &&
+        pimpl_->workers_.get() != NULL)
+    {
+      pimpl_->workers_->GetStatistics(target);
+    }
+    else
+    {
+      target.countWorkers_ = 0;
+      target.minWorkers_ = minThreads_;
+      target.maxWorkers_ = maxThreads_;
+      target.countRunnables_ = 0;
+      target.countActive_ = 0;
+    }
+  }
 }
@@ -37,6 +37,7 @@
 #include "IStoreRequestHandlerFactory.h"
 #include "IWorklistRequestHandlerFactory.h"
 #include "IApplicationEntityFilter.h"
+#include "../../Core/MultiThreading/RunnableWorkersPool.h"
 
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
@@ -55,6 +56,8 @@ namespace Orthanc
     uint16_t port_;
     bool continue_;
     uint32_t clientTimeout_;
+    size_t minThreads_;
+    size_t maxThreads_;
     IFindRequestHandlerFactory* findRequestHandlerFactory_;
     IMoveRequestHandlerFactory* moveRequestHandlerFactory_;
     IStoreRequestHandlerFactory* storeRequestHandlerFactory_;
@@ -74,6 +77,13 @@ namespace Orthanc
     void SetClientTimeout(uint32_t timeout);
     uint32_t GetClientTimeout() const;
 
+    // The number of threads that process the associations grows from
+    // "minimum" to "maximum" as the concurrent associations pile up
+    void SetThreadsCount(size_t minimum,
+                         size_t maximum);
+    size_t GetMinimumThreadsCount() const;
+    size_t GetMaximumThreadsCount() const;
+
     void SetCalledApplicationEntityTitleCheck(bool check);
     bool HasCalledApplicationEntityTitleCheck() const;
 
@@ -105,6 +115,9 @@ namespace Orthanc
     void Stop();
 
     bool IsMyAETitle(const std::string& aet) const;
+
+    // One runnable corresponds to one association
+    void GetStatistics(RunnableWorkersPool::Statistics& target);
   };
 
 }
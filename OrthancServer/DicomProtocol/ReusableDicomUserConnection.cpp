@@ -36,6 +36,8 @@
 #include "../../Core/Logging.h"
 #include "../../Core/OrthancException.h"
 
+#include <boost/lexical_cast.hpp>
+
 namespace Orthanc
 {
   static boost::posix_time::ptime Now()
@@ -43,38 +45,131 @@ namespace Orthanc
     return boost::posix_time::microsec_clock::local_time();
   }
 
-  void ReusableDicomUserConnection::Open(const std::string& localAet,
-                                         const RemoteModalityParameters& remote)
+
+  static std::string GetConnectionKey(const std::string& localAet,
+                                      const RemoteModalityParameters& remote)
+  {
+    return (localAet + "\\" + remote.GetApplicationEntityTitle() + "\\" + 
+            remote.GetHost() + "\\" + boost::lexical_cast<std::string>(remote.GetPort()) + "\\" +
+            boost::lexical_cast<std::string>(static_cast<int>(remote.GetManufacturer())));
+  }
+
+
+  ReusableDicomUserConnection::PooledConnection& 
+  ReusableDicomUserConnection::Acquire(const std::string& localAet,
+                                       const RemoteModalityParameters& remote)
   {
-    if (connection_ != NULL &&
-        connection_->GetLocalApplicationEntityTitle() == localAet &&
-        connection_->GetRemoteApplicationEntityTitle() == remote.GetApplicationEntityTitle() &&
-        connection_->GetRemoteHost() == remote.GetHost() &&
-        connection_->GetRemotePort() == remote.GetPort() &&
-        connection_->GetRemoteManufacturer() == remote.GetManufacturer())
+    const std::string key = GetConnectionKey(localAet, remote);
+
+    PooledConnection* result = NULL;
+
     {
-      // The current connection can be reused
-      LOG(INFO) << "Reusing the previous SCU connection";
-      return;
+      boost::mutex::scoped_lock lock(mutex_);
+
+      for (;;)
+      {
+        if (!continue_)
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+
+        unsigned int count = 0;
+
+        for (Connections::iterator it = connections_.begin(); it != connections_.end(); ++it)
+        {
+          if ((*it)->key_ == key)
+          {
+            count++;
+
+            if (!(*it)->busy_ &&
+                (*it)->connection_ != NULL)
+            {
+              // An idle connection can be reused
+              LOG(INFO) << "Reusing a SCU connection to modality " << remote.GetApplicationEntityTitle();
+              (*it)->busy_ = true;
+              countReused_++;
+              return **it;
+            }
+          }
+        }
+
+        if (count < maxPerModality_)
+        {
+          // Reserve a new slot in the pool
+          result = new PooledConnection;
+          result->key_ = key;
+          result->modality_ = (remote.GetApplicationEntityTitle() + "@" + remote.GetHost() + ":" +
+                               boost::lexical_cast<std::string>(remote.GetPort()));
+          result->connection_ = NULL;
+          result->busy_ = true;
+          result->lastUse_ = Now();
+          connections_.push_back(result);
+          break;
+        }
+
+        // All the connections to this modality are in use
+        available_.wait(lock);
+      }
     }
 
-    Close();
+    // Open the association outside of the mutex, as this might take
+    // time, and must not block the connections to other modalities
+    try
+    {
+      std::auto_ptr<DicomUserConnection> connection(new DicomUserConnection);
+      connection->SetLocalApplicationEntityTitle(localAet);
+      connection->SetRemoteModality(remote);
+      connection->Open();
+
+      boost::mutex::scoped_lock lock(mutex_);
+      result->connection_ = connection.release();
+      countOpened_++;
+    }
+    catch (...)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      connections_.remove(result);
+      delete result;
+      available_.notify_all();
+      throw;
+    }
 
-    connection_ = new DicomUserConnection();
-    connection_->SetLocalApplicationEntityTitle(localAet);
-    connection_->SetRemoteModality(remote);
-    connection_->Open();
+    return *result;
   }
-    
-  void ReusableDicomUserConnection::Close()
+
+
+  void ReusableDicomUserConnection::Release(PooledConnection& connection)
   {
-    if (connection_ != NULL)
+    DicomUserConnection* toClose = NULL;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!continue_ ||
+          connection.connection_->GetRemoteManufacturer() == ModalityManufacturer_StoreScp)
+      {
+        // The pool is being finalized, or "storescp" from DCMTK has
+        // problems when reusing a connection. Always close.
+        toClose = connection.connection_;
+        connections_.remove(&connection);
+        delete &connection;
+      }
+      else
+      {
+        connection.busy_ = false;
+        connection.lastUse_ = Now();
+      }
+
+      available_.notify_all();
+    }
+
+    if (toClose != NULL)
     {
-      delete connection_;
-      connection_ = NULL;
+      delete toClose;
     }
   }
 
+
   void ReusableDicomUserConnection::CloseThread(ReusableDicomUserConnection* that)
   {
     for (;;)
@@ -86,15 +181,37 @@ namespace Orthanc
         return;
       }
 
+      std::list<DicomUserConnection*> expired;
+
       {
         boost::mutex::scoped_lock lock(that->mutex_);
-        if (that->connection_ != NULL &&
-            Now() >= that->lastUse_ + that->timeBeforeClose_)
+        const boost::posix_time::ptime now = Now();
+
+        Connections::iterator it = that->connections_.begin();
+        while (it != that->connections_.end())
         {
-          LOG(INFO) << "Closing the global SCU connection after timeout";
-          that->Close();
+          if (!(*it)->busy_ &&
+              now >= (*it)->lastUse_ + that->timeBeforeClose_)
+          {
+            expired.push_back((*it)->connection_);
+            delete *it;
+            it = that->connections_.erase(it);
+          }
+          else
+          {
+            ++it;
+          }
         }
       }
+
+      // Close the associations outside of the mutex
+      for (std::list<DicomUserConnection*>::iterator 
+             it = expired.begin(); it != expired.end(); ++it)
+      {
+        LOG(INFO) << "Closing the SCU connection to modality " 
+                  << (*it)->GetRemoteApplicationEntityTitle() << " after timeout";
+        delete *it;
+      }
     }
   }
     
@@ -102,32 +219,40 @@ namespace Orthanc
   ReusableDicomUserConnection::Locker::Locker(ReusableDicomUserConnection& that,
                                               const std::string& localAet,
                                               const RemoteModalityParameters& remote) :
-    ::Orthanc::Locker(that)
+    that_(that),
+    connection_(that.Acquire(localAet, remote))
   {
-    that.Open(localAet, remote);
-    connection_ = that.connection_;    
+  }
+
+
+  ReusableDicomUserConnection::Locker::~Locker()
+  {
+    that_.Release(connection_);
   }
 
 
   DicomUserConnection& ReusableDicomUserConnection::Locker::GetConnection()
   {
-    if (connection_ == NULL)
+    if (connection_.connection_ == NULL)
     {
       throw OrthancException(ErrorCode_InternalError);
     }
 
-    return *connection_;
+    return *connection_.connection_;
   }      
 
+
   ReusableDicomUserConnection::ReusableDicomUserConnection() : 
-    connection_(NULL), 
+    maxPerModality_(1),
+    countOpened_(0),
+    countReused_(0),
     timeBeforeClose_(boost::posix_time::seconds(5))  // By default, close connection after 5 seconds
   {
-    lastUse_ = Now();
     continue_ = true;
     closeThread_ = boost::thread(CloseThread, this);
   }
 
+
   ReusableDicomUserConnection::~ReusableDicomUserConnection()
   {
     if (continue_)
@@ -137,6 +262,7 @@ namespace Orthanc
     }
   }
 
+
   void ReusableDicomUserConnection::SetMillisecondsBeforeClose(uint64_t ms)
   {
     boost::mutex::scoped_lock lock(mutex_);
@@ -149,23 +275,45 @@ namespace Orthanc
     timeBeforeClose_ = boost::posix_time::milliseconds(ms);
   }
 
-  void ReusableDicomUserConnection::Lock()
+
+  void ReusableDicomUserConnection::SetMaximumConnectionsPerModality(unsigned int count)
   {
-    mutex_.lock();
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    maxPerModality_ = count;
+    available_.notify_all();
   }
 
-  void ReusableDicomUserConnection::Unlock()
+
+  void ReusableDicomUserConnection::FormatStatistics(Json::Value& target)
   {
-    if (connection_ != NULL &&
-        connection_->GetRemoteManufacturer() == ModalityManufacturer_StoreScp)
+    boost::mutex::scoped_lock lock(mutex_);
+
+    target = Json::objectValue;
+    target["MaximumPerModality"] = maxPerModality_;
+    target["Opened"] = static_cast<unsigned int>(countOpened_);
+    target["Reused"] = static_cast<unsigned int>(countReused_);
+
+    Json::Value modalities = Json::objectValue;
+
+    for (Connections::const_iterator it = connections_.begin(); it != connections_.end(); ++it)
     {
-      // "storescp" from DCMTK has problems when reusing a
-      // connection. Always close.
-      Close();
+      Json::Value& modality = modalities[(*it)->modality_];
+      if (modality.type() == Json::nullValue)
+      {
+        modality["Busy"] = 0;
+        modality["Idle"] = 0;
+      }
+
+      const char* field = ((*it)->busy_ ? "Busy" : "Idle");
+      modality[field] = modality[field].asInt() + 1;
     }
 
-    lastUse_ = Now();
-    mutex_.unlock();
+    target["Modalities"] = modalities;
   }
 
   
@@ -173,15 +321,36 @@ namespace Orthanc
   {
     if (continue_)
     {
-      continue_ = false;
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        continue_ = false;
+        available_.notify_all();
+      }
 
       if (closeThread_.joinable())
       {
         closeThread_.join();
       }
 
-      Close();
+      boost::mutex::scoped_lock lock(mutex_);
+
+      Connections::iterator it = connections_.begin();
+      while (it != connections_.end())
+      {
+        if ((*it)->busy_)
+        {
+          // Should never happen, as the users of the pool are stopped
+          // first. The connection will be closed by "Release()".
+          LOG(ERROR) << "INTERNAL ERROR: A SCU connection is still in use while finalizing the pool";
+          ++it;
+        }
+        else
+        {
+          delete (*it)->connection_;
+          delete *it;
+          it = connections_.erase(it);
+        }
+      }
     }
   }
 }
-
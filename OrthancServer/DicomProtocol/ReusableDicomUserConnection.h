@@ -33,46 +33,66 @@
 #pragma once
 
 #include "DicomUserConnection.h"
-#include "../../Core/MultiThreading/Locker.h"
 
 #include <boost/thread.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <json/value.h>
+#include <list>
 
 namespace Orthanc
 {
-  class ReusableDicomUserConnection : public ILockable
+  /**
+   * Pool of the outgoing DICOM associations. The associations are
+   * indexed by the local AET and the parameters of the remote
+   * modality. Several associations to the same modality can be used
+   * concurrently, up to a configurable maximum, and the associations
+   * that are idle for too long are automatically closed.
+   **/
+  class ReusableDicomUserConnection : public boost::noncopyable
   {
   private:
+    struct PooledConnection
+    {
+      std::string               key_;
+      std::string               modality_;     // "AET@host:port", for statistics
+      DicomUserConnection*      connection_;   // NULL while opening
+      bool                      busy_;
+      boost::posix_time::ptime  lastUse_;
+    };
+
+    typedef std::list<PooledConnection*>  Connections;
+
     boost::mutex mutex_;
-    DicomUserConnection* connection_;
+    boost::condition_variable available_;
+    Connections connections_;
+    unsigned int maxPerModality_;
+    uint64_t countOpened_;
+    uint64_t countReused_;
     bool continue_;
     boost::posix_time::time_duration timeBeforeClose_;
-    boost::posix_time::ptime lastUse_;
     boost::thread closeThread_;
 
-    void Open(const std::string& localAet,
-              const RemoteModalityParameters& remote);
-    
-    void Close();
+    PooledConnection& Acquire(const std::string& localAet,
+                              const RemoteModalityParameters& remote);
 
-    static void CloseThread(ReusableDicomUserConnection* that);
+    void Release(PooledConnection& connection);
 
-  protected:
-    virtual void Lock();
+    static void CloseThread(ReusableDicomUserConnection* that);
 
-    virtual void Unlock();
-    
   public:
-    class Locker : public ::Orthanc::Locker
+    class Locker : public boost::noncopyable
     {
     private:
-      DicomUserConnection* connection_;
+      ReusableDicomUserConnection&  that_;
+      PooledConnection&             connection_;
 
     public:
       Locker(ReusableDicomUserConnection& that,
              const std::string& localAet,
              const RemoteModalityParameters& remote);
 
+      ~Locker();
+
       DicomUserConnection& GetConnection();
     };
 
@@ -82,7 +102,11 @@ namespace Orthanc
 
     void SetMillisecondsBeforeClose(uint64_t ms);
 
+    // Maximum number of simultaneous associations to one modality
+    void SetMaximumConnectionsPerModality(unsigned int count);
+
+    void FormatStatistics(Json::Value& target);
+
     void Finalize();
   };
 }
-
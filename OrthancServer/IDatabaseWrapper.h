@@ -40,10 +40,14 @@
 #include "ExportedResource.h"
 
 #include <list>
+#include <map>
+#include <vector>
 #include <boost/noncopyable.hpp>
 
 namespace Orthanc
 {
+  class LookupIdentifierQuery;
+
   class IDatabaseWrapper : public boost::noncopyable
   {
   public:
@@ -80,6 +84,12 @@ namespace Orthanc
 
     virtual bool HasFlushToDisk() const = 0;
 
+    // Opens another connection to the same database, that will only
+    // be used for reading, possibly concurrently with this
+    // connection. Returns NULL if this is not supported by the
+    // database back-end.
+    virtual IDatabaseWrapper* OpenReadOnlyConnection() = 0;
+
     virtual void GetAllMetadata(std::map<MetadataType, std::string>& target,
                                 int64_t id) = 0;
 
@@ -94,6 +104,14 @@ namespace Orthanc
                                  size_t since,
                                  size_t limit) = 0;
 
+    // Keyset pagination: Lists at most "limit" resources of the given
+    // level whose internal identifier is strictly greater than
+    // "after", sorted by increasing internal identifier
+    virtual void GetPublicIdsAfter(std::list< std::pair<int64_t, std::string> >& target,
+                                   ResourceType resourceType,
+                                   int64_t after,
+                                   size_t limit) = 0;
+
     virtual void GetChanges(std::list<ServerIndexChange>& target /*out*/,
                             bool& done /*out*/,
                             int64_t since,
@@ -117,6 +135,12 @@ namespace Orthanc
     virtual void GetMainDicomTags(DicomMap& map,
                                   int64_t id) = 0;
 
+    // Bulk version of the method above, that avoids one query per
+    // resource. "target[i]" receives the main DICOM tags of the
+    // resource "ids[i]". The identifiers must be distinct.
+    virtual void GetMainDicomTags(const std::vector<DicomMap*>& target,
+                                  const std::vector<int64_t>& ids) = 0;
+
     virtual std::string GetPublicId(int64_t resourceId) = 0;
 
     virtual uint64_t GetResourceCount(ResourceType resourceType) = 0;
@@ -155,6 +179,11 @@ namespace Orthanc
                                   IdentifierConstraintType type,
                                   const std::string& value) = 0;
 
+    // Lists the resources that match all the constraints of a
+    // non-empty query, at the level of this query
+    virtual void LookupIdentifiers(std::list<int64_t>& result,
+                                   const LookupIdentifierQuery& query) = 0;
+
     virtual bool LookupMetadata(std::string& target,
                                 int64_t id,
                                 MetadataType type) = 0;
@@ -166,6 +195,30 @@ namespace Orthanc
                                 ResourceType& type,
                                 const std::string& publicId) = 0;
 
+    // Bulk versions of "LookupResource()", "LookupParent()" combined
+    // with "GetPublicId()", "GetChildrenPublicId()", "GetAllMetadata()"
+    // and "LookupAttachment()", that avoid one query per resource
+    // while expanding lists of resources. The resources that do not
+    // exist (or that do not have the expected type) are absent from
+    // the maps.
+    virtual void LookupResources(std::map<std::string, int64_t>& target,
+                                 ResourceType type,
+                                 const std::vector<std::string>& publicIds) = 0;
+
+    virtual void LookupParentsPublicId(std::map<int64_t, std::string>& target,
+                                       const std::vector<int64_t>& ids) = 0;
+
+    // The children are given as pairs (internal ID, public ID)
+    virtual void GetChildren(std::map<int64_t, std::list<std::pair<int64_t, std::string> > >& target,
+                             const std::vector<int64_t>& ids) = 0;
+
+    virtual void GetAllMetadata(std::map<int64_t, std::map<MetadataType, std::string> >& target,
+                                const std::vector<int64_t>& ids) = 0;
+
+    virtual void LookupAttachments(std::map<int64_t, FileInfo>& target,
+                                   FileContentType contentType,
+                                   const std::vector<int64_t>& ids) = 0;
+
     virtual bool SelectPatientToRecycle(int64_t& internalId) = 0;
 
     virtual bool SelectPatientToRecycle(int64_t& internalId,
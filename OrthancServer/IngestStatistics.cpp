@@ -0,0 +1,142 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersServer.h"
+#include "IngestStatistics.h"
+
+#include "../Core/OrthancException.h"
+
+namespace Orthanc
+{
+  static const char* GetStageName(IngestStatistics::Stage stage)
+  {
+    switch (stage)
+    {
+      case IngestStatistics::Stage_Parsing:
+        return "Parsing";
+
+      case IngestStatistics::Stage_Filtering:
+        return "Filtering";
+
+      case IngestStatistics::Stage_StorageWrite:
+        return "StorageWrite";
+
+      case IngestStatistics::Stage_IndexCommit:
+        return "IndexCommit";
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  IngestStatistics::Timer::Timer(IngestStatistics& statistics,
+                                 Stage stage) :
+    statistics_(statistics),
+    stage_(stage),
+    start_(boost::posix_time::microsec_clock::universal_time())
+  {
+  }
+
+
+  IngestStatistics::Timer::~Timer()
+  {
+    boost::posix_time::time_duration elapsed = 
+      boost::posix_time::microsec_clock::universal_time() - start_;
+
+    statistics_.Add(stage_, static_cast<uint64_t>(elapsed.total_microseconds()));
+  }
+
+
+  IngestStatistics::IngestStatistics()
+  {
+    Reset();
+  }
+
+
+  void IngestStatistics::Add(Stage stage,
+                             uint64_t microseconds)
+  {
+    if (static_cast<unsigned int>(stage) >= STAGES_COUNT)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    counters_[stage].count_ += 1;
+    counters_[stage].microseconds_ += microseconds;
+  }
+
+
+  void IngestStatistics::Reset()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    for (unsigned int i = 0; i < STAGES_COUNT; i++)
+    {
+      counters_[i].count_ = 0;
+      counters_[i].microseconds_ = 0;
+    }
+  }
+
+
+  void IngestStatistics::Format(Json::Value& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    target = Json::objectValue;
+
+    for (unsigned int i = 0; i < STAGES_COUNT; i++)
+    {
+      const Counter& counter = counters_[i];
+      double milliseconds = static_cast<double>(counter.microseconds_) / 1000.0;
+
+      Json::Value stage = Json::objectValue;
+      stage["Count"] = static_cast<unsigned int>(counter.count_);
+      stage["TotalMilliseconds"] = milliseconds;
+
+      if (counter.count_ == 0 ||
+          counter.microseconds_ == 0)
+      {
+        stage["AverageMilliseconds"] = 0.0;
+        stage["InstancesPerSecond"] = 0.0;
+      }
+      else
+      {
+        stage["AverageMilliseconds"] = milliseconds / static_cast<double>(counter.count_);
+        stage["InstancesPerSecond"] = (static_cast<double>(counter.count_) * 1000.0 / milliseconds);
+      }
+
+      target[GetStageName(static_cast<Stage>(i))] = stage;
+    }
+  }
+}
@@ -0,0 +1,95 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <json/value.h>
+#include <stdint.h>
+
+namespace Orthanc
+{
+  /**
+   * Thread-safe counters that keep track of the time spent in each
+   * stage of the ingest of an incoming DICOM instance. This makes it
+   * possible to spot the bottleneck of "ServerContext::Store()".
+   **/
+  class IngestStatistics : public boost::noncopyable
+  {
+  public:
+    enum Stage
+    {
+      Stage_Parsing = 0,       // Parsing of the tags and hashing of the identifiers
+      Stage_Filtering = 1,     // Calls to the filters of the listeners
+      Stage_StorageWrite = 2,  // Compression and writing to the storage area
+      Stage_IndexCommit = 3    // Transaction in the index (serialized)
+    };
+
+    class Timer : public boost::noncopyable
+    {
+    private:
+      IngestStatistics&         statistics_;
+      Stage                     stage_;
+      boost::posix_time::ptime  start_;
+
+    public:
+      Timer(IngestStatistics& statistics,
+            Stage stage);
+
+      ~Timer();
+    };
+
+  private:
+    static const unsigned int STAGES_COUNT = 4;
+
+    struct Counter
+    {
+      uint64_t  count_;
+      uint64_t  microseconds_;
+    };
+
+    boost::mutex  mutex_;
+    Counter       counters_[STAGES_COUNT];
+
+  public:
+    IngestStatistics();
+
+    void Add(Stage stage,
+             uint64_t microseconds);
+
+    void Reset();
+
+    void Format(Json::Value& target);
+  };
+}
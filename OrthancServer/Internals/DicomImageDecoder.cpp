@@ -708,20 +708,26 @@ namespace Orthanc
         int64_t a, b;
         ImageProcessing::GetMinMaxValue(a, b, *image);
 
+        // If the source image is not grayscale 8bpp, the stretching
+        // and the conversion to 8bpp are done in one single pass
+        std::auto_ptr<ImageAccessor> target;
+        if (image->GetFormat() != PixelFormat_Grayscale8)
+        {
+          target.reset(new Image(PixelFormat_Grayscale8, image->GetWidth(), image->GetHeight()));
+        }
+
         if (a == b)
         {
-          ImageProcessing::Set(*image, 0);
+          ImageProcessing::Set(target.get() == NULL ? *image : *target, 0);
         }
         else
         {
-          ImageProcessing::ShiftScale(*image, static_cast<float>(-a), 255.0f / static_cast<float>(b - a));
+          ImageProcessing::ShiftScale(target.get() == NULL ? *image : *target, *image,
+                                      static_cast<float>(-a), 255.0f / static_cast<float>(b - a));
         }
 
-        // If the source image is not grayscale 8bpp, convert it
-        if (image->GetFormat() != PixelFormat_Grayscale8)
+        if (target.get() != NULL)
         {
-          std::auto_ptr<ImageAccessor> target(new Image(PixelFormat_Grayscale8, image->GetWidth(), image->GetHeight()));
-          ImageProcessing::Convert(*target, *image);
           image = target;
         }
 
@@ -110,6 +110,7 @@ namespace Orthanc
   static void ExtractTagFromInstances(std::set<std::string>& target,
                                       ServerContext& context,
                                       const DicomTag& tag,
+                                      MetadataType metadata,  // Metadata caching the value of the tag
                                       const std::list<std::string>& instances)
   {
     std::string formatted = tag.Format();
@@ -117,6 +118,14 @@ namespace Orthanc
     for (std::list<std::string>::const_iterator
            it = instances.begin(); it != instances.end(); ++it)
     {
+      std::string value;
+      if (context.GetIndex().LookupMetadata(value, *it, metadata))
+      {
+        target.insert(value);
+        continue;
+      }
+
+      // This instance was received before the metadata was introduced
       Json::Value dicom;
       context.ReadJson(dicom, *it);
 
@@ -224,7 +233,8 @@ namespace Orthanc
     if (query.HasTag(DICOM_TAG_SOP_CLASSES_IN_STUDY))
     {
       std::set<std::string> values;
-      ExtractTagFromInstances(values, context, DICOM_TAG_SOP_CLASS_UID, instances);
+      ExtractTagFromInstances(values, context, DICOM_TAG_SOP_CLASS_UID,
+                              MetadataType_Instance_SopClassUid, instances);
       StoreSetOfStrings(result, DICOM_TAG_SOP_CLASSES_IN_STUDY, values);
     }
   }
@@ -247,7 +257,7 @@ namespace Orthanc
 
 
   static DicomMap* ComputeCounters(ServerContext& context,
-                                   const std::string& instanceId,
+                                   const std::string& resourceId,
                                    ResourceType level,
                                    const DicomMap& query)
   {
@@ -286,26 +296,20 @@ namespace Orthanc
         return NULL;
     }
 
-    std::string parent;
-    if (!context.GetIndex().LookupParent(parent, instanceId, level))
-    {
-      throw OrthancException(ErrorCode_UnknownResource);  // The resource was deleted in between
-    }
-
     std::auto_ptr<DicomMap> result(new DicomMap);
 
     switch (level)
     {
       case ResourceType_Patient:
-        ComputePatientCounters(*result, context.GetIndex(), parent, query);
+        ComputePatientCounters(*result, context.GetIndex(), resourceId, query);
         break;
 
       case ResourceType_Study:
-        ComputeStudyCounters(*result, context, parent, query);
+        ComputeStudyCounters(*result, context, resourceId, query);
         break;
 
       case ResourceType_Series:
-        ComputeSeriesCounters(*result, context.GetIndex(), parent, query);
+        ComputeSeriesCounters(*result, context.GetIndex(), resourceId, query);
         break;
 
       default:
@@ -316,6 +320,123 @@ namespace Orthanc
   }
 
 
+  static void CopyCounters(DicomMap& result,
+                           const DicomMap* counters)
+  {
+    if (counters != NULL)
+    {
+      DicomArray tmp(*counters);
+      for (size_t i = 0; i < tmp.GetSize(); i++)
+      {
+        result.SetValue(tmp.GetElement(i).GetTag(), tmp.GetElement(i).GetValue().GetContent());
+      }
+    }
+  }
+
+
+  static bool IsAnsweredByCounters(const DicomTag& tag)
+  {
+    return (tag == DICOM_TAG_NUMBER_OF_PATIENT_RELATED_STUDIES ||
+            tag == DICOM_TAG_NUMBER_OF_PATIENT_RELATED_SERIES ||
+            tag == DICOM_TAG_NUMBER_OF_PATIENT_RELATED_INSTANCES ||
+            tag == DICOM_TAG_NUMBER_OF_STUDY_RELATED_SERIES ||
+            tag == DICOM_TAG_NUMBER_OF_STUDY_RELATED_INSTANCES ||
+            tag == DICOM_TAG_NUMBER_OF_SERIES_RELATED_INSTANCES ||
+            tag == DICOM_TAG_SOP_CLASSES_IN_STUDY ||
+            tag == DICOM_TAG_MODALITIES_IN_STUDY);
+  }
+
+
+  static bool IsAnsweredByIndex(const DicomArray& query,
+                                ResourceType level)
+  {
+    // Check whether all the requested tags are main DICOM tags of the
+    // query level or of one of its ancestors, in which case the
+    // answers can be built without reading the JSON summaries
+    for (size_t i = 0; i < query.GetSize(); i++)
+    {
+      const DicomTag& tag = query.GetElement(i).GetTag();
+
+      if (tag == DICOM_TAG_QUERY_RETRIEVE_LEVEL ||
+          tag == DICOM_TAG_SPECIFIC_CHARACTER_SET ||
+          IsAnsweredByCounters(tag))
+      {
+        continue;
+      }
+
+      bool found = false;
+      ResourceType current = level;
+
+      for (;;)
+      {
+        if (DicomMap::IsMainDicomTag(tag, current))
+        {
+          found = true;
+          break;
+        }
+
+        if (current == ResourceType_Patient)
+        {
+          break;
+        }
+
+        current = GetParentResourceType(current);
+      }
+
+      if (!found)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  static void AddAnswerFromIndex(DicomFindAnswers& answers,
+                                 const DicomMap& mainDicomTags,
+                                 const DicomArray& query,
+                                 const DicomMap* counters)
+  {
+    DicomMap result;
+
+    for (size_t i = 0; i < query.GetSize(); i++)
+    {
+      const DicomTag& tag = query.GetElement(i).GetTag();
+
+      if (tag == DICOM_TAG_QUERY_RETRIEVE_LEVEL)
+      {
+        result.SetValue(tag, query.GetElement(i).GetValue());
+      }
+      else if (tag != DICOM_TAG_SPECIFIC_CHARACTER_SET)
+      {
+        const DicomValue* value = mainDicomTags.TestAndGetValue(tag);
+        if (value != NULL &&
+            !value->IsNull() &&
+            !value->IsBinary())
+        {
+          result.SetValue(tag, value->GetContent());
+        }
+        else
+        {
+          result.SetValue(tag, "");
+        }
+      }
+    }
+
+    CopyCounters(result, counters);
+
+    if (result.GetSize() == 0)
+    {
+      LOG(WARNING) << "The C-FIND request does not return any DICOM tag";
+    }
+    else
+    {
+      answers.Add(result);
+    }
+  }
+
+
   static void AddAnswer(DicomFindAnswers& answers,
                         const Json::Value& resource,
                         const DicomArray& query,
@@ -351,14 +472,7 @@ namespace Orthanc
       }
     }
 
-    if (counters != NULL)
-    {
-      DicomArray tmp(*counters);
-      for (size_t i = 0; i < tmp.GetSize(); i++)
-      {
-        result.SetValue(tmp.GetElement(i).GetTag(), tmp.GetElement(i).GetValue().GetContent());
-      }
-    }
+    CopyCounters(result, counters);
 
     if (result.GetSize() == 0 &&
         sequencesToReturn.empty())
@@ -636,31 +750,71 @@ namespace Orthanc
 
     size_t maxResults = (level == ResourceType_Instance) ? maxInstances_ : maxResults_;
 
-    std::vector<std::string> resources, instances;
-    context_.GetIndex().FindCandidates(resources, instances, finder);
+    // Ask for one more candidate, so as to detect incomplete answers
+    std::vector<std::string> resources;
+    context_.GetIndex().FindCandidates(resources, finder, (maxResults == 0 ? 0 : maxResults + 1));
 
-    assert(resources.size() == instances.size());
     bool complete = true;
 
-    for (size_t i = 0; i < instances.size(); i++)
+    // If the constraints have been fully checked by the index, and if
+    // the requested tags are all stored in the index, the JSON
+    // summaries of the instances need not be read from the disk
+    bool fromIndex = (sequencesToReturn.empty() &&
+                      !finder.HasUnoptimizedConstraints() &&
+                      IsAnsweredByIndex(query, level));
+
+    if (fromIndex)
+    {
+      LOG(INFO) << "The C-FIND answers are built from the index only";
+    }
+
+    for (size_t i = 0; i < resources.size(); i++)
     {
       Json::Value dicom;
-      context_.ReadJson(dicom, instances[i]);
-      
-      if (finder.IsMatch(dicom))
+      DicomMap mainDicomTags;
+
+      if (fromIndex)
       {
-        if (maxResults != 0 &&
-            answers.GetSize() >= maxResults)
+        if (!context_.GetIndex().GetMainDicomTagsWithParents(mainDicomTags, resources[i], level))
         {
-          complete = false;
-          break;
+          throw OrthancException(ErrorCode_UnknownResource);  // The resource was deleted in between
         }
-        else
+      }
+      else
+      {
+        // The child instance is only looked up for the candidates
+        // whose JSON summary is actually needed
+        std::string instance;
+        if (!context_.GetIndex().LookupOneChildInstance(instance, resources[i]))
+        {
+          throw OrthancException(ErrorCode_UnknownResource);  // The resource was deleted in between
+        }
+
+        context_.ReadJson(dicom, instance);
+
+        if (!finder.IsMatch(dicom))
         {
-          std::auto_ptr<DicomMap> counters(ComputeCounters(context_, instances[i], level, input));
-          AddAnswer(answers, dicom, query, sequencesToReturn, counters.get());
+          continue;
         }
       }
+
+      if (maxResults != 0 &&
+          answers.GetSize() >= maxResults)
+      {
+        complete = false;
+        break;
+      }
+
+      std::auto_ptr<DicomMap> counters(ComputeCounters(context_, resources[i], level, input));
+
+      if (fromIndex)
+      {
+        AddAnswerFromIndex(answers, mainDicomTags, query, counters.get());
+      }
+      else
+      {
+        AddAnswer(answers, dicom, query, sequencesToReturn, counters.get());
+      }
     }
 
     LOG(INFO) << "Number of matching resources: " << answers.GetSize();
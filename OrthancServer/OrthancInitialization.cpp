@@ -917,7 +917,15 @@ namespace Orthanc
     {
     }
 
-    return new DatabaseWrapper(indexDirectory.string() + "/index");
+    std::auto_ptr<DatabaseWrapper> database(new DatabaseWrapper(indexDirectory.string() + "/index"));
+
+    if (Configuration::GetGlobalIntegerParameter("IndexReadConnections", 0) > 0)
+    {
+      // Other connections will be opened to read the database
+      database->SetExclusiveLocking(false);
+    }
+
+    return database.release();
   }
 
 
@@ -33,6 +33,7 @@
 #include "../PrecompiledHeadersServer.h"
 #include "OrthancRestApi.h"
 
+#include "../../Core/HttpServer/HttpToolbox.h"
 #include "../../Core/Logging.h"
 #include "../DicomModification.h"
 #include "../ServerContext.h"
@@ -78,6 +79,56 @@ namespace Orthanc
 
   // Upload of DICOM files through HTTP ---------------------------------------
 
+  static void UploadMultipartDicomFiles(RestApiPostCall& call,
+                                        const std::string& boundary)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    std::vector<HttpToolbox::MultipartPart> parts;
+    HttpToolbox::ParseMultipartBody(parts, call.GetBodyData(), call.GetBodySize(), boundary);
+
+    LOG(INFO) << "Receiving a bundle of " << parts.size() << " DICOM files through HTTP";
+
+    // The answer contains one item per part, in the same order
+    Json::Value result = Json::arrayValue;
+
+    for (size_t i = 0; i < parts.size(); i++)
+    {
+      Json::Value item = Json::objectValue;
+
+      try
+      {
+        std::string dicom(parts[i].data_, parts[i].size_);
+
+        DicomInstanceToStore toStore;
+        toStore.SetRestOrigin(call);
+        toStore.SetBuffer(dicom);
+
+        std::string publicId;
+        StoreStatus status = context.Store(publicId, toStore);
+
+        if (status != StoreStatus_Failure)
+        {
+          item["ID"] = publicId;
+          item["Path"] = GetBasePath(ResourceType_Instance, publicId);
+        }
+
+        item["Status"] = EnumerationToString(status);
+      }
+      catch (OrthancException& e)
+      {
+        // Do not discard the other files of the bundle
+        LOG(ERROR) << "Cannot store a DICOM file of a bundle: " << e.What();
+        item["Status"] = EnumerationToString(StoreStatus_Failure);
+      }
+
+      result.append(item);
+    }
+
+    call.GetOutput().AnswerJson(result);
+  }
+
+
   static void UploadDicomFile(RestApiPostCall& call)
   {
     ServerContext& context = OrthancRestApi::GetContext(call);
@@ -87,6 +138,14 @@ namespace Orthanc
       return;
     }
 
+    std::string boundary;
+    if (HttpToolbox::ParseMultipartBoundary(boundary, call.GetHttpHeader("content-type", "")))
+    {
+      // Bundle of DICOM files, e.g. sent by another Orthanc peer
+      UploadMultipartDicomFiles(call, boundary);
+      return;
+    }
+
     LOG(INFO) << "Receiving a DICOM file of " << call.GetBodySize() << " bytes through HTTP";
 
     // TODO Remove unneccessary memcpy
@@ -36,12 +36,13 @@
 #include "../DicomDirWriter.h"
 #include "../../Core/FileStorage/StorageAccessor.h"
 #include "../../Core/Compression/HierarchicalZipWriter.h"
-#include "../../Core/HttpServer/FilesystemHttpSender.h"
 #include "../../Core/Logging.h"
 #include "../../Core/Uuid.h"
 #include "../ServerContext.h"
 
 #include <stdio.h>
+#include <algorithm>
+#include <boost/thread.hpp>
 
 #if defined(_MSC_VER)
 #define snprintf _snprintf
@@ -423,11 +424,221 @@ namespace Orthanc
     };
 
 
+    /**
+     * Reads (and uncompresses) the DICOM files of the archive from a
+     * pool of worker threads, a bounded number of instances ahead of
+     * the writer. The files are given back in the order of the visit,
+     * so that the content of the ZIP archive is deterministic.
+     **/
+    class ArchivePrefetcher : public IArchiveVisitor
+    {
+    private:
+      ServerContext&               context_;
+      unsigned int                 countThreads_;
+      size_t                       maxPending_;  // Number of files that are read in advance
+      std::vector<std::string>     instances_;
+      std::vector<FileInfo>        files_;
+      std::vector<std::string*>    contents_;
+      boost::mutex                 mutex_;
+      boost::condition_variable    changed_;
+      size_t                       nextToRead_;
+      size_t                       next_;
+      bool                         done_;
+      ErrorCode                    error_;
+      std::vector<boost::thread*>  threads_;
+
+      static void Worker(ArchivePrefetcher* that)
+      {
+        for (;;)
+        {
+          size_t index;
+
+          {
+            boost::mutex::scoped_lock lock(that->mutex_);
+
+            while (!that->done_ &&
+                   that->error_ == ErrorCode_Success &&
+                   that->nextToRead_ < that->files_.size() &&
+                   that->nextToRead_ >= that->next_ + that->maxPending_)
+            {
+              that->changed_.wait(lock);
+            }
+
+            if (that->done_ ||
+                that->error_ != ErrorCode_Success ||
+                that->nextToRead_ >= that->files_.size())
+            {
+              return;
+            }
+
+            index = that->nextToRead_;
+            that->nextToRead_++;
+          }
+
+          std::auto_ptr<std::string> content(new std::string);
+          ErrorCode error = ErrorCode_Success;
+
+          try
+          {
+            that->context_.ReadFile(*content, that->files_[index]);
+          }
+          catch (OrthancException& e)
+          {
+            error = e.GetErrorCode();
+          }
+          catch (...)
+          {
+            error = ErrorCode_InternalError;
+          }
+
+          boost::mutex::scoped_lock lock(that->mutex_);
+
+          if (error == ErrorCode_Success)
+          {
+            that->contents_[index] = content.release();
+          }
+          else
+          {
+            that->error_ = error;
+          }
+
+          that->changed_.notify_all();
+        }
+      }
+
+    public:
+      ArchivePrefetcher(ServerContext& context) :
+        context_(context),
+        countThreads_(context.GetArchiveThreads()),
+        nextToRead_(0),
+        next_(0),
+        done_(false),
+        error_(ErrorCode_Success)
+      {
+        if (countThreads_ == 0)
+        {
+          countThreads_ = 1;
+        }
+
+        maxPending_ = 2 * countThreads_;
+      }
+
+      ~ArchivePrefetcher()
+      {
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          done_ = true;
+          changed_.notify_all();
+        }
+
+        for (size_t i = 0; i < threads_.size(); i++)
+        {
+          if (threads_[i]->joinable())
+          {
+            threads_[i]->join();
+          }
+
+          delete threads_[i];
+        }
+
+        for (size_t i = 0; i < contents_.size(); i++)
+        {
+          if (contents_[i] != NULL)
+          {
+            delete contents_[i];
+          }
+        }
+      }
+
+      virtual void Open(ResourceType level,
+                        const std::string& publicId)
+      {
+      }
+
+      virtual void Close()
+      {
+      }
+
+      virtual void AddInstance(const std::string& instanceId,
+                               const FileInfo& dicom)
+      {
+        instances_.push_back(instanceId);
+        files_.push_back(dicom);
+      }
+
+      void Start()
+      {
+        if (!threads_.empty())
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
+
+        contents_.resize(files_.size(), NULL);
+
+        size_t count = std::min(static_cast<size_t>(countThreads_), files_.size());
+        for (size_t i = 0; i < count; i++)
+        {
+          threads_.push_back(new boost::thread(Worker, this));
+        }
+      }
+
+      // Must be invoked in the same order as "AddInstance()"
+      void GetNext(std::string& content,
+                   const std::string& instanceId)
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (next_ >= instances_.size() ||
+            next_ >= contents_.size() ||
+            instances_[next_] != instanceId)
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        while (contents_[next_] == NULL &&
+               error_ == ErrorCode_Success)
+        {
+          changed_.wait(lock);
+        }
+
+        if (contents_[next_] == NULL)
+        {
+          throw OrthancException(error_);
+        }
+
+        std::auto_ptr<std::string> item(contents_[next_]);
+        contents_[next_] = NULL;
+        content.swap(*item);
+        next_++;
+
+        changed_.notify_all();
+      }
+    };
+
+
+    class HttpZipStream : public ZipWriter::IOutputStream
+    {
+    private:
+      RestApiOutput&  output_;
+
+    public:
+      HttpZipStream(RestApiOutput& output) : output_(output)
+      {
+      }
+
+      virtual void Write(const std::string& chunk)
+      {
+        output_.SendStreamItem(chunk.c_str(), chunk.size());
+      }
+    };
+
+
     class ArchiveWriterVisitor : public IArchiveVisitor
     {
     private:
       HierarchicalZipWriter&  writer_;
-      ServerContext&            context_;
+      ServerContext&          context_;
+      ArchivePrefetcher&      prefetcher_;
       char                    instanceFormat_[24];
       unsigned int            countInstances_;
 
@@ -449,9 +660,11 @@ namespace Orthanc
 
     public:
       ArchiveWriterVisitor(HierarchicalZipWriter& writer,
-                           ServerContext& context) :
+                           ServerContext& context,
+                           ArchivePrefetcher& prefetcher) :
         writer_(writer),
         context_(context),
+        prefetcher_(prefetcher),
         countInstances_(0)
       {
         snprintf(instanceFormat_, sizeof(instanceFormat_) - 1, "%%08d.dcm");
@@ -524,7 +737,7 @@ namespace Orthanc
                                const FileInfo& dicom)
       {
         std::string content;
-        context_.ReadFile(content, dicom);
+        prefetcher_.GetNext(content, instanceId);
 
         char filename[24];
         snprintf(filename, sizeof(filename) - 1, instanceFormat_, countInstances_);
@@ -546,27 +759,23 @@ namespace Orthanc
 
         const bool isZip64 = IsZip64Required(stats.GetUncompressedSize(), stats.GetInstancesCount());
 
-        // Create a RAII for the temporary file to manage the ZIP file
-        Toolbox::TemporaryFile tmp;
+        ArchivePrefetcher prefetcher(context);
+        archive.Apply(prefetcher);
+        prefetcher.Start();
 
-        {
-          // Create a ZIP writer
-          HierarchicalZipWriter writer(tmp.GetPath().c_str());
-          writer.SetZip64(isZip64);
-
-          ArchiveWriterVisitor v(writer, context);
-          archive.Apply(v);
-        }
+        // The ZIP file is directly streamed to the HTTP client,
+        // without being written to a temporary file
+        output.StartStream("application/zip", filename);
 
-        // Prepare the sending of the ZIP file
-        FilesystemHttpSender sender(tmp.GetPath());
-        sender.SetContentType("application/zip");
-        sender.SetContentFilename(filename);
+        HttpZipStream stream(output);
+        HierarchicalZipWriter writer(stream);
+        writer.SetZip64(isZip64);
 
-        // Send the ZIP
-        output.AnswerStream(sender);
+        ArchiveWriterVisitor v(writer, context, prefetcher);
+        archive.Apply(v);
 
-        // The temporary file is automatically removed thanks to the RAII
+        writer.Close();
+        output.CloseStream();
       }
     };
 
@@ -577,13 +786,16 @@ namespace Orthanc
       HierarchicalZipWriter&  writer_;
       DicomDirWriter          dicomDir_;
       ServerContext&          context_;
+      ArchivePrefetcher&      prefetcher_;
       unsigned int            countInstances_;
 
     public:
       MediaWriterVisitor(HierarchicalZipWriter& writer,
-                         ServerContext& context) :
+                         ServerContext& context,
+                         ArchivePrefetcher& prefetcher) :
         writer_(writer),
         context_(context),
+        prefetcher_(prefetcher),
         countInstances_(0)
       {
       }
@@ -612,7 +824,7 @@ namespace Orthanc
         writer_.OpenFile(filename.c_str());
 
         std::string content;
-        context_.ReadFile(content, dicom);
+        prefetcher_.GetNext(content, instanceId);
         writer_.Write(content);
 
         ParsedDicomFile parsed(content);
@@ -633,38 +845,29 @@ namespace Orthanc
 
         const bool isZip64 = IsZip64Required(stats.GetUncompressedSize(), stats.GetInstancesCount());
 
-        // Create a RAII for the temporary file to manage the ZIP file
-        Toolbox::TemporaryFile tmp;
+        ArchivePrefetcher prefetcher(context);
+        archive.Apply(prefetcher);
+        prefetcher.Start();
 
-        {
-          // Create a ZIP writer
-          HierarchicalZipWriter writer(tmp.GetPath().c_str());
-          writer.SetZip64(isZip64);
-          writer.OpenDirectory("IMAGES");
+        output.StartStream("application/zip", filename);
 
-          // Create the DICOMDIR writer
-          DicomDirWriter dicomDir;
-
-          MediaWriterVisitor v(writer, context);
-          archive.Apply(v);
-
-          // Add the DICOMDIR
-          writer.CloseDirectory();
-          writer.OpenFile("DICOMDIR");
-          std::string s;
-          v.EncodeDicomDir(s);
-          writer.Write(s);
-        }
+        HttpZipStream stream(output);
+        HierarchicalZipWriter writer(stream);
+        writer.SetZip64(isZip64);
+        writer.OpenDirectory("IMAGES");
 
-        // Prepare the sending of the ZIP file
-        FilesystemHttpSender sender(tmp.GetPath());
-        sender.SetContentType("application/zip");
-        sender.SetContentFilename(filename);
+        MediaWriterVisitor v(writer, context, prefetcher);
+        archive.Apply(v);
 
-        // Send the ZIP
-        output.AnswerStream(sender);
+        // Add the DICOMDIR
+        writer.CloseDirectory();
+        writer.OpenFile("DICOMDIR");
+        std::string s;
+        v.EncodeDicomDir(s);
+        writer.Write(s);
 
-        // The temporary file is automatically removed thanks to the RAII
+        writer.Close();
+        output.CloseStream();
       }
     };
   }
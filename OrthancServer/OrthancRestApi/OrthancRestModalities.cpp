@@ -700,6 +700,7 @@ namespace Orthanc
     }
 
     job.SetDescription("HTTP request: Store-SCU to peer \"" + remote + "\"");
+    job.SetPriority(1);  // The HTTP client is waiting for this job
 
     if (context.GetScheduler().SubmitAndWait(job))
     {
@@ -766,14 +767,19 @@ namespace Orthanc
     OrthancPeerParameters peer;
     Configuration::GetOrthancPeer(peer, remote);
 
+    // A single command, so that the instances are sent by bundles
+    // and concurrently by "StorePeerCommand"
     ServerJob job;
+    ServerCommandInstance& command = job.AddCommand(new StorePeerCommand(context, peer, false));
+
     for (std::list<std::string>::const_iterator 
            it = instances.begin(); it != instances.end(); ++it)
     {
-      job.AddCommand(new StorePeerCommand(context, peer, false)).AddInput(*it);
+      command.AddInput(*it);
     }
 
     job.SetDescription("HTTP request: POST to peer \"" + remote + "\"");
+    job.SetPriority(1);  // The HTTP client is waiting for this job
 
     if (context.GetScheduler().SubmitAndWait(job))
     {
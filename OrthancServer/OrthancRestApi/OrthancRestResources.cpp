@@ -35,43 +35,77 @@
 
 #include "../../Core/Logging.h"
 #include "../../Core/HttpServer/HttpContentNegociation.h"
+#include "../../Core/Images/Image.h"
+#include "../../Core/Images/ImageProcessing.h"
+#include "../../Core/RestApi/RestApiJsonStream.h"
 #include "../ServerToolbox.h"
 #include "../FromDcmtkBridge.h"
 #include "../ServerContext.h"
 #include "../SliceOrdering.h"
 #include "../Internals/DicomImageDecoder.h"
+#include "../Scheduler/ChangeCompressionCommand.h"
+#include "../Scheduler/ChangeDicomAsJsonCommand.h"
+
+#include <boost/math/special_functions/round.hpp>
+#include <algorithm>
 
 
 namespace Orthanc
 {
   // List all the patients, studies, series or instances ----------------------
  
-  static void AnswerListOfResources(RestApiOutput& output,
-                                    ServerIndex& index,
-                                    const std::list<std::string>& resources,
-                                    ResourceType level,
-                                    bool expand)
+  static void WriteListOfResources(RestApiJsonStream& stream,
+                                   ServerIndex& index,
+                                   const std::list<std::string>& resources,
+                                   ResourceType level,
+                                   bool expand)
   {
-    Json::Value answer = Json::arrayValue;
+    // Number of resources that are expanded before being written
+    static const size_t CHUNK_SIZE = 256;
 
-    for (std::list<std::string>::const_iterator
-           resource = resources.begin(); resource != resources.end(); ++resource)
+    stream.StartArray();
+
+    std::list<std::string>::const_iterator resource = resources.begin();
+    while (resource != resources.end())
     {
       if (expand)
       {
-        Json::Value item;
-        if (index.LookupResource(item, *resource, level))
+        std::list<std::string> chunk;
+        while (resource != resources.end() &&
+               chunk.size() < CHUNK_SIZE)
+        {
+          chunk.push_back(*resource);
+          ++resource;
+        }
+
+        Json::Value expanded;
+        index.ExpandResources(expanded, chunk, level);
+
+        for (Json::Value::ArrayIndex i = 0; i < expanded.size(); i++)
         {
-          answer.append(item);
+          stream.WriteValue(expanded[i]);
         }
       }
       else
       {
-        answer.append(*resource);
+        stream.WriteValue(*resource);
+        ++resource;
       }
     }
 
-    output.AnswerJson(answer);
+    stream.EndArray();
+  }
+
+
+  static void AnswerListOfResources(RestApiOutput& output,
+                                    ServerIndex& index,
+                                    const std::list<std::string>& resources,
+                                    ResourceType level,
+                                    bool expand)
+  {
+    RestApiJsonStream stream(output);
+    WriteListOfResources(stream, index, resources, level, expand);
+    stream.Close();
   }
 
 
@@ -82,6 +116,63 @@ namespace Orthanc
 
     std::list<std::string> result;
 
+    if (call.HasArgument("after"))
+    {
+      // Keyset pagination: The answer embeds the continuation token
+      // to be provided as the "after" argument of the next page
+      if (call.HasArgument("since"))
+      {
+        LOG(ERROR) << "The \"since\" and \"after\" arguments cannot be combined for GET request against: " 
+                   << call.FlattenUri();
+        throw OrthancException(ErrorCode_BadRequest);
+      }
+
+      if (!call.HasArgument("limit"))
+      {
+        LOG(ERROR) << "Missing \"limit\" argument for GET request against: " << call.FlattenUri();
+        throw OrthancException(ErrorCode_BadRequest);
+      }
+
+      // Parse as a signed integer, otherwise "-1" would wrap around
+      const std::string argument = call.GetArgument("limit", "");
+      int64_t limit = 0;
+
+      try
+      {
+        limit = boost::lexical_cast<int64_t>(argument);
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+      }
+
+      if (limit <= 0)
+      {
+        LOG(ERROR) << "Bad \"limit\" argument (must be a positive integer): " << argument;
+        throw OrthancException(ErrorCode_BadRequest);
+      }
+
+      std::string next;
+      bool done = index.GetUuidsAfter(result, next, resourceType, call.GetArgument("after", ""),
+                                       static_cast<size_t>(limit));
+
+      RestApiJsonStream stream(call.GetOutput());
+      stream.StartObject();
+      stream.WriteKey("Resources");
+      WriteListOfResources(stream, index, result, resourceType, call.HasArgument("expand"));
+      stream.WriteKey("Done");
+      stream.WriteValue(done);
+
+      if (!done)
+      {
+        stream.WriteKey("Next");
+        stream.WriteValue(next);
+      }
+
+      stream.EndObject();
+      stream.Close();
+      return;
+    }
+
     if (call.HasArgument("limit") ||
         call.HasArgument("since"))
     {
@@ -175,7 +266,8 @@ namespace Orthanc
     ServerContext& context = OrthancRestApi::GetContext(call);
 
     std::string publicId = call.GetUriComponent("id", "");
-    context.AnswerAttachment(call.GetOutput(), publicId, FileContentType_Dicom);
+    context.AnswerAttachment(call.GetOutput(), publicId, FileContentType_Dicom,
+                             call.GetHttpHeader("range", ""));
   }
 
 
@@ -210,11 +302,14 @@ namespace Orthanc
 
       Json::Value simplified;
       Toolbox::SimplifyTags(simplified, full, DicomToJsonFormat_Human);
-      call.GetOutput().AnswerJson(simplified);
+
+      RestApiJsonStream stream(call.GetOutput());
+      stream.WriteValue(simplified);
+      stream.Close();
     }
     else
     {
-      context.AnswerAttachment(call.GetOutput(), publicId, FileContentType_DicomAsJson);
+      context.AnswerDicomAsJson(call.GetOutput(), publicId);
     }
   }
 
@@ -266,34 +361,58 @@ namespace Orthanc
     class ImageToEncode
     {
     private:
-      std::auto_ptr<ImageAccessor>&  image_;
-      ImageExtractionMode            mode_;
-      std::string                    format_;
-      std::string                    answer_;
+      ImageExtractionMode  mode_;
+      std::string          format_;
+      uint8_t              quality_;
 
     public:
-      ImageToEncode(std::auto_ptr<ImageAccessor>& image,
-                    ImageExtractionMode mode) : 
-        image_(image),
-        mode_(mode)
+      ImageToEncode(ImageExtractionMode mode) : 
+        mode_(mode),
+        quality_(0)
+      {
+      }
+
+      void SetMode(ImageExtractionMode mode)
       {
+        mode_ = mode;
       }
 
-      void Answer(RestApiOutput& output)
+      const std::string& GetFormat() const
       {
-        output.AnswerBuffer(answer_, format_);
+        return format_;
+      }
+
+      uint8_t GetQuality() const
+      {
+        return quality_;
       }
 
       void EncodeUsingPng()
       {
         format_ = "image/png";
-        DicomImageDecoder::ExtractPngImage(answer_, image_, mode_);
       }
 
       void EncodeUsingJpeg(uint8_t quality)
       {
         format_ = "image/jpeg";
-        DicomImageDecoder::ExtractJpegImage(answer_, image_, mode_, quality);
+        quality_ = quality;
+      }
+
+      void Encode(std::string& answer,
+                  std::auto_ptr<ImageAccessor>& image) const
+      {
+        if (format_ == "image/png")
+        {
+          DicomImageDecoder::ExtractPngImage(answer, image, mode_);
+        }
+        else if (format_ == "image/jpeg")
+        {
+          DicomImageDecoder::ExtractJpegImage(answer, image, mode_, quality_);
+        }
+        else
+        {
+          throw OrthancException(ErrorCode_BadSequenceOfCalls);
+        }
       }
     };
 
@@ -357,8 +476,326 @@ namespace Orthanc
   }
 
 
-  template <enum ImageExtractionMode mode>
-  static void GetImage(RestApiGetCall& call)
+  namespace
+  {
+    /**
+     * Server-side rendering of the frames, as specified by the GET
+     * arguments: "crop" ("x,y,width,height" in the full frame),
+     * "width" and "height" (maximum size of the answer, the aspect
+     * ratio is preserved and the frame is never upscaled), and
+     * "window-center" and "window-width" (windowing of the grayscale
+     * previews, expressed in the units of the modality). If the
+     * windowing is only partially specified, or if "defaultWindow"
+     * is set, the missing values are read from the VOI tags of the
+     * instance.
+     **/
+    class RenderingParameters
+    {
+    private:
+      bool          hasCrop_;
+      unsigned int  cropX_;
+      unsigned int  cropY_;
+      unsigned int  cropWidth_;
+      unsigned int  cropHeight_;
+      unsigned int  maxWidth_;    // "0" means no constraint
+      unsigned int  maxHeight_;
+      bool          hasWindowCenter_;
+      bool          hasWindowWidth_;
+      float         windowCenter_;
+      float         windowWidth_;
+      bool          defaultWindow_;
+
+      static unsigned int ParseUnsignedInteger(const std::string& value,
+                                               const char* name)
+      {
+        try
+        {
+          return boost::lexical_cast<unsigned int>(Toolbox::StripSpaces(value));
+        }
+        catch (boost::bad_lexical_cast&)
+        {
+          LOG(ERROR) << "Bad value for the \"" << name << "\" argument of a rendering: " << value;
+          throw OrthancException(ErrorCode_BadRequest);
+        }
+      }
+
+      static float ParseFloat(const std::string& value,
+                              const char* name)
+      {
+        try
+        {
+          return boost::lexical_cast<float>(Toolbox::StripSpaces(value));
+        }
+        catch (boost::bad_lexical_cast&)
+        {
+          LOG(ERROR) << "Bad value for the \"" << name << "\" argument of a rendering: " << value;
+          throw OrthancException(ErrorCode_BadRequest);
+        }
+      }
+
+      // Reads the first value of a (possibly multi-valued) DS tag
+      static bool LookupFloatTag(float& target,
+                                 ParsedDicomFile& dicom,
+                                 const DicomTag& tag)
+      {
+        std::string value;
+        if (!dicom.GetTagValue(value, tag))
+        {
+          return false;
+        }
+
+        std::vector<std::string> tokens;
+        Toolbox::TokenizeString(tokens, value, '\\');
+
+        try
+        {
+          if (!tokens.empty())
+          {
+            target = boost::lexical_cast<float>(Toolbox::StripSpaces(tokens[0]));
+            return true;
+          }
+        }
+        catch (boost::bad_lexical_cast&)
+        {
+        }
+
+        return false;
+      }
+
+      bool HasWindowing() const
+      {
+        return defaultWindow_ || hasWindowCenter_ || hasWindowWidth_;
+      }
+
+      // Returns "false" iff the windowing must be replaced by the
+      // stretching of the dynamics of the preview
+      bool ApplyWindowing(std::auto_ptr<ImageAccessor>& image,
+                          ServerContext& context,
+                          const std::string& publicId) const
+      {
+        float center = windowCenter_;
+        float width = windowWidth_;
+        float slope = 1.0f;
+        float intercept = 0.0f;
+
+        {
+          ServerContext::DicomCacheLocker locker(context, publicId);
+
+          if ((!hasWindowCenter_ && !LookupFloatTag(center, locker.GetDicom(), DICOM_TAG_WINDOW_CENTER)) ||
+              (!hasWindowWidth_ && !LookupFloatTag(width, locker.GetDicom(), DICOM_TAG_WINDOW_WIDTH)))
+          {
+            if (hasWindowCenter_ || hasWindowWidth_)
+            {
+              LOG(ERROR) << "Both \"window-center\" and \"window-width\" must be provided, "
+                         << "as the instance has no VOI tags: " << publicId;
+              throw OrthancException(ErrorCode_BadRequest);
+            }
+            else
+            {
+              return false;
+            }
+          }
+
+          if (!LookupFloatTag(slope, locker.GetDicom(), DICOM_TAG_RESCALE_SLOPE) ||
+              std::abs(slope) <= std::numeric_limits<float>::epsilon())
+          {
+            slope = 1.0f;
+          }
+
+          if (!LookupFloatTag(intercept, locker.GetDicom(), DICOM_TAG_RESCALE_INTERCEPT))
+          {
+            intercept = 0.0f;
+          }
+        }
+
+        if (!(width >= 1.0f))
+        {
+          // An explicit "window-width" is checked by the constructor,
+          // so this width comes from a malformed VOI tag
+          LOG(WARNING) << "Ignoring the invalid width of the window of instance " 
+                       << publicId << ": " << width;
+          return false;
+        }
+
+        std::auto_ptr<ImageAccessor> target(new Image(PixelFormat_Grayscale8, image->GetWidth(), image->GetHeight()));
+        ImageProcessing::ApplyWindowing(*target, *image, center, width, slope, intercept);
+        image = target;
+
+        return true;
+      }
+
+    public:
+      RenderingParameters(const RestApiGetCall& call,
+                          bool defaultWindow) :
+        hasCrop_(false),
+        cropX_(0),
+        cropY_(0),
+        cropWidth_(0),
+        cropHeight_(0),
+        maxWidth_(0),
+        maxHeight_(0),
+        hasWindowCenter_(false),
+        hasWindowWidth_(false),
+        windowCenter_(0),
+        windowWidth_(0),
+        defaultWindow_(defaultWindow)
+      {
+        if (call.HasArgument("crop"))
+        {
+          std::vector<std::string> tokens;
+          Toolbox::TokenizeString(tokens, call.GetArgument("crop", ""), ',');
+
+          if (tokens.size() != 4)
+          {
+            LOG(ERROR) << "The \"crop\" argument of a rendering must be \"x,y,width,height\"";
+            throw OrthancException(ErrorCode_BadRequest);
+          }
+
+          hasCrop_ = true;
+          cropX_ = ParseUnsignedInteger(tokens[0], "crop");
+          cropY_ = ParseUnsignedInteger(tokens[1], "crop");
+          cropWidth_ = ParseUnsignedInteger(tokens[2], "crop");
+          cropHeight_ = ParseUnsignedInteger(tokens[3], "crop");
+        }
+
+        if (call.HasArgument("width"))
+        {
+          maxWidth_ = ParseUnsignedInteger(call.GetArgument("width", ""), "width");
+        }
+
+        if (call.HasArgument("height"))
+        {
+          maxHeight_ = ParseUnsignedInteger(call.GetArgument("height", ""), "height");
+        }
+
+        if (call.HasArgument("window-center"))
+        {
+          hasWindowCenter_ = true;
+          windowCenter_ = ParseFloat(call.GetArgument("window-center", ""), "window-center");
+        }
+
+        if (call.HasArgument("window-width"))
+        {
+          hasWindowWidth_ = true;
+          windowWidth_ = ParseFloat(call.GetArgument("window-width", ""), "window-width");
+
+          if (!(windowWidth_ >= 1.0f))   // Also rejects "NaN"
+          {
+            LOG(ERROR) << "The width of a window must be greater or equal to 1: " << windowWidth_;
+            throw OrthancException(ErrorCode_BadRequest);
+          }
+        }
+      }
+
+      // Serialization of the parameters, for the keys of the cache of the previews
+      std::string Format() const
+      {
+        std::string s;
+
+        if (hasCrop_)
+        {
+          s += ("crop=" + boost::lexical_cast<std::string>(cropX_) + "," +
+                boost::lexical_cast<std::string>(cropY_) + "," +
+                boost::lexical_cast<std::string>(cropWidth_) + "," +
+                boost::lexical_cast<std::string>(cropHeight_) + ";");
+        }
+
+        if (maxWidth_ != 0 ||
+            maxHeight_ != 0)
+        {
+          s += ("size=" + boost::lexical_cast<std::string>(maxWidth_) + "x" +
+                boost::lexical_cast<std::string>(maxHeight_) + ";");
+        }
+
+        if (defaultWindow_)
+        {
+          s += "window;";
+        }
+
+        if (hasWindowCenter_)
+        {
+          s += "center=" + boost::lexical_cast<std::string>(windowCenter_) + ";";
+        }
+
+        if (hasWindowWidth_)
+        {
+          s += "width=" + boost::lexical_cast<std::string>(windowWidth_) + ";";
+        }
+
+        return s;
+      }
+
+      // Crops, then resizes, then applies the windowing to the
+      // decoded frame. Returns "true" iff the windowing was applied.
+      bool Apply(std::auto_ptr<ImageAccessor>& image,
+                 ImageExtractionMode mode,
+                 ServerContext& context,
+                 const std::string& publicId) const
+      {
+        ImageAccessor region = *image;
+
+        if (hasCrop_)
+        {
+          if (cropWidth_ == 0 ||
+              cropHeight_ == 0 ||
+              cropX_ >= image->GetWidth() ||
+              cropY_ >= image->GetHeight() ||
+              cropWidth_ > image->GetWidth() - cropX_ ||
+              cropHeight_ > image->GetHeight() - cropY_)
+          {
+            LOG(ERROR) << "The cropping region exceeds the size of the frame";
+            throw OrthancException(ErrorCode_BadRequest);
+          }
+
+          region = image->GetRegion(cropX_, cropY_, cropWidth_, cropHeight_);
+        }
+
+        // Downsampling that preserves the aspect ratio
+        float scaling = 1.0f;
+
+        if (maxWidth_ != 0 &&
+            maxWidth_ < region.GetWidth())
+        {
+          scaling = static_cast<float>(maxWidth_) / static_cast<float>(region.GetWidth());
+        }
+
+        if (maxHeight_ != 0 &&
+            maxHeight_ < region.GetHeight())
+        {
+          scaling = std::min(scaling, static_cast<float>(maxHeight_) / static_cast<float>(region.GetHeight()));
+        }
+
+        if (hasCrop_ ||
+            scaling < 1.0f)
+        {
+          unsigned int width = std::max(1, boost::math::iround(scaling * static_cast<float>(region.GetWidth())));
+          unsigned int height = std::max(1, boost::math::iround(scaling * static_cast<float>(region.GetHeight())));
+
+          std::auto_ptr<ImageAccessor> target(new Image(region.GetFormat(), width, height));
+          ImageProcessing::Resize(*target, region);
+          image = target;
+        }
+
+        if (mode == ImageExtractionMode_Preview &&
+            HasWindowing() &&
+            (image->GetFormat() == PixelFormat_Grayscale8 ||
+             image->GetFormat() == PixelFormat_Grayscale16 ||
+             image->GetFormat() == PixelFormat_SignedGrayscale16))
+        {
+          return ApplyWindowing(image, context, publicId);
+        }
+        else
+        {
+          return false;
+        }
+      }
+    };
+  }
+
+
+  static void GetImageInternal(RestApiGetCall& call,
+                               ImageExtractionMode mode,
+                               bool defaultWindow)
   {
     ServerContext& context = OrthancRestApi::GetContext(call);
 
@@ -374,12 +811,48 @@ namespace Orthanc
       return;
     }
 
+    std::string publicId = call.GetUriComponent("id", "");
+
+    // The content negotiation only selects the encoding at this point
+    ImageToEncode image(mode);
+
+    HttpContentNegociation negociation;
+    EncodePng png(image);          negociation.Register("image/png", png);
+    EncodeJpeg jpeg(image, call);  negociation.Register("image/jpeg", jpeg);
+
+    if (!negociation.Apply(call.GetHttpHeaders()))
+    {
+      return;
+    }
+
+    RenderingParameters rendering(call, defaultWindow);
+
+    // Avoid decoding and encoding again the previews that were
+    // recently generated
+    PreviewCache& cache = context.GetPreviewCache();
+    std::string key = PreviewCache::FormatKey(publicId, frame, mode, image.GetFormat(), 
+                                              image.GetQuality(), rendering.Format());
+
+    // The cache might still hold the previews of an instance whose
+    // deletion is being committed
+    ResourceType type;
+    if (!context.GetIndex().LookupResourceType(type, publicId) ||
+        type != ResourceType_Instance)
+    {
+      return;
+    }
+
+    std::string answer;
+    if (cache.Lookup(answer, key, publicId))
+    {
+      call.GetOutput().AnswerBuffer(answer, image.GetFormat());
+      return;
+    }
+
     std::auto_ptr<ImageAccessor> decoded;
 
     try
     {
-      std::string publicId = call.GetUriComponent("id", "");
-
 #if ORTHANC_PLUGINS_ENABLED == 1
       if (context.GetPlugins().HasCustomImageDecoder())
       {
@@ -415,18 +888,35 @@ namespace Orthanc
 
         call.GetOutput().Redirect(root + "app/images/unsupported.png");
       }
-    }
-
-    ImageToEncode image(decoded, mode);
 
-    HttpContentNegociation negociation;
-    EncodePng png(image);          negociation.Register("image/png", png);
-    EncodeJpeg jpeg(image, call);  negociation.Register("image/jpeg", jpeg);
+      return;
+    }
 
-    if (negociation.Apply(call.GetHttpHeaders()))
+    if (rendering.Apply(decoded, mode, context, publicId))
     {
-      image.Answer(call.GetOutput());
+      // The windowing has already produced a grayscale 8bpp image,
+      // that must not be stretched again as a preview
+      image.SetMode(ImageExtractionMode_UInt8);
     }
+
+    image.Encode(answer, decoded);
+    cache.Store(key, publicId, answer);
+
+    call.GetOutput().AnswerBuffer(answer, image.GetFormat());
+  }
+
+
+  template <enum ImageExtractionMode mode>
+  static void GetImage(RestApiGetCall& call)
+  {
+    GetImageInternal(call, mode, false);
+  }
+
+
+  static void GetRenderedFrame(RestApiGetCall& call)
+  {
+    // Same as the preview, but the windowing defaults to the VOI tags
+    GetImageInternal(call, ImageExtractionMode_Preview, true);
   }
 
 
@@ -573,7 +1063,11 @@ namespace Orthanc
     for (std::list<FileContentType>::const_iterator 
            it = attachments.begin(); it != attachments.end(); ++it)
     {
-      result.append(EnumerationToString(*it));
+      // The spilled previews are an internal cache, not a content of the resource
+      if (*it != FileContentType_Preview)
+      {
+        result.append(EnumerationToString(*it));
+      }
     }
 
     call.GetOutput().AnswerJson(result);
@@ -642,7 +1136,8 @@ namespace Orthanc
 
     if (uncompress)
     {
-      context.AnswerAttachment(call.GetOutput(), publicId, type);
+      context.AnswerAttachment(call.GetOutput(), publicId, type,
+                               call.GetHttpHeader("range", ""));
     }
     else
     {
@@ -783,7 +1278,7 @@ namespace Orthanc
   }
 
 
-  template <enum CompressionType compression>
+  template <bool compress>
   static void ChangeAttachmentCompression(RestApiPostCall& call)
   {
     CheckValidResourceType(call);
@@ -792,11 +1287,166 @@ namespace Orthanc
     std::string name = call.GetUriComponent("name", "");
     FileContentType contentType = StringToContentType(name);
 
-    OrthancRestApi::GetContext(call).ChangeAttachmentCompression(publicId, contentType, compression);
+    ServerContext& context = OrthancRestApi::GetContext(call);
+    CompressionType compression = (compress ? context.GetCompressionType() : CompressionType_None);
+    context.ChangeAttachmentCompression(publicId, contentType, compression);
     call.GetOutput().AnswerBuffer("{}", "application/json");
   }
 
 
+  static void ParseMaintenanceRequest(Json::Value& request,
+                                      RestApiPostCall& call)
+  {
+    request = Json::objectValue;
+    if (call.GetBodySize() > 0 &&
+        (!call.ParseJsonRequest(request) ||
+         request.type() != Json::objectValue))
+    {
+      throw OrthancException(ErrorCode_BadRequest);
+    }
+  }
+
+
+  static bool GetBooleanOption(const Json::Value& request,
+                               const char* option,
+                               bool defaultValue)
+  {
+    if (!request.isMember(option))
+    {
+      return defaultValue;
+    }
+    else if (request[option].type() != Json::booleanValue)
+    {
+      throw OrthancException(ErrorCode_BadRequest);
+    }
+    else
+    {
+      return request[option].asBool();
+    }
+  }
+
+
+  static void GetMaintenanceInstances(std::list<std::string>& instances,
+                                      ServerIndex& index,
+                                      const Json::Value& request)
+  {
+    instances.clear();
+
+    if (request.isMember("Resources"))
+    {
+      // Only process the instances below the given resources
+      const Json::Value& resources = request["Resources"];
+      if (resources.type() != Json::arrayValue)
+      {
+        throw OrthancException(ErrorCode_BadRequest);
+      }
+
+      for (Json::Value::ArrayIndex i = 0; i < resources.size(); i++)
+      {
+        if (resources[i].type() != Json::stringValue)
+        {
+          throw OrthancException(ErrorCode_BadRequest);
+        }
+
+        std::list<std::string> tmp;
+        index.GetChildInstances(tmp, resources[i].asString());
+        instances.splice(instances.end(), tmp);
+      }
+    }
+    else
+    {
+      index.GetAllUuids(instances, ResourceType_Instance);
+    }
+  }
+
+
+  static void RecompressAttachments(RestApiPostCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    Json::Value request;
+    ParseMaintenanceRequest(request, call);
+
+    bool compress = GetBooleanOption(request, "Compress", context.IsCompressionEnabled());
+
+    std::list<std::string> instances;
+    GetMaintenanceInstances(instances, context.GetIndex(), request);
+
+    CompressionType compression = (compress ? context.GetCompressionType() : CompressionType_None);
+
+    // The instances are processed by batches, which keeps the number
+    // of commands of the scheduler low on large databases, while
+    // still tracking the progress of the job
+    static const size_t BATCH_SIZE = 100;
+
+    ServerJob job;
+    ServerCommandInstance* batch = NULL;
+    size_t count = 0;
+
+    for (std::list<std::string>::const_iterator 
+           it = instances.begin(); it != instances.end(); ++it, count++)
+    {
+      if (count % BATCH_SIZE == 0)
+      {
+        batch = &job.AddCommand(new ChangeCompressionCommand(context, compression));
+      }
+
+      batch->AddInput(*it);
+    }
+
+    job.SetDescription(compress ? "HTTP request: Compress attachments" :
+                       "HTTP request: Uncompress attachments");
+
+    // Do not delay the forwarding of the instances
+    job.SetPriority(-1);
+
+    // The job runs in the background
+    context.GetScheduler().Submit(job);
+
+    Json::Value result = Json::objectValue;
+    result["ID"] = job.GetId();
+    result["Compress"] = compress;
+    result["InstancesCount"] = static_cast<unsigned int>(instances.size());
+    call.GetOutput().AnswerJson(result);
+  }
+
+
+  static void MigrateDicomAsJson(RestApiPostCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    Json::Value request;
+    ParseMaintenanceRequest(request, call);
+
+    bool store = GetBooleanOption(request, "Store", context.IsStoreDicomAsJson());
+
+    std::list<std::string> instances;
+    GetMaintenanceInstances(instances, context.GetIndex(), request);
+
+    ServerJob job;
+    for (std::list<std::string>::const_iterator 
+           it = instances.begin(); it != instances.end(); ++it)
+    {
+      job.AddCommand(new ChangeDicomAsJsonCommand(context, store)).AddInput(*it);
+    }
+
+    job.SetDescription(store ? "HTTP request: Store the DICOM files converted to JSON" :
+                       "HTTP request: Remove the DICOM files converted to JSON");
+
+    // Do not delay the forwarding of the instances
+    job.SetPriority(-1);
+
+    // The job runs in the background
+    context.GetScheduler().Submit(job);
+
+    Json::Value result = Json::objectValue;
+    result["ID"] = job.GetId();
+    result["Store"] = store;
+    result["InstancesCount"] = static_cast<unsigned int>(instances.size());
+    call.GetOutput().AnswerJson(result);
+  }
+
+
   static void IsAttachmentCompressed(RestApiGetCall& call)
   {
     FileInfo info;
@@ -1078,7 +1728,7 @@ namespace Orthanc
       size_t limit = 0;
       if (request.isMember("Limit"))
       {
-        int tmp = request["CaseSensitive"].asInt();
+        int tmp = request["Limit"].asInt();
         if (tmp < 0)
         {
           throw OrthancException(ErrorCode_ParameterOutOfRange);
@@ -1121,41 +1771,11 @@ namespace Orthanc
   {
     ServerIndex& index = OrthancRestApi::GetIndex(call);
 
-    std::list<std::string> a, b, c;
-    a.push_back(call.GetUriComponent("id", ""));
-
-    ResourceType type = start;
-    while (type != end)
-    {
-      b.clear();
-
-      for (std::list<std::string>::const_iterator
-             it = a.begin(); it != a.end(); ++it)
-      {
-        index.GetChildren(c, *it);
-        b.splice(b.begin(), c);
-      }
-
-      type = GetChildResourceType(type);
-
-      a.clear();
-      a.splice(a.begin(), b);
-    }
-
-    Json::Value result = Json::arrayValue;
-
-    for (std::list<std::string>::const_iterator
-           it = a.begin(); it != a.end(); ++it)
+    std::list<std::string> children;
+    if (index.GetDescendants(children, call.GetUriComponent("id", ""), start, end))
     {
-      Json::Value item;
-
-      if (OrthancRestApi::GetIndex(call).LookupResource(item, *it, end))
-      {
-        result.append(item);
-      }
+      AnswerListOfResources(call.GetOutput(), index, children, end, true);
     }
-
-    call.GetOutput().AnswerJson(result);
   }
 
 
@@ -1171,27 +1791,36 @@ namespace Orthanc
 
     context.GetIndex().GetChildInstances(instances, publicId);  // (*)
 
-    Json::Value result = Json::objectValue;
+    // The tags are written instance by instance, so that the answer
+    // is never entirely stored in memory. Sort the instances to get
+    // the same order as an object stored in a "Json::Value".
+    std::vector<std::string> sorted(instances.begin(), instances.end());
+    std::sort(sorted.begin(), sorted.end());
 
-    for (Instances::const_iterator it = instances.begin();
-         it != instances.end(); ++it)
+    RestApiJsonStream stream(call.GetOutput());
+    stream.StartObject();
+
+    for (size_t i = 0; i < sorted.size(); i++)
     {
       Json::Value full;
-      context.ReadJson(full, *it);
+      context.ReadJson(full, sorted[i]);
+
+      stream.WriteKey(sorted[i]);
 
       if (simplify)
       {
         Json::Value simplified;
         Toolbox::SimplifyTags(simplified, full, DicomToJsonFormat_Human);
-        result[*it] = simplified;
+        stream.WriteValue(simplified);
       }
       else
       {
-        result[*it] = full;
+        stream.WriteValue(full);
       }
     }
-    
-    call.GetOutput().AnswerJson(result);
+
+    stream.EndObject();
+    stream.Close();
   }
 
 
@@ -1324,12 +1953,14 @@ namespace Orthanc
     Register("/instances/{id}/frames", ListFrames);
 
     Register("/instances/{id}/frames/{frame}/preview", GetImage<ImageExtractionMode_Preview>);
+    Register("/instances/{id}/frames/{frame}/rendered", GetRenderedFrame);
     Register("/instances/{id}/frames/{frame}/image-uint8", GetImage<ImageExtractionMode_UInt8>);
     Register("/instances/{id}/frames/{frame}/image-uint16", GetImage<ImageExtractionMode_UInt16>);
     Register("/instances/{id}/frames/{frame}/image-int16", GetImage<ImageExtractionMode_Int16>);
     Register("/instances/{id}/frames/{frame}/matlab", GetMatlabImage);
     Register("/instances/{id}/pdf", ExtractPdf);
     Register("/instances/{id}/preview", GetImage<ImageExtractionMode_Preview>);
+    Register("/instances/{id}/rendered", GetRenderedFrame);
     Register("/instances/{id}/image-uint8", GetImage<ImageExtractionMode_UInt8>);
     Register("/instances/{id}/image-uint16", GetImage<ImageExtractionMode_UInt16>);
     Register("/instances/{id}/image-int16", GetImage<ImageExtractionMode_Int16>);
@@ -1348,7 +1979,7 @@ namespace Orthanc
     Register("/{resourceType}/{id}/attachments/{name}", DeleteAttachment);
     Register("/{resourceType}/{id}/attachments/{name}", GetAttachmentOperations);
     Register("/{resourceType}/{id}/attachments/{name}", UploadAttachment);
-    Register("/{resourceType}/{id}/attachments/{name}/compress", ChangeAttachmentCompression<CompressionType_ZlibWithSize>);
+    Register("/{resourceType}/{id}/attachments/{name}/compress", ChangeAttachmentCompression<true>);
     Register("/{resourceType}/{id}/attachments/{name}/compressed-data", GetAttachmentData<0>);
     Register("/{resourceType}/{id}/attachments/{name}/compressed-md5", GetAttachmentCompressedMD5);
     Register("/{resourceType}/{id}/attachments/{name}/compressed-size", GetAttachmentCompressedSize);
@@ -1356,11 +1987,13 @@ namespace Orthanc
     Register("/{resourceType}/{id}/attachments/{name}/is-compressed", IsAttachmentCompressed);
     Register("/{resourceType}/{id}/attachments/{name}/md5", GetAttachmentMD5);
     Register("/{resourceType}/{id}/attachments/{name}/size", GetAttachmentSize);
-    Register("/{resourceType}/{id}/attachments/{name}/uncompress", ChangeAttachmentCompression<CompressionType_None>);
+    Register("/{resourceType}/{id}/attachments/{name}/uncompress", ChangeAttachmentCompression<false>);
     Register("/{resourceType}/{id}/attachments/{name}/verify-md5", VerifyAttachment);
 
     Register("/tools/lookup", Lookup);
     Register("/tools/find", Find);
+    Register("/tools/recompress", RecompressAttachments);
+    Register("/tools/migrate-dicom-as-json", MigrateDicomAsJson);
 
     Register("/patients/{id}/studies", GetChildResources<ResourceType_Patient, ResourceType_Study>);
     Register("/patients/{id}/series", GetChildResources<ResourceType_Patient, ResourceType_Series>);
@@ -89,6 +89,20 @@ namespace Orthanc
   {
     Json::Value result = Json::objectValue;
     OrthancRestApi::GetIndex(call).ComputeStatistics(result);
+    OrthancRestApi::GetContext(call).GetIngestStatistics().Format(result["Ingest"]);
+    OrthancRestApi::GetContext(call).FormatDicomCacheStatistics(result["DicomCache"]);
+    OrthancRestApi::GetContext(call).FormatDicomAsJsonCacheStatistics(result["DicomAsJsonCache"]);
+    OrthancRestApi::GetContext(call).FormatPreviewCacheStatistics(result["PreviewCache"]);
+    OrthancRestApi::GetContext(call).FormatListenersStatistics(result["Listeners"]);
+    OrthancRestApi::GetContext(call).GetScheduler().FormatStatistics(result["Scheduler"]);
+    OrthancRestApi::GetContext(call).GetReusableDicomUserConnection().FormatStatistics(result["DicomAssociations"]);
+
+    Json::Value dicomServer;
+    if (OrthancRestApi::GetContext(call).FormatDicomServerStatistics(dicomServer))
+    {
+      result["DicomServer"] = dicomServer;
+    }
+
     call.GetOutput().AnswerJson(result);
   }
 
@@ -0,0 +1,360 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersServer.h"
+#include "PreviewCache.h"
+
+#include "../Core/FileStorage/StorageAccessor.h"
+#include "../Core/Logging.h"
+#include "../Core/OrthancException.h"
+
+#include <boost/lexical_cast.hpp>
+
+namespace Orthanc
+{
+  void PreviewCache::RemoveInternal(const std::string& key)
+  {
+    // WARNING: The mutex must be locked
+
+    Entries::iterator entry = entries_.find(key);
+    if (entry == entries_.end())
+    {
+      return;
+    }
+
+    EntriesOfInstances::iterator instance = entriesOfInstances_.find(entry->second->instance_);
+    if (instance != entriesOfInstances_.end())
+    {
+      instance->second.erase(key);
+      if (instance->second.empty())
+      {
+        entriesOfInstances_.erase(instance);
+      }
+    }
+
+    lru_.Invalidate(key);
+    currentSize_ -= entry->second->content_.size();
+    delete entry->second;
+    entries_.erase(entry);
+  }
+
+
+  void PreviewCache::StoreInternal(SpilledEntries& recycled,
+                                   const std::string& key,
+                                   const std::string& instance,
+                                   const std::string& content)
+  {
+    // WARNING: The mutex must be locked
+
+    RemoveInternal(key);
+
+    std::auto_ptr<Entry> entry(new Entry);
+    entry->instance_ = instance;
+    entry->content_ = content;
+
+    entriesOfInstances_[instance].insert(key);
+    lru_.Add(key);
+    currentSize_ += content.size();
+    entries_[key] = entry.release();
+
+    while (currentSize_ > maximumSize_ &&
+           !lru_.IsEmpty())
+    {
+      std::string oldest = lru_.GetOldest();
+      Entry* recycledEntry = entries_[oldest];
+
+      if (spill_)
+      {
+        // Detach the entry, that will be written to the storage area
+        // once the mutex is unlocked
+        recycled.push_back(std::make_pair(oldest, new Entry(*recycledEntry)));
+      }
+
+      RemoveInternal(oldest);
+    }
+  }
+
+
+  void PreviewCache::Spill(SpilledEntries& recycled)
+  {
+    // WARNING: The mutex must NOT be locked
+
+    for (SpilledEntries::iterator it = recycled.begin(); it != recycled.end(); ++it)
+    {
+      std::auto_ptr<Entry> entry(it->second);
+
+      // Never trigger the recycling of patients to store a preview
+      if (index_.GetMaximumStorageSize() == 0)
+      {
+        std::string buffer = it->first + "\n" + entry->content_;
+
+        try
+        {
+          // PNG and JPEG are already compressed
+          StorageAccessor accessor(area_);
+          FileInfo attachment = accessor.Write(buffer, FileContentType_Preview,
+                                               CompressionType_None, false);
+
+          if (index_.AddAttachment(attachment, entry->instance_) != StoreStatus_Success)
+          {
+            // The instance was deleted in between
+            accessor.Remove(attachment);
+          }
+        }
+        catch (OrthancException& e)
+        {
+          LOG(WARNING) << "Cannot spill a preview to the storage area: " << e.What();
+        }
+      }
+    }
+
+    recycled.clear();
+  }
+
+
+  bool PreviewCache::LookupSpilled(std::string& content,
+                                   const std::string& key,
+                                   const std::string& instance)
+  {
+    FileInfo attachment;
+    if (!index_.LookupAttachment(attachment, instance, FileContentType_Preview))
+    {
+      return false;
+    }
+
+    std::string buffer;
+
+    try
+    {
+      StorageAccessor accessor(area_);
+      accessor.Read(buffer, attachment);
+    }
+    catch (OrthancException&)
+    {
+      return false;  // The instance was deleted in between
+    }
+
+    // The spilled preview must correspond to the requested key
+    size_t separator = buffer.find('\n');
+    if (separator == std::string::npos ||
+        buffer.compare(0, separator, key) != 0)
+    {
+      return false;
+    }
+
+    content = buffer.substr(separator + 1);
+    return true;
+  }
+
+
+  void PreviewCache::CheckInstance(const std::string& instance)
+  {
+    // WARNING: The mutex must NOT be locked
+
+    // A preview might be stored by a request that started before the
+    // deletion of its instance. The changes are signaled once the
+    // deletion is committed: Either the invalidation is still to
+    // come, or the instance is already missing from the index.
+    ResourceType type;
+    if (!index_.LookupResourceType(type, instance))
+    {
+      Invalidate(instance);
+    }
+  }
+
+
+  PreviewCache::PreviewCache(ServerIndex& index,
+                             IStorageArea& area) :
+    index_(index),
+    area_(area),
+    maximumSize_(0),
+    currentSize_(0),
+    spill_(false),
+    hits_(0),
+    misses_(0),
+    spillHits_(0)
+  {
+  }
+
+
+  PreviewCache::~PreviewCache()
+  {
+    for (Entries::iterator it = entries_.begin(); it != entries_.end(); ++it)
+    {
+      delete it->second;
+    }
+  }
+
+
+  std::string PreviewCache::FormatKey(const std::string& instance,
+                                      unsigned int frame,
+                                      ImageExtractionMode mode,
+                                      const std::string& mime,
+                                      unsigned int quality,
+                                      const std::string& rendering)
+  {
+    std::string key = (instance + "|" + 
+                       boost::lexical_cast<std::string>(frame) + "|" +
+                       boost::lexical_cast<std::string>(static_cast<int>(mode)) + "|" +
+                       mime + "|" +
+                       boost::lexical_cast<std::string>(quality));
+
+    if (!rendering.empty())
+    {
+      key += "|" + rendering;
+    }
+
+    return key;
+  }
+
+
+  void PreviewCache::SetMaximumSize(size_t size)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    maximumSize_ = size;
+
+    while (currentSize_ > maximumSize_ &&
+           !lru_.IsEmpty())
+    {
+      RemoveInternal(lru_.GetOldest());
+    }
+  }
+
+
+  void PreviewCache::SetSpillEnabled(bool enabled)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    spill_ = enabled;
+  }
+
+
+  bool PreviewCache::Lookup(std::string& content,
+                            const std::string& key,
+                            const std::string& instance)
+  {
+    bool spill;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      Entries::const_iterator found = entries_.find(key);
+      if (found != entries_.end())
+      {
+        lru_.MakeMostRecent(key);
+        content = found->second->content_;
+        hits_++;
+        return true;
+      }
+
+      spill = spill_;
+    }
+
+    if (spill &&
+        LookupSpilled(content, key, instance))
+    {
+      SpilledEntries recycled;
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        spillHits_++;
+
+        if (maximumSize_ != 0)
+        {
+          StoreInternal(recycled, key, instance, content);
+        }
+      }
+
+      Spill(recycled);
+      CheckInstance(instance);
+      return true;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    misses_++;
+    return false;
+  }
+
+
+  void PreviewCache::Store(const std::string& key,
+                           const std::string& instance,
+                           const std::string& content)
+  {
+    SpilledEntries recycled;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (maximumSize_ == 0 &&
+          !spill_)
+      {
+        return;  // The cache is disabled
+      }
+
+      StoreInternal(recycled, key, instance, content);
+    }
+
+    Spill(recycled);
+    CheckInstance(instance);
+  }
+
+
+  void PreviewCache::Invalidate(const std::string& instance)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    EntriesOfInstances::iterator found = entriesOfInstances_.find(instance);
+    if (found != entriesOfInstances_.end())
+    {
+      // Copy the keys, as "RemoveInternal()" modifies "entriesOfInstances_"
+      std::set<std::string> keys = found->second;
+
+      for (std::set<std::string>::const_iterator
+             it = keys.begin(); it != keys.end(); ++it)
+      {
+        RemoveInternal(*it);
+      }
+    }
+  }
+
+
+  void PreviewCache::GetStatistics(Statistics& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    target.hits_ = hits_;
+    target.misses_ = misses_;
+    target.spillHits_ = spillHits_;
+    target.countEntries_ = entries_.size();
+    target.currentSize_ = currentSize_;
+    target.maximumSize_ = maximumSize_;
+  }
+}
@@ -0,0 +1,141 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../Core/Cache/LeastRecentlyUsedIndex.h"
+#include "../Core/FileStorage/IStorageArea.h"
+#include "ServerIndex.h"
+
+#include <boost/thread.hpp>
+#include <set>
+
+namespace Orthanc
+{
+  /**
+   * Cache of the encoded previews of the frames (as returned by
+   * "/instances/{id}/frames/{n}/preview" and the similar URIs). The
+   * entries are indexed by the instance, the frame, the extraction
+   * mode, the MIME type, the quality of the encoding and the
+   * parameters of the server-side rendering (if any). They are
+   * kept in memory with a least recently used (LRU) recycling
+   * policy. The entries of an instance are invalidated synchronously
+   * by "ServerContext::SignalChange()" when the instance is deleted.
+   *
+   * If spilling is enabled, the entries that are recycled from memory
+   * are stored in the storage area as the "preview" attachment of
+   * their instance. As one instance has at most one attachment of a
+   * given type, only the last spilled preview of each instance is
+   * kept on the disk.
+   **/
+  class PreviewCache : public boost::noncopyable
+  {
+  public:
+    struct Statistics
+    {
+      uint64_t  hits_;
+      uint64_t  misses_;
+      uint64_t  spillHits_;
+      size_t    countEntries_;
+      size_t    currentSize_;
+      size_t    maximumSize_;
+    };
+
+  private:
+    struct Entry
+    {
+      std::string  instance_;
+      std::string  content_;
+    };
+
+    typedef std::map<std::string, Entry*>                  Entries;
+    typedef std::map<std::string, std::set<std::string> >  EntriesOfInstances;
+    typedef std::list< std::pair<std::string, Entry*> >    SpilledEntries;
+
+    ServerIndex&          index_;
+    IStorageArea&         area_;
+    boost::mutex          mutex_;
+    size_t                maximumSize_;
+    size_t                currentSize_;
+    bool                  spill_;
+    Entries               entries_;
+    EntriesOfInstances    entriesOfInstances_;
+    LeastRecentlyUsedIndex<std::string>  lru_;
+    uint64_t              hits_;
+    uint64_t              misses_;
+    uint64_t              spillHits_;
+
+    void RemoveInternal(const std::string& key);
+
+    void StoreInternal(SpilledEntries& recycled,
+                       const std::string& key,
+                       const std::string& instance,
+                       const std::string& content);
+
+    void Spill(SpilledEntries& recycled);
+
+    bool LookupSpilled(std::string& content,
+                       const std::string& key,
+                       const std::string& instance);
+
+    void CheckInstance(const std::string& instance);
+
+  public:
+    PreviewCache(ServerIndex& index,
+                 IStorageArea& area);
+
+    ~PreviewCache();
+
+    static std::string FormatKey(const std::string& instance,
+                                 unsigned int frame,
+                                 ImageExtractionMode mode,
+                                 const std::string& mime,
+                                 unsigned int quality,
+                                 const std::string& rendering = "");
+
+    void SetMaximumSize(size_t size);   // In bytes, "0" disables the cache
+
+    void SetSpillEnabled(bool enabled);
+
+    bool Lookup(std::string& content,
+                const std::string& key,
+                const std::string& instance);
+
+    void Store(const std::string& key,
+               const std::string& instance,
+               const std::string& content);
+
+    void Invalidate(const std::string& instance);
+
+    void GetStatistics(Statistics& target);
+  };
+}
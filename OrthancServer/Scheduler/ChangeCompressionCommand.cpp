@@ -0,0 +1,68 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "ChangeCompressionCommand.h"
+
+#include "../../Core/Logging.h"
+
+namespace Orthanc
+{
+  bool ChangeCompressionCommand::Apply(ListOfStrings& outputs,
+                                       const ListOfStrings& inputs)
+  {
+    for (ListOfStrings::const_iterator
+           it = inputs.begin(); it != inputs.end(); ++it)
+    {
+      try
+      {
+        context_.ChangeAttachmentCompression(*it, FileContentType_Dicom, compression_);
+
+        // The "DicomAsJson" attachment is absent if it is derived on demand
+        FileInfo json;
+        if (context_.GetIndex().LookupAttachment(json, *it, FileContentType_DicomAsJson))
+        {
+          context_.ChangeAttachmentCompression(*it, FileContentType_DicomAsJson, compression_);
+        }
+
+        outputs.push_back(*it);
+      }
+      catch (OrthancException& e)
+      {
+        // The instance might have been deleted in between
+        LOG(ERROR) << "Unable to change the compression of instance " << *it << ": " << e.What();
+      }
+    }
+
+    return true;
+  }
+}
@@ -49,5 +49,13 @@ namespace Orthanc
 
     virtual bool Apply(ListOfStrings& outputs,
                        const ListOfStrings& inputs) = 0;
+
+    // Remote destination of this command (e.g. a DICOM modality or an
+    // Orthanc peer), whose number of concurrent commands is limited
+    // by the scheduler. An empty string denotes a local command.
+    virtual std::string GetDestination() const
+    {
+      return "";
+    }
   };
 }
@@ -37,41 +37,21 @@
 
 namespace Orthanc
 {
-  bool ServerCommandInstance::Execute(IListener& listener)
+  bool ServerCommandInstance::Execute(ListOfStrings& outputs)
   {
-    ListOfStrings outputs;
-
-    bool success = false;
+    // The outputs are forwarded to the next commands by the
+    // scheduler, as several commands of the same job might run
+    // concurrently
+    outputs.clear();
 
     try
     {
-      if (command_->Apply(outputs, inputs_))
-      {
-        success = true;
-      }
+      return command_->Apply(outputs, inputs_);
     }
     catch (OrthancException&)
     {
+      return false;
     }
-
-    if (!success)
-    {
-      listener.SignalFailure(jobId_);
-      return true;
-    }
-
-    for (std::list<ServerCommandInstance*>::iterator
-           it = next_.begin(); it != next_.end(); ++it)
-    {
-      for (ListOfStrings::const_iterator
-             output = outputs.begin(); output != outputs.end(); ++output)
-      {
-        (*it)->AddInput(*output);
-      }
-    }
-
-    listener.SignalSuccess(jobId_);
-    return true;
   }
 
 
@@ -79,7 +59,9 @@ namespace Orthanc
                                                const std::string& jobId) : 
     command_(command), 
     jobId_(jobId),
-    connectedToSink_(false)
+    connectedToSink_(false),
+    priority_(0),
+    countPrevious_(0)
   {
     if (command_ == NULL)
     {
@@ -41,19 +41,6 @@ namespace Orthanc
   {
     friend class ServerScheduler;
 
-  public:
-    class IListener
-    {
-    public:
-      virtual ~IListener()
-      {
-      }
-
-      virtual void SignalSuccess(const std::string& jobId) = 0;
-
-      virtual void SignalFailure(const std::string& jobId) = 0;
-    };
-
   private:
     typedef IServerCommand::ListOfStrings  ListOfStrings;
 
@@ -63,7 +50,12 @@ namespace Orthanc
     std::list<ServerCommandInstance*> next_;
     bool connectedToSink_;
 
-    bool Execute(IListener& listener);
+    // Bookkeeping of the scheduler
+    std::string destination_;
+    int priority_;
+    unsigned int countPrevious_;   // Number of previous commands that are not executed yet
+
+    bool Execute(ListOfStrings& outputs);
 
   public:
     ServerCommandInstance(IServerCommand *command,
@@ -69,8 +69,7 @@ namespace Orthanc
   }
 
 
-  size_t ServerJob::Submit(SharedMessageQueue& target,
-                           ServerCommandInstance::IListener& listener)
+  void ServerJob::Submit(std::list<ServerCommandInstance*>& target)
   {
     if (submitted_)
     {
@@ -80,25 +79,16 @@ namespace Orthanc
 
     CheckOrdering();
 
-    size_t size = filters_.size();
-
-    for (std::list<ServerCommandInstance*>::iterator 
-           it = filters_.begin(); it != filters_.end(); ++it)
-    {
-      target.Enqueue(*it);
-    }
-
-    filters_.clear();
+    target.splice(target.end(), filters_);
     submitted_ = true;
-
-    return size;
   }
 
 
   ServerJob::ServerJob() :
     jobId_(Toolbox::GenerateUuid()),
     submitted_(false),
-    description_("no description")
+    description_("no description"),
+    priority_(0)
   {
   }
 
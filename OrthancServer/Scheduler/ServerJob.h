@@ -33,7 +33,6 @@
 #pragma once
 
 #include "ServerCommandInstance.h"
-#include "../../Core/MultiThreading/SharedMessageQueue.h"
 
 namespace Orthanc
 {
@@ -47,11 +46,12 @@ namespace Orthanc
     std::string jobId_;
     bool submitted_;
     std::string description_;
+    int priority_;
 
     void CheckOrdering();
 
-    size_t Submit(SharedMessageQueue& target,
-                  ServerCommandInstance::IListener& listener);
+    // Transfers the ownership of the commands to "target"
+    void Submit(std::list<ServerCommandInstance*>& target);
 
   public:
     ServerJob();
@@ -73,6 +73,18 @@ namespace Orthanc
       return description_;
     }
 
+    // The commands of the jobs with a higher priority are executed
+    // first by the scheduler (the default priority is "0")
+    void SetPriority(int priority)
+    {
+      priority_ = priority;
+    }
+
+    int GetPriority() const
+    {
+      return priority_;
+    }
+
     ServerCommandInstance& AddCommand(IServerCommand* filter);
 
     // Take the ownership of a payload to a job. This payload will be
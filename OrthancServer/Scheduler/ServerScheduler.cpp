@@ -36,6 +36,8 @@
 #include "../../Core/OrthancException.h"
 #include "../../Core/Logging.h"
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 namespace Orthanc
 {
   namespace
@@ -79,24 +81,41 @@ namespace Orthanc
   }
 
 
-  void ServerScheduler::SignalSuccess(const std::string& jobId)
+  void ServerScheduler::SignalCompletion(const std::string& jobId,
+                                         bool success)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    // The mutex must be locked by the caller
 
     JobInfo& info = GetJobInfo(jobId);
-    info.success_++;
 
-    assert(info.failures_ == 0);
+    if (success)
+    {
+      info.success_++;
+    }
+    else
+    {
+      info.failures_++;
+    }
 
-    if (info.success_ >= info.size_)
+    if (info.success_ + info.failures_ >= info.size_)
     {
+      bool hasSucceeded = (info.failures_ == 0);
+
       if (info.watched_)
       {
-        watchedJobStatus_[jobId] = JobStatus_Success;
+        watchedJobStatus_[jobId] = (hasSucceeded ? JobStatus_Success : JobStatus_Failure);
         watchedJobFinished_.notify_all();
       }
 
-      LOG(INFO) << "Job successfully finished (" << info.description_ << ")";
+      if (hasSucceeded)
+      {
+        LOG(INFO) << "Job successfully finished (" << info.description_ << ")";
+      }
+      else
+      {
+        LOG(ERROR) << "Job has failed (" << info.description_ << ")";
+      }
+
       jobs_.erase(jobId);
 
       availableJob_.Release();
@@ -104,60 +123,178 @@ namespace Orthanc
   }
 
 
-  void ServerScheduler::SignalFailure(const std::string& jobId)
+  void ServerScheduler::EnqueueReady(ServerCommandInstance* command)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    // The mutex must be locked by the caller
 
-    JobInfo& info = GetJobInfo(jobId);
-    info.failures_++;
+    ready_[command->priority_].push_back(command);
+    countReady_++;
 
-    if (info.success_ + info.failures_ >= info.size_)
+    if (!command->destination_.empty())
     {
-      if (info.watched_)
+      destinations_[command->destination_].queued_++;
+    }
+
+    commandReady_.notify_one();
+  }
+
+
+  ServerCommandInstance* ServerScheduler::PickReady()
+  {
+    // The mutex must be locked by the caller
+
+    for (ReadyCommands::iterator it = ready_.begin(); it != ready_.end(); ++it)
+    {
+      std::list<ServerCommandInstance*>& commands = it->second;
+
+      for (std::list<ServerCommandInstance*>::iterator 
+             command = commands.begin(); command != commands.end(); ++command)
       {
-        watchedJobStatus_[jobId] = JobStatus_Failure;
-        watchedJobFinished_.notify_all();
-      }
+        const std::string& destination = (*command)->destination_;
 
-      LOG(ERROR) << "Job has failed (" << info.description_ << ")";
-      jobs_.erase(jobId);
+        if (!destination.empty())
+        {
+          DestinationInfo& info = destinations_[destination];
+
+          if (info.running_ >= concurrencyPerDestination_)
+          {
+            const JobInfo& job = GetJobInfo((*command)->GetJobId());
+            if (job.failures_ == 0 &&
+                !job.cancel_)
+            {
+              // This destination is saturated. The commands of the
+              // failed jobs are picked anyway, as they are skipped.
+              continue;
+            }
+          }
+
+          info.queued_--;
+          info.running_++;
+        }
 
-      availableJob_.Release();
+        ServerCommandInstance* result = *command;
+
+        commands.erase(command);
+        if (commands.empty())
+        {
+          ready_.erase(it);
+        }
+
+        countReady_--;
+        countRunning_++;
+
+        return result;
+      }
     }
+
+    return NULL;
   }
 
 
-  void ServerScheduler::Worker(ServerScheduler* that)
+  void ServerScheduler::ExecuteCommand(ServerCommandInstance& command)
   {
-    static const int32_t TIMEOUT = 100;
+    // Skip the execution of this command if its parent job has
+    // previously failed.
+    bool jobHasFailed;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      JobInfo& info = GetJobInfo(command.GetJobId());
+      jobHasFailed = (info.failures_ > 0 || info.cancel_); 
+    }
+
+    ListOfStrings outputs;
+    bool success = false;
 
-    LOG(WARNING) << "The server scheduler has started";
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
 
-    while (!that->finish_)
+    if (!jobHasFailed)
     {
-      std::auto_ptr<IDynamicObject> object(that->queue_.Dequeue(TIMEOUT));
-      if (object.get() != NULL)
+      success = command.Execute(outputs);
+    }
+
+    boost::posix_time::time_duration elapsed = (boost::posix_time::microsec_clock::universal_time() - start);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    countRunning_--;
+
+    if (!command.destination_.empty())
+    {
+      DestinationInfo& info = destinations_[command.destination_];
+      info.running_--;
+
+      if (!jobHasFailed)
       {
-        ServerCommandInstance& filter = dynamic_cast<ServerCommandInstance&>(*object);
+        info.commands_++;
+        info.microseconds_ += static_cast<uint64_t>(elapsed.total_microseconds());
 
-        // Skip the execution of this filter if its parent job has
-        // previously failed.
-        bool jobHasFailed;
+        if (success)
         {
-          boost::mutex::scoped_lock lock(that->mutex_);
-          JobInfo& info = that->GetJobInfo(filter.GetJobId());
-          jobHasFailed = (info.failures_ > 0 || info.cancel_); 
+          info.items_ += command.inputs_.size();
         }
+        else
+        {
+          info.failures_++;
+        }
+      }
+    }
 
-        if (jobHasFailed)
+    // Forward the outputs to the next commands, and schedule the
+    // next commands whose inputs are now complete. This is done even
+    // if the job has failed, so that the job is properly finalized.
+    for (std::list<ServerCommandInstance*>::iterator
+           next = command.next_.begin(); next != command.next_.end(); ++next)
+    {
+      if (success)
+      {
+        for (ListOfStrings::const_iterator
+               output = outputs.begin(); output != outputs.end(); ++output)
         {
-          that->SignalFailure(filter.GetJobId());
+          (*next)->AddInput(*output);
         }
-        else
+      }
+
+      assert((*next)->countPrevious_ > 0);
+      (*next)->countPrevious_--;
+
+      if ((*next)->countPrevious_ == 0)
+      {
+        waiting_.erase(*next);
+        EnqueueReady(*next);
+      }
+    }
+
+    SignalCompletion(command.GetJobId(), success);
+
+    // The destination of this command might not be saturated anymore
+    commandReady_.notify_all();
+  }
+
+
+  void ServerScheduler::Worker(ServerScheduler* that)
+  {
+    for (;;)
+    {
+      ServerCommandInstance* command = NULL;
+
+      {
+        boost::mutex::scoped_lock lock(that->mutex_);
+
+        while (!that->finish_ &&
+               (command = that->PickReady()) == NULL)
         {
-          filter.Execute(*that);
+          that->commandReady_.wait(lock);
         }
       }
+
+      if (command == NULL)
+      {
+        break;  // The scheduler is stopping
+      }
+
+      std::auto_ptr<ServerCommandInstance> owner(command);
+      that->ExecuteCommand(*command);
     }
   }
 
@@ -165,20 +302,23 @@ namespace Orthanc
   void ServerScheduler::SubmitInternal(ServerJob& job,
                                        bool watched)
   {
+    std::list<ServerCommandInstance*> commands;
+    job.Submit(commands);
+
+    assert(!commands.empty());
+
     availableJob_.Acquire();
 
     boost::mutex::scoped_lock lock(mutex_);
 
     JobInfo info;
-    info.size_ = job.Submit(queue_, *this);
+    info.size_ = commands.size();
     info.cancel_ = false;
     info.success_ = 0;
     info.failures_ = 0;
     info.description_ = job.GetDescription();
     info.watched_ = watched;
 
-    assert(info.size_ > 0);
-
     if (watched)
     {
       watchedJobStatus_[job.GetId()] = JobStatus_Running;
@@ -186,14 +326,58 @@ namespace Orthanc
 
     jobs_[job.GetId()] = info;
 
+    for (std::list<ServerCommandInstance*>::iterator
+           it = commands.begin(); it != commands.end(); ++it)
+    {
+      (*it)->priority_ = job.GetPriority();
+      (*it)->destination_ = (*it)->command_->GetDestination();
+
+      const std::list<ServerCommandInstance*>& next = (*it)->GetNextCommands();
+      for (std::list<ServerCommandInstance*>::const_iterator
+             it2 = next.begin(); it2 != next.end(); ++it2)
+      {
+        (*it2)->countPrevious_++;
+      }
+    }
+
+    for (std::list<ServerCommandInstance*>::iterator
+           it = commands.begin(); it != commands.end(); ++it)
+    {
+      if ((*it)->countPrevious_ == 0)
+      {
+        EnqueueReady(*it);
+      }
+      else
+      {
+        waiting_.insert(*it);
+      }
+    }
+
     LOG(INFO) << "New job submitted (" << job.description_ << ")";
   }
 
 
-  ServerScheduler::ServerScheduler(unsigned int maxJobs) : availableJob_(maxJobs)
+  ServerScheduler::ServerScheduler(unsigned int maxJobs,
+                                   unsigned int countThreads) : 
+    countReady_(0),
+    concurrencyPerDestination_(1),
+    countRunning_(0),
+    finish_(false),
+    availableJob_(maxJobs)
   {
-    finish_ = false;
-    worker_ = boost::thread(Worker, this);
+    if (countThreads == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    LOG(WARNING) << "The server scheduler has started with " << countThreads << " thread(s)";
+
+    workers_.resize(countThreads);
+
+    for (unsigned int i = 0; i < countThreads; i++)
+    {
+      workers_[i] = new boost::thread(Worker, this);
+    }
   }
 
 
@@ -209,15 +393,62 @@ namespace Orthanc
 
   void ServerScheduler::Stop()
   {
-    if (!finish_)
     {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (finish_)
+      {
+        return;
+      }
+
       finish_ = true;
+      commandReady_.notify_all();
+    }
+
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+      if (workers_[i]->joinable())
+      {
+        workers_[i]->join();
+      }
 
-      if (worker_.joinable())
+      delete workers_[i];
+    }
+
+    workers_.clear();
+
+    // Free the commands that were not executed
+    for (ReadyCommands::iterator it = ready_.begin(); it != ready_.end(); ++it)
+    {
+      for (std::list<ServerCommandInstance*>::iterator
+             command = it->second.begin(); command != it->second.end(); ++command)
       {
-        worker_.join();
+        delete *command;
       }
     }
+
+    for (std::set<ServerCommandInstance*>::iterator 
+           it = waiting_.begin(); it != waiting_.end(); ++it)
+    {
+      delete *it;
+    }
+
+    ready_.clear();
+    waiting_.clear();
+    countReady_ = 0;
+  }
+
+
+  void ServerScheduler::SetConcurrencyPerDestination(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    concurrencyPerDestination_ = count;
+    commandReady_.notify_all();
   }
 
 
@@ -350,4 +581,48 @@ namespace Orthanc
       jobs.push_back(it->first);
     }
   }
+
+
+  void ServerScheduler::FormatStatistics(Json::Value& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    target = Json::objectValue;
+    target["Threads"] = static_cast<unsigned int>(workers_.size());
+    target["ConcurrencyPerDestination"] = concurrencyPerDestination_;
+    target["ActiveJobs"] = static_cast<unsigned int>(jobs_.size());
+    target["ReadyCommands"] = static_cast<unsigned int>(countReady_);
+    target["WaitingCommands"] = static_cast<unsigned int>(waiting_.size());
+    target["RunningCommands"] = countRunning_;
+
+    Json::Value destinations = Json::objectValue;
+
+    for (Destinations::const_iterator 
+           it = destinations_.begin(); it != destinations_.end(); ++it)
+    {
+      const DestinationInfo& info = it->second;
+      double milliseconds = static_cast<double>(info.microseconds_) / 1000.0;
+
+      Json::Value destination = Json::objectValue;
+      destination["Running"] = info.running_;
+      destination["Queued"] = info.queued_;
+      destination["Commands"] = static_cast<unsigned int>(info.commands_);
+      destination["Failures"] = static_cast<unsigned int>(info.failures_);
+      destination["Items"] = static_cast<unsigned int>(info.items_);
+      destination["TotalMilliseconds"] = milliseconds;
+
+      if (info.microseconds_ == 0)
+      {
+        destination["ItemsPerSecond"] = 0.0;
+      }
+      else
+      {
+        destination["ItemsPerSecond"] = (static_cast<double>(info.items_) * 1000.0 / milliseconds);
+      }
+
+      destinations[it->first] = destination;
+    }
+
+    target["Destinations"] = destinations;
+  }
 }
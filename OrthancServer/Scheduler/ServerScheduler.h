@@ -36,9 +36,22 @@
 
 #include "../../Core/MultiThreading/Semaphore.h"
 
+#include <json/value.h>
+#include <set>
+#include <stdint.h>
+#include <vector>
+
 namespace Orthanc
 {
-  class ServerScheduler : public ServerCommandInstance::IListener
+  /**
+   * The commands of the submitted jobs are executed by a pool of
+   * worker threads. A command is only executed once all its previous
+   * commands are over. The commands of the jobs with the highest
+   * priority are executed first, and the number of commands that
+   * simultaneously target the same remote destination is bounded, so
+   * that a slow destination does not monopolize the workers.
+   **/
+  class ServerScheduler : public boost::noncopyable
   {
   private:
     struct JobInfo
@@ -51,6 +64,26 @@ namespace Orthanc
       std::string description_;
     };
 
+    struct DestinationInfo
+    {
+      unsigned int  running_;
+      unsigned int  queued_;
+      uint64_t      commands_;
+      uint64_t      failures_;
+      uint64_t      items_;
+      uint64_t      microseconds_;
+
+      DestinationInfo() : 
+        running_(0),
+        queued_(0),
+        commands_(0),
+        failures_(0),
+        items_(0),
+        microseconds_(0)
+      {
+      }
+    };
+
     enum JobStatus
     {
       JobStatus_Running = 1,
@@ -60,21 +93,37 @@ namespace Orthanc
 
     typedef IServerCommand::ListOfStrings  ListOfStrings;
     typedef std::map<std::string, JobInfo> Jobs;
+    typedef std::map<std::string, DestinationInfo>  Destinations;
+
+    // The commands that are ready to be executed, indexed by
+    // decreasing priority, in FIFO order for each priority
+    typedef std::map< int, std::list<ServerCommandInstance*>, std::greater<int> >  ReadyCommands;
 
     boost::mutex mutex_;
     boost::condition_variable watchedJobFinished_;
+    boost::condition_variable commandReady_;
     Jobs jobs_;
-    SharedMessageQueue queue_;
+    ReadyCommands ready_;
+    size_t countReady_;
+    std::set<ServerCommandInstance*> waiting_;
+    Destinations destinations_;
+    unsigned int concurrencyPerDestination_;
+    unsigned int countRunning_;
     bool finish_;
-    boost::thread worker_;
+    std::vector<boost::thread*> workers_;
     std::map<std::string, JobStatus> watchedJobStatus_;
     Semaphore availableJob_;
 
     JobInfo& GetJobInfo(const std::string& jobId);
 
-    virtual void SignalSuccess(const std::string& jobId);
+    void SignalCompletion(const std::string& jobId,
+                          bool success);
 
-    virtual void SignalFailure(const std::string& jobId);
+    void EnqueueReady(ServerCommandInstance* command);
+
+    ServerCommandInstance* PickReady();
+
+    void ExecuteCommand(ServerCommandInstance& command);
 
     static void Worker(ServerScheduler* that);
 
@@ -82,12 +131,17 @@ namespace Orthanc
                         bool watched);
 
   public:
-    ServerScheduler(unsigned int maxjobs);
+    explicit ServerScheduler(unsigned int maxJobs,
+                             unsigned int countThreads = 1);
 
     ~ServerScheduler();
 
     void Stop();
 
+    // Maximum number of commands that simultaneously target the same
+    // remote destination (cf. "IServerCommand::GetDestination()")
+    void SetConcurrencyPerDestination(unsigned int count);
+
     void Submit(ServerJob& job);
 
     bool SubmitAndWait(ListOfStrings& outputs,
@@ -118,5 +172,7 @@ namespace Orthanc
     }
 
     void GetListOfJobs(ListOfStrings& jobs);
+
+    void FormatStatistics(Json::Value& target);
   };
 }
@@ -33,68 +33,462 @@
 #include "../PrecompiledHeadersServer.h"
 #include "StorePeerCommand.h"
 
-#include "../../Core/Logging.h"
 #include "../../Core/HttpClient.h"
+#include "../../Core/HttpServer/HttpOutput.h"
+#include "../../Core/Logging.h"
+
+#include <boost/lexical_cast.hpp>
 
 namespace Orthanc
 {
-  StorePeerCommand::StorePeerCommand(ServerContext& context,
-                                     const OrthancPeerParameters& peer,
-                                     bool ignoreExceptions) : 
-    context_(context),
-    peer_(peer),
-    ignoreExceptions_(ignoreExceptions)
+  // Bundles are closed once they exceed this size, so as to bound
+  // the memory that is used by each uploading thread
+  static const size_t MAX_BUNDLE_SIZE = 64 * 1024 * 1024;  // 64MB
+
+
+  namespace
   {
+    /**
+     * Collects the multipart body that is written by "HttpOutput",
+     * together with the "Content-Type" header that announces its
+     * boundary.
+     **/
+    class MultipartBodyStream : public IHttpOutputStream
+    {
+    private:
+      std::string   header_;
+      std::string&  body_;
+
+    public:
+      MultipartBodyStream(std::string& body) :
+        body_(body)
+      {
+        body_.clear();
+      }
+
+      virtual void OnHttpStatusReceived(HttpStatus status)
+      {
+      }
+
+      virtual void Send(bool isHeader, const void* buffer, size_t length)
+      {
+        if (length > 0)
+        {
+          (isHeader ? header_ : body_).append(reinterpret_cast<const char*>(buffer), length);
+        }
+      }
+
+      std::string GetContentType() const
+      {
+        static const std::string PREFIX = "Content-Type: ";
+
+        size_t start = header_.find(PREFIX);
+        if (start == std::string::npos)
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        start += PREFIX.size();
+        return header_.substr(start, header_.find("\r\n", start) - start);
+      }
+    };
+
+
+    class HttpPeerConnection : public StorePeerCommand::IPeerConnection
+    {
+    private:
+      HttpClient  client_;
+
+    public:
+      HttpPeerConnection(const OrthancPeerParameters& peer)
+      {
+        client_.SetProxy(Configuration::GetGlobalStringParameter("HttpProxy", ""));
+        if (peer.GetUsername().size() != 0 && 
+            peer.GetPassword().size() != 0)
+        {
+          client_.SetCredentials(peer.GetUsername().c_str(), 
+                                 peer.GetPassword().c_str());
+        }
+
+        client_.SetUrl(peer.GetUrl() + "instances");
+        client_.SetMethod(HttpMethod_Post);
+      }
+
+      virtual bool PostInstances(std::string& answer,
+                                 HttpStatus& status,
+                                 std::string& body,
+                                 const std::string& contentType)
+      {
+        client_.ClearHeaders();
+        if (!contentType.empty())
+        {
+          client_.AddHeader("Content-Type", contentType);
+        }
+
+        client_.GetBody().swap(body);
+        body.clear();
+
+        bool success = client_.Apply(answer);
+        status = client_.GetLastStatus();
+
+        client_.GetBody().clear();
+        return success;
+      }
+    };
   }
 
-  bool StorePeerCommand::Apply(ListOfStrings& outputs,
-                               const ListOfStrings& inputs)
+
+  void StorePeerCommand::UploadBundle(std::vector<std::string>& errors,
+                                      bool& bundlesSupported,
+                                      IPeerConnection& connection,
+                                      const std::vector<std::string>& files)
+  {
+    errors.resize(files.size());
+
+    std::string body, answer;
+    HttpStatus status;
+
+    if (files.size() > 1 &&
+        bundlesSupported)
+    {
+      std::string contentType;
+
+      {
+        size_t size = 0;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+          size += files[i].size() + 256 /* headers of the part */;
+        }
+
+        body.reserve(size);
+
+        MultipartBodyStream stream(body);
+        HttpOutput output(stream, false /* no keep-alive */);
+        output.StartMultipart("related", "application/dicom");
+
+        std::map<std::string, std::string> headers;
+        for (size_t i = 0; i < files.size(); i++)
+        {
+          output.SendMultipartItem(files[i].empty() ? NULL : files[i].c_str(), files[i].size(), headers);
+        }
+
+        output.CloseMultipart();
+        contentType = stream.GetContentType();
+      }
+
+      if (connection.PostInstances(answer, status, body, contentType))
+      {
+        Json::Value json;
+        Json::Reader reader;
+
+        if (!reader.parse(answer, json) ||
+            json.type() != Json::arrayValue ||
+            json.size() != files.size())
+        {
+          // The files might have been stored: Do not send them again
+          for (size_t i = 0; i < files.size(); i++)
+          {
+            errors[i] = "Unexpected answer of the peer to a bundle of DICOM files";
+          }
+        }
+        else
+        {
+          for (size_t i = 0; i < files.size(); i++)
+          {
+            const Json::Value& item = json[static_cast<Json::Value::ArrayIndex>(i)];
+            if (item.type() == Json::objectValue &&
+                item.isMember("ID"))
+            {
+              errors[i].clear();
+            }
+            else
+            {
+              errors[i] = "Rejected by the peer";
+            }
+          }
+        }
+
+        return;
+      }
+      else if (status == HttpStatus_400_BadRequest ||
+               status == HttpStatus_415_UnsupportedMediaType)
+      {
+        // The peer is probably an older version of Orthanc, that has
+        // tried and failed to parse the bundle as one DICOM file
+        bundlesSupported = false;
+      }
+      else
+      {
+        for (size_t i = 0; i < files.size(); i++)
+        {
+          errors[i] = "HTTP status " + boost::lexical_cast<std::string>(status);
+        }
+
+        return;
+      }
+    }
+
+    // Send the files one by one
+    for (size_t i = 0; i < files.size(); i++)
+    {
+      body = files[i];
+
+      if (connection.PostInstances(answer, status, body, ""))
+      {
+        errors[i].clear();
+      }
+      else
+      {
+        errors[i] = "HTTP status " + boost::lexical_cast<std::string>(status);
+      }
+    }
+  }
+
+
+  /**
+   * Shared state of the threads that upload the instances. Each
+   * thread owns its HTTP client, whose connection is kept alive
+   * between successive requests. The reading of the next instances
+   * by one thread overlaps with the uploads of the other threads.
+   **/
+  class StorePeerCommand::Uploader : public boost::noncopyable
   {
-    // Configure the HTTP client
-    HttpClient client;
-    client.SetProxy(Configuration::GetGlobalStringParameter("HttpProxy", ""));
-    if (peer_.GetUsername().size() != 0 && 
-        peer_.GetPassword().size() != 0)
+  private:
+    const StorePeerCommand&          command_;
+    const std::vector<std::string>&  instances_;
+    boost::mutex                     mutex_;
+    size_t                           next_;
+    std::vector<bool>                success_;
+    bool                             bundlesSupported_;
+
+    bool TakeNext(size_t& index)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (next_ < instances_.size())
+      {
+        index = next_++;
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    void SignalSuccess(size_t index)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      success_[index] = true;
+    }
+
+    bool AreBundlesSupported()
     {
-      client.SetCredentials(peer_.GetUsername().c_str(), 
-                            peer_.GetPassword().c_str());
+      boost::mutex::scoped_lock lock(mutex_);
+      return bundlesSupported_;
+    }
+
+    void SignalBundlesRejected()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (bundlesSupported_)
+      {
+        LOG(WARNING) << "The Orthanc peer \"" << command_.peer_.GetUrl() 
+                     << "\" does not accept bundles of DICOM files, sending them one by one";
+        bundlesSupported_ = false;
+      }
     }
 
-    client.SetUrl(peer_.GetUrl() + "instances");
-    client.SetMethod(HttpMethod_Post);
+    void LogError(size_t index,
+                  const std::string& message)
+    {
+      LOG(ERROR) << "Unable to forward to an Orthanc peer in a Lua script (instance " 
+                 << instances_[index] << ", peer " << command_.peer_.GetUrl() << "): " << message;
+    }
 
-    for (ListOfStrings::const_iterator
-           it = inputs.begin(); it != inputs.end(); ++it)
+    void Worker()
     {
-      LOG(INFO) << "Sending resource " << *it << " to peer \"" 
-                << peer_.GetUrl() << "\"";
+      HttpPeerConnection connection(command_.peer_);
 
-      try
+      bool done = false;
+
+      while (!done)
       {
-        context_.ReadFile(client.GetBody(), *it, FileContentType_Dicom);
+        // Read the files of the next bundle
+        std::vector<size_t> indexes;
+        std::vector<std::string> files;
+        size_t bundleSize = 0;
 
-        std::string answer;
-        if (!client.Apply(answer))
+        while (indexes.size() < command_.bundleSize_ &&
+               bundleSize < MAX_BUNDLE_SIZE)
         {
-          LOG(ERROR) << "Unable to send resource " << *it << " to peer \"" << peer_.GetUrl() << "\"";
-          throw OrthancException(ErrorCode_NetworkProtocol);
+          size_t index;
+          if (!TakeNext(index))
+          {
+            done = true;
+            break;
+          }
+
+          LOG(INFO) << "Sending resource " << instances_[index] << " to peer \"" 
+                    << command_.peer_.GetUrl() << "\"";
+
+          try
+          {
+            files.push_back(std::string());
+            command_.context_.ReadFile(files.back(), instances_[index], FileContentType_Dicom);
+            indexes.push_back(index);
+            bundleSize += files.back().size();
+          }
+          catch (OrthancException& e)
+          {
+            files.pop_back();
+            LogError(index, e.What());
+          }
         }
 
-        // Only chain with other commands if this command succeeds
-        outputs.push_back(*it);
+        if (!indexes.empty())
+        {
+          try
+          {
+            bool bundlesSupported = AreBundlesSupported();
+
+            std::vector<std::string> errors;
+            UploadBundle(errors, bundlesSupported, connection, files);
+
+            if (!bundlesSupported)
+            {
+              SignalBundlesRejected();
+            }
+
+            for (size_t i = 0; i < indexes.size(); i++)
+            {
+              if (errors[i].empty())
+              {
+                SignalSuccess(indexes[i]);
+              }
+              else
+              {
+                LogError(indexes[i], errors[i]);
+              }
+            }
+          }
+          catch (OrthancException& e)
+          {
+            // Network error
+            for (size_t i = 0; i < indexes.size(); i++)
+            {
+              LogError(indexes[i], e.What());
+            }
+          }
+        }
       }
-      catch (OrthancException& e)
+    }
+
+    static void WorkerThread(Uploader* that)
+    {
+      that->Worker();
+    }
+
+  public:
+    Uploader(const StorePeerCommand& command,
+             const std::vector<std::string>& instances) :
+      command_(command),
+      instances_(instances),
+      next_(0),
+      success_(instances.size(), false),
+      bundlesSupported_(true)
+    {
+    }
+
+    void Run()
+    {
+      size_t countBundles = (instances_.size() + command_.bundleSize_ - 1) / command_.bundleSize_;
+      size_t countThreads = std::min(static_cast<size_t>(command_.concurrency_), countBundles);
+
+      if (countThreads <= 1)
       {
-        LOG(ERROR) << "Unable to forward to an Orthanc peer in a Lua script (instance " 
-                   << *it << ", peer " << peer_.GetUrl() << "): " << e.What();
+        Worker();
+      }
+      else
+      {
+        std::vector<boost::thread*> threads(countThreads);
+
+        for (size_t i = 0; i < countThreads; i++)
+        {
+          threads[i] = new boost::thread(WorkerThread, this);
+        }
 
-        if (!ignoreExceptions_)
+        for (size_t i = 0; i < countThreads; i++)
         {
-          throw;
+          threads[i]->join();
+          delete threads[i];
         }
       }
     }
 
+    bool IsSuccess(size_t index) const
+    {
+      return success_[index];
+    }
+  };
+
+
+  StorePeerCommand::StorePeerCommand(ServerContext& context,
+                                     const OrthancPeerParameters& peer,
+                                     bool ignoreExceptions) : 
+    context_(context),
+    peer_(peer),
+    ignoreExceptions_(ignoreExceptions),
+    bundleSize_(Configuration::GetGlobalIntegerParameter("OrthancPeersBundleSize", 16)),
+    concurrency_(Configuration::GetGlobalIntegerParameter("OrthancPeersConcurrency", 4))
+  {
+    if (bundleSize_ == 0)
+    {
+      bundleSize_ = 1;
+    }
+
+    if (concurrency_ == 0)
+    {
+      concurrency_ = 1;
+    }
+  }
+
+
+  bool StorePeerCommand::Apply(ListOfStrings& outputs,
+                               const ListOfStrings& inputs)
+  {
+    if (inputs.empty())
+    {
+      return true;
+    }
+
+    std::vector<std::string> instances(inputs.begin(), inputs.end());
+
+    Uploader uploader(*this, instances);
+    uploader.Run();
+
+    bool hasFailed = false;
+
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+      if (uploader.IsSuccess(i))
+      {
+        // Only chain with other commands if this command succeeds
+        outputs.push_back(instances[i]);
+      }
+      else
+      {
+        hasFailed = true;
+      }
+    }
+
+    if (hasFailed &&
+        !ignoreExceptions_)
+    {
+      throw OrthancException(ErrorCode_NetworkProtocol);
+    }
+
     return true;
   }
 }
@@ -40,10 +40,51 @@ namespace Orthanc
 {
   class StorePeerCommand : public IServerCommand
   {
+  public:
+    /**
+     * HTTP connection to the "/instances" URI of an Orthanc peer. It
+     * is abstracted so that the upload of the bundles can be tested
+     * without network.
+     **/
+    class IPeerConnection : public boost::noncopyable
+    {
+    public:
+      virtual ~IPeerConnection()
+      {
+      }
+
+      // Returns "false" if the peer answers with an HTTP error, whose
+      // status is then stored in "status". Throws an exception on
+      // network errors. The content of "body" is consumed.
+      virtual bool PostInstances(std::string& answer,
+                                 HttpStatus& status,
+                                 std::string& body,
+                                 const std::string& contentType) = 0;
+    };
+
+    /**
+     * Uploads the given DICOM files as one "multipart/related" bundle,
+     * and stores in "errors[i]" the reason why the i-th file was not
+     * stored, or an empty string on success. If the peer rejects the
+     * whole bundle with HTTP status 400 or 415 (which means that it
+     * does not support bundles, and that it has stored none of the
+     * files), "bundlesSupported" is set to "false" and the files are
+     * sent one by one. Any other error is not retried, so that no
+     * file is sent twice.
+     **/
+    static void UploadBundle(std::vector<std::string>& errors,
+                             bool& bundlesSupported,
+                             IPeerConnection& connection,
+                             const std::vector<std::string>& files);
+
   private:
+    class Uploader;
+
     ServerContext& context_;
     OrthancPeerParameters peer_;
     bool ignoreExceptions_;
+    unsigned int bundleSize_;
+    unsigned int concurrency_;
 
   public:
     StorePeerCommand(ServerContext& context,
@@ -52,5 +93,10 @@ namespace Orthanc
     
     virtual bool Apply(ListOfStrings& outputs,
                        const ListOfStrings& inputs);
+
+    virtual std::string GetDestination() const
+    {
+      return "peer:" + peer_.GetUrl();
+    }
   };
 }
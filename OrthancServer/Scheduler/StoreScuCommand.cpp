@@ -35,6 +35,8 @@
 
 #include "../../Core/Logging.h"
 
+#include <boost/lexical_cast.hpp>
+
 namespace Orthanc
 {
   StoreScuCommand::StoreScuCommand(ServerContext& context,
@@ -87,4 +89,11 @@ namespace Orthanc
 
     return true;
   }
+
+
+  std::string StoreScuCommand::GetDestination() const
+  {
+    return ("modality:" + modality_.GetApplicationEntityTitle() + "@" +
+            modality_.GetHost() + ":" + boost::lexical_cast<std::string>(modality_.GetPort()));
+  }
 }
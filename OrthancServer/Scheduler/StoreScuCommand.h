@@ -56,5 +56,9 @@ namespace Orthanc
 
     virtual bool Apply(ListOfStrings& outputs,
                        const ListOfStrings& inputs);
+
+    // Several modalities may share the same AET, hence the host and
+    // the port in the key of the destination
+    virtual std::string GetDestination() const;
   };
 }
@@ -231,6 +231,18 @@ namespace Orthanc
 
   void LookupIdentifierQuery::Apply(SetOfResources& result,
                                     IDatabaseWrapper& database)
+  {
+    if (!constraints_.empty())
+    {
+      std::list<int64_t> matches;
+      database.LookupIdentifiers(matches, *this);
+      result.Intersect(matches);
+    }
+  }
+
+
+  void LookupIdentifierQuery::ApplySeparately(SetOfResources& result,
+                                              IDatabaseWrapper& database) const
   {
     for (size_t i = 0; i < GetSize(); i++)
     {
@@ -157,13 +157,25 @@ namespace Orthanc
       return constraints_.size();
     }
 
+    const Disjunction& GetDisjunction(size_t i) const
+    {
+      return *constraints_[i];
+    }
+
     // The database must be locked
     void Apply(std::list<std::string>& result,
                IDatabaseWrapper& database);
 
+    // All the constraints are combined into a single database request
     void Apply(SetOfResources& result,
                IDatabaseWrapper& database);
 
+    // Looks for each constraint separately, then intersects the
+    // results. This is the fallback for the back-ends that cannot
+    // combine the constraints.
+    void ApplySeparately(SetOfResources& result,
+                         IDatabaseWrapper& database) const;
+
     static void LoadIdentifiers(const DicomTag*& tags,
                                 size_t& size,
                                 ResourceType level);
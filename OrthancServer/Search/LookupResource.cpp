@@ -211,8 +211,74 @@ namespace Orthanc
   }
 
 
+  bool LookupResource::Level::IsMatch(const DicomMap& tags) const
+  {
+    // Re-apply the identifier constraints, as their "Setup" method is
+    // less restrictive than their "Match" method
+    for (Constraints::const_iterator it = identifiersConstraints_.begin(); 
+         it != identifiersConstraints_.end(); ++it)
+    {
+      if (!Match(tags, it->first, *it->second))
+      {
+        return false;
+      }
+    }
+
+    for (Constraints::const_iterator it = mainTagsConstraints_.begin(); 
+         it != mainTagsConstraints_.end(); ++it)
+    {
+      if (!Match(tags, it->first, *it->second))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  void LookupResource::Level::FilterChunk(std::list<int64_t>& filtered,
+                                          const std::vector<int64_t>& chunk,
+                                          IDatabaseWrapper& database) const
+  {
+    std::vector<DicomMap*> tags(chunk.size());
+    for (size_t i = 0; i < chunk.size(); i++)
+    {
+      tags[i] = new DicomMap;
+    }
+
+    try
+    {
+      database.GetMainDicomTags(tags, chunk);
+
+      for (size_t i = 0; i < chunk.size(); i++)
+      {
+        if (IsMatch(*tags[i]))
+        {
+          filtered.push_back(chunk[i]);
+        }
+      }
+    }
+    catch (...)
+    {
+      for (size_t i = 0; i < tags.size(); i++)
+      {
+        delete tags[i];
+      }
+
+      throw;
+    }
+
+    for (size_t i = 0; i < tags.size(); i++)
+    {
+      delete tags[i];
+    }
+  }
+
+
   void LookupResource::Level::Apply(SetOfResources& candidates,
-                                    IDatabaseWrapper& database) const
+                                    IDatabaseWrapper& database,
+                                    size_t maxResults) const
   {
     // First, use the indexed identifiers
     LookupIdentifierQuery query(level_);
@@ -236,43 +302,41 @@ namespace Orthanc
     if (!identifiersConstraints_.empty() ||
         !mainTagsConstraints_.empty())
     {
+      // The main DICOM tags of the candidates are retrieved by chunks,
+      // instead of issuing one database query per candidate
+      static const size_t CHUNK_SIZE = 256;
+
       std::list<int64_t>  source;
       candidates.Flatten(source);
       candidates.Clear();
 
       std::list<int64_t>  filtered;
+      std::vector<int64_t>  chunk;
+      chunk.reserve(CHUNK_SIZE);
+
       for (std::list<int64_t>::const_iterator candidate = source.begin(); 
            candidate != source.end(); ++candidate)
       {
-        DicomMap tags;
-        database.GetMainDicomTags(tags, *candidate);
+        chunk.push_back(*candidate);
 
-        bool match = true;
-
-        // Re-apply the identifier constraints, as their "Setup"
-        // method is less restrictive than their "Match" method
-        for (Constraints::const_iterator it = identifiersConstraints_.begin(); 
-             match && it != identifiersConstraints_.end(); ++it)
+        if (chunk.size() == CHUNK_SIZE)
         {
-          if (!Match(tags, it->first, *it->second))
-          {
-            match = false;
-          }
-        }
+          FilterChunk(filtered, chunk, database);
+          chunk.clear();
 
-        for (Constraints::const_iterator it = mainTagsConstraints_.begin(); 
-             match && it != mainTagsConstraints_.end(); ++it)
-        {
-          if (!Match(tags, it->first, *it->second))
+          if (maxResults != 0 &&
+              filtered.size() >= maxResults)
           {
-            match = false;
+            break;   // Early termination, enough candidates were found
           }
         }
+      }
 
-        if (match)
-        {
-          filtered.push_back(*candidate);
-        }
+      if (!chunk.empty() &&
+          (maxResults == 0 ||
+           filtered.size() < maxResults))
+      {
+        FilterChunk(filtered, chunk, database);
       }
       
       candidates.Intersect(filtered);
@@ -308,16 +372,20 @@ namespace Orthanc
 
   void LookupResource::ApplyLevel(SetOfResources& candidates,
                                   ResourceType level,
-                                  IDatabaseWrapper& database) const
+                                  IDatabaseWrapper& database,
+                                  size_t maxResults) const
   {
+    bool hasModalitiesInStudy = (level == ResourceType_Study &&
+                                 modalitiesInStudy_.get() != NULL);
+
     Levels::const_iterator it = levels_.find(level);
     if (it != levels_.end())
     {
-      it->second->Apply(candidates, database);
+      // The limit cannot be applied before the "ModalitiesInStudy" filter
+      it->second->Apply(candidates, database, hasModalitiesInStudy ? 0 : maxResults);
     }
 
-    if (level == ResourceType_Study &&
-        modalitiesInStudy_.get() != NULL)
+    if (hasModalitiesInStudy)
     {
       // There is a constraint on the "ModalitiesInStudy" DICOM
       // extension. Check out whether one child series has one of the
@@ -328,6 +396,12 @@ namespace Orthanc
       for (std::list<int64_t>::const_iterator
              study = allStudies.begin(); study != allStudies.end(); ++study)
       {
+        if (maxResults != 0 &&
+            matchingStudies.size() >= maxResults)
+        {
+          break;
+        }
+
         std::list<int64_t> childrenSeries;
         database.GetChildrenInternalId(childrenSeries, *study);
 
@@ -357,8 +431,16 @@ namespace Orthanc
 
 
   void LookupResource::FindCandidates(std::list<int64_t>& result,
-                                      IDatabaseWrapper& database) const
+                                      IDatabaseWrapper& database,
+                                      size_t maxResults) const
   {
+    if (!unoptimizedConstraints_.empty())
+    {
+      // The candidates will be further filtered by "IsMatch()", so
+      // the limit cannot be applied at this point
+      maxResults = 0;
+    }
+
     ResourceType startingLevel;
     if (level_ == ResourceType_Patient)
     {
@@ -374,25 +456,25 @@ namespace Orthanc
     switch (level_)
     {
       case ResourceType_Patient:
-        ApplyLevel(candidates, ResourceType_Patient, database);
+        ApplyLevel(candidates, ResourceType_Patient, database, maxResults);
         break;
 
       case ResourceType_Study:
-        ApplyLevel(candidates, ResourceType_Study, database);
+        ApplyLevel(candidates, ResourceType_Study, database, maxResults);
         break;
 
       case ResourceType_Series:
-        ApplyLevel(candidates, ResourceType_Study, database);
+        ApplyLevel(candidates, ResourceType_Study, database, 0);
         candidates.GoDown();
-        ApplyLevel(candidates, ResourceType_Series, database);
+        ApplyLevel(candidates, ResourceType_Series, database, maxResults);
         break;
 
       case ResourceType_Instance:
-        ApplyLevel(candidates, ResourceType_Study, database);
+        ApplyLevel(candidates, ResourceType_Study, database, 0);
         candidates.GoDown();
-        ApplyLevel(candidates, ResourceType_Series, database);
+        ApplyLevel(candidates, ResourceType_Series, database, 0);
         candidates.GoDown();
-        ApplyLevel(candidates, ResourceType_Instance, database);
+        ApplyLevel(candidates, ResourceType_Instance, database, maxResults);
         break;
 
       default:
@@ -400,6 +482,12 @@ namespace Orthanc
     }
 
     candidates.Flatten(result);
+
+    if (maxResults != 0 &&
+        result.size() > maxResults)
+    {
+      result.resize(maxResults);
+    }
   }
 
 
@@ -53,6 +53,12 @@ namespace Orthanc
       Constraints         identifiersConstraints_;
       Constraints         mainTagsConstraints_;
 
+      bool IsMatch(const DicomMap& tags) const;
+
+      void FilterChunk(std::list<int64_t>& filtered,
+                       const std::vector<int64_t>& chunk,
+                       IDatabaseWrapper& database) const;
+
     public:
       Level(ResourceType level);
 
@@ -62,7 +68,8 @@ namespace Orthanc
                std::auto_ptr<IFindConstraint>& constraint);
 
       void Apply(SetOfResources& candidates,
-                 IDatabaseWrapper& database) const;
+                 IDatabaseWrapper& database,
+                 size_t maxResults) const;
     };
 
     typedef std::map<ResourceType, Level*>  Levels;
@@ -78,7 +85,8 @@ namespace Orthanc
 
     void ApplyLevel(SetOfResources& candidates,
                     ResourceType level,
-                    IDatabaseWrapper& database) const;
+                    IDatabaseWrapper& database,
+                    size_t maxResults) const;
 
   public:
     LookupResource(ResourceType level);
@@ -99,9 +107,21 @@ namespace Orthanc
                             const std::string& dicomQuery,
                             bool caseSensitive);
 
+    // If "maxResults" is not zero and if there is no unoptimized
+    // constraint, the lookup stops as soon as "maxResults" candidates
+    // are found. Ask for one more result than needed in order to
+    // detect whether the answers are incomplete.
     void FindCandidates(std::list<int64_t>& result,
-                        IDatabaseWrapper& database) const;
+                        IDatabaseWrapper& database,
+                        size_t maxResults) const;
 
     bool IsMatch(const Json::Value& dicomAsJson) const;
+
+    // If "false", "FindCandidates()" is enough to check the matching
+    // resources, and "IsMatch()" needs not be called
+    bool HasUnoptimizedConstraints() const
+    {
+      return !unoptimizedConstraints_.empty();
+    }
   };
 }
@@ -33,14 +33,21 @@
 #include "../PrecompiledHeadersServer.h"
 #include "WildcardConstraint.h"
 
-#include <boost/regex.hpp>
+#include "WildcardMatcher.h"
 
 namespace Orthanc
 {
   struct WildcardConstraint::PImpl
   {
-    boost::regex  pattern_;
-    std::string   wildcard_;
+    WildcardMatcher  matcher_;
+    std::string      wildcard_;
+
+    PImpl(const std::string& wildcard,
+          bool isCaseSensitive) :
+      matcher_(wildcard, isCaseSensitive),
+      wildcard_(wildcard)
+    {
+    }
   };
 
 
@@ -52,25 +59,13 @@ namespace Orthanc
 
   WildcardConstraint::WildcardConstraint(const std::string& wildcard,
                                          bool isCaseSensitive) :
-    pimpl_(new PImpl)
+    pimpl_(new PImpl(wildcard, isCaseSensitive))
   {
-    pimpl_->wildcard_ = wildcard;
-
-    std::string re = Toolbox::WildcardToRegularExpression(wildcard);
-
-    if (isCaseSensitive)
-    {
-      pimpl_->pattern_ = boost::regex(re);
-    }
-    else
-    {
-      pimpl_->pattern_ = boost::regex(re, boost::regex::icase /* case insensitive search */);
-    }
   }
 
   bool WildcardConstraint::Match(const std::string& value) const
   {
-    return boost::regex_match(value, pimpl_->pattern_);
+    return pimpl_->matcher_.Match(value);
   }
 
   void WildcardConstraint::Setup(LookupIdentifierQuery& lookup,
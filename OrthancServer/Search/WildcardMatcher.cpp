@@ -0,0 +1,150 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "WildcardMatcher.h"
+
+#include <ctype.h>
+
+namespace Orthanc
+{
+  WildcardMatcher::WildcardMatcher(const std::string& pattern,
+                                   bool isCaseSensitive) :
+    hasStar_(false),
+    minimumLength_(0)
+  {
+    for (unsigned int c = 0; c < 256; c++)
+    {
+      fold_[c] = static_cast<unsigned char>(isCaseSensitive ? c : toupper(c));
+    }
+
+    // Split the pattern at the stars, merging the consecutive stars
+    std::string segment;
+    for (size_t i = 0; i < pattern.size(); i++)
+    {
+      if (pattern[i] == '*')
+      {
+        segments_.push_back(segment);
+        segment.clear();
+        hasStar_ = true;
+
+        while (i + 1 < pattern.size() &&
+               pattern[i + 1] == '*')
+        {
+          i++;
+        }
+      }
+      else
+      {
+        segment.push_back(static_cast<char>(fold_[static_cast<unsigned char>(pattern[i])]));
+        minimumLength_++;
+      }
+    }
+
+    segments_.push_back(segment);
+  }
+
+
+  bool WildcardMatcher::MatchSegment(const std::string& value,
+                                     size_t position,
+                                     const std::string& segment) const
+  {
+    for (size_t i = 0; i < segment.size(); i++)
+    {
+      if (segment[i] != '?' &&
+          static_cast<char>(fold_[static_cast<unsigned char>(value[position + i])]) != segment[i])
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  bool WildcardMatcher::Match(const std::string& value) const
+  {
+    if (!hasStar_)
+    {
+      return (value.size() == minimumLength_ &&
+              MatchSegment(value, 0, segments_[0]));
+    }
+
+    if (value.size() < minimumLength_)
+    {
+      return false;
+    }
+
+    const std::string& first = segments_.front();
+    const std::string& last = segments_.back();
+
+    if (!MatchSegment(value, 0, first) ||
+        !MatchSegment(value, value.size() - last.size(), last))
+    {
+      return false;
+    }
+
+    /**
+     * The segments between two stars are matched at their leftmost
+     * position, which leaves as much room as possible to the next
+     * segments: No backtracking is needed.
+     **/
+    size_t position = first.size();
+    const size_t end = value.size() - last.size();
+
+    for (size_t i = 1; i + 1 < segments_.size(); i++)
+    {
+      const std::string& segment = segments_[i];
+
+      for (;;)
+      {
+        if (position + segment.size() > end)
+        {
+          return false;
+        }
+        else if (MatchSegment(value, position, segment))
+        {
+          position += segment.size();
+          break;
+        }
+        else
+        {
+          position++;
+        }
+      }
+    }
+
+    return true;
+  }
+}
@@ -37,6 +37,8 @@
 #include "../Core/HttpServer/FilesystemHttpSender.h"
 #include "../Core/HttpServer/HttpStreamTranscoder.h"
 #include "../Core/Logging.h"
+#include "../Core/RestApi/RestApiJsonStream.h"
+#include "DicomProtocol/DicomServer.h"
 #include "FromDcmtkBridge.h"
 #include "ServerToolbox.h"
 #include "OrthancInitialization.h"
@@ -54,9 +56,9 @@
 #include "../Plugins/Engine/OrthancPlugins.h"
 
 
-#define ENABLE_DICOM_CACHE  1
-
-static const size_t DICOM_CACHE_SIZE = 2;
+static const size_t DICOM_CACHE_SIZE = 128 * 1024 * 1024;  // 128 MB by default
+static const size_t DICOM_AS_JSON_CACHE_SIZE = 32 * 1024 * 1024;  // 32 MB by default
+static const unsigned int MAX_ARCHIVE_THREADS = 64;
 
 /**
  * IMPORTANT: We make the assumption that the same instance of
@@ -69,6 +71,188 @@ static const size_t DICOM_CACHE_SIZE = 2;
 
 namespace Orthanc
 {
+  class ServerContext::PendingWrite : public boost::noncopyable
+  {
+  private:
+    boost::mutex               mutex_;
+    boost::condition_variable  finished_;
+    bool                       isFinished_;
+    ErrorCode                  errorCode_;
+    FileInfo                   info_;
+
+  public:
+    PendingWrite() : 
+      isFinished_(false),
+      errorCode_(ErrorCode_Success)
+    {
+    }
+
+    // The first signal wins, the next ones are ignored
+    void SignalSuccess(const FileInfo& info)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (!isFinished_)
+      {
+        info_ = info;
+        isFinished_ = true;
+        finished_.notify_all();
+      }
+    }
+
+    void SignalFailure(ErrorCode errorCode)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (!isFinished_)
+      {
+        errorCode_ = errorCode;
+        isFinished_ = true;
+        finished_.notify_all();
+      }
+    }
+
+    // Returns "false" iff the write has failed
+    bool Wait(FileInfo& info,
+              ErrorCode& errorCode)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      while (!isFinished_)
+      {
+        finished_.wait(lock);
+      }
+
+      info = info_;
+      errorCode = errorCode_;
+      return (errorCode_ == ErrorCode_Success);
+    }
+  };
+
+
+  /**
+   * Compresses and writes one attachment in a storage writer
+   * thread. Either the raw buffer, or the JSON that is serialized by
+   * the worker, is written.
+   **/
+  class ServerContext::AttachmentWriter : public IRunnableBySteps
+  {
+  private:
+    boost::shared_ptr<PendingWrite>  pending_;
+    IStorageArea&       area_;
+    const void*         data_;
+    size_t              size_;
+    const Json::Value*  json_;
+    FileContentType     type_;
+    CompressionType     compression_;
+    uint8_t             compressionLevel_;
+    bool                storeMD5_;
+
+  public:
+    AttachmentWriter(boost::shared_ptr<PendingWrite> pending,
+                     IStorageArea& area,
+                     const void* data,
+                     size_t size,
+                     FileContentType type,
+                     CompressionType compression,
+                     uint8_t compressionLevel,
+                     bool storeMD5) :
+      pending_(pending),
+      area_(area),
+      data_(data),
+      size_(size),
+      json_(NULL),
+      type_(type),
+      compression_(compression),
+      compressionLevel_(compressionLevel),
+      storeMD5_(storeMD5)
+    {
+    }
+
+    AttachmentWriter(boost::shared_ptr<PendingWrite> pending,
+                     IStorageArea& area,
+                     const Json::Value& json,
+                     CompressionType compression,
+                     uint8_t compressionLevel,
+                     bool storeMD5) :
+      pending_(pending),
+      area_(area),
+      data_(NULL),
+      size_(0),
+      json_(&json),
+      type_(FileContentType_DicomAsJson),
+      compression_(compression),
+      compressionLevel_(compressionLevel),
+      storeMD5_(storeMD5)
+    {
+    }
+
+    virtual ~AttachmentWriter()
+    {
+      // The job is destroyed without having run if the pool of
+      // storage writers is stopped: Do not let the caller hang
+      pending_->SignalFailure(ErrorCode_BadSequenceOfCalls);
+    }
+
+    virtual bool Step()
+    {
+      try
+      {
+        StorageAccessor accessor(area_);
+        accessor.SetCompressionLevel(compressionLevel_);
+
+        if (json_ == NULL)
+        {
+          pending_->SignalSuccess(accessor.Write(data_, size_, type_, compression_, storeMD5_));
+        }
+        else
+        {
+          Json::FastWriter writer;
+          pending_->SignalSuccess(accessor.Write(writer.write(*json_), type_, compression_, storeMD5_));
+        }
+      }
+      catch (OrthancException& e)
+      {
+        pending_->SignalFailure(e.GetErrorCode());
+      }
+      catch (...)
+      {
+        pending_->SignalFailure(ErrorCode_InternalError);
+      }
+
+      return false;  // This is a one-shot job
+    }
+  };
+
+
+  static void SubmitWrite(RunnableWorkersPool& pool,
+                          IRunnableBySteps* writer)  // Takes the ownership
+  {
+    std::auto_ptr<IRunnableBySteps> protection(writer);
+
+    try
+    {
+      pool.Add(writer);
+      protection.release();
+    }
+    catch (OrthancException&)
+    {
+      // The pool is stopped: The destructor of the writer signals the failure
+    }
+  }
+
+
+  class ServerContext::DicomAsJsonItem : public IDynamicObject
+  {
+  private:
+    Json::Value  json_;
+
+  public:
+    Json::Value& GetJson()
+    {
+      return json_;
+    }
+  };
+
+
   void ServerContext::ChangeThread(ServerContext* that)
   {
     while (!that->done_)
@@ -79,20 +263,65 @@ namespace Orthanc
       {
         const ServerIndexChange& change = dynamic_cast<const ServerIndexChange&>(*obj.get());
 
-        boost::recursive_mutex::scoped_lock lock(that->listenersMutex_);
-        for (ServerListeners::iterator it = that->listeners_.begin(); 
-             it != that->listeners_.end(); ++it)
+        // Copy the queues, so that a full queue does not block the
+        // registration of the listeners, nor the incoming instances
+        std::vector< boost::shared_ptr<ServerListenerQueue> > queues;
+
         {
-          try
-          {
-            it->GetListener().SignalChange(change);
-          }
-          catch (OrthancException& e)
+          boost::recursive_mutex::scoped_lock lock(that->listenersMutex_);
+          queues.reserve(that->listeners_.size());
+
+          for (ServerListeners::iterator it = that->listeners_.begin(); 
+               it != that->listeners_.end(); ++it)
           {
-            LOG(ERROR) << "Error in the " << it->GetDescription() 
-                       << " callback while signaling a change: " << e.What();
+            queues.push_back(it->GetQueue());
           }
         }
+
+        for (size_t i = 0; i < queues.size(); i++)
+        {
+          queues[i]->Enqueue(change);
+        }
+      }
+    }
+  }
+
+
+  void ServerContext::AddListener(IServerListener& listener,
+                                  const std::string& description)
+  {
+    boost::recursive_mutex::scoped_lock lock(listenersMutex_);
+    listeners_.push_back(ServerListener(listener, description, listenersQueueSize_, listenersOverflowPolicy_));
+    listeners_.back().GetQueue()->SetBlockTimeout(listenersBlockTimeout_);
+  }
+
+
+  void ServerContext::RemoveListener(IServerListener& listener)
+  {
+    /**
+     * Destroying a queue joins its worker thread, that might be
+     * delivering a change to a listener that re-enters the server
+     * context. The queues are thus destroyed outside of the mutex.
+     **/
+    ServerListeners removed;
+
+    {
+      boost::recursive_mutex::scoped_lock lock(listenersMutex_);
+
+      ServerListeners::iterator it = listeners_.begin();
+      while (it != listeners_.end())
+      {
+        if (&it->GetListener() == &listener)
+        {
+          ServerListeners::iterator next = it;
+          ++next;
+          removed.splice(removed.end(), listeners_, it);
+          it = next;
+        }
+        else
+        {
+          ++it;
+        }
       }
     }
   }
@@ -103,22 +332,39 @@ namespace Orthanc
     index_(*this, database),
     area_(area),
     compressionEnabled_(false),
+    compressionType_(CompressionType_ZlibWithSize),
+    compressionLevel_(6),
     storeMD5_(true),
+    storeDicomAsJson_(true),
+    archiveThreads_(1),
     provider_(*this),
     dicomCache_(provider_, DICOM_CACHE_SIZE),
-    scheduler_(Configuration::GetGlobalIntegerParameter("LimitJobs", 10)),
+    dicomAsJsonProvider_(*this),
+    dicomAsJsonCache_(dicomAsJsonProvider_, DICOM_AS_JSON_CACHE_SIZE),
+    previewCache_(index_, area_),
+    scheduler_(Configuration::GetGlobalIntegerParameter("LimitJobs", 10),
+               Configuration::GetGlobalIntegerParameter("SchedulerThreads", 4)),
     lua_(*this),
 #if ORTHANC_PLUGINS_ENABLED == 1
     plugins_(NULL),
 #endif
+    listenersQueueSize_(1000),
+    listenersOverflowPolicy_(ListenerOverflowPolicy_Block),
+    listenersBlockTimeout_(1000),
+    dicomServer_(NULL),
     done_(false),
     queryRetrieveArchive_(Configuration::GetGlobalIntegerParameter("QueryRetrieveSize", 10)),
     defaultLocalAet_(Configuration::GetGlobalStringParameter("DicomAet", "ORTHANC"))
   {
     uint64_t s = Configuration::GetGlobalIntegerParameter("DicomAssociationCloseDelay", 5);  // In seconds
     scu_.SetMillisecondsBeforeClose(s * 1000);  // Milliseconds are expected here
+    scu_.SetMaximumConnectionsPerModality
+      (Configuration::GetGlobalIntegerParameter("DicomAssociationsPerModality", 4));
+
+    scheduler_.SetConcurrencyPerDestination
+      (Configuration::GetGlobalIntegerParameter("SchedulerConcurrencyPerDestination", 1));
 
-    listeners_.push_back(ServerListener(lua_, "Lua"));
+    AddListener(lua_, "Lua");
 
     changeThread_ = boost::thread(ChangeThread, this);
   }
@@ -139,11 +385,6 @@ namespace Orthanc
   {
     if (!done_)
     {
-      {
-        boost::recursive_mutex::scoped_lock lock(listenersMutex_);
-        listeners_.clear();
-      }
-
       done_ = true;
 
       if (changeThread_.joinable())
@@ -151,8 +392,22 @@ namespace Orthanc
         changeThread_.join();
       }
 
+      {
+        // This stops the worker threads of the listeners, outside of
+        // the mutex (cf. "RemoveListener()")
+        ServerListeners removed;
+
+        {
+          boost::recursive_mutex::scoped_lock lock(listenersMutex_);
+          removed.swap(listeners_);
+        }
+      }
+
       scu_.Finalize();
 
+      // Wait for the pending writes to the storage area
+      storageWriters_.reset(NULL);
+
       // Do not change the order below!
       scheduler_.Stop();
       index_.Stop();
@@ -171,6 +426,42 @@ namespace Orthanc
   }
 
 
+  void ServerContext::SetCompressionType(CompressionType type)
+  {
+    if (type != CompressionType_ZlibWithSize &&
+        type != CompressionType_Lz4WithSize)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    LOG(WARNING) << "Algorithm of the disk compression: " << EnumerationToString(type);
+    compressionType_ = type;
+  }
+
+
+  void ServerContext::SetCompressionLevel(uint8_t level)
+  {
+    if (level > 9)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    LOG(WARNING) << "Level of the zlib compression of the attachments: " << static_cast<int>(level);
+    compressionLevel_ = level;
+  }
+
+
+  void ServerContext::SetStoreDicomAsJson(bool store)
+  {
+    if (store)
+      LOG(WARNING) << "The DICOM files converted to JSON are written to the storage area";
+    else
+      LOG(WARNING) << "The DICOM files are converted to JSON on demand, and not written to the storage area";
+
+    storeDicomAsJson_ = store;
+  }
+
+
   void ServerContext::RemoveFile(const std::string& fileUuid,
                                  FileContentType type)
   {
@@ -178,6 +469,109 @@ namespace Orthanc
   }
 
 
+  void ServerContext::WriteAttachments(FileInfo& dicomInfo,
+                                       FileInfo& jsonInfo,
+                                       DicomInstanceToStore& dicom,
+                                       CompressionType compression,
+                                       bool storeJson)
+  {
+    StorageAccessor accessor(area_);
+    accessor.SetCompressionLevel(compressionLevel_);
+
+    if (!storeJson)
+    {
+      dicomInfo = accessor.Write(dicom.GetBufferData(), dicom.GetBufferSize(), 
+                                 FileContentType_Dicom, compression, storeMD5_);
+      return;
+    }
+
+    if (storageWriters_.get() == NULL)
+    {
+      dicomInfo = accessor.Write(dicom.GetBufferData(), dicom.GetBufferSize(), 
+                                 FileContentType_Dicom, compression, storeMD5_);
+
+      try
+      {
+        Json::FastWriter writer;
+        jsonInfo = accessor.Write(writer.write(dicom.GetJson()), 
+                                  FileContentType_DicomAsJson, compression, storeMD5_);
+      }
+      catch (OrthancException&)
+      {
+        accessor.Remove(dicomInfo);
+        throw;
+      }
+
+      return;
+    }
+
+    /**
+     * Compress and write the DICOM file and its DicomAsJson summary in
+     * parallel in the storage writer threads. The calling thread waits
+     * for both writes, as the index must know the attachments.
+     **/
+
+    boost::shared_ptr<PendingWrite> dicomPending(new PendingWrite);
+    SubmitWrite(*storageWriters_, new AttachmentWriter(dicomPending, area_, dicom.GetBufferData(),
+                                                       dicom.GetBufferSize(), FileContentType_Dicom,
+                                                       compression, compressionLevel_, storeMD5_));
+
+    boost::shared_ptr<PendingWrite> jsonPending(new PendingWrite);
+    SubmitWrite(*storageWriters_, new AttachmentWriter(jsonPending, area_, dicom.GetJson(),
+                                                       compression, compressionLevel_, storeMD5_));
+
+    // Always wait for both jobs, as they reference the buffers of "dicom"
+    ErrorCode dicomError, jsonError;
+    bool dicomSuccess = dicomPending->Wait(dicomInfo, dicomError);
+    bool jsonSuccess = jsonPending->Wait(jsonInfo, jsonError);
+
+    if (!dicomSuccess || !jsonSuccess)
+    {
+      if (dicomSuccess)
+      {
+        accessor.Remove(dicomInfo);
+      }
+
+      if (jsonSuccess)
+      {
+        accessor.Remove(jsonInfo);
+      }
+
+      throw OrthancException(dicomSuccess ? jsonError : dicomError);
+    }
+  }
+
+
+  void ServerContext::SetStorageWriteThreads(unsigned int countThreads)
+  {
+    if (countThreads == 0)
+    {
+      LOG(WARNING) << "The attachments of the incoming instances are written sequentially";
+      storageWriters_.reset(NULL);
+    }
+    else
+    {
+      LOG(WARNING) << "Number of threads writing to the storage area: " << countThreads;
+      storageWriters_.reset(new RunnableWorkersPool(countThreads));
+    }
+  }
+
+
+  void ServerContext::SetArchiveThreads(unsigned int countThreads)
+  {
+    if (countThreads == 0 ||
+        countThreads > MAX_ARCHIVE_THREADS)
+    {
+      LOG(ERROR) << "The number of threads reading the DICOM files of the archives must be "
+                 << "between 1 and " << MAX_ARCHIVE_THREADS << ", got: " << countThreads;
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    LOG(WARNING) << "Number of threads reading the DICOM files of the archives: " << countThreads;
+    archiveThreads_ = countThreads;
+  }
+
+
   StoreStatus ServerContext::Store(std::string& resultPublicId,
                                    DicomInstanceToStore& dicom)
   {
@@ -185,16 +579,22 @@ namespace Orthanc
     {
       StorageAccessor accessor(area_);
 
-      DicomInstanceHasher hasher(dicom.GetSummary());
-      resultPublicId = hasher.HashInstance();
-
       Json::Value simplifiedTags;
-      Toolbox::SimplifyTags(simplifiedTags, dicom.GetJson(), DicomToJsonFormat_Human);
+
+      {
+        IngestStatistics::Timer timer(ingestStatistics_, IngestStatistics::Stage_Parsing);
+
+        DicomInstanceHasher hasher(dicom.GetSummary());
+        resultPublicId = hasher.HashInstance();
+
+        Toolbox::SimplifyTags(simplifiedTags, dicom.GetJson(), DicomToJsonFormat_Human);
+      }
 
       // Test if the instance must be filtered out
       bool accepted = true;
 
       {
+        IngestStatistics::Timer timer(ingestStatistics_, IngestStatistics::Stage_Filtering);
         boost::recursive_mutex::scoped_lock lock(listenersMutex_);
 
         for (ServerListeners::iterator it = listeners_.begin(); it != listeners_.end(); ++it)
@@ -223,20 +623,34 @@ namespace Orthanc
       }
 
       // TODO Should we use "gzip" instead?
-      CompressionType compression = (compressionEnabled_ ? CompressionType_ZlibWithSize : CompressionType_None);
+      CompressionType compression = GetStorageCompression();
+
+      // Read the option only once, as it may be changed concurrently
+      const bool storeJson = storeDicomAsJson_;
 
-      FileInfo dicomInfo = accessor.Write(dicom.GetBufferData(), dicom.GetBufferSize(), 
-                                          FileContentType_Dicom, compression, storeMD5_);
-      FileInfo jsonInfo = accessor.Write(dicom.GetJson().toStyledString(), 
-                                         FileContentType_DicomAsJson, compression, storeMD5_);
+      FileInfo dicomInfo, jsonInfo;
+
+      {
+        IngestStatistics::Timer timer(ingestStatistics_, IngestStatistics::Stage_StorageWrite);
+        WriteAttachments(dicomInfo, jsonInfo, dicom, compression, storeJson);
+      }
 
       ServerIndex::Attachments attachments;
       attachments.push_back(dicomInfo);
-      attachments.push_back(jsonInfo);
+
+      if (storeJson)
+      {
+        attachments.push_back(jsonInfo);
+      }
 
       typedef std::map<MetadataType, std::string>  InstanceMetadata;
       InstanceMetadata  instanceMetadata;
-      StoreStatus status = index_.Store(instanceMetadata, dicom, attachments);
+      StoreStatus status;
+
+      {
+        IngestStatistics::Timer timer(ingestStatistics_, IngestStatistics::Stage_IndexCommit);
+        status = index_.Store(instanceMetadata, dicom, attachments);
+      }
 
       // Only keep the metadata for the "instance" level
       dicom.GetMetadata().clear();
@@ -251,7 +665,18 @@ namespace Orthanc
       if (status != StoreStatus_Success)
       {
         accessor.Remove(dicomInfo);
-        accessor.Remove(jsonInfo);
+
+        if (storeJson)
+        {
+          accessor.Remove(jsonInfo);
+        }
+      }
+      else
+      {
+        // Drop the cached versions of a previous instance that had
+        // the same identifier, and that has possibly been deleted
+        dicomCache_.Invalidate(resultPublicId);
+        dicomAsJsonCache_.Invalidate(resultPublicId);
       }
 
       switch (status)
@@ -308,7 +733,8 @@ namespace Orthanc
 
   void ServerContext::AnswerAttachment(RestApiOutput& output,
                                        const std::string& resourceId,
-                                       FileContentType content)
+                                       FileContentType content,
+                                       const std::string& range)
   {
     FileInfo attachment;
     if (!index_.LookupAttachment(attachment, resourceId, content))
@@ -317,7 +743,7 @@ namespace Orthanc
     }
 
     StorageAccessor accessor(area_);
-    accessor.AnswerFile(output, attachment, GetFileContentMime(content));
+    accessor.AnswerFileRange(output, attachment, GetFileContentMime(content), range);
   }
 
 
@@ -345,6 +771,7 @@ namespace Orthanc
     std::string content;
 
     StorageAccessor accessor(area_);
+    accessor.SetCompressionLevel(compressionLevel_);
     accessor.Read(content, attachment);
 
     FileInfo modified = accessor.Write(content.empty() ? NULL : content.c_str(),
@@ -370,13 +797,77 @@ namespace Orthanc
   void ServerContext::ReadJson(Json::Value& result,
                                const std::string& instancePublicId)
   {
-    std::string s;
-    ReadFile(s, instancePublicId, FileContentType_DicomAsJson);
+    FileInfo attachment;
+    if (index_.LookupAttachment(attachment, instancePublicId, FileContentType_DicomAsJson))
+    {
+      std::string s;
+      ReadFile(s, attachment);
+
+      Json::Reader reader;
+      if (!reader.parse(s, result))
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+    else if (index_.LookupAttachment(attachment, instancePublicId, FileContentType_Dicom))
+    {
+      // The JSON is derived on demand. The caches are only consulted
+      // if the instance still exists, as they might be filled by a
+      // reader that raced with the deletion of the instance.
+      ConcurrentMemoryCache::Accessor accessor(dicomAsJsonCache_, instancePublicId);
+      result = dynamic_cast<DicomAsJsonItem&>(accessor.GetItem()).GetJson();
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+  }
+
+
+  void ServerContext::AnswerDicomAsJson(RestApiOutput& output,
+                                        const std::string& instancePublicId)
+  {
+    FileInfo attachment;
+    if (index_.LookupAttachment(attachment, instancePublicId, FileContentType_DicomAsJson))
+    {
+      StorageAccessor accessor(area_);
+      accessor.AnswerFile(output, attachment, GetFileContentMime(FileContentType_DicomAsJson));
+    }
+    else
+    {
+      Json::Value json;
+      ReadJson(json, instancePublicId);
 
-    Json::Reader reader;
-    if (!reader.parse(s, result))
+      RestApiJsonStream stream(output);
+      stream.WriteValue(json);
+      stream.Close();
+    }
+  }
+
+
+  void ServerContext::ChangeDicomAsJsonStorage(const std::string& instancePublicId,
+                                               bool store)
+  {
+    FileInfo attachment;
+    bool isStored = index_.LookupAttachment(attachment, instancePublicId, FileContentType_DicomAsJson);
+
+    if (store && !isStored)
+    {
+      Json::Value json;
+      ReadJson(json, instancePublicId);
+
+      Json::FastWriter writer;
+      std::string s = writer.write(json);
+
+      if (!AddAttachment(instancePublicId, FileContentType_DicomAsJson, s.c_str(), s.size()))
+      {
+        throw OrthancException(ErrorCode_Database);
+      }
+    }
+    else if (!store && isStored)
     {
-      throw OrthancException(ErrorCode_CorruptedFile);
+      // The derived version will be computed on the next access
+      index_.DeleteAttachment(instancePublicId, FileContentType_DicomAsJson);
     }
   }
 
@@ -414,31 +905,172 @@ namespace Orthanc
   }
 
 
-  IDynamicObject* ServerContext::DicomCacheProvider::Provide(const std::string& instancePublicId)
+  IDynamicObject* ServerContext::DicomCacheProvider::Provide(size_t& size,
+                                                             const std::string& instancePublicId)
   {
     std::string content;
     context_.ReadFile(content, instancePublicId, FileContentType_Dicom);
+
+    // The size of the DICOM file is used as an estimate of the memory
+    // that is consumed by its parsed version
+    size = content.size();
+
     return new ParsedDicomFile(content);
   }
 
 
+  IDynamicObject* ServerContext::DicomAsJsonCacheProvider::Provide(size_t& size,
+                                                                   const std::string& instancePublicId)
+  {
+    std::auto_ptr<DicomAsJsonItem> item(new DicomAsJsonItem);
+
+    {
+      DicomCacheLocker locker(context_, instancePublicId);
+      locker.GetDicom().ToJson(item->GetJson(), DicomToJsonFormat_Full,
+                               DicomToJsonFlags_Default, ORTHANC_MAXIMUM_TAG_LENGTH);
+    }
+
+    // The size of the compact serialization is used as an estimate
+    // of the memory that is consumed by the JSON object
+    Json::FastWriter writer;
+    size = writer.write(item->GetJson()).size();
+
+    return item.release();
+  }
+
+
   ServerContext::DicomCacheLocker::DicomCacheLocker(ServerContext& that,
                                                     const std::string& instancePublicId) : 
-    that_(that),
-    lock_(that_.dicomCacheMutex_)
+    accessor_(that.dicomCache_, instancePublicId)
   {
-#if ENABLE_DICOM_CACHE == 0
-    static std::auto_ptr<IDynamicObject> p;
-    p.reset(provider_.Provide(instancePublicId));
-    dicom_ = dynamic_cast<ParsedDicomFile*>(p.get());
-#else
-    dicom_ = &dynamic_cast<ParsedDicomFile&>(that_.dicomCache_.Access(instancePublicId));
-#endif
+    dicom_ = &dynamic_cast<ParsedDicomFile&>(accessor_.GetItem());
   }
 
 
-  ServerContext::DicomCacheLocker::~DicomCacheLocker()
+  void ServerContext::SetDicomCacheSize(size_t size)
   {
+    LOG(INFO) << "Size of the cache of parsed DICOM files: " << (size / (1024 * 1024)) << " MB";
+    dicomCache_.SetMaximumSize(size);
+  }
+
+
+  static void FormatMemoryCacheStatistics(Json::Value& target,
+                                          ConcurrentMemoryCache& cache)
+  {
+    ConcurrentMemoryCache::Statistics statistics;
+    cache.GetStatistics(statistics);
+
+    target = Json::objectValue;
+    target["Hits"] = static_cast<unsigned int>(statistics.hits_);
+    target["Misses"] = static_cast<unsigned int>(statistics.misses_);
+    target["Evictions"] = static_cast<unsigned int>(statistics.evictions_);
+    target["CountEntries"] = static_cast<unsigned int>(statistics.countPages_);
+    target["Size"] = boost::lexical_cast<std::string>(statistics.currentSize_);
+    target["SizeMB"] = static_cast<unsigned int>(statistics.currentSize_ / (1024 * 1024));
+    target["MaximumSizeMB"] = static_cast<unsigned int>(statistics.maximumSize_ / (1024 * 1024));
+  }
+
+
+  void ServerContext::FormatDicomCacheStatistics(Json::Value& target)
+  {
+    FormatMemoryCacheStatistics(target, dicomCache_);
+  }
+
+
+  void ServerContext::SetDicomAsJsonCacheSize(size_t size)
+  {
+    LOG(INFO) << "Size of the cache of the DICOM files converted to JSON: " << (size / (1024 * 1024)) << " MB";
+    dicomAsJsonCache_.SetMaximumSize(size);
+  }
+
+
+  void ServerContext::FormatDicomAsJsonCacheStatistics(Json::Value& target)
+  {
+    FormatMemoryCacheStatistics(target, dicomAsJsonCache_);
+  }
+
+
+  void ServerContext::FormatPreviewCacheStatistics(Json::Value& target)
+  {
+    PreviewCache::Statistics statistics;
+    previewCache_.GetStatistics(statistics);
+
+    target = Json::objectValue;
+    target["Hits"] = static_cast<unsigned int>(statistics.hits_);
+    target["Misses"] = static_cast<unsigned int>(statistics.misses_);
+    target["SpillHits"] = static_cast<unsigned int>(statistics.spillHits_);
+    target["CountEntries"] = static_cast<unsigned int>(statistics.countEntries_);
+    target["Size"] = boost::lexical_cast<std::string>(statistics.currentSize_);
+    target["SizeMB"] = static_cast<unsigned int>(statistics.currentSize_ / (1024 * 1024));
+    target["MaximumSizeMB"] = static_cast<unsigned int>(statistics.maximumSize_ / (1024 * 1024));
+  }
+
+
+  void ServerContext::SetListenersQueue(size_t queueSize,
+                                       ListenerOverflowPolicy policy,
+                                       unsigned int blockTimeout)
+  {
+    LOG(INFO) << "Size of the queues of the changes for the listeners: " << queueSize
+              << " (overflow policy: " << EnumerationToString(policy) 
+              << ", block timeout: " << blockTimeout << "ms)";
+
+    boost::recursive_mutex::scoped_lock lock(listenersMutex_);
+
+    listenersQueueSize_ = queueSize;
+    listenersOverflowPolicy_ = policy;
+    listenersBlockTimeout_ = blockTimeout;
+
+    for (ServerListeners::iterator it = listeners_.begin(); it != listeners_.end(); ++it)
+    {
+      it->GetQueue()->SetMaximumSize(queueSize);
+      it->GetQueue()->SetOverflowPolicy(policy);
+      it->GetQueue()->SetBlockTimeout(blockTimeout);
+    }
+  }
+
+
+  void ServerContext::FormatListenersStatistics(Json::Value& target)
+  {
+    boost::recursive_mutex::scoped_lock lock(listenersMutex_);
+
+    target = Json::objectValue;
+
+    for (ServerListeners::iterator it = listeners_.begin(); it != listeners_.end(); ++it)
+    {
+      it->GetQueue()->Format(target[it->GetDescription()]);
+    }
+  }
+
+
+  void ServerContext::SetDicomServer(DicomServer* server)
+  {
+    boost::mutex::scoped_lock lock(dicomServerMutex_);
+    dicomServer_ = server;
+  }
+
+
+  bool ServerContext::FormatDicomServerStatistics(Json::Value& target)
+  {
+    RunnableWorkersPool::Statistics statistics;
+
+    {
+      boost::mutex::scoped_lock lock(dicomServerMutex_);
+
+      if (dicomServer_ == NULL)
+      {
+        return false;
+      }
+
+      dicomServer_->GetStatistics(statistics);
+    }
+
+    target = Json::objectValue;
+    target["Threads"] = static_cast<unsigned int>(statistics.countWorkers_);
+    target["MinimumThreads"] = static_cast<unsigned int>(statistics.minWorkers_);
+    target["MaximumThreads"] = static_cast<unsigned int>(statistics.maxWorkers_);
+    target["ActiveAssociations"] = static_cast<unsigned int>(statistics.countActive_);
+    target["QueuedAssociations"] = static_cast<unsigned int>(statistics.countRunnables_ - statistics.countActive_);
+    return true;
   }
 
 
@@ -457,9 +1089,10 @@ namespace Orthanc
     LOG(INFO) << "Adding attachment " << EnumerationToString(attachmentType) << " to resource " << resourceId;
     
     // TODO Should we use "gzip" instead?
-    CompressionType compression = (compressionEnabled_ ? CompressionType_ZlibWithSize : CompressionType_None);
+    CompressionType compression = GetStorageCompression();
 
     StorageAccessor accessor(area_);
+    accessor.SetCompressionLevel(compressionLevel_);
     FileInfo attachment = accessor.Write(data, size, attachmentType, compression, storeMD5_);
 
     StoreStatus status = index_.AddAttachment(attachment, resourceId);
@@ -485,6 +1118,16 @@ namespace Orthanc
 
   void ServerContext::SignalChange(const ServerIndexChange& change)
   {
+    if (change.GetChangeType() == ChangeType_Deleted &&
+        change.GetResourceType() == ResourceType_Instance)
+    {
+      // The caches must not serve a deleted instance. This is done
+      // synchronously, as the listeners are notified asynchronously.
+      dicomCache_.Invalidate(change.GetPublicId());
+      dicomAsJsonCache_.Invalidate(change.GetPublicId());
+      previewCache_.Invalidate(change.GetPublicId());
+    }
+
     pendingChanges_.Enqueue(change.Clone());
   }
 
@@ -492,26 +1135,29 @@ namespace Orthanc
 #if ORTHANC_PLUGINS_ENABLED == 1
   void ServerContext::SetPlugins(OrthancPlugins& plugins)
   {
-    boost::recursive_mutex::scoped_lock lock(listenersMutex_);
+    ResetPlugins();
 
+    boost::recursive_mutex::scoped_lock lock(listenersMutex_);
     plugins_ = &plugins;
-
-    // TODO REFACTOR THIS
-    listeners_.clear();
-    listeners_.push_back(ServerListener(lua_, "Lua"));
-    listeners_.push_back(ServerListener(plugins, "plugin"));
+    AddListener(plugins, "plugin");
   }
 
 
   void ServerContext::ResetPlugins()
   {
-    boost::recursive_mutex::scoped_lock lock(listenersMutex_);
+    OrthancPlugins* previous;
 
-    plugins_ = NULL;
+    {
+      boost::recursive_mutex::scoped_lock lock(listenersMutex_);
+      previous = plugins_;
+      plugins_ = NULL;
+    }
 
-    // TODO REFACTOR THIS
-    listeners_.clear();
-    listeners_.push_back(ServerListener(lua_, "Lua"));
+    // Not in the mutex (cf. "RemoveListener()")
+    if (previous != NULL)
+    {
+      RemoveListener(*previous);
+    }
   }
 
 
@@ -558,28 +1204,40 @@ namespace Orthanc
   {
     result.clear();
 
-    std::vector<std::string> resources, instances;
-    GetIndex().FindCandidates(resources, instances, lookup);
-
-    assert(resources.size() == instances.size());
+    // Ask for one more candidate, so as to detect too many results
+    std::vector<std::string> resources;
+    GetIndex().FindCandidates(resources, lookup, (maxResults == 0 ? 0 : maxResults + 1));
 
-    for (size_t i = 0; i < instances.size(); i++)
+    for (size_t i = 0; i < resources.size(); i++)
     {
-      Json::Value dicom;
-      ReadJson(dicom, instances[i]);
-      
-      if (lookup.IsMatch(dicom))
+      if (lookup.HasUnoptimizedConstraints())
       {
-        if (maxResults != 0 &&
-            result.size() >= maxResults)
+        // The JSON summary of one child instance is needed to check
+        // the constraints that are not handled by the index
+        std::string instance;
+        if (!GetIndex().LookupOneChildInstance(instance, resources[i]))
         {
-          return false;  // too many results
+          continue;  // The resource was deleted in between
         }
-        else
+
+        Json::Value dicom;
+        ReadJson(dicom, instance);
+
+        if (!lookup.IsMatch(dicom))
         {
-          result.push_back(resources[i]);
+          continue;
         }
       }
+
+      if (maxResults != 0 &&
+          result.size() >= maxResults)
+      {
+        return false;  // too many results
+      }
+      else
+      {
+        result.push_back(resources[i]);
+      }
     }
 
     return true;  // finished
@@ -32,8 +32,9 @@
 
 #pragma once
 
+#include "../Core/MultiThreading/RunnableWorkersPool.h"
 #include "../Core/MultiThreading/SharedMessageQueue.h"
-#include "../Core/Cache/MemoryCache.h"
+#include "../Core/Cache/ConcurrentMemoryCache.h"
 #include "../Core/Cache/SharedArchive.h"
 #include "../Core/FileStorage/IStorageArea.h"
 #include "../Core/Lua/LuaContext.h"
@@ -42,10 +43,13 @@
 #include "DicomInstanceToStore.h"
 #include "DicomProtocol/ReusableDicomUserConnection.h"
 #include "IServerListener.h"
+#include "IngestStatistics.h"
 #include "LuaScripting.h"
 #include "ParsedDicomFile.h"
+#include "PreviewCache.h"
 #include "Scheduler/ServerScheduler.h"
 #include "ServerIndex.h"
+#include "ServerListenerQueue.h"
 #include "OrthancHttpHandler.h"
 #include "Search/LookupResource.h"
 
@@ -55,6 +59,8 @@
 
 namespace Orthanc
 {
+  class DicomServer;
+
   /**
    * This class is responsible for maintaining the storage area on the
    * filesystem (including compression), as well as the index of the
@@ -63,7 +69,7 @@ namespace Orthanc
   class ServerContext
   {
   private:
-    class DicomCacheProvider : public ICachePageProvider
+    class DicomCacheProvider : public ConcurrentMemoryCache::IPageProvider
     {
     private:
       ServerContext& context_;
@@ -73,49 +79,93 @@ namespace Orthanc
       {
       }
       
-      virtual IDynamicObject* Provide(const std::string& id);
+      virtual IDynamicObject* Provide(size_t& size,
+                                      const std::string& id);
+    };
+
+    class DicomAsJsonCacheProvider : public ConcurrentMemoryCache::IPageProvider
+    {
+    private:
+      ServerContext& context_;
+
+    public:
+      DicomAsJsonCacheProvider(ServerContext& context) : context_(context)
+      {
+      }
+      
+      virtual IDynamicObject* Provide(size_t& size,
+                                      const std::string& id);
     };
 
     class ServerListener
     {
     private:
-      IServerListener *listener_;
-      std::string      description_;
+      boost::shared_ptr<ServerListenerQueue>  queue_;
 
     public:
       ServerListener(IServerListener& listener,
-                     const std::string& description) :
-        listener_(&listener),
-        description_(description)
+                     const std::string& description,
+                     size_t queueSize,
+                     ListenerOverflowPolicy policy) :
+        queue_(new ServerListenerQueue(listener, description, queueSize, policy))
       {
       }
 
       IServerListener& GetListener()
       {
-        return *listener_;
+        return queue_->GetListener();
       }
 
       const std::string& GetDescription()
       {
-        return description_;
+        return queue_->GetDescription();
+      }
+
+      const boost::shared_ptr<ServerListenerQueue>& GetQueue()
+      {
+        return queue_;
       }
     };
 
     typedef std::list<ServerListener>  ServerListeners;
 
+    class PendingWrite;
+    class AttachmentWriter;
+    class DicomAsJsonItem;
+
 
     static void ChangeThread(ServerContext* that);
 
+    void AddListener(IServerListener& listener,
+                     const std::string& description);
+
+    void RemoveListener(IServerListener& listener);
+
+    void WriteAttachments(FileInfo& dicomInfo,
+                          FileInfo& jsonInfo,
+                          DicomInstanceToStore& dicom,
+                          CompressionType compression,
+                          bool storeJson);
+
 
     ServerIndex index_;
     IStorageArea& area_;
 
     bool compressionEnabled_;
+    CompressionType compressionType_;
+    uint8_t compressionLevel_;
     bool storeMD5_;
+    bool storeDicomAsJson_;
+
+    IngestStatistics ingestStatistics_;
+    std::auto_ptr<RunnableWorkersPool> storageWriters_;
+    unsigned int archiveThreads_;
     
     DicomCacheProvider provider_;
-    boost::mutex dicomCacheMutex_;
-    MemoryCache dicomCache_;
+    ConcurrentMemoryCache dicomCache_;
+    DicomAsJsonCacheProvider dicomAsJsonProvider_;
+    ConcurrentMemoryCache dicomAsJsonCache_;
+    PreviewCache previewCache_;
     ReusableDicomUserConnection scu_;
     ServerScheduler scheduler_;
 
@@ -127,6 +177,12 @@ namespace Orthanc
 
     ServerListeners listeners_;
     boost::recursive_mutex listenersMutex_;
+    size_t listenersQueueSize_;
+    ListenerOverflowPolicy listenersOverflowPolicy_;
+    unsigned int listenersBlockTimeout_;
+
+    boost::mutex dicomServerMutex_;
+    DicomServer* dicomServer_;
 
     bool done_;
     SharedMessageQueue  pendingChanges_;
@@ -137,19 +193,20 @@ namespace Orthanc
     OrthancHttpHandler  httpHandler_;
 
   public:
+    /**
+     * Exclusive access to the parsed DICOM file of one instance. Only
+     * the accesses to the same instance are serialized.
+     **/
     class DicomCacheLocker : public boost::noncopyable
     {
     private:
-      ServerContext& that_;
+      ConcurrentMemoryCache::Accessor accessor_;
       ParsedDicomFile *dicom_;
-      boost::mutex::scoped_lock lock_;
 
     public:
       DicomCacheLocker(ServerContext& that,
                        const std::string& instancePublicId);
 
-      ~DicomCacheLocker();
-
       ParsedDicomFile& GetDicom()
       {
         return *dicom_;
@@ -173,6 +230,31 @@ namespace Orthanc
       return compressionEnabled_;
     }
 
+    // Algorithm that is used if compression is enabled, either
+    // "CompressionType_ZlibWithSize" (the default) or
+    // "CompressionType_Lz4WithSize"
+    void SetCompressionType(CompressionType type);
+
+    CompressionType GetCompressionType() const
+    {
+      return compressionType_;
+    }
+
+    // Compression of the newly written attachments
+    CompressionType GetStorageCompression() const
+    {
+      return compressionEnabled_ ? compressionType_ : CompressionType_None;
+    }
+
+    // Between 1 (fastest) and 9 (smallest), 6 is the default of
+    // zlib. LZ4 has no level.
+    void SetCompressionLevel(uint8_t level);
+
+    uint8_t GetCompressionLevel() const
+    {
+      return compressionLevel_;
+    }
+
     void RemoveFile(const std::string& fileUuid,
                     FileContentType type);
 
@@ -184,17 +266,29 @@ namespace Orthanc
     StoreStatus Store(std::string& resultPublicId,
                       DicomInstanceToStore& dicom);
 
+    // "range" is the value of the "Range" HTTP header, if any
     void AnswerAttachment(RestApiOutput& output,
                           const std::string& resourceId,
-                          FileContentType content);
+                          FileContentType content,
+                          const std::string& range = "");
 
     void ChangeAttachmentCompression(const std::string& resourceId,
                                      FileContentType attachmentType,
                                      CompressionType compression);
 
+    // Uses the "DicomAsJson" attachment if available, otherwise
+    // converts the DICOM file (the result is cached in memory)
     void ReadJson(Json::Value& result,
                   const std::string& instancePublicId);
 
+    void AnswerDicomAsJson(RestApiOutput& output,
+                           const std::string& instancePublicId);
+
+    // Creates ("store == true") or removes ("store == false") the
+    // "DicomAsJson" attachment of one instance that is already stored
+    void ChangeDicomAsJsonStorage(const std::string& instancePublicId,
+                                  bool store);
+
     // TODO CACHING MECHANISM AT THIS POINT
     void ReadFile(std::string& result,
                   const std::string& instancePublicId,
@@ -211,6 +305,62 @@ namespace Orthanc
       return storeMD5_;
     }
 
+    // If "false", the "DicomAsJson" attachment is not written for the
+    // incoming instances, and is derived from the DICOM file on demand
+    void SetStoreDicomAsJson(bool store);
+
+    bool IsStoreDicomAsJson() const
+    {
+      return storeDicomAsJson_;
+    }
+
+    // "countThreads == 0" means that the attachments of the incoming
+    // instances are written sequentially by the calling thread
+    void SetStorageWriteThreads(unsigned int countThreads);
+
+    // Number of threads that read and uncompress the DICOM files in
+    // advance while creating ZIP archives and DICOMDIR media
+    void SetArchiveThreads(unsigned int countThreads);
+
+    unsigned int GetArchiveThreads() const
+    {
+      return archiveThreads_;
+    }
+
+    void SetDicomCacheSize(size_t size);   // In bytes
+
+    void FormatDicomCacheStatistics(Json::Value& target);
+
+    void SetDicomAsJsonCacheSize(size_t size);   // In bytes
+
+    void FormatDicomAsJsonCacheStatistics(Json::Value& target);
+
+    void FormatPreviewCacheStatistics(Json::Value& target);
+
+    // "queueSize == 0" means that the queues of the pending changes
+    // of the listeners are unbounded. "blockTimeout" is the maximum
+    // number of milliseconds to wait for room in a full queue.
+    void SetListenersQueue(size_t queueSize,
+                           ListenerOverflowPolicy policy,
+                           unsigned int blockTimeout);
+
+    void FormatListenersStatistics(Json::Value& target);
+
+    // "NULL" means that the DICOM server is not running
+    void SetDicomServer(DicomServer* server);
+
+    bool FormatDicomServerStatistics(Json::Value& target);
+
+    PreviewCache& GetPreviewCache()
+    {
+      return previewCache_;
+    }
+
+    IngestStatistics& GetIngestStatistics()
+    {
+      return ingestStatistics_;
+    }
+
     ReusableDicomUserConnection& GetReusableDicomUserConnection()
     {
       return scu_;
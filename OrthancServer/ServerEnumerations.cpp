@@ -64,9 +64,11 @@ namespace Orthanc
     dictMetadataType_.Add(MetadataType_AnonymizedFrom, "AnonymizedFrom");
     dictMetadataType_.Add(MetadataType_LastUpdate, "LastUpdate");
     dictMetadataType_.Add(MetadataType_Instance_Origin, "Origin");
+    dictMetadataType_.Add(MetadataType_Instance_SopClassUid, "SopClassUid");
 
     dictContentType_.Add(FileContentType_Dicom, "dicom");
     dictContentType_.Add(FileContentType_DicomAsJson, "dicom-as-json");
+    dictContentType_.Add(FileContentType_Preview, "preview");
   }
 
   void RegisterUserMetadata(int metadata,
@@ -428,6 +430,46 @@ namespace Orthanc
   }
 
 
+  const char* EnumerationToString(ListenerOverflowPolicy policy)
+  {
+    switch (policy)
+    {
+      case ListenerOverflowPolicy_Block:
+        return "Block";
+
+      case ListenerOverflowPolicy_Drop:
+        return "Drop";
+
+      case ListenerOverflowPolicy_Coalesce:
+        return "Coalesce";
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
+  ListenerOverflowPolicy StringToListenerOverflowPolicy(const std::string& policy)
+  {
+    if (policy == "Block")
+    {
+      return ListenerOverflowPolicy_Block;
+    }
+    else if (policy == "Drop")
+    {
+      return ListenerOverflowPolicy_Drop;
+    }
+    else if (policy == "Coalesce")
+    {
+      return ListenerOverflowPolicy_Coalesce;
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+  }
+
+
   const char* EnumerationToString(TransferSyntax syntax)
   {
     switch (syntax)
@@ -136,6 +136,13 @@ namespace Orthanc
     DicomFromJsonFlags_GenerateIdentifiers = (1 << 1)
   };
 
+  enum ListenerOverflowPolicy
+  {
+    ListenerOverflowPolicy_Block,     // Wait for the listener to make room
+    ListenerOverflowPolicy_Drop,      // Discard the oldest pending change
+    ListenerOverflowPolicy_Coalesce   // Merge with an identical pending change, otherwise wait
+  };
+
   enum IdentifierConstraintType
   {
     IdentifierConstraintType_Equal,
@@ -168,6 +175,7 @@ namespace Orthanc
     MetadataType_AnonymizedFrom = 6,
     MetadataType_LastUpdate = 7,
     MetadataType_Instance_Origin = 8,   // New in Orthanc 0.9.5
+    MetadataType_Instance_SopClassUid = 9,   // New in Orthanc mainline
 
     // Make sure that the value "65535" can be stored into this enumeration
     MetadataType_StartUser = 1024,
@@ -236,7 +244,11 @@ namespace Orthanc
 
   const char* EnumerationToString(TransferSyntax syntax);
 
+  const char* EnumerationToString(ListenerOverflowPolicy policy);
+
   ModalityManufacturer StringToModalityManufacturer(const std::string& manufacturer);
 
+  ListenerOverflowPolicy StringToListenerOverflowPolicy(const std::string& policy);
+
   bool IsUserMetadata(MetadataType type);
 }
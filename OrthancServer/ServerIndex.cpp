@@ -53,10 +53,15 @@
 #include "DicomInstanceToStore.h"
 
 #include <boost/lexical_cast.hpp>
+#include <limits>
 #include <stdio.h>
 
 static const uint64_t MEGA_BYTES = 1024 * 1024;
 
+// Number of resources that are expanded under one single lock of the
+// index, cf. "ServerIndex::ExpandResources()"
+static const size_t EXPAND_CHUNK_SIZE = 256;
+
 namespace Orthanc
 {
   class ServerIndex::Listener : public IDatabaseListener
@@ -92,11 +97,13 @@ namespace Orthanc
     std::list<FileToRemove> pendingFilesToRemove_;
     std::list<ServerIndexChange> pendingChanges_;
     uint64_t sizeOfFilesToRemove_;
+    uint64_t sizeOfAddedFiles_;
     bool insideTransaction_;
 
     void Reset()
     {
       sizeOfFilesToRemove_ = 0;
+      sizeOfAddedFiles_ = 0;
       hasRemainingLevel_ = false;
       pendingFilesToRemove_.clear();
       pendingChanges_.clear();
@@ -128,6 +135,18 @@ namespace Orthanc
       return sizeOfFilesToRemove_;
     }
 
+    // Keeps track of the files that are added by a transaction
+    // shared by several instances (group commit)
+    void SignalFilesAdded(uint64_t size)
+    {
+      sizeOfAddedFiles_ += size;
+    }
+
+    uint64_t GetSizeOfAddedFiles()
+    {
+      return sizeOfAddedFiles_;
+    }
+
     void CommitFilesToRemove()
     {
       for (std::list<FileToRemove>::const_iterator 
@@ -266,6 +285,152 @@ namespace Orthanc
   };
 
 
+  class ServerIndex::ReadLock : public boost::noncopyable
+  {
+  private:
+    ServerIndex& index_;
+    IDatabaseWrapper* reader_;
+    std::auto_ptr<boost::mutex::scoped_lock> exclusiveLock_;
+    std::auto_ptr<SQLite::ITransaction> transaction_;
+
+    void ReleaseReader()
+    {
+      boost::mutex::scoped_lock lock(index_.readersMutex_);
+      index_.availableReaders_.push_back(reader_);
+      index_.readerAvailable_.notify_one();
+    }
+
+  public:
+    explicit ReadLock(ServerIndex& index) : 
+      index_(index),
+      reader_(NULL)
+    {
+      {
+        boost::mutex::scoped_lock lock(index_.readersMutex_);
+
+        if (!index_.readers_.empty())
+        {
+          while (index_.availableReaders_.empty())
+          {
+            index_.readerAvailable_.wait(lock);
+          }
+
+          reader_ = index_.availableReaders_.back();
+          index_.availableReaders_.pop_back();
+        }
+      }
+
+      if (reader_ == NULL)
+      {
+        // No read-only connection: Serialize with the writers
+        exclusiveLock_.reset(new boost::mutex::scoped_lock(index_.mutex_));
+      }
+      else
+      {
+        try
+        {
+          // The read transaction provides a consistent snapshot of
+          // the database, even if the writer commits meanwhile
+          transaction_.reset(reader_->StartTransaction());
+          transaction_->Begin();
+        }
+        catch (...)
+        {
+          ReleaseReader();
+          throw;
+        }
+      }
+    }
+
+    ~ReadLock()
+    {
+      if (reader_ != NULL)
+      {
+        // Nothing was modified, so the transaction can be rolled
+        // back. No exception must escape from this destructor.
+        try
+        {
+          transaction_->Rollback();
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Cannot end a read-only transaction: " << e.What();
+        }
+        catch (...)
+        {
+          LOG(ERROR) << "Cannot end a read-only transaction";
+        }
+
+        transaction_.reset(NULL);
+        ReleaseReader();
+      }
+    }
+
+    IDatabaseWrapper& GetDatabase()
+    {
+      return (reader_ == NULL ? index_.db_ : *reader_);
+    }
+  };
+
+
+  class ServerIndex::PendingStore : public boost::noncopyable
+  {
+  private:
+    std::map<MetadataType, std::string>&  instanceMetadata_;
+    DicomInstanceToStore&                 instance_;
+    const Attachments&                    attachments_;
+    StoreStatus                           status_;
+    bool                                  done_;
+
+  public:
+    PendingStore(std::map<MetadataType, std::string>& instanceMetadata,
+                 DicomInstanceToStore& instance,
+                 const Attachments& attachments) :
+      instanceMetadata_(instanceMetadata),
+      instance_(instance),
+      attachments_(attachments),
+      status_(StoreStatus_Failure),
+      done_(false)
+    {
+    }
+
+    std::map<MetadataType, std::string>& GetInstanceMetadata()
+    {
+      return instanceMetadata_;
+    }
+
+    DicomInstanceToStore& GetInstance()
+    {
+      return instance_;
+    }
+
+    const Attachments& GetAttachments() const
+    {
+      return attachments_;
+    }
+
+    StoreStatus GetStatus() const
+    {
+      return status_;
+    }
+
+    void SetStatus(StoreStatus status)
+    {
+      status_ = status;
+    }
+
+    bool IsDone() const
+    {
+      return done_;
+    }
+
+    void SetDone()
+    {
+      done_ = true;
+    }
+  };
+
+
   class ServerIndex::UnstableResourcePayload
   {
   private:
@@ -430,11 +595,12 @@ namespace Orthanc
 
 
   bool ServerIndex::GetMetadataAsInteger(int64_t& result,
+                                         IDatabaseWrapper& db,
                                          int64_t id,
                                          MetadataType type)
   {
     std::string s;
-    if (!db_.LookupMetadata(s, id, type))
+    if (!db.LookupMetadata(s, id, type))
     {
       return false;
     }
@@ -540,7 +706,10 @@ namespace Orthanc
     done_(false),
     db_(db),
     maximumStorageSize_(0),
-    maximumPatients_(0)
+    maximumPatients_(0),
+    hasGroupLeader_(false),
+    groupCommitSize_(1),
+    groupCommitDelay_(0)
   {
     listener_.reset(new Listener(context));
     db_.SetListener(*listener_);
@@ -568,6 +737,9 @@ namespace Orthanc
       LOG(ERROR) << "INTERNAL ERROR: ServerIndex::Stop() should be invoked manually to avoid mess in the destruction order!";
       Stop();
     }
+
+    boost::mutex::scoped_lock lock(readersMutex_);
+    CloseReadConnections();
   }
 
 
@@ -593,229 +765,477 @@ namespace Orthanc
 
 
 
-  StoreStatus ServerIndex::Store(std::map<MetadataType, std::string>& instanceMetadata,
-                                 DicomInstanceToStore& instanceToStore,
-                                 const Attachments& attachments)
+  StoreStatus ServerIndex::StoreInternal(uint64_t& instanceSize,
+                                         std::map<MetadataType, std::string>& instanceMetadata,
+                                         DicomInstanceToStore& instanceToStore,
+                                         const Attachments& attachments)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    // WARNING: Before calling this method, "mutex_" must be locked
+    // and a transaction must be active. An exception is thrown on
+    // failure, in which case the transaction must be rolled back.
 
     const DicomMap& dicomSummary = instanceToStore.GetSummary();
     const ServerIndex::MetadataMap& metadata = instanceToStore.GetMetadata();
 
     instanceMetadata.clear();
+    instanceSize = 0;
 
     DicomInstanceHasher hasher(instanceToStore.GetSummary());
 
-    try
+    // Do nothing if the instance already exists
     {
-      Transaction t(*this);
-
-      // Do nothing if the instance already exists
+      ResourceType type;
+      int64_t tmp;
+      if (db_.LookupResource(tmp, type, hasher.HashInstance()))
       {
-        ResourceType type;
-        int64_t tmp;
-        if (db_.LookupResource(tmp, type, hasher.HashInstance()))
-        {
-          assert(type == ResourceType_Instance);
-          db_.GetAllMetadata(instanceMetadata, tmp);
-          return StoreStatus_AlreadyStored;
-        }
-      }
-
-      // Ensure there is enough room in the storage for the new instance
-      uint64_t instanceSize = 0;
-      for (Attachments::const_iterator it = attachments.begin();
-           it != attachments.end(); ++it)
-      {
-        instanceSize += it->GetCompressedSize();
+        assert(type == ResourceType_Instance);
+        db_.GetAllMetadata(instanceMetadata, tmp);
+        return StoreStatus_AlreadyStored;
       }
+    }
 
-      Recycle(instanceSize, hasher.HashPatient());
+    // Ensure there is enough room in the storage for the new instance
+    for (Attachments::const_iterator it = attachments.begin();
+         it != attachments.end(); ++it)
+    {
+      instanceSize += it->GetCompressedSize();
+    }
 
-      // Create the instance
-      int64_t instance = CreateResource(hasher.HashInstance(), ResourceType_Instance);
-      Toolbox::SetMainDicomTags(db_, instance, ResourceType_Instance, dicomSummary);
+    Recycle(instanceSize, hasher.HashPatient());
 
-      // Detect up to which level the patient/study/series/instance
-      // hierarchy must be created
-      int64_t patient = -1, study = -1, series = -1;
-      bool isNewPatient = false;
-      bool isNewStudy = false;
-      bool isNewSeries = false;
+    // Create the instance
+    int64_t instance = CreateResource(hasher.HashInstance(), ResourceType_Instance);
+    Toolbox::SetMainDicomTags(db_, instance, ResourceType_Instance, dicomSummary);
 
-      {
-        ResourceType dummy;
+    // Detect up to which level the patient/study/series/instance
+    // hierarchy must be created
+    int64_t patient = -1, study = -1, series = -1;
+    bool isNewPatient = false;
+    bool isNewStudy = false;
+    bool isNewSeries = false;
 
-        if (db_.LookupResource(series, dummy, hasher.HashSeries()))
-        {
-          assert(dummy == ResourceType_Series);
-          // The patient, the study and the series already exist
+    {
+      ResourceType dummy;
 
-          bool ok = (db_.LookupResource(patient, dummy, hasher.HashPatient()) &&
-                     db_.LookupResource(study, dummy, hasher.HashStudy()));
-          assert(ok);
-        }
-        else if (db_.LookupResource(study, dummy, hasher.HashStudy()))
-        {
-          assert(dummy == ResourceType_Study);
+      if (db_.LookupResource(series, dummy, hasher.HashSeries()))
+      {
+        assert(dummy == ResourceType_Series);
+        // The patient, the study and the series already exist
 
-          // New series: The patient and the study already exist
-          isNewSeries = true;
+        bool ok = (db_.LookupResource(patient, dummy, hasher.HashPatient()) &&
+                   db_.LookupResource(study, dummy, hasher.HashStudy()));
+        assert(ok);
+      }
+      else if (db_.LookupResource(study, dummy, hasher.HashStudy()))
+      {
+        assert(dummy == ResourceType_Study);
 
-          bool ok = db_.LookupResource(patient, dummy, hasher.HashPatient());
-          assert(ok);
-        }
-        else if (db_.LookupResource(patient, dummy, hasher.HashPatient()))
-        {
-          assert(dummy == ResourceType_Patient);
+        // New series: The patient and the study already exist
+        isNewSeries = true;
 
-          // New study and series: The patient already exist
-          isNewStudy = true;
-          isNewSeries = true;
-        }
-        else
-        {
-          // New patient, study and series: Nothing exists
-          isNewPatient = true;
-          isNewStudy = true;
-          isNewSeries = true;
-        }
+        bool ok = db_.LookupResource(patient, dummy, hasher.HashPatient());
+        assert(ok);
       }
-
-      // Create the series if needed
-      if (isNewSeries)
+      else if (db_.LookupResource(patient, dummy, hasher.HashPatient()))
       {
-        series = CreateResource(hasher.HashSeries(), ResourceType_Series);
-        Toolbox::SetMainDicomTags(db_, series, ResourceType_Series, dicomSummary);
-      }
+        assert(dummy == ResourceType_Patient);
 
-      // Create the study if needed
-      if (isNewStudy)
+        // New study and series: The patient already exist
+        isNewStudy = true;
+        isNewSeries = true;
+      }
+      else
       {
-        study = CreateResource(hasher.HashStudy(), ResourceType_Study);
-        Toolbox::SetMainDicomTags(db_, study, ResourceType_Study, dicomSummary);
+        // New patient, study and series: Nothing exists
+        isNewPatient = true;
+        isNewStudy = true;
+        isNewSeries = true;
       }
+    }
+
+    // Create the series if needed
+    if (isNewSeries)
+    {
+      series = CreateResource(hasher.HashSeries(), ResourceType_Series);
+      Toolbox::SetMainDicomTags(db_, series, ResourceType_Series, dicomSummary);
+    }
+
+    // Create the study if needed
+    if (isNewStudy)
+    {
+      study = CreateResource(hasher.HashStudy(), ResourceType_Study);
+      Toolbox::SetMainDicomTags(db_, study, ResourceType_Study, dicomSummary);
+    }
+
+    // Create the patient if needed
+    if (isNewPatient)
+    {
+      patient = CreateResource(hasher.HashPatient(), ResourceType_Patient);
+      Toolbox::SetMainDicomTags(db_, patient, ResourceType_Patient, dicomSummary);
+    }
+
+    // Create the parent-to-child links
+    db_.AttachChild(series, instance);
+
+    if (isNewSeries)
+    {
+      db_.AttachChild(study, series);
+    }
+
+    if (isNewStudy)
+    {
+      db_.AttachChild(patient, study);
+    }
 
-      // Create the patient if needed
-      if (isNewPatient)
+    // Sanity checks
+    assert(patient != -1);
+    assert(study != -1);
+    assert(series != -1);
+    assert(instance != -1);
+
+    // Attach the files to the newly created instance
+    for (Attachments::const_iterator it = attachments.begin();
+         it != attachments.end(); ++it)
+    {
+      db_.AddAttachment(instance, *it);
+    }
+
+    // Attach the user-specified metadata
+    for (MetadataMap::const_iterator 
+           it = metadata.begin(); it != metadata.end(); ++it)
+    {
+      switch (it->first.first)
       {
-        patient = CreateResource(hasher.HashPatient(), ResourceType_Patient);
-        Toolbox::SetMainDicomTags(db_, patient, ResourceType_Patient, dicomSummary);
+        case ResourceType_Patient:
+          db_.SetMetadata(patient, it->first.second, it->second);
+          break;
+
+        case ResourceType_Study:
+          db_.SetMetadata(study, it->first.second, it->second);
+          break;
+
+        case ResourceType_Series:
+          db_.SetMetadata(series, it->first.second, it->second);
+          break;
+
+        case ResourceType_Instance:
+          db_.SetMetadata(instance, it->first.second, it->second);
+          instanceMetadata[it->first.second] = it->second;
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
       }
+    }
+
+    // Attach the auto-computed metadata for the patient/study/series levels
+    std::string now = Toolbox::GetNowIsoString();
+    db_.SetMetadata(series, MetadataType_LastUpdate, now);
+    db_.SetMetadata(study, MetadataType_LastUpdate, now);
+    db_.SetMetadata(patient, MetadataType_LastUpdate, now);
 
-      // Create the parent-to-child links
-      db_.AttachChild(series, instance);
+    // Attach the auto-computed metadata for the instance level,
+    // reflecting these additions into the input metadata map
+    db_.SetMetadata(instance, MetadataType_Instance_ReceptionDate, now);
+    instanceMetadata[MetadataType_Instance_ReceptionDate] = now;
+
+    db_.SetMetadata(instance, MetadataType_Instance_RemoteAet, instanceToStore.GetRemoteAet());
+    instanceMetadata[MetadataType_Instance_RemoteAet] = instanceToStore.GetRemoteAet();
+
+    {
+      std::string s = EnumerationToString(instanceToStore.GetRequestOrigin());
+      db_.SetMetadata(instance, MetadataType_Instance_Origin, s);
+      instanceMetadata[MetadataType_Instance_Origin] = s;
+    }
+
+    const DicomValue* value;
+    if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_SOP_CLASS_UID)) != NULL &&
+        !value->IsNull() &&
+        !value->IsBinary())
+    {
+      // Cached to answer "SOPClassesInStudy" without reading the DICOM file
+      db_.SetMetadata(instance, MetadataType_Instance_SopClassUid, value->GetContent());
+      instanceMetadata[MetadataType_Instance_SopClassUid] = value->GetContent();
+    }
 
-      if (isNewSeries)
+    if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_INSTANCE_NUMBER)) != NULL ||
+        (value = dicomSummary.TestAndGetValue(DICOM_TAG_IMAGE_INDEX)) != NULL)
+    {
+      if (!value->IsNull() && 
+          !value->IsBinary())
       {
-        db_.AttachChild(study, series);
+        db_.SetMetadata(instance, MetadataType_Instance_IndexInSeries, value->GetContent());
+        instanceMetadata[MetadataType_Instance_IndexInSeries] = value->GetContent();
       }
+    }
+
+    // Check whether the series of this new instance is now completed
+    if (isNewSeries)
+    {
+      ComputeExpectedNumberOfInstances(db_, series, dicomSummary);
+    }
+
+    SeriesStatus seriesStatus = GetSeriesStatus(db_, series);
+    if (seriesStatus == SeriesStatus_Complete)
+    {
+      LogChange(series, ChangeType_CompletedSeries, ResourceType_Series, hasher.HashSeries());
+    }
+
+    // Mark the parent resources of this instance as unstable
+    MarkAsUnstable(series, ResourceType_Series, hasher.HashSeries());
+    MarkAsUnstable(study, ResourceType_Study, hasher.HashStudy());
+    MarkAsUnstable(patient, ResourceType_Patient, hasher.HashPatient());
+
+    listener_->SignalFilesAdded(instanceSize);
+
+    return StoreStatus_Success;
+  }
+
 
-      if (isNewStudy)
+  StoreStatus ServerIndex::StoreSingle(std::map<MetadataType, std::string>& instanceMetadata,
+                                       DicomInstanceToStore& instanceToStore,
+                                       const Attachments& attachments)
+  {
+    // WARNING: Before calling this method, "mutex_" must be locked
+
+    try
+    {
+      Transaction t(*this);
+
+      uint64_t instanceSize;
+      StoreStatus status = StoreInternal(instanceSize, instanceMetadata, instanceToStore, attachments);
+
+      if (status == StoreStatus_Success)
       {
-        db_.AttachChild(patient, study);
+        t.Commit(instanceSize);
       }
 
-      // Sanity checks
-      assert(patient != -1);
-      assert(study != -1);
-      assert(series != -1);
-      assert(instance != -1);
+      return status;
+    }
+    catch (OrthancException& e)
+    {
+      LOG(ERROR) << "EXCEPTION [" << e.What() << "]";
+    }
 
-      // Attach the files to the newly created instance
-      for (Attachments::const_iterator it = attachments.begin();
-           it != attachments.end(); ++it)
+    return StoreStatus_Failure;
+  }
+
+
+  void ServerIndex::StoreGroup(const std::vector<PendingStore*>& group)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (group.size() == 1)
+    {
+      PendingStore& item = *group.front();
+      item.SetStatus(StoreSingle(item.GetInstanceMetadata(), item.GetInstance(), item.GetAttachments()));
+      return;
+    }
+
+    try
+    {
+      Transaction t(*this);
+
+      uint64_t totalSize = 0;
+
+      for (size_t i = 0; i < group.size(); i++)
       {
-        db_.AddAttachment(instance, *it);
+        uint64_t instanceSize;
+        group[i]->SetStatus(StoreInternal(instanceSize, group[i]->GetInstanceMetadata(),
+                                          group[i]->GetInstance(), group[i]->GetAttachments()));
+        totalSize += instanceSize;
       }
 
-      // Attach the user-specified metadata
-      for (MetadataMap::const_iterator 
-             it = metadata.begin(); it != metadata.end(); ++it)
-      {
-        switch (it->first.first)
-        {
-          case ResourceType_Patient:
-            db_.SetMetadata(patient, it->first.second, it->second);
-            break;
+      t.Commit(totalSize);
 
-          case ResourceType_Study:
-            db_.SetMetadata(study, it->first.second, it->second);
-            break;
+      VLOG(1) << "Group commit of " << group.size() << " instances";
+      return;
+    }
+    catch (OrthancException& e)
+    {
+      LOG(WARNING) << "Error during the group commit of " << group.size() 
+                   << " instances, storing them one by one: " << e.What();
+    }
 
-          case ResourceType_Series:
-            db_.SetMetadata(series, it->first.second, it->second);
-            break;
+    // The shared transaction has been rolled back: Isolate the
+    // faulty instance(s) by using one transaction per instance
+    for (size_t i = 0; i < group.size(); i++)
+    {
+      PendingStore& item = *group[i];
+      item.SetStatus(StoreSingle(item.GetInstanceMetadata(), item.GetInstance(), item.GetAttachments()));
+    }
+  }
 
-          case ResourceType_Instance:
-            db_.SetMetadata(instance, it->first.second, it->second);
-            instanceMetadata[it->first.second] = it->second;
-            break;
 
-          default:
-            throw OrthancException(ErrorCode_ParameterOutOfRange);
-        }
-      }
+  StoreStatus ServerIndex::Store(std::map<MetadataType, std::string>& instanceMetadata,
+                                 DicomInstanceToStore& instanceToStore,
+                                 const Attachments& attachments)
+  {
+    boost::mutex::scoped_lock lock(groupMutex_);
+
+    if (groupCommitSize_ <= 1)
+    {
+      // Group commit is disabled, no need to keep "groupMutex_"
+      lock.unlock();
 
-      // Attach the auto-computed metadata for the patient/study/series levels
-      std::string now = Toolbox::GetNowIsoString();
-      db_.SetMetadata(series, MetadataType_LastUpdate, now);
-      db_.SetMetadata(study, MetadataType_LastUpdate, now);
-      db_.SetMetadata(patient, MetadataType_LastUpdate, now);
+      boost::mutex::scoped_lock indexLock(mutex_);
+      return StoreSingle(instanceMetadata, instanceToStore, attachments);
+    }
 
-      // Attach the auto-computed metadata for the instance level,
-      // reflecting these additions into the input metadata map
-      db_.SetMetadata(instance, MetadataType_Instance_ReceptionDate, now);
-      instanceMetadata[MetadataType_Instance_ReceptionDate] = now;
+    PendingStore request(instanceMetadata, instanceToStore, attachments);
 
-      db_.SetMetadata(instance, MetadataType_Instance_RemoteAet, instanceToStore.GetRemoteAet());
-      instanceMetadata[MetadataType_Instance_RemoteAet] = instanceToStore.GetRemoteAet();
+    groupQueue_.push_back(&request);
+    groupArrival_.notify_one();
 
+    while (!request.IsDone())
+    {
+      if (hasGroupLeader_)
       {
-        std::string s = EnumerationToString(instanceToStore.GetRequestOrigin());
-        db_.SetMetadata(instance, MetadataType_Instance_Origin, s);
-        instanceMetadata[MetadataType_Instance_Origin] = s;
+        // Another thread is committing a group, wait for it to finish
+        groupCompleted_.wait(lock);
+        continue;
       }
 
-      const DicomValue* value;
-      if ((value = dicomSummary.TestAndGetValue(DICOM_TAG_INSTANCE_NUMBER)) != NULL ||
-          (value = dicomSummary.TestAndGetValue(DICOM_TAG_IMAGE_INDEX)) != NULL)
+      // This thread becomes the leader of the next group: Give the
+      // concurrent callers a chance to join the group
+      hasGroupLeader_ = true;
+
+      if (groupCommitDelay_ > 0)
       {
-        if (!value->IsNull() && 
-            !value->IsBinary())
+        boost::system_time timeout = (boost::get_system_time() + 
+                                      boost::posix_time::milliseconds(groupCommitDelay_));
+
+        while (groupQueue_.size() < groupCommitSize_ &&
+               groupArrival_.timed_wait(lock, timeout))
         {
-          db_.SetMetadata(instance, MetadataType_Instance_IndexInSeries, value->GetContent());
-          instanceMetadata[MetadataType_Instance_IndexInSeries] = value->GetContent();
         }
       }
 
-      // Check whether the series of this new instance is now completed
-      if (isNewSeries)
+      std::vector<PendingStore*> group;
+      group.reserve(groupCommitSize_);
+
+      while (!groupQueue_.empty() &&
+             group.size() < groupCommitSize_)
       {
-        ComputeExpectedNumberOfInstances(db_, series, dicomSummary);
+        group.push_back(groupQueue_.front());
+        groupQueue_.pop_front();
       }
 
-      SeriesStatus seriesStatus = GetSeriesStatus(series);
-      if (seriesStatus == SeriesStatus_Complete)
+      lock.unlock();
+
+      try
+      {
+        StoreGroup(group);
+      }
+      catch (...)
       {
-        LogChange(series, ChangeType_CompletedSeries, ResourceType_Series, hasher.HashSeries());
+        LOG(ERROR) << "Unexpected error during the group commit of " << group.size() << " instances";
       }
 
-      // Mark the parent resources of this instance as unstable
-      MarkAsUnstable(series, ResourceType_Series, hasher.HashSeries());
-      MarkAsUnstable(study, ResourceType_Study, hasher.HashStudy());
-      MarkAsUnstable(patient, ResourceType_Patient, hasher.HashPatient());
+      lock.lock();
 
-      t.Commit(instanceSize);
+      for (size_t i = 0; i < group.size(); i++)
+      {
+        group[i]->SetDone();
+      }
 
-      return StoreStatus_Success;
+      hasGroupLeader_ = false;
+      groupCompleted_.notify_all();
     }
-    catch (OrthancException& e)
+
+    return request.GetStatus();
+  }
+
+
+  void ServerIndex::SetGroupCommit(unsigned int maxSize,
+                                   unsigned int delay)
+  {
+    boost::mutex::scoped_lock lock(groupMutex_);
+
+    if (maxSize <= 1)
     {
-      LOG(ERROR) << "EXCEPTION [" << e.What() << "]";
+      LOG(WARNING) << "Group commit of the incoming instances is disabled";
+      groupCommitSize_ = 1;
+      groupCommitDelay_ = 0;
     }
+    else
+    {
+      LOG(WARNING) << "Group commit of at most " << maxSize << " incoming instances (delay: "
+                   << delay << "ms)";
+      groupCommitSize_ = maxSize;
+      groupCommitDelay_ = delay;
+    }
+  }
 
-    return StoreStatus_Failure;
+
+  unsigned int ServerIndex::GetGroupCommitSize()
+  {
+    boost::mutex::scoped_lock lock(groupMutex_);
+    return groupCommitSize_;
+  }
+
+
+
+
+  void ServerIndex::CloseReadConnections()
+  {
+    // WARNING: Before calling this method, "readersMutex_" must be
+    // locked, and no read-only connection can be in use
+
+    assert(availableReaders_.size() == readers_.size());
+
+    for (size_t i = 0; i < readers_.size(); i++)
+    {
+      assert(readers_[i] != NULL);
+      readers_[i]->Close();
+      delete readers_[i];
+    }
+
+    readers_.clear();
+    availableReaders_.clear();
+  }
+
+
+  bool ServerIndex::SetReadConnections(unsigned int count)
+  {
+    boost::mutex::scoped_lock lock(readersMutex_);
+
+    if (availableReaders_.size() != readers_.size())
+    {
+      // Some read-only connection is in use
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    CloseReadConnections();
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+      IDatabaseWrapper* reader = db_.OpenReadOnlyConnection();
+      if (reader == NULL)
+      {
+        LOG(WARNING) << "The database back-end does not support read-only connections, "
+                     << "all the accesses to the index will be serialized";
+        CloseReadConnections();
+        return false;
+      }
+
+      readers_.push_back(reader);
+      availableReaders_.push_back(reader);
+    }
+
+    if (count > 0)
+    {
+      LOG(WARNING) << "Number of read-only connections to the database: " << count;
+    }
+
+    return true;
+  }
+
+
+  unsigned int ServerIndex::GetReadConnectionsCount()
+  {
+    boost::mutex::scoped_lock lock(readersMutex_);
+    return readers_.size();
   }
 
 
@@ -840,43 +1260,27 @@ namespace Orthanc
 
 
 
-  SeriesStatus ServerIndex::GetSeriesStatus(int64_t id)
+  // "indexes" contains the "IndexInSeries" metadata of all the
+  // instances of the series
+  static SeriesStatus ComputeSeriesStatus(int64_t expected,
+                                          const std::vector<int64_t>& indexes)
   {
-    // Get the expected number of instances in this series (from the metadata)
-    int64_t expected;
-    if (!GetMetadataAsInteger(expected, id, MetadataType_Series_ExpectedNumberOfInstances))
-    {
-      return SeriesStatus_Unknown;
-    }
-
-    // Loop over the instances of this series
-    std::list<int64_t> children;
-    db_.GetChildrenInternalId(children, id);
-
     std::set<int64_t> instances;
-    for (std::list<int64_t>::const_iterator 
-           it = children.begin(); it != children.end(); ++it)
+    for (size_t i = 0; i < indexes.size(); i++)
     {
-      // Get the index of this instance in the series
-      int64_t index;
-      if (!GetMetadataAsInteger(index, *it, MetadataType_Instance_IndexInSeries))
-      {
-        return SeriesStatus_Unknown;
-      }
-
-      if (!(index > 0 && index <= expected))
+      if (!(indexes[i] > 0 && indexes[i] <= expected))
       {
         // Out-of-range instance index
         return SeriesStatus_Inconsistent;
       }
 
-      if (instances.find(index) != instances.end())
+      if (instances.find(indexes[i]) != instances.end())
       {
         // Twice the same instance index
         return SeriesStatus_Inconsistent;
       }
 
-      instances.insert(index);
+      instances.insert(indexes[i]);
     }
 
     if (static_cast<int64_t>(instances.size()) == expected)
@@ -890,13 +1294,67 @@ namespace Orthanc
   }
 
 
+  static bool LookupIntegerMetadata(int64_t& result,
+                                    const std::map<MetadataType, std::string>& metadata,
+                                    MetadataType type)
+  {
+    std::map<MetadataType, std::string>::const_iterator found = metadata.find(type);
+
+    if (found == metadata.end())
+    {
+      return false;
+    }
+
+    try
+    {
+      result = boost::lexical_cast<int64_t>(found->second);
+      return true;
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      return false;
+    }
+  }
+
+
+  SeriesStatus ServerIndex::GetSeriesStatus(IDatabaseWrapper& db,
+                                            int64_t id)
+  {
+    // Get the expected number of instances in this series (from the metadata)
+    int64_t expected;
+    if (!GetMetadataAsInteger(expected, db, id, MetadataType_Series_ExpectedNumberOfInstances))
+    {
+      return SeriesStatus_Unknown;
+    }
+
+    // Loop over the instances of this series
+    std::list<int64_t> children;
+    db.GetChildrenInternalId(children, id);
+
+    std::vector<int64_t> indexes;
+    indexes.reserve(children.size());
+
+    for (std::list<int64_t>::const_iterator 
+           it = children.begin(); it != children.end(); ++it)
+    {
+      // Get the index of this instance in the series
+      int64_t index;
+      if (!GetMetadataAsInteger(index, db, *it, MetadataType_Instance_IndexInSeries))
+      {
+        return SeriesStatus_Unknown;
+      }
+
+      indexes.push_back(index);
+    }
+
+    return ComputeSeriesStatus(expected, indexes);
+  }
+
+
   void ServerIndex::MainDicomTagsToJson(Json::Value& target,
-                                        int64_t resourceId,
+                                        const DicomMap& tags,
                                         ResourceType resourceType)
   {
-    DicomMap tags;
-    db_.GetMainDicomTags(tags, resourceId);
-
     if (resourceType == ResourceType_Study)
     {
       DicomMap t1, t2;
@@ -916,163 +1374,440 @@ namespace Orthanc
     }
   }
 
+
   bool ServerIndex::LookupResource(Json::Value& result,
                                    const std::string& publicId,
                                    ResourceType expectedType)
   {
-    result = Json::objectValue;
+    std::vector<std::string> resources(1, publicId);
 
-    boost::mutex::scoped_lock lock(mutex_);
+    Json::Value expanded = Json::arrayValue;
+    ExpandResourcesInternal(expanded, resources, expectedType);
 
-    // Lookup for the requested resource
-    int64_t id;
-    ResourceType type;
-    if (!db_.LookupResource(id, type, publicId) ||
-        type != expectedType)
+    if (expanded.size() == 1)
+    {
+      result = expanded[0];
+      return true;
+    }
+    else
+    {
+      result = Json::objectValue;
+      return false;
+    }
+  }
+
+
+  void ServerIndex::ExpandResources(Json::Value& target,
+                                    const std::list<std::string>& publicIds,
+                                    ResourceType level)
+  {
+    target = Json::arrayValue;
+
+    // The lock is released between the chunks, so that the writers
+    // are not starved while expanding long lists of resources
+    std::vector<std::string> chunk;
+    chunk.reserve(EXPAND_CHUNK_SIZE);
+
+    for (std::list<std::string>::const_iterator
+           it = publicIds.begin(); it != publicIds.end(); ++it)
+    {
+      chunk.push_back(*it);
+
+      if (chunk.size() == EXPAND_CHUNK_SIZE)
+      {
+        ExpandResourcesInternal(target, chunk, level);
+        chunk.clear();
+      }
+    }
+
+    if (!chunk.empty())
+    {
+      ExpandResourcesInternal(target, chunk, level);
+    }
+  }
+
+
+  void ServerIndex::ExpandResourcesInternal(Json::Value& target,
+                                            const std::vector<std::string>& publicIds,
+                                            ResourceType level)
+  {
+    assert(target.type() == Json::arrayValue);
+
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
+
+    std::map<std::string, int64_t> found;
+    db.LookupResources(found, level, publicIds);
+
+    if (found.empty())
+    {
+      return;
+    }
+
+    // The bulk queries of the database require distinct identifiers
+    std::vector<int64_t> ids;
+    ids.reserve(found.size());
+
+    for (std::map<std::string, int64_t>::const_iterator
+           it = found.begin(); it != found.end(); ++it)
+    {
+      ids.push_back(it->second);
+    }
+
+    std::map<int64_t, std::string> parents;
+    if (level != ResourceType_Patient)
+    {
+      db.LookupParentsPublicId(parents, ids);
+    }
+
+    typedef std::map<int64_t, std::list<std::pair<int64_t, std::string> > >  Children;
+
+    Children children;
+    if (level != ResourceType_Instance)
+    {
+      db.GetChildren(children, ids);
+    }
+
+    std::map<int64_t, std::map<MetadataType, std::string> >  metadata;
+    db.GetAllMetadata(metadata, ids);
+
+    std::map<int64_t, FileInfo> attachments;
+    if (level == ResourceType_Instance)
+    {
+      db.LookupAttachments(attachments, FileContentType_Dicom, ids);
+    }
+
+    std::map<int64_t, SeriesStatus> seriesStatus;
+    if (level == ResourceType_Series)
+    {
+      // Only the series with an expected number of instances have a
+      // known status: Gather the indexes of their instances at once
+      std::map<int64_t, int64_t> expected;
+      std::vector<int64_t> instances;
+
+      for (size_t i = 0; i < ids.size(); i++)
+      {
+        int64_t value;
+        if (LookupIntegerMetadata(value, metadata[ids[i]], MetadataType_Series_ExpectedNumberOfInstances))
+        {
+          expected[ids[i]] = value;
+
+          const std::list<std::pair<int64_t, std::string> >& c = children[ids[i]];
+          for (std::list<std::pair<int64_t, std::string> >::const_iterator
+                 it = c.begin(); it != c.end(); ++it)
+          {
+            instances.push_back(it->first);
+          }
+        }
+        else
+        {
+          seriesStatus[ids[i]] = SeriesStatus_Unknown;
+        }
+      }
+
+      std::map<int64_t, std::map<MetadataType, std::string> >  instancesMetadata;
+      if (!instances.empty())
+      {
+        db.GetAllMetadata(instancesMetadata, instances);
+      }
+
+      for (std::map<int64_t, int64_t>::const_iterator 
+             it = expected.begin(); it != expected.end(); ++it)
+      {
+        const std::list<std::pair<int64_t, std::string> >& c = children[it->first];
+
+        std::vector<int64_t> indexes;
+        indexes.reserve(c.size());
+
+        SeriesStatus status = SeriesStatus_Unknown;
+        bool hasAllIndexes = true;
+
+        for (std::list<std::pair<int64_t, std::string> >::const_iterator
+               child = c.begin(); child != c.end() && hasAllIndexes; ++child)
+        {
+          int64_t index;
+          if (LookupIntegerMetadata(index, instancesMetadata[child->first], MetadataType_Instance_IndexInSeries))
+          {
+            indexes.push_back(index);
+          }
+          else
+          {
+            hasAllIndexes = false;
+          }
+        }
+
+        if (hasAllIndexes)
+        {
+          status = ComputeSeriesStatus(it->second, indexes);
+        }
+
+        seriesStatus[it->first] = status;
+      }
+    }
+
+    std::vector<DicomMap*> tags(ids.size());
+    for (size_t i = 0; i < ids.size(); i++)
     {
-      return false;
+      tags[i] = new DicomMap;
     }
 
-    // Find the parent resource (if it exists)
-    if (type != ResourceType_Patient)
+    try
     {
-      int64_t parentId;
-      if (!db_.LookupParent(parentId, id))
+      db.GetMainDicomTags(tags, ids);
+
+      std::map<int64_t, const DicomMap*> tagsIndex;
+      for (size_t i = 0; i < ids.size(); i++)
       {
-        throw OrthancException(ErrorCode_InternalError);
+        tagsIndex[ids[i]] = tags[i];
       }
 
-      std::string parent = db_.GetPublicId(parentId);
+      std::set<int64_t> unstable;
+      if (level != ResourceType_Instance)
+      {
+        boost::mutex::scoped_lock unstableLock(unstableResourcesMutex_);
+
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+          if (unstableResources_.Contains(ids[i]))
+          {
+            unstable.insert(ids[i]);
+          }
+        }
+      }
 
-      switch (type)
+      // Format the resources, in the order of the request
+      for (size_t i = 0; i < publicIds.size(); i++)
       {
-        case ResourceType_Study:
-          result["ParentPatient"] = parent;
-          break;
+        std::map<std::string, int64_t>::const_iterator resource = found.find(publicIds[i]);
+        if (resource == found.end())
+        {
+          continue;
+        }
 
-        case ResourceType_Series:
-          result["ParentStudy"] = parent;
-          break;
+        const int64_t id = resource->second;
+        const std::map<MetadataType, std::string>& m = metadata[id];
 
-        case ResourceType_Instance:
-          result["ParentSeries"] = parent;
-          break;
+        Json::Value result = Json::objectValue;
 
-        default:
-          throw OrthancException(ErrorCode_InternalError);
-      }
-    }
+        // Set the parent resource (if it exists)
+        if (level != ResourceType_Patient)
+        {
+          std::map<int64_t, std::string>::const_iterator parent = parents.find(id);
+          if (parent == parents.end())
+          {
+            throw OrthancException(ErrorCode_InternalError);
+          }
 
-    // List the children resources
-    std::list<std::string> children;
-    db_.GetChildrenPublicId(children, id);
+          switch (level)
+          {
+            case ResourceType_Study:
+              result["ParentPatient"] = parent->second;
+              break;
 
-    if (type != ResourceType_Instance)
-    {
-      Json::Value c = Json::arrayValue;
+            case ResourceType_Series:
+              result["ParentStudy"] = parent->second;
+              break;
 
-      for (std::list<std::string>::const_iterator
-             it = children.begin(); it != children.end(); ++it)
-      {
-        c.append(*it);
-      }
+            case ResourceType_Instance:
+              result["ParentSeries"] = parent->second;
+              break;
 
-      switch (type)
-      {
-        case ResourceType_Patient:
-          result["Studies"] = c;
-          break;
+            default:
+              throw OrthancException(ErrorCode_InternalError);
+          }
+        }
 
-        case ResourceType_Study:
-          result["Series"] = c;
-          break;
+        // List the children resources
+        if (level != ResourceType_Instance)
+        {
+          Json::Value c = Json::arrayValue;
 
-        case ResourceType_Series:
-          result["Instances"] = c;
-          break;
+          const std::list<std::pair<int64_t, std::string> >& tmp = children[id];
+          for (std::list<std::pair<int64_t, std::string> >::const_iterator
+                 it = tmp.begin(); it != tmp.end(); ++it)
+          {
+            c.append(it->second);
+          }
 
-        default:
-          throw OrthancException(ErrorCode_InternalError);
-      }
-    }
+          switch (level)
+          {
+            case ResourceType_Patient:
+              result["Studies"] = c;
+              break;
 
-    // Set the resource type
-    switch (type)
-    {
-      case ResourceType_Patient:
-        result["Type"] = "Patient";
-        break;
+            case ResourceType_Study:
+              result["Series"] = c;
+              break;
 
-      case ResourceType_Study:
-        result["Type"] = "Study";
-        break;
+            case ResourceType_Series:
+              result["Instances"] = c;
+              break;
 
-      case ResourceType_Series:
-      {
-        result["Type"] = "Series";
-        result["Status"] = EnumerationToString(GetSeriesStatus(id));
+            default:
+              throw OrthancException(ErrorCode_InternalError);
+          }
+        }
 
-        int64_t i;
-        if (GetMetadataAsInteger(i, id, MetadataType_Series_ExpectedNumberOfInstances))
-          result["ExpectedNumberOfInstances"] = static_cast<int>(i);
-        else
-          result["ExpectedNumberOfInstances"] = Json::nullValue;
+        // Set the resource type
+        switch (level)
+        {
+          case ResourceType_Patient:
+            result["Type"] = "Patient";
+            break;
 
-        break;
-      }
+          case ResourceType_Study:
+            result["Type"] = "Study";
+            break;
 
-      case ResourceType_Instance:
-      {
-        result["Type"] = "Instance";
+          case ResourceType_Series:
+          {
+            result["Type"] = "Series";
+            result["Status"] = EnumerationToString(seriesStatus[id]);
 
-        FileInfo attachment;
-        if (!db_.LookupAttachment(attachment, id, FileContentType_Dicom))
+            int64_t i;
+            if (LookupIntegerMetadata(i, m, MetadataType_Series_ExpectedNumberOfInstances))
+              result["ExpectedNumberOfInstances"] = static_cast<int>(i);
+            else
+              result["ExpectedNumberOfInstances"] = Json::nullValue;
+
+            break;
+          }
+
+          case ResourceType_Instance:
+          {
+            result["Type"] = "Instance";
+
+            std::map<int64_t, FileInfo>::const_iterator attachment = attachments.find(id);
+            if (attachment == attachments.end())
+            {
+              throw OrthancException(ErrorCode_InternalError);
+            }
+
+            result["FileSize"] = static_cast<unsigned int>(attachment->second.GetUncompressedSize());
+            result["FileUuid"] = attachment->second.GetUuid();
+
+            int64_t i;
+            if (LookupIntegerMetadata(i, m, MetadataType_Instance_IndexInSeries))
+              result["IndexInSeries"] = static_cast<int>(i);
+            else
+              result["IndexInSeries"] = Json::nullValue;
+
+            break;
+          }
+
+          default:
+            throw OrthancException(ErrorCode_InternalError);
+        }
+
+        // Record the remaining information
+        result["ID"] = publicIds[i];
+        MainDicomTagsToJson(result, *tagsIndex[id], level);
+
+        std::map<MetadataType, std::string>::const_iterator value;
+
+        value = m.find(MetadataType_AnonymizedFrom);
+        if (value != m.end())
         {
-          throw OrthancException(ErrorCode_InternalError);
+          result["AnonymizedFrom"] = value->second;
         }
 
-        result["FileSize"] = static_cast<unsigned int>(attachment.GetUncompressedSize());
-        result["FileUuid"] = attachment.GetUuid();
+        value = m.find(MetadataType_ModifiedFrom);
+        if (value != m.end())
+        {
+          result["ModifiedFrom"] = value->second;
+        }
 
-        int64_t i;
-        if (GetMetadataAsInteger(i, id, MetadataType_Instance_IndexInSeries))
-          result["IndexInSeries"] = static_cast<int>(i);
-        else
-          result["IndexInSeries"] = Json::nullValue;
+        if (level == ResourceType_Patient ||
+            level == ResourceType_Study ||
+            level == ResourceType_Series)
+        {
+          result["IsStable"] = (unstable.find(id) == unstable.end());
 
-        break;
-      }
+          value = m.find(MetadataType_LastUpdate);
+          if (value != m.end())
+          {
+            result["LastUpdate"] = value->second;
+          }
+        }
 
-      default:
-        throw OrthancException(ErrorCode_InternalError);
+        target.append(result);
+      }
     }
+    catch (...)
+    {
+      for (size_t i = 0; i < tags.size(); i++)
+      {
+        delete tags[i];
+      }
 
-    // Record the remaining information
-    result["ID"] = publicId;
-    MainDicomTagsToJson(result, id, type);
-
-    std::string tmp;
+      throw;
+    }
 
-    if (db_.LookupMetadata(tmp, id, MetadataType_AnonymizedFrom))
+    for (size_t i = 0; i < tags.size(); i++)
     {
-      result["AnonymizedFrom"] = tmp;
+      delete tags[i];
     }
+  }
+
 
-    if (db_.LookupMetadata(tmp, id, MetadataType_ModifiedFrom))
+  bool ServerIndex::GetDescendants(std::list<std::string>& target,
+                                   const std::string& publicId,
+                                   ResourceType start,
+                                   ResourceType end)
+  {
+    target.clear();
+
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
+
+    int64_t id;
+    ResourceType type;
+    if (!db.LookupResource(id, type, publicId) ||
+        type != start)
     {
-      result["ModifiedFrom"] = tmp;
+      return false;
     }
 
-    if (type == ResourceType_Patient ||
-        type == ResourceType_Study ||
-        type == ResourceType_Series)
+    // Walk down the hierarchy, one level at a time, with one bulk
+    // query per chunk of resources
+    std::vector<int64_t> current(1, id);
+    std::list<std::string> publicIds;
+
+    while (type != end)
     {
-      result["IsStable"] = !unstableResources_.Contains(id);
+      typedef std::map<int64_t, std::list<std::pair<int64_t, std::string> > >  Children;
 
-      if (db_.LookupMetadata(tmp, id, MetadataType_LastUpdate))
+      Children children;
+      db.GetChildren(children, current);
+
+      std::vector<int64_t> next;
+      publicIds.clear();
+
+      for (size_t i = 0; i < current.size(); i++)
       {
-        result["LastUpdate"] = tmp;
+        Children::const_iterator found = children.find(current[i]);
+        if (found != children.end())
+        {
+          for (std::list<std::pair<int64_t, std::string> >::const_iterator
+                 it = found->second.begin(); it != found->second.end(); ++it)
+          {
+            next.push_back(it->first);
+            publicIds.push_back(it->second);
+          }
+        }
       }
+
+      current.swap(next);
+      type = GetChildResourceType(type);
+    }
+
+    if (start == end)
+    {
+      target.push_back(publicId);
+    }
+    else
+    {
+      target.swap(publicIds);
     }
 
     return true;
@@ -1083,16 +1818,17 @@ namespace Orthanc
                                      const std::string& instanceUuid,
                                      FileContentType contentType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, instanceUuid))
+    if (!db.LookupResource(id, type, instanceUuid))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    if (db_.LookupAttachment(attachment, id, contentType))
+    if (db.LookupAttachment(attachment, id, contentType))
     {
       assert(attachment.GetContentType() == contentType);
       return true;
@@ -1108,8 +1844,9 @@ namespace Orthanc
   void ServerIndex::GetAllUuids(std::list<std::string>& target,
                                 ResourceType resourceType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
-    db_.GetAllPublicIds(target, resourceType);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
+    db.GetAllPublicIds(target, resourceType);
   }
 
 
@@ -1124,8 +1861,76 @@ namespace Orthanc
       return;
     }
 
-    boost::mutex::scoped_lock lock(mutex_);
-    db_.GetAllPublicIds(target, resourceType, since, limit);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
+    db.GetAllPublicIds(target, resourceType, since, limit);
+  }
+
+
+  bool ServerIndex::GetUuidsAfter(std::list<std::string>& target,
+                                  std::string& next,
+                                  ResourceType resourceType,
+                                  const std::string& after,
+                                  size_t limit)
+  {
+    if (limit == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    // The continuation token is the internal identifier of the last
+    // resource of the previous page
+    int64_t last = std::numeric_limits<int64_t>::min();
+
+    if (!after.empty())
+    {
+      try
+      {
+        last = boost::lexical_cast<int64_t>(after);
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        LOG(ERROR) << "Invalid continuation token: " << after;
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+    }
+
+    std::list< std::pair<int64_t, std::string> > page;
+
+    {
+      ReadLock lock(*this);
+      IDatabaseWrapper& db = lock.GetDatabase();
+
+      // Ask for one more resource to know whether the end is reached
+      // (saturated, as the database cannot hold that many resources)
+      const size_t count = (limit < static_cast<size_t>(std::numeric_limits<int64_t>::max()) ?
+                            limit + 1 : static_cast<size_t>(std::numeric_limits<int64_t>::max()));
+      db.GetPublicIdsAfter(page, resourceType, last, count);
+    }
+
+    bool done = (page.size() <= limit);
+    if (!done)
+    {
+      page.pop_back();
+    }
+
+    target.clear();
+    for (std::list< std::pair<int64_t, std::string> >::const_iterator
+           it = page.begin(); it != page.end(); ++it)
+    {
+      target.push_back(it->second);
+    }
+
+    if (done)
+    {
+      next.clear();
+    }
+    else
+    {
+      next = boost::lexical_cast<std::string>(page.back().first);
+    }
+
+    return done;
   }
 
 
@@ -1162,8 +1967,9 @@ namespace Orthanc
     bool done;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
-      db_.GetChanges(changes, done, since, maxResults);
+      ReadLock lock(*this);
+      IDatabaseWrapper& db = lock.GetDatabase();
+      db.GetChanges(changes, done, since, maxResults);
     }
 
     FormatLog(target, changes, "Changes", done, since);
@@ -1175,8 +1981,9 @@ namespace Orthanc
     std::list<ServerIndexChange> changes;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
-      db_.GetLastChange(changes);
+      ReadLock lock(*this);
+      IDatabaseWrapper& db = lock.GetDatabase();
+      db.GetLastChange(changes);
     }
 
     FormatLog(target, changes, "Changes", true, 0);
@@ -1269,8 +2076,9 @@ namespace Orthanc
     bool done;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
-      db_.GetExportedResources(exported, done, since, maxResults);
+      ReadLock lock(*this);
+      IDatabaseWrapper& db = lock.GetDatabase();
+      db.GetExportedResources(exported, done, since, maxResults);
     }
 
     FormatLog(target, exported, "Exports", done, since);
@@ -1282,8 +2090,9 @@ namespace Orthanc
     std::list<ExportedResource> exported;
 
     {
-      boost::mutex::scoped_lock lock(mutex_);
-      db_.GetLastExportedResource(exported);
+      ReadLock lock(*this);
+      IDatabaseWrapper& db = lock.GetDatabase();
+      db.GetLastExportedResource(exported);
     }
 
     FormatLog(target, exported, "Exports", true, 0);
@@ -1294,7 +2103,8 @@ namespace Orthanc
   {
     if (maximumStorageSize_ != 0)
     {
-      uint64_t currentSize = currentStorageSize_ - listener_->GetSizeOfFilesToRemove();
+      uint64_t currentSize = (currentStorageSize_ + listener_->GetSizeOfAddedFiles() -
+                              listener_->GetSizeOfFilesToRemove());
       assert(db_.GetTotalCompressedSize() == currentSize);
 
       if (currentSize + instanceSize > maximumStorageSize_)
@@ -1407,18 +2217,19 @@ namespace Orthanc
 
   bool ServerIndex::IsProtectedPatient(const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     // Lookup for the requested resource
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, publicId) ||
+    if (!db.LookupResource(id, type, publicId) ||
         type != ResourceType_Patient)
     {
       throw OrthancException(ErrorCode_ParameterOutOfRange);
     }
 
-    return db_.IsProtectedPatient(id);
+    return db.IsProtectedPatient(id);
   }
      
 
@@ -1452,11 +2263,12 @@ namespace Orthanc
   {
     result.clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     ResourceType type;
     int64_t resource;
-    if (!db_.LookupResource(resource, type, publicId))
+    if (!db.LookupResource(resource, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -1468,12 +2280,12 @@ namespace Orthanc
     }
 
     std::list<int64_t> tmp;
-    db_.GetChildrenInternalId(tmp, resource);
+    db.GetChildrenInternalId(tmp, resource);
 
     for (std::list<int64_t>::const_iterator 
            it = tmp.begin(); it != tmp.end(); ++it)
     {
-      result.push_back(db_.GetPublicId(*it));
+      result.push_back(db.GetPublicId(*it));
     }
   }
 
@@ -1483,11 +2295,12 @@ namespace Orthanc
   {
     result.clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     ResourceType type;
     int64_t top;
-    if (!db_.LookupResource(top, type, publicId))
+    if (!db.LookupResource(top, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -1510,14 +2323,14 @@ namespace Orthanc
       int64_t resource = toExplore.top();
       toExplore.pop();
 
-      if (db_.GetResourceType(resource) == ResourceType_Instance)
+      if (db.GetResourceType(resource) == ResourceType_Instance)
       {
-        result.push_back(db_.GetPublicId(resource));
+        result.push_back(db.GetPublicId(resource));
       }
       else
       {
         // Tag all the children of this resource as to be explored
-        db_.GetChildrenInternalId(tmp, resource);
+        db.GetChildrenInternalId(tmp, resource);
         for (std::list<int64_t>::const_iterator 
                it = tmp.begin(); it != tmp.end(); ++it)
         {
@@ -1581,32 +2394,34 @@ namespace Orthanc
                                    const std::string& publicId,
                                    MetadataType type)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     ResourceType rtype;
     int64_t id;
-    if (!db_.LookupResource(id, rtype, publicId))
+    if (!db.LookupResource(id, rtype, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    return db_.LookupMetadata(target, id, type);
+    return db.LookupMetadata(target, id, type);
   }
 
 
   void ServerIndex::ListAvailableMetadata(std::list<MetadataType>& target,
                                           const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     ResourceType rtype;
     int64_t id;
-    if (!db_.LookupResource(id, rtype, publicId))
+    if (!db.LookupResource(id, rtype, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    db_.ListAvailableMetadata(target, id);
+    db.ListAvailableMetadata(target, id);
   }
 
 
@@ -1614,36 +2429,38 @@ namespace Orthanc
                                              const std::string& publicId,
                                              ResourceType expectedType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId) ||
+    if (!db.LookupResource(id, type, publicId) ||
         expectedType != type)
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
-    db_.ListAvailableAttachments(target, id);
+    db.ListAvailableAttachments(target, id);
   }
 
 
   bool ServerIndex::LookupParent(std::string& target,
                                  const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId))
+    if (!db.LookupResource(id, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
     int64_t parentId;
-    if (db_.LookupParent(parentId, id))
+    if (db.LookupParent(parentId, id))
     {
-      target = db_.GetPublicId(parentId);
+      target = db.GetPublicId(parentId);
       return true;
     }
     else
@@ -1702,6 +2519,7 @@ namespace Orthanc
                                           /* out */ unsigned int& countStudies, 
                                           /* out */ unsigned int& countSeries, 
                                           /* out */ unsigned int& countInstances, 
+                                          /* in  */ IDatabaseWrapper& db,
                                           /* in  */ int64_t id,
                                           /* in  */ ResourceType type)
   {
@@ -1720,16 +2538,16 @@ namespace Orthanc
       int64_t resource = toExplore.top();
       toExplore.pop();
 
-      ResourceType thisType = db_.GetResourceType(resource);
+      ResourceType thisType = db.GetResourceType(resource);
 
       std::list<FileContentType> f;
-      db_.ListAvailableAttachments(f, resource);
+      db.ListAvailableAttachments(f, resource);
 
       for (std::list<FileContentType>::const_iterator
              it = f.begin(); it != f.end(); ++it)
       {
         FileInfo attachment;
-        if (db_.LookupAttachment(attachment, resource, *it))
+        if (db.LookupAttachment(attachment, resource, *it))
         {
           compressedSize += attachment.GetCompressedSize();
           uncompressedSize += attachment.GetUncompressedSize();
@@ -1758,7 +2576,7 @@ namespace Orthanc
 
         // Tag all the children of this resource as to be explored
         std::list<int64_t> tmp;
-        db_.GetChildrenInternalId(tmp, resource);
+        db.GetChildrenInternalId(tmp, resource);
         for (std::list<int64_t>::const_iterator 
                it = tmp.begin(); it != tmp.end(); ++it)
         {
@@ -1783,11 +2601,12 @@ namespace Orthanc
   void ServerIndex::GetStatistics(Json::Value& target,
                                   const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     ResourceType type;
     int64_t top;
-    if (!db_.LookupResource(top, type, publicId))
+    if (!db.LookupResource(top, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -1798,7 +2617,7 @@ namespace Orthanc
     unsigned int countSeries;
     unsigned int countInstances;
     GetStatisticsInternal(compressedSize, uncompressedSize, countStudies, 
-                          countSeries, countInstances, top, type);
+                          countSeries, countInstances, db, top, type);
 
     target = Json::objectValue;
     target["DiskSize"] = boost::lexical_cast<std::string>(compressedSize);
@@ -1832,17 +2651,18 @@ namespace Orthanc
                                   /* out */ unsigned int& countInstances, 
                                   const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     ResourceType type;
     int64_t top;
-    if (!db_.LookupResource(top, type, publicId))
+    if (!db.LookupResource(top, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
 
     GetStatisticsInternal(compressedSize, uncompressedSize, countStudies, 
-                          countSeries, countInstances, top, type);    
+                          countSeries, countInstances, db, top, type);    
   }
 
 
@@ -1862,6 +2682,7 @@ namespace Orthanc
       boost::this_thread::sleep(boost::posix_time::seconds(1));
 
       boost::mutex::scoped_lock lock(that->mutex_);
+      boost::mutex::scoped_lock unstableLock(that->unstableResourcesMutex_);
 
       while (!that->unstableResources_.IsEmpty() &&
              that->unstableResources_.GetOldestPayload().GetAge() > static_cast<unsigned int>(stableAge))
@@ -1912,8 +2733,11 @@ namespace Orthanc
            type == Orthanc::ResourceType_Study ||
            type == Orthanc::ResourceType_Series);
 
-    UnstableResourcePayload payload(type, publicId);
-    unstableResources_.AddOrMakeMostRecent(id, payload);
+    {
+      boost::mutex::scoped_lock lock(unstableResourcesMutex_);
+      UnstableResourcePayload payload(type, publicId);
+      unstableResources_.AddOrMakeMostRecent(id, payload);
+    }
     //LOG(INFO) << "Unstable resource: " << EnumerationToString(type) << " " << id;
 
     LogChange(id, ChangeType_NewChildInstance, type, publicId);
@@ -1934,11 +2758,12 @@ namespace Orthanc
     
     result.clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     LookupIdentifierQuery query(level);
     query.AddConstraint(tag, IdentifierConstraintType_Equal, value);
-    query.Apply(result, db_);
+    query.Apply(result, db);
   }
 
 
@@ -2020,19 +2845,20 @@ namespace Orthanc
   bool ServerIndex::GetMetadata(Json::Value& target,
                                 const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     target = Json::objectValue;
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId))
+    if (!db.LookupResource(id, type, publicId))
     {
       return false;
     }
 
     std::list<MetadataType> metadata;
-    db_.ListAvailableMetadata(metadata, id);
+    db.ListAvailableMetadata(metadata, id);
 
     for (std::list<MetadataType>::const_iterator
            it = metadata.begin(); it != metadata.end(); ++it)
@@ -2040,7 +2866,7 @@ namespace Orthanc
       std::string key = EnumerationToString(*it);
 
       std::string value;
-      if (!db_.LookupMetadata(value, id, *it))
+      if (!db.LookupMetadata(value, id, *it))
       {
         value.clear();
       }
@@ -2063,10 +2889,11 @@ namespace Orthanc
   std::string ServerIndex::GetGlobalProperty(GlobalProperty property,
                                              const std::string& defaultValue)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     std::string value;
-    if (db_.LookupGlobalProperty(value, property))
+    if (db.LookupGlobalProperty(value, property))
     {
       return value;
     }
@@ -2094,12 +2921,13 @@ namespace Orthanc
 
     result.Clear();
 
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     // Lookup for the requested resource
     int64_t id;
     ResourceType type;
-    if (!db_.LookupResource(id, type, publicId) ||
+    if (!db.LookupResource(id, type, publicId) ||
         type != expectedType)
     {
       return false;
@@ -2108,7 +2936,7 @@ namespace Orthanc
     if (type == ResourceType_Study)
     {
       DicomMap tmp;
-      db_.GetMainDicomTags(tmp, id);
+      db.GetMainDicomTags(tmp, id);
 
       switch (levelOfInterest)
       {
@@ -2126,19 +2954,61 @@ namespace Orthanc
     }
     else
     {
-      db_.GetMainDicomTags(result, id);
+      db.GetMainDicomTags(result, id);
       return true;
     }    
   }
 
 
+  bool ServerIndex::GetMainDicomTagsWithParents(DicomMap& result,
+                                                const std::string& publicId,
+                                                ResourceType expectedType)
+  {
+    result.Clear();
+
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
+
+    int64_t id;
+    ResourceType type;
+    if (!db.LookupResource(id, type, publicId) ||
+        type != expectedType)
+    {
+      return false;
+    }
+
+    for (;;)
+    {
+      DicomMap tags;
+      db.GetMainDicomTags(tags, id);
+
+      DicomArray flattened(tags);
+      for (size_t i = 0; i < flattened.GetSize(); i++)
+      {
+        result.SetValue(flattened.GetElement(i).GetTag(), flattened.GetElement(i).GetValue());
+      }
+
+      int64_t parentId;
+      if (type == ResourceType_Patient ||
+          !db.LookupParent(parentId, id))
+      {
+        return true;
+      }
+
+      id = parentId;
+      type = GetParentResourceType(type);
+    }
+  }
+
+
   bool ServerIndex::LookupResourceType(ResourceType& type,
                                        const std::string& publicId)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     int64_t id;
-    return db_.LookupResource(id, type, publicId);
+    return db.LookupResource(id, type, publicId);
   }
 
 
@@ -2150,32 +3020,43 @@ namespace Orthanc
 
 
   void ServerIndex::FindCandidates(std::vector<std::string>& resources,
-                                   std::vector<std::string>& instances,
-                                   const ::Orthanc::LookupResource& lookup)
+                                   const ::Orthanc::LookupResource& lookup,
+                                   size_t maxResults)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
    
     std::list<int64_t> tmp;
-    lookup.FindCandidates(tmp, db_);
+    lookup.FindCandidates(tmp, db, maxResults);
 
     resources.resize(tmp.size());
-    instances.resize(tmp.size());
 
     size_t pos = 0;
     for (std::list<int64_t>::const_iterator
            it = tmp.begin(); it != tmp.end(); ++it, pos++)
     {
-      assert(db_.GetResourceType(*it) == lookup.GetLevel());
-      
-      int64_t instance;
-      if (!Toolbox::FindOneChildInstance(instance, db_, *it, lookup.GetLevel()))
-      {
-        throw OrthancException(ErrorCode_InternalError);
-      }
+      assert(db.GetResourceType(*it) == lookup.GetLevel());
+      resources[pos] = db.GetPublicId(*it);
+    }
+  }
+
+
+  bool ServerIndex::LookupOneChildInstance(std::string& instance,
+                                           const std::string& publicId)
+  {
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
-      resources[pos] = db_.GetPublicId(*it);
-      instances[pos] = db_.GetPublicId(instance);
+    int64_t id, child;
+    ResourceType type;
+    if (!db.LookupResource(id, type, publicId) ||
+        !Toolbox::FindOneChildInstance(child, db, id, type))
+    {
+      return false;
     }
+
+    instance = db.GetPublicId(child);
+    return true;
   }
 
 
@@ -2183,11 +3064,12 @@ namespace Orthanc
                                  const std::string& publicId,
                                  ResourceType parentType)
   {
-    boost::mutex::scoped_lock lock(mutex_);
+    ReadLock lock(*this);
+    IDatabaseWrapper& db = lock.GetDatabase();
 
     ResourceType type;
     int64_t id;
-    if (!db_.LookupResource(id, type, publicId))
+    if (!db.LookupResource(id, type, publicId))
     {
       throw OrthancException(ErrorCode_UnknownResource);
     }
@@ -2197,7 +3079,7 @@ namespace Orthanc
       int64_t parentId;
 
       if (type == ResourceType_Patient ||    // Cannot further go up in hierarchy
-          !db_.LookupParent(parentId, id))
+          !db.LookupParent(parentId, id))
       {
         return false;
       }
@@ -2206,7 +3088,7 @@ namespace Orthanc
       type = GetParentResourceType(type);
     }
 
-    target = db_.GetPublicId(id);
+    target = db.GetPublicId(id);
     return true;
   }
 }
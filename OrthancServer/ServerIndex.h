@@ -57,7 +57,9 @@ namespace Orthanc
   private:
     class Listener;
     class Transaction;
+    class ReadLock;
     class UnstableResourcePayload;
+    class PendingStore;
 
     bool done_;
     boost::mutex mutex_;
@@ -66,21 +68,45 @@ namespace Orthanc
 
     std::auto_ptr<Listener> listener_;
     IDatabaseWrapper& db_;
+
+    // "unstableResources_" is read without locking "mutex_" if
+    // read-only connections are available
+    boost::mutex unstableResourcesMutex_;
     LeastRecentlyUsedIndex<int64_t, UnstableResourcePayload>  unstableResources_;
 
+    // Pool of read-only connections to the database
+    boost::mutex readersMutex_;
+    boost::condition_variable readerAvailable_;
+    std::vector<IDatabaseWrapper*> readers_;
+    std::vector<IDatabaseWrapper*> availableReaders_;
+
     uint64_t currentStorageSize_;
     uint64_t maximumStorageSize_;
     unsigned int maximumPatients_;
 
+    // Group commit of the incoming instances
+    boost::mutex groupMutex_;
+    boost::condition_variable groupArrival_;
+    boost::condition_variable groupCompleted_;
+    std::list<PendingStore*> groupQueue_;
+    bool hasGroupLeader_;
+    unsigned int groupCommitSize_;
+    unsigned int groupCommitDelay_;
+
     static void FlushThread(ServerIndex* that);
 
     static void UnstableResourcesMonitorThread(ServerIndex* that);
 
-    void MainDicomTagsToJson(Json::Value& result,
-                             int64_t resourceId,
-                             ResourceType resourceType);
+    static void MainDicomTagsToJson(Json::Value& result,
+                                    const DicomMap& tags,
+                                    ResourceType resourceType);
 
-    SeriesStatus GetSeriesStatus(int64_t id);
+    void ExpandResourcesInternal(Json::Value& target,
+                                 const std::vector<std::string>& publicIds,
+                                 ResourceType level);
+
+    static SeriesStatus GetSeriesStatus(IDatabaseWrapper& db,
+                                        int64_t id);
 
     bool IsRecyclingNeeded(uint64_t instanceSize);
 
@@ -93,17 +119,19 @@ namespace Orthanc
                         Orthanc::ResourceType type,
                         const std::string& publicId);
 
-    void GetStatisticsInternal(/* out */ uint64_t& compressedSize, 
-                               /* out */ uint64_t& uncompressedSize, 
-                               /* out */ unsigned int& countStudies, 
-                               /* out */ unsigned int& countSeries, 
-                               /* out */ unsigned int& countInstances, 
-                               /* in  */ int64_t id,
-                               /* in  */ ResourceType type);
+    static void GetStatisticsInternal(/* out */ uint64_t& compressedSize, 
+                                      /* out */ uint64_t& uncompressedSize, 
+                                      /* out */ unsigned int& countStudies, 
+                                      /* out */ unsigned int& countSeries, 
+                                      /* out */ unsigned int& countInstances, 
+                                      /* in  */ IDatabaseWrapper& db,
+                                      /* in  */ int64_t id,
+                                      /* in  */ ResourceType type);
 
-    bool GetMetadataAsInteger(int64_t& result,
-                              int64_t id,
-                              MetadataType type);
+    static bool GetMetadataAsInteger(int64_t& result,
+                                     IDatabaseWrapper& db,
+                                     int64_t id,
+                                     MetadataType type);
 
     void LogChange(int64_t internalId,
                    ChangeType changeType,
@@ -115,6 +143,19 @@ namespace Orthanc
     int64_t CreateResource(const std::string& publicId,
                            ResourceType type);
 
+    StoreStatus StoreInternal(uint64_t& instanceSize,
+                              std::map<MetadataType, std::string>& instanceMetadata,
+                              DicomInstanceToStore& instance,
+                              const Attachments& attachments);
+
+    StoreStatus StoreSingle(std::map<MetadataType, std::string>& instanceMetadata,
+                            DicomInstanceToStore& instance,
+                            const Attachments& attachments);
+
+    void StoreGroup(const std::vector<PendingStore*>& group);
+
+    void CloseReadConnections();
+
   public:
     ServerIndex(ServerContext& context,
                 IDatabaseWrapper& database);
@@ -139,6 +180,24 @@ namespace Orthanc
     // "count == 0" means no limit on the number of patients
     void SetMaximumPatientCount(unsigned int count);
 
+    // Concurrent calls to "Store()" are grouped into a single
+    // transaction of at most "maxSize" instances. The first caller of
+    // a group waits at most "delay" milliseconds for other instances
+    // to arrive. "maxSize <= 1" disables group commit.
+    void SetGroupCommit(unsigned int maxSize,
+                        unsigned int delay);
+
+    unsigned int GetGroupCommitSize();
+
+    // Opens "count" read-only connections to the database, so that
+    // the read-only methods of the index can run concurrently with
+    // each other and with the modifications. "count == 0" serializes
+    // all the accesses through the main connection. Returns "false"
+    // if the database back-end cannot open read-only connections.
+    bool SetReadConnections(unsigned int count);
+
+    unsigned int GetReadConnectionsCount();
+
     StoreStatus Store(std::map<MetadataType, std::string>& instanceMetadata,
                       DicomInstanceToStore& instance,
                       const Attachments& attachments);
@@ -149,6 +208,21 @@ namespace Orthanc
                         const std::string& publicId,
                         ResourceType expectedType);
 
+    // Bulk version of "LookupResource()": "target" is set to a JSON
+    // array containing the expansion of each resource of the list,
+    // in the same order. The resources that do not exist, or that are
+    // not of the expected level, are skipped.
+    void ExpandResources(Json::Value& target,
+                         const std::list<std::string>& publicIds,
+                         ResourceType level);
+
+    // Lists the public IDs of the descendants of "publicId" at the
+    // level "end". Returns "false" if the resource does not exist.
+    bool GetDescendants(std::list<std::string>& target,
+                        const std::string& publicId,
+                        ResourceType start,
+                        ResourceType end);
+
     bool LookupAttachment(FileInfo& attachment,
                           const std::string& instanceUuid,
                           FileContentType contentType);
@@ -161,6 +235,16 @@ namespace Orthanc
                      size_t since,
                      size_t limit);
 
+    // Keyset pagination: "after" is the opaque continuation token
+    // returned by the previous page, or an empty string for the first
+    // page. Returns "true" iff the end of the list is reached,
+    // otherwise "next" is the token of the following page.
+    bool GetUuidsAfter(std::list<std::string>& target,
+                       std::string& next,
+                       ResourceType resourceType,
+                       const std::string& after,
+                       size_t limit);
+
     bool DeleteResource(Json::Value& target /* out */,
                         const std::string& uuid,
                         ResourceType expectedType);
@@ -256,14 +340,24 @@ namespace Orthanc
                           ResourceType expectedType,
                           ResourceType levelOfInterest);
 
+    // Merges the main DICOM tags of the resource with those of all
+    // its ancestors, using one single access to the index
+    bool GetMainDicomTagsWithParents(DicomMap& result,
+                                     const std::string& publicId,
+                                     ResourceType expectedType);
+
     bool LookupResourceType(ResourceType& type,
                             const std::string& publicId);
 
     unsigned int GetDatabaseVersion();
 
+    // "maxResults == 0" means no limit (cf. LookupResource::FindCandidates())
     void FindCandidates(std::vector<std::string>& resources,
-                        std::vector<std::string>& instances,
-                        const ::Orthanc::LookupResource& lookup);
+                        const ::Orthanc::LookupResource& lookup,
+                        size_t maxResults);
+
+    bool LookupOneChildInstance(std::string& instance,
+                                const std::string& publicId);
 
     bool LookupParent(std::string& target,
                       const std::string& publicId,
@@ -0,0 +1,308 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersServer.h"
+#include "ServerListenerQueue.h"
+
+#include "../Core/Logging.h"
+#include "../Core/OrthancException.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+namespace Orthanc
+{
+  void ServerListenerQueue::Worker(ServerListenerQueue* that)
+  {
+    for (;;)
+    {
+      std::auto_ptr<ServerIndexChange> change;
+
+      {
+        boost::mutex::scoped_lock lock(that->mutex_);
+
+        while (that->queue_.empty() && !that->done_)
+        {
+          that->elementAvailable_.wait(lock);
+        }
+
+        if (that->done_)
+        {
+          return;
+        }
+
+        change.reset(that->queue_.front());
+        that->queue_.pop_front();
+        that->busy_ = true;
+        that->roomAvailable_.notify_all();
+      }
+
+      boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+      try
+      {
+        that->listener_.SignalChange(*change);
+      }
+      catch (OrthancException& e)
+      {
+        LOG(ERROR) << "Error in the " << that->description_ 
+                   << " callback while signaling a change: " << e.What();
+      }
+      catch (...)
+      {
+        LOG(ERROR) << "Native exception in the " << that->description_ 
+                   << " callback while signaling a change";
+      }
+
+      boost::posix_time::time_duration elapsed = 
+        boost::posix_time::microsec_clock::universal_time() - start;
+      uint64_t microseconds = static_cast<uint64_t>(elapsed.total_microseconds());
+
+      {
+        boost::mutex::scoped_lock lock(that->mutex_);
+
+        that->busy_ = false;
+        that->processed_++;
+        that->totalMicroseconds_ += microseconds;
+        if (microseconds > that->maximumMicroseconds_)
+        {
+          that->maximumMicroseconds_ = microseconds;
+        }
+
+        if (that->queue_.empty())
+        {
+          that->stalled_ = false;   // The listener has caught up
+          that->emptied_.notify_all();
+        }
+      }
+    }
+  }
+
+
+  bool ServerListenerQueue::IsFull() const
+  {
+    // WARNING: The mutex must be locked
+    return (maxSize_ != 0 && queue_.size() >= maxSize_);
+  }
+
+
+  bool ServerListenerQueue::Coalesce(const ServerIndexChange& change)
+  {
+    // WARNING: The mutex must be locked
+
+    for (Queue::const_iterator it = queue_.begin(); it != queue_.end(); ++it)
+    {
+      if ((*it)->GetChangeType() == change.GetChangeType() &&
+          (*it)->GetResourceType() == change.GetResourceType() &&
+          (*it)->GetPublicId() == change.GetPublicId())
+      {
+        // The listener will be notified by the pending change
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  ServerListenerQueue::ServerListenerQueue(IServerListener& listener,
+                                           const std::string& description,
+                                           size_t maxSize,
+                                           ListenerOverflowPolicy policy) :
+    listener_(listener),
+    description_(description),
+    maxSize_(maxSize),
+    policy_(policy),
+    blockTimeout_(1000),
+    stalled_(false),
+    done_(false),
+    busy_(false),
+    processed_(0),
+    dropped_(0),
+    coalesced_(0),
+    totalMicroseconds_(0),
+    maximumMicroseconds_(0)
+  {
+    worker_ = boost::thread(Worker, this);
+  }
+
+
+  ServerListenerQueue::~ServerListenerQueue()
+  {
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      done_ = true;
+      elementAvailable_.notify_all();
+      roomAvailable_.notify_all();
+      emptied_.notify_all();
+    }
+
+    if (worker_.joinable())
+    {
+      worker_.join();
+    }
+
+    if (!queue_.empty())
+    {
+      LOG(WARNING) << "Discarding " << queue_.size() << " pending change(s) for the " 
+                   << description_ << " listener";
+    }
+
+    for (Queue::iterator it = queue_.begin(); it != queue_.end(); ++it)
+    {
+      delete *it;
+    }
+  }
+
+
+  void ServerListenerQueue::SetMaximumSize(size_t size)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    maxSize_ = size;
+    roomAvailable_.notify_all();
+  }
+
+
+  void ServerListenerQueue::SetOverflowPolicy(ListenerOverflowPolicy policy)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    policy_ = policy;
+    roomAvailable_.notify_all();
+  }
+
+
+  void ServerListenerQueue::SetBlockTimeout(unsigned int milliseconds)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    blockTimeout_ = milliseconds;
+    roomAvailable_.notify_all();
+  }
+
+
+  void ServerListenerQueue::Enqueue(const ServerIndexChange& change)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (policy_ == ListenerOverflowPolicy_Coalesce &&
+        Coalesce(change))
+    {
+      coalesced_++;
+      return;
+    }
+
+    const boost::system_time timeout = 
+      boost::get_system_time() + boost::posix_time::milliseconds(blockTimeout_);
+
+    while (IsFull() && !done_)
+    {
+      if (policy_ != ListenerOverflowPolicy_Drop &&
+          !stalled_ &&
+          !roomAvailable_.timed_wait(lock, timeout) &&
+          IsFull())
+      {
+        LOG(WARNING) << "The " << description_ << " listener is stalled, "
+                     << "dropping its oldest pending changes until it catches up";
+        stalled_ = true;
+      }
+
+      if (IsFull() &&
+          (policy_ == ListenerOverflowPolicy_Drop || stalled_))
+      {
+        // Make room by discarding the oldest pending change
+        delete queue_.front();
+        queue_.pop_front();
+        dropped_++;
+      }
+    }
+
+    if (done_)
+    {
+      return;
+    }
+
+    queue_.push_back(change.Clone());
+    elementAvailable_.notify_one();
+  }
+
+
+  void ServerListenerQueue::WaitEmpty()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    while ((!queue_.empty() || busy_) && !done_)
+    {
+      emptied_.wait(lock);
+    }
+  }
+
+
+  void ServerListenerQueue::GetStatistics(Statistics& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    target.queueSize_ = queue_.size();
+    target.maximumQueueSize_ = maxSize_;
+    target.policy_ = policy_;
+    target.processed_ = processed_;
+    target.dropped_ = dropped_;
+    target.coalesced_ = coalesced_;
+    target.totalMicroseconds_ = totalMicroseconds_;
+    target.maximumMicroseconds_ = maximumMicroseconds_;
+  }
+
+
+  void ServerListenerQueue::Format(Json::Value& target)
+  {
+    Statistics statistics;
+    GetStatistics(statistics);
+
+    target = Json::objectValue;
+    target["OverflowPolicy"] = EnumerationToString(statistics.policy_);
+    target["QueueSize"] = static_cast<unsigned int>(statistics.queueSize_);
+    target["MaximumQueueSize"] = static_cast<unsigned int>(statistics.maximumQueueSize_);
+    target["Processed"] = static_cast<unsigned int>(statistics.processed_);
+    target["Dropped"] = static_cast<unsigned int>(statistics.dropped_);
+    target["Coalesced"] = static_cast<unsigned int>(statistics.coalesced_);
+
+    double milliseconds = static_cast<double>(statistics.totalMicroseconds_) / 1000.0;
+    target["TotalMilliseconds"] = milliseconds;
+    target["MaximumMilliseconds"] = static_cast<double>(statistics.maximumMicroseconds_) / 1000.0;
+
+    if (statistics.processed_ == 0)
+    {
+      target["AverageMilliseconds"] = 0.0;
+    }
+    else
+    {
+      target["AverageMilliseconds"] = milliseconds / static_cast<double>(statistics.processed_);
+    }
+  }
+}
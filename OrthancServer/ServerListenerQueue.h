@@ -0,0 +1,138 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "IServerListener.h"
+#include "ServerIndexChange.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <deque>
+#include <stdint.h>
+
+namespace Orthanc
+{
+  /**
+   * Delivers the changes to one listener from its own worker thread,
+   * so that a slow listener (e.g. a Lua callback or a plugin) never
+   * delays the other listeners, nor the ingest of new instances. The
+   * queue of the pending changes is bounded: Once it is full, the
+   * overflow policy tells whether "Enqueue()" waits for the listener
+   * to make room, drops the oldest pending change, or merges the new
+   * change with an identical pending change. If the maximum size is
+   * "0", the queue is unbounded.
+   *
+   * The wait for room is bounded by the block timeout, as all the
+   * listeners are fed by the same thread: Once the timeout expires,
+   * the listener is considered as stalled, and the oldest pending
+   * changes are dropped without waiting until its queue is emptied.
+   **/
+  class ServerListenerQueue : public boost::noncopyable
+  {
+  public:
+    struct Statistics
+    {
+      size_t                  queueSize_;
+      size_t                  maximumQueueSize_;
+      ListenerOverflowPolicy  policy_;
+      uint64_t                processed_;
+      uint64_t                dropped_;
+      uint64_t                coalesced_;
+      uint64_t                totalMicroseconds_;
+      uint64_t                maximumMicroseconds_;
+    };
+
+  private:
+    typedef std::deque<ServerIndexChange*>  Queue;
+
+    IServerListener&           listener_;
+    std::string                description_;
+    boost::mutex               mutex_;
+    boost::condition_variable  elementAvailable_;
+    boost::condition_variable  roomAvailable_;
+    boost::condition_variable  emptied_;
+    Queue                      queue_;
+    size_t                     maxSize_;
+    ListenerOverflowPolicy     policy_;
+    unsigned int               blockTimeout_;   // In milliseconds
+    bool                       stalled_;
+    bool                       done_;
+    bool                       busy_;
+    uint64_t                   processed_;
+    uint64_t                   dropped_;
+    uint64_t                   coalesced_;
+    uint64_t                   totalMicroseconds_;
+    uint64_t                   maximumMicroseconds_;
+    boost::thread              worker_;
+
+    static void Worker(ServerListenerQueue* that);
+
+    bool IsFull() const;
+
+    bool Coalesce(const ServerIndexChange& change);
+
+  public:
+    ServerListenerQueue(IServerListener& listener,
+                        const std::string& description,
+                        size_t maxSize,
+                        ListenerOverflowPolicy policy);
+
+    // The changes that are still pending are discarded
+    ~ServerListenerQueue();
+
+    IServerListener& GetListener()
+    {
+      return listener_;
+    }
+
+    const std::string& GetDescription() const
+    {
+      return description_;
+    }
+
+    void SetMaximumSize(size_t size);
+
+    void SetOverflowPolicy(ListenerOverflowPolicy policy);
+
+    void SetBlockTimeout(unsigned int milliseconds);
+
+    void Enqueue(const ServerIndexChange& change);
+
+    // Wait until all the pending changes have been delivered
+    void WaitEmpty();
+
+    void GetStatistics(Statistics& target);
+
+    void Format(Json::Value& target);
+  };
+}
@@ -34,6 +34,7 @@
 #include "OrthancRestApi/OrthancRestApi.h"
 
 #include <fstream>
+#include <limits>
 #include <boost/algorithm/string/predicate.hpp>
 
 #include "../Core/Logging.h"
@@ -746,10 +747,15 @@ static bool StartDicomServer(ServerContext& context,
   dicomServer.SetPortNumber(Configuration::GetGlobalIntegerParameter("DicomPort", 4242));
   dicomServer.SetApplicationEntityTitle(Configuration::GetGlobalStringParameter("DicomAet", "ORTHANC"));
   dicomServer.SetApplicationEntityFilter(dicomFilter);
+  dicomServer.SetThreadsCount(Configuration::GetGlobalIntegerParameter("DicomThreadsMinimum", 4),
+                              Configuration::GetGlobalIntegerParameter("DicomThreadsMaximum", 16));
 
   dicomServer.Start();
+  context.SetDicomServer(&dicomServer);
   LOG(WARNING) << "DICOM server listening with AET " << dicomServer.GetApplicationEntityTitle() 
-               << " on port: " << dicomServer.GetPortNumber();
+               << " on port: " << dicomServer.GetPortNumber()
+               << " (between " << dicomServer.GetMinimumThreadsCount() << " and " 
+               << dicomServer.GetMaximumThreadsCount() << " threads)";
 
   bool restart;
   ErrorCode error = ErrorCode_Success;
@@ -763,6 +769,7 @@ static bool StartDicomServer(ServerContext& context,
     error = e.GetErrorCode();
   }
 
+  context.SetDicomServer(NULL);
   dicomServer.Stop();
   LOG(WARNING) << "    DICOM server has stopped";
 
@@ -859,6 +866,22 @@ static bool UpgradeDatabase(IDatabaseWrapper& database,
 }
 
 
+static size_t GetCacheSize(const std::string& parameter,
+                           int defaultValue)
+{
+  // The size is given in megabytes, "0" disables the cache
+  int size = Configuration::GetGlobalIntegerParameter(parameter, defaultValue);
+  if (size < 0 ||
+      static_cast<uint64_t>(size) > std::numeric_limits<size_t>::max() / (1024 * 1024))
+  {
+    LOG(ERROR) << "The configuration option \"" << parameter << "\" must be a positive number of megabytes";
+    throw OrthancException(ErrorCode_ParameterOutOfRange);
+  }
+
+  return static_cast<size_t>(size) * 1024 * 1024;
+}
+
+
 static bool ConfigureServerContext(IDatabaseWrapper& database,
                                    IStorageArea& storageArea,
                                    OrthancPlugins *plugins)
@@ -867,7 +890,54 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
 
   HttpClient::SetDefaultTimeout(Configuration::GetGlobalIntegerParameter("HttpTimeout", 0));
   context.SetCompressionEnabled(Configuration::GetGlobalBoolParameter("StorageCompression", false));
+  context.SetCompressionType(StringToCompressionType
+                             (Configuration::GetGlobalStringParameter("StorageCompressionAlgorithm", "Zlib").c_str()));
+
+  {
+    // Check the range before the narrowing to "uint8_t"
+    int level = Configuration::GetGlobalIntegerParameter("StorageCompressionLevel", 6);
+    if (level < 0 || level > 9)
+    {
+      LOG(ERROR) << "The configuration option \"StorageCompressionLevel\" must be between 0 and 9";
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    context.SetCompressionLevel(static_cast<uint8_t>(level));
+  }
   context.SetStoreMD5ForAttachments(Configuration::GetGlobalBoolParameter("StoreMD5ForAttachments", true));
+  context.SetStoreDicomAsJson(Configuration::GetGlobalBoolParameter("StoreDicomAsJson", true));
+  context.SetStorageWriteThreads(Configuration::GetGlobalIntegerParameter("StorageWriteThreads", 4));
+
+  {
+    int archiveThreads = Configuration::GetGlobalIntegerParameter("ArchiveThreads", 4);
+    if (archiveThreads <= 0)
+    {
+      LOG(ERROR) << "The configuration option \"ArchiveThreads\" must be at least 1";
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    context.SetArchiveThreads(static_cast<unsigned int>(archiveThreads));
+  }
+
+  context.SetDicomCacheSize(GetCacheSize("DicomCacheSize", 128));
+
+  context.SetDicomAsJsonCacheSize(GetCacheSize("DicomAsJsonCacheSize", 32));
+  context.GetPreviewCache().SetMaximumSize(GetCacheSize("PreviewCacheSize", 16));
+  context.GetPreviewCache().SetSpillEnabled(Configuration::GetGlobalBoolParameter("PreviewCacheSpill", false));
+
+  {
+    int blockTimeout = Configuration::GetGlobalIntegerParameter("ListenersBlockTimeout", 1000);
+    if (blockTimeout < 0)
+    {
+      LOG(ERROR) << "The configuration option \"ListenersBlockTimeout\" must be positive";
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    context.SetListenersQueue(Configuration::GetGlobalIntegerParameter("ListenersQueueSize", 1000),
+                              StringToListenerOverflowPolicy
+                              (Configuration::GetGlobalStringParameter("ListenersOverflowPolicy", "Block")),
+                              static_cast<unsigned int>(blockTimeout));
+  }
 
   try
   {
@@ -888,6 +958,10 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
     context.GetIndex().SetMaximumStorageSize(0);
   }
 
+  context.GetIndex().SetGroupCommit(Configuration::GetGlobalIntegerParameter("IndexGroupCommitSize", 1),
+                                    Configuration::GetGlobalIntegerParameter("IndexGroupCommitDelay", 0));
+  context.GetIndex().SetReadConnections(Configuration::GetGlobalIntegerParameter("IndexReadConnections", 0));
+
   LoadLuaScripts(context);
 
 #if ORTHANC_PLUGINS_ENABLED == 1
@@ -41,8 +41,10 @@
 #include "../../Core/OrthancException.h"
 #include "../../Core/Logging.h"
 #include "PluginsEnumerations.h"
+#include "../../OrthancServer/Search/LookupIdentifierQuery.h"
 
 #include <cassert>
+#include <algorithm>
 
 namespace Orthanc
 {
@@ -73,6 +75,7 @@ namespace Orthanc
     type_ = _OrthancPluginDatabaseAnswerType_None;
 
     answerDicomMap_ = NULL;
+    answerDicomMaps_ = NULL;
     answerChanges_ = NULL;
     answerExportedResources_ = NULL;
     answerDone_ = NULL;
@@ -172,6 +175,7 @@ namespace Orthanc
     payload_(payload),
     listener_(NULL),
     answerDicomMap_(NULL),
+    answerDicomMaps_(NULL),
     answerChanges_(NULL),
     answerExportedResources_(NULL),
     answerDone_(NULL)
@@ -344,6 +348,66 @@ namespace Orthanc
   }
 
 
+  void OrthancPluginDatabase::GetPublicIdsAfter(std::list< std::pair<int64_t, std::string> >& target,
+                                                ResourceType resourceType,
+                                                int64_t after,
+                                                size_t limit)
+  {
+    if (extensions_.getPublicIdsAfter != NULL)
+    {
+      ResetAnswers();
+      CheckSuccess(extensions_.getPublicIdsAfter
+                   (GetContext(), payload_, Plugins::Convert(resourceType), after, limit));
+
+      if (type_ != _OrthancPluginDatabaseAnswerType_None &&
+          type_ != _OrthancPluginDatabaseAnswerType_PublicId)
+      {
+        throw OrthancException(ErrorCode_DatabasePlugin);
+      }
+
+      target.clear();
+
+      if (type_ == _OrthancPluginDatabaseAnswerType_PublicId)
+      {
+        target.splice(target.end(), answerPublicIds_);
+      }
+    }
+    else
+    {
+      // The extension is not available in the database plugin, use a
+      // fallback implementation that scans all the resources of this
+      // level (this requires the "getAllInternalIds" extension)
+      target.clear();
+
+      if (limit == 0)
+      {
+        return;
+      }
+
+      std::list<int64_t> all;
+      GetAllInternalIds(all, resourceType);
+
+      std::vector<int64_t> ids;
+      ids.reserve(all.size());
+
+      for (std::list<int64_t>::const_iterator it = all.begin(); it != all.end(); ++it)
+      {
+        if (*it > after)
+        {
+          ids.push_back(*it);
+        }
+      }
+
+      std::sort(ids.begin(), ids.end());
+
+      for (size_t i = 0; i < ids.size() && i < limit; i++)
+      {
+        target.push_back(std::make_pair(ids[i], GetPublicId(ids[i])));
+      }
+    }
+  }
+
+
 
   void OrthancPluginDatabase::GetChanges(std::list<ServerIndexChange>& target /*out*/,
                                          bool& done /*out*/,
@@ -425,6 +489,154 @@ namespace Orthanc
   }
 
 
+  void OrthancPluginDatabase::GetMainDicomTags(const std::vector<DicomMap*>& target,
+                                               const std::vector<int64_t>& ids)
+  {
+    if (target.size() != ids.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    for (size_t i = 0; i < target.size(); i++)
+    {
+      if (target[i] == NULL)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+    }
+
+    if (extensions_.getMainDicomTagsBulk == NULL)
+    {
+      // The extension is not available in the database plugin, use a
+      // fallback implementation
+      for (size_t i = 0; i < ids.size(); i++)
+      {
+        GetMainDicomTags(*target[i], ids[i]);
+      }
+
+      return;
+    }
+
+    std::map<int64_t, DicomMap*> maps;
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      if (maps.find(ids[i]) != maps.end())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      target[i]->Clear();
+      maps[ids[i]] = target[i];
+    }
+
+    if (!ids.empty())
+    {
+      ResetAnswers();
+      answerDicomMaps_ = &maps;
+
+      CheckSuccess(extensions_.getMainDicomTagsBulk(GetContext(), payload_, &ids[0], 
+                                                    static_cast<uint32_t>(ids.size())));
+    }
+  }
+
+
+  /**
+   * The database plugin SDK has no bulk primitive for the expansion
+   * of the resources: The bulk methods below are fallback
+   * implementations that issue one request per resource. They still
+   * benefit from the single lock of the index that is taken by the
+   * caller.
+   **/
+
+  void OrthancPluginDatabase::LookupResources(std::map<std::string, int64_t>& target,
+                                              ResourceType type,
+                                              const std::vector<std::string>& publicIds)
+  {
+    target.clear();
+
+    for (size_t i = 0; i < publicIds.size(); i++)
+    {
+      int64_t id;
+      ResourceType t;
+      if (LookupResource(id, t, publicIds[i]) &&
+          t == type)
+      {
+        target[publicIds[i]] = id;
+      }
+    }
+  }
+
+
+  void OrthancPluginDatabase::LookupParentsPublicId(std::map<int64_t, std::string>& target,
+                                                    const std::vector<int64_t>& ids)
+  {
+    target.clear();
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      int64_t parent;
+      if (LookupParent(parent, ids[i]))
+      {
+        target[ids[i]] = GetPublicId(parent);
+      }
+    }
+  }
+
+
+  void OrthancPluginDatabase::GetChildren(std::map<int64_t, std::list<std::pair<int64_t, std::string> > >& target,
+                                          const std::vector<int64_t>& ids)
+  {
+    target.clear();
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      std::list<int64_t> children;
+      GetChildrenInternalId(children, ids[i]);
+
+      for (std::list<int64_t>::const_iterator
+             it = children.begin(); it != children.end(); ++it)
+      {
+        target[ids[i]].push_back(std::make_pair(*it, GetPublicId(*it)));
+      }
+    }
+  }
+
+
+  void OrthancPluginDatabase::GetAllMetadata(std::map<int64_t, std::map<MetadataType, std::string> >& target,
+                                             const std::vector<int64_t>& ids)
+  {
+    target.clear();
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      std::map<MetadataType, std::string> metadata;
+      GetAllMetadata(metadata, ids[i]);
+
+      if (!metadata.empty())
+      {
+        target[ids[i]] = metadata;
+      }
+    }
+  }
+
+
+  void OrthancPluginDatabase::LookupAttachments(std::map<int64_t, FileInfo>& target,
+                                                FileContentType contentType,
+                                                const std::vector<int64_t>& ids)
+  {
+    target.clear();
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+      FileInfo attachment;
+      if (LookupAttachment(attachment, ids[i], contentType))
+      {
+        target[ids[i]] = attachment;
+      }
+    }
+  }
+
+
   std::string OrthancPluginDatabase::GetPublicId(int64_t resourceId)
   {
     ResetAnswers();
@@ -633,6 +845,16 @@ namespace Orthanc
   }
 
 
+  void OrthancPluginDatabase::LookupIdentifiers(std::list<int64_t>& result,
+                                                const LookupIdentifierQuery& query)
+  {
+    // The database SDK can only look for one constraint at once
+    SetOfResources resources(*this, query.GetLevel());
+    query.ApplySeparately(resources, *this);
+    resources.Flatten(result);
+  }
+
+
   bool OrthancPluginDatabase::LookupMetadata(std::string& target,
                                              int64_t id,
                                              MetadataType type)
@@ -922,6 +1144,10 @@ namespace Orthanc
           answerAttachments_.clear();
           break;
 
+        case _OrthancPluginDatabaseAnswerType_PublicId:
+          answerPublicIds_.clear();
+          break;
+
         case _OrthancPluginDatabaseAnswerType_String:
           answerStrings_.clear();
           break;
@@ -931,6 +1157,11 @@ namespace Orthanc
           answerDicomMap_->Clear();
           break;
 
+        case _OrthancPluginDatabaseAnswerType_MainDicomTag:
+          // The maps were cleared before calling the plugin
+          assert(answerDicomMaps_ != NULL);
+          break;
+
         case _OrthancPluginDatabaseAnswerType_Change:
           assert(answerChanges_ != NULL);
           answerChanges_->clear();
@@ -982,6 +1213,17 @@ namespace Orthanc
         break;
       }
 
+      case _OrthancPluginDatabaseAnswerType_PublicId:
+      {
+        if (answer.valueString == NULL)
+        {
+          throw OrthancException(ErrorCode_DatabasePlugin);
+        }
+
+        answerPublicIds_.push_back(std::make_pair(answer.valueInt64, std::string(answer.valueString)));
+        break;
+      }
+
       case _OrthancPluginDatabaseAnswerType_DicomTag:
       {
         const OrthancPluginDicomTag& tag = *reinterpret_cast<const OrthancPluginDicomTag*>(answer.valueGeneric);
@@ -990,6 +1232,22 @@ namespace Orthanc
         break;
       }
 
+      case _OrthancPluginDatabaseAnswerType_MainDicomTag:
+      {
+        const OrthancPluginDicomTag& tag = *reinterpret_cast<const OrthancPluginDicomTag*>(answer.valueGeneric);
+        assert(answerDicomMaps_ != NULL);
+
+        std::map<int64_t, DicomMap*>::iterator found = answerDicomMaps_->find(answer.valueInt64);
+        if (found == answerDicomMaps_->end())
+        {
+          LOG(ERROR) << "The database plugin has answered with a resource that was not requested: " << answer.valueInt64;
+          throw OrthancException(ErrorCode_DatabasePlugin);
+        }
+
+        found->second->SetValue(tag.group, tag.element, std::string(tag.value));
+        break;
+      }
+
       case _OrthancPluginDatabaseAnswerType_String:
       {
         if (answer.valueString == NULL)
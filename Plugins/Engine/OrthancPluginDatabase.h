@@ -47,6 +47,7 @@ namespace Orthanc
     class Transaction;
 
     typedef std::pair<int64_t, ResourceType>  AnswerResource;
+    typedef std::pair<int64_t, std::string>   AnswerPublicId;
 
     SharedLibrary&  library_;
     PluginsErrorDictionary&  errorDictionary_;
@@ -61,8 +62,10 @@ namespace Orthanc
     std::list<int64_t>             answerInt64_;
     std::list<AnswerResource>      answerResources_;
     std::list<FileInfo>            answerAttachments_;
+    std::list<AnswerPublicId>      answerPublicIds_;
 
     DicomMap*                      answerDicomMap_;
+    std::map<int64_t, DicomMap*>*  answerDicomMaps_;
     std::list<ServerIndexChange>*  answerChanges_;
     std::list<ExportedResource>*   answerExportedResources_;
     bool*                          answerDone_;
@@ -137,6 +140,12 @@ namespace Orthanc
       return false;
     }
 
+    virtual IDatabaseWrapper* OpenReadOnlyConnection()
+    {
+      // Nothing guarantees that the database plugin is thread-safe
+      return NULL;
+    }
+
     virtual void GetAllMetadata(std::map<MetadataType, std::string>& target,
                                 int64_t id);
 
@@ -151,6 +160,11 @@ namespace Orthanc
                                  size_t since,
                                  size_t limit);
 
+    virtual void GetPublicIdsAfter(std::list< std::pair<int64_t, std::string> >& target,
+                                   ResourceType resourceType,
+                                   int64_t after,
+                                   size_t limit);
+
     virtual void GetChanges(std::list<ServerIndexChange>& target /*out*/,
                             bool& done /*out*/,
                             int64_t since,
@@ -174,6 +188,26 @@ namespace Orthanc
     virtual void GetMainDicomTags(DicomMap& map,
                                   int64_t id);
 
+    virtual void GetMainDicomTags(const std::vector<DicomMap*>& target,
+                                  const std::vector<int64_t>& ids);
+
+    virtual void LookupResources(std::map<std::string, int64_t>& target,
+                                 ResourceType type,
+                                 const std::vector<std::string>& publicIds);
+
+    virtual void LookupParentsPublicId(std::map<int64_t, std::string>& target,
+                                       const std::vector<int64_t>& ids);
+
+    virtual void GetChildren(std::map<int64_t, std::list<std::pair<int64_t, std::string> > >& target,
+                             const std::vector<int64_t>& ids);
+
+    virtual void GetAllMetadata(std::map<int64_t, std::map<MetadataType, std::string> >& target,
+                                const std::vector<int64_t>& ids);
+
+    virtual void LookupAttachments(std::map<int64_t, FileInfo>& target,
+                                   FileContentType contentType,
+                                   const std::vector<int64_t>& ids);
+
     virtual std::string GetPublicId(int64_t resourceId);
 
     virtual uint64_t GetResourceCount(ResourceType resourceType);
@@ -212,6 +246,9 @@ namespace Orthanc
                                   IdentifierConstraintType type,
                                   const std::string& value);
 
+    virtual void LookupIdentifiers(std::list<int64_t>& result,
+                                   const LookupIdentifierQuery& query);
+
     virtual bool LookupMetadata(std::string& target,
                                 int64_t id,
                                 MetadataType type);
@@ -113,6 +113,7 @@ namespace Orthanc
     {
     private:
       _OrthancPluginRegisterStorageArea callbacks_;
+      OrthancPluginStorageReadRange     readRange_;
       PluginsErrorDictionary&  errorDictionary_;
 
       void Free(void* buffer) const
@@ -125,8 +126,10 @@ namespace Orthanc
 
     public:
       PluginStorageArea(const _OrthancPluginRegisterStorageArea& callbacks,
+                        OrthancPluginStorageReadRange readRange,
                         PluginsErrorDictionary&  errorDictionary) : 
         callbacks_(callbacks),
+        readRange_(readRange),
         errorDictionary_(errorDictionary)
       {
       }
@@ -183,6 +186,41 @@ namespace Orthanc
       }
 
 
+      virtual bool HasReadRange() const
+      {
+        return readRange_ != NULL;
+      }
+
+
+      virtual void ReadRange(std::string& content,
+                             const std::string& uuid,
+                             FileContentType type,
+                             uint64_t start,
+                             size_t size)
+      {
+        if (readRange_ == NULL)
+        {
+          // This plugin was registered by "OrthancPluginRegisterStorageArea()"
+          IStorageArea::ReadRange(content, uuid, type, start, size);
+          return;
+        }
+
+        content.resize(size);
+
+        if (size > 0)
+        {
+          OrthancPluginErrorCode error = readRange_
+            (&content[0], uuid.c_str(), Plugins::Convert(type), start, size);
+
+          if (error != OrthancPluginErrorCode_Success)
+          {
+            errorDictionary_.LogError(error, true);
+            throw OrthancException(static_cast<ErrorCode>(error));
+          }
+        }
+      }
+
+
       virtual void Remove(const std::string& uuid,
                           FileContentType type) 
       {
@@ -203,6 +241,7 @@ namespace Orthanc
     private:
       SharedLibrary&   sharedLibrary_;
       _OrthancPluginRegisterStorageArea  callbacks_;
+      OrthancPluginStorageReadRange      readRange_;
       PluginsErrorDictionary&  errorDictionary_;
 
     public:
@@ -211,10 +250,24 @@ namespace Orthanc
                          PluginsErrorDictionary&  errorDictionary) :
         sharedLibrary_(sharedLibrary),
         callbacks_(callbacks),
+        readRange_(NULL),
         errorDictionary_(errorDictionary)
       {
       }
 
+      StorageAreaFactory(SharedLibrary& sharedLibrary,
+                         const _OrthancPluginRegisterStorageArea2& callbacks,
+                         PluginsErrorDictionary&  errorDictionary) :
+        sharedLibrary_(sharedLibrary),
+        readRange_(callbacks.readRange),
+        errorDictionary_(errorDictionary)
+      {
+        callbacks_.create = callbacks.create;
+        callbacks_.read = callbacks.read;
+        callbacks_.remove = callbacks.remove;
+        callbacks_.free = callbacks.free;
+      }
+
       SharedLibrary&  GetSharedLibrary()
       {
         return sharedLibrary_;
@@ -222,7 +275,7 @@ namespace Orthanc
 
       IStorageArea* Create() const
       {
-        return new PluginStorageArea(callbacks_, errorDictionary_);
+        return new PluginStorageArea(callbacks_, readRange_, errorDictionary_);
       }
     };
   }
@@ -1874,6 +1927,24 @@ namespace Orthanc
         return true;
       }
 
+      case _OrthancPluginService_RegisterStorageArea2:
+      {
+        LOG(INFO) << "Plugin has registered a custom storage area, with support for range reads";
+        const _OrthancPluginRegisterStorageArea2& p = 
+          *reinterpret_cast<const _OrthancPluginRegisterStorageArea2*>(parameters);
+        
+        if (pimpl_->storageArea_.get() == NULL)
+        {
+          pimpl_->storageArea_.reset(new StorageAreaFactory(plugin, p, GetErrorDictionary()));
+        }
+        else
+        {
+          throw OrthancException(ErrorCode_StorageAreaAlreadyRegistered);
+        }
+
+        return true;
+      }
+
       case _OrthancPluginService_SetPluginProperty:
       {
         const _OrthancPluginSetPluginProperty& p = 
@@ -194,6 +194,9 @@ namespace Orthanc
         case FileContentType_DicomAsJson:
           return OrthancPluginContentType_DicomAsJson;
 
+        case FileContentType_Preview:
+          return OrthancPluginContentType_Preview;
+
         default:
           return OrthancPluginContentType_Unknown;
       }
@@ -210,6 +213,9 @@ namespace Orthanc
         case OrthancPluginContentType_DicomAsJson:
           return FileContentType_DicomAsJson;
 
+        case OrthancPluginContentType_Preview:
+          return FileContentType_Preview;
+
         default:
           return FileContentType_Unknown;
       }
@@ -16,7 +16,7 @@
  *    - Register all its REST callbacks using ::OrthancPluginRegisterRestCallback().
  *    - Possibly register its callback for received DICOM instances using ::OrthancPluginRegisterOnStoredInstanceCallback().
  *    - Possibly register its callback for changes to the DICOM store using ::OrthancPluginRegisterOnChangeCallback().
- *    - Possibly register a custom storage area using ::OrthancPluginRegisterStorageArea().
+ *    - Possibly register a custom storage area using ::OrthancPluginRegisterStorageArea() or ::OrthancPluginRegisterStorageArea2().
  *    - Possibly register a custom database back-end area using OrthancPluginRegisterDatabaseBackendV2().
  *    - Possibly register a handler for C-Find SCP against DICOM worklists using OrthancPluginRegisterWorklistCallback().
  *    - Possibly register a custom decoder for DICOM images using OrthancPluginRegisterDecodeImageCallback().
@@ -410,6 +410,7 @@ extern "C"
     _OrthancPluginService_RegisterRestCallbackNoLock = 1004,
     _OrthancPluginService_RegisterWorklistCallback = 1005,
     _OrthancPluginService_RegisterDecodeImageCallback = 1006,
+    _OrthancPluginService_RegisterStorageArea2 = 1007,
 
     /* Sending answers to REST calls */
     _OrthancPluginService_AnswerBuffer = 2000,
@@ -561,6 +562,7 @@ extern "C"
     OrthancPluginContentType_Unknown = 0,      /*!< Unknown content type */
     OrthancPluginContentType_Dicom = 1,        /*!< DICOM */
     OrthancPluginContentType_DicomAsJson = 2,  /*!< JSON summary of a DICOM file */
+    OrthancPluginContentType_Preview = 3,      /*!< Spilled preview of a frame */
 
     _OrthancPluginContentType_INTERNAL = 0x7fffffff
   } OrthancPluginContentType;
@@ -913,6 +915,31 @@ extern "C"
 
 
 
+  /**
+   * @brief Callback for reading a range of a file from the storage area.
+   *
+   * Signature of a callback function that is triggered when Orthanc
+   * reads a part of a file from the storage area, e.g. to answer a
+   * HTTP request with a "Range" header, or to stream a large file to
+   * the HTTP client without loading it into memory.
+   *
+   * @param target The target buffer, that is allocated by Orthanc and that can contain "rangeSize" bytes (output).
+   * @param uuid The UUID of the file of interest.
+   * @param type The content type corresponding to this file. 
+   * @param rangeStart Offset of the first byte of the range.
+   * @param rangeSize Number of bytes to be read.
+   * @return 0 if success, other value if error.
+   * @ingroup Callbacks
+   **/
+  typedef OrthancPluginErrorCode (*OrthancPluginStorageReadRange) (
+    void* target,
+    const char* uuid,
+    OrthancPluginContentType type,
+    uint64_t rangeStart,
+    uint64_t rangeSize);
+
+
+
   /**
    * @brief Callback for removing a file from the storage area.
    *
@@ -2286,6 +2313,57 @@ extern "C"
 
 
 
+  typedef struct
+  {
+    OrthancPluginStorageCreate     create;
+    OrthancPluginStorageRead       read;
+    OrthancPluginStorageReadRange  readRange;
+    OrthancPluginStorageRemove     remove;
+    OrthancPluginFree              free;
+  } _OrthancPluginRegisterStorageArea2;
+
+  /**
+   * @brief Register a custom storage area, with support for range reads.
+   *
+   * This function is similar to OrthancPluginRegisterStorageArea(),
+   * but it additionally registers a callback that reads a part of a
+   * file. Orthanc uses this callback to stream large uncompressed
+   * files to the HTTP clients, and to answer the HTTP requests with
+   * a "Range" header, without reading the whole file into memory.
+   * This function must be called during the initialization of the
+   * plugin, i.e. inside the OrthancPluginInitialize() public function.
+   * 
+   * @param context The Orthanc plugin context, as received by OrthancPluginInitialize().
+   * @param create The callback function to store a file on the custom storage area.
+   * @param read The callback function to read a whole file from the custom storage area.
+   * @param readRange The callback function to read a range of a file from the custom storage area. Can be NULL.
+   * @param remove The callback function to remove a file from the custom storage area.
+   * @ingroup Callbacks
+   **/
+  ORTHANC_PLUGIN_INLINE void OrthancPluginRegisterStorageArea2(
+    OrthancPluginContext*          context,
+    OrthancPluginStorageCreate     create,
+    OrthancPluginStorageRead       read,
+    OrthancPluginStorageReadRange  readRange,
+    OrthancPluginStorageRemove     remove)
+  {
+    _OrthancPluginRegisterStorageArea2 params;
+    params.create = create;
+    params.read = read;
+    params.readRange = readRange;
+    params.remove = remove;
+
+#ifdef  __cplusplus
+    params.free = ::free;
+#else
+    params.free = free;
+#endif
+
+    context->InvokeService(context, _OrthancPluginService_RegisterStorageArea2, &params);
+  }
+
+
+
   /**
    * @brief Return the path to the Orthanc executable.
    *
@@ -35,9 +35,11 @@
 
 #include "OrthancCDatabasePlugin.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <list>
 #include <string>
+#include <vector>
 
 namespace OrthancPlugins
 {
@@ -92,6 +94,7 @@ namespace OrthancPlugins
   class DatabaseBackendOutput : public NonCopyable
   {
     friend class DatabaseBackendAdapter;
+    friend class IDatabaseBackend;
 
   private:
     enum AllowedAnswers
@@ -101,12 +104,14 @@ namespace OrthancPlugins
       AllowedAnswers_Attachment,
       AllowedAnswers_Change,
       AllowedAnswers_DicomTag,
-      AllowedAnswers_ExportedResource
+      AllowedAnswers_ExportedResource,
+      AllowedAnswers_MainDicomTag
     };
 
     OrthancPluginContext*         context_;
     OrthancPluginDatabaseContext* database_;
     AllowedAnswers                allowedAnswers_;
+    int64_t                       currentResource_;  // For "AnswerDicomTag()" in bulk mode
 
     void SetAllowedAnswers(AllowedAnswers allowed)
     {
@@ -118,7 +123,8 @@ namespace OrthancPlugins
                           OrthancPluginDatabaseContext* database) :
       context_(context),
       database_(database),
-      allowedAnswers_(AllowedAnswers_All /* for unit tests */)
+      allowedAnswers_(AllowedAnswers_All /* for unit tests */),
+      currentResource_(-1)
     {
     }
 
@@ -226,6 +232,13 @@ namespace OrthancPlugins
                         uint16_t element,
                         const std::string& value)
     {
+      if (allowedAnswers_ == AllowedAnswers_MainDicomTag)
+      {
+        // Default implementation of "IDatabaseBackend::GetMainDicomTagsBulk()"
+        AnswerMainDicomTag(currentResource_, group, element, value);
+        return;
+      }
+
       if (allowedAnswers_ != AllowedAnswers_All &&
           allowedAnswers_ != AllowedAnswers_DicomTag)
       {
@@ -240,6 +253,25 @@ namespace OrthancPlugins
       OrthancPluginDatabaseAnswerDicomTag(context_, database_, &tag);
     }
 
+    void AnswerMainDicomTag(int64_t resourceId,
+                            uint16_t group,
+                            uint16_t element,
+                            const std::string& value)
+    {
+      if (allowedAnswers_ != AllowedAnswers_All &&
+          allowedAnswers_ != AllowedAnswers_MainDicomTag)
+      {
+        throw std::runtime_error("Cannot answer with a main DICOM tag in the current state");
+      }
+
+      OrthancPluginDicomTag tag;
+      tag.group = group;
+      tag.element = element;
+      tag.value = value.c_str();
+
+      OrthancPluginDatabaseAnswerMainDicomTag(context_, database_, resourceId, &tag);
+    }
+
     void AnswerExportedResource(int64_t                    seq,
                                 OrthancPluginResourceType  resourceType,
                                 const std::string&         publicId,
@@ -350,6 +382,36 @@ namespace OrthancPlugins
                                  uint64_t since,
                                  uint64_t limit) = 0;
 
+    /* Lists at most "limit" resources whose internal identifier is
+       strictly greater than "after", sorted by increasing internal
+       identifier. The default implementation scans all the resources
+       of the level: Override it with a range query. */
+    virtual void GetPublicIdsAfter(std::list< std::pair<int64_t, std::string> >& target,
+                                   OrthancPluginResourceType resourceType,
+                                   int64_t after,
+                                   uint64_t limit)
+    {
+      std::list<int64_t> all;
+      GetAllInternalIds(all, resourceType);
+
+      std::vector<int64_t> ids;
+      for (std::list<int64_t>::const_iterator it = all.begin(); it != all.end(); ++it)
+      {
+        if (*it > after)
+        {
+          ids.push_back(*it);
+        }
+      }
+
+      std::sort(ids.begin(), ids.end());
+
+      target.clear();
+      for (size_t i = 0; i < ids.size() && i < limit; i++)
+      {
+        target.push_back(std::make_pair(ids[i], GetPublicId(ids[i])));
+      }
+    }
+
     /* Use GetOutput().AnswerChange() */
     virtual void GetChanges(bool& done /*out*/,
                             int64_t since,
@@ -375,6 +437,18 @@ namespace OrthancPlugins
     /* Use GetOutput().AnswerDicomTag() */
     virtual void GetMainDicomTags(int64_t id) = 0;
 
+    /* Use GetOutput().AnswerMainDicomTag(). The default implementation
+       calls "GetMainDicomTags()" once per resource: Override it to
+       retrieve the tags of all the resources at once. */
+    virtual void GetMainDicomTagsBulk(const std::vector<int64_t>& ids)
+    {
+      for (size_t i = 0; i < ids.size(); i++)
+      {
+        output_->currentResource_ = ids[i];
+        GetMainDicomTags(ids[i]);
+      }
+    }
+
     virtual std::string GetPublicId(int64_t resourceId) = 0;
 
     virtual uint64_t GetResourceCount(OrthancPluginResourceType resourceType) = 0;
@@ -785,6 +859,42 @@ namespace OrthancPlugins
     }
 
 
+    static OrthancPluginErrorCode  GetPublicIdsAfter(OrthancPluginDatabaseContext* context,
+                                                     void* payload,
+                                                     OrthancPluginResourceType resourceType,
+                                                     int64_t after,
+                                                     uint64_t limit)
+    {
+      IDatabaseBackend* backend = reinterpret_cast<IDatabaseBackend*>(payload);
+      backend->GetOutput().SetAllowedAnswers(DatabaseBackendOutput::AllowedAnswers_None);
+
+      try
+      {
+        std::list< std::pair<int64_t, std::string> > ids;
+        backend->GetPublicIdsAfter(ids, resourceType, after, limit);
+
+        for (std::list< std::pair<int64_t, std::string> >::const_iterator
+               it = ids.begin(); it != ids.end(); ++it)
+        {
+          OrthancPluginDatabaseAnswerPublicId(backend->GetOutput().context_,
+                                              backend->GetOutput().database_,
+                                              it->first, it->second.c_str());
+        }
+
+        return OrthancPluginErrorCode_Success;
+      }
+      catch (std::runtime_error& e)
+      {
+        LogError(backend, e);
+        return OrthancPluginErrorCode_DatabasePlugin;
+      }
+      catch (DatabaseException& e)
+      {
+        return e.GetErrorCode();
+      }
+    }
+
+
     static OrthancPluginErrorCode  GetChanges(OrthancPluginDatabaseContext* context,
                                               void* payload,
                                               int64_t since,
@@ -987,6 +1097,32 @@ namespace OrthancPlugins
     }
           
          
+    static OrthancPluginErrorCode  GetMainDicomTagsBulk(OrthancPluginDatabaseContext* context,
+                                                        void* payload,
+                                                        const int64_t* ids,
+                                                        uint32_t idsCount)
+    {
+      IDatabaseBackend* backend = reinterpret_cast<IDatabaseBackend*>(payload);
+      backend->GetOutput().SetAllowedAnswers(DatabaseBackendOutput::AllowedAnswers_MainDicomTag);
+
+      try
+      {
+        std::vector<int64_t> tmp(ids, ids + idsCount);
+        backend->GetMainDicomTagsBulk(tmp);
+        return OrthancPluginErrorCode_Success;
+      }
+      catch (std::runtime_error& e)
+      {
+        LogError(backend, e);
+        return OrthancPluginErrorCode_DatabasePlugin;
+      }
+      catch (DatabaseException& e)
+      {
+        return e.GetErrorCode();
+      }
+    }
+
+         
     static OrthancPluginErrorCode  GetPublicId(OrthancPluginDatabaseContext* context,
                                                void* payload,
                                                int64_t id)
@@ -1882,6 +2018,8 @@ namespace OrthancPlugins
       extensions.clearMainDicomTags = ClearMainDicomTags;
       extensions.getAllInternalIds = GetAllInternalIds;   // New in Orthanc 0.9.5 (db v6)
       extensions.lookupIdentifier3 = LookupIdentifier3;   // New in Orthanc 0.9.5 (db v6)
+      extensions.getMainDicomTagsBulk = GetMainDicomTagsBulk;   // New in Orthanc mainline
+      extensions.getPublicIdsAfter = GetPublicIdsAfter;         // New in Orthanc mainline
 
       OrthancPluginDatabaseContext* database = OrthancPluginRegisterDatabaseBackendV2(context, &params, &extensions, &backend);
       if (!context)
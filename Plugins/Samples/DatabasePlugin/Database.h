@@ -119,6 +119,14 @@ public:
     base_.GetAllPublicIds(target, Orthanc::Plugins::Convert(resourceType), since, limit);
   }
 
+  virtual void GetPublicIdsAfter(std::list< std::pair<int64_t, std::string> >& target,
+                                 OrthancPluginResourceType resourceType,
+                                 int64_t after,
+                                 uint64_t limit)
+  {
+    base_.GetPublicIdsAfter(target, Orthanc::Plugins::Convert(resourceType), after, limit);
+  }
+
   virtual void GetChanges(bool& done /*out*/,
                           int64_t since,
                           uint32_t maxResults);
@@ -102,6 +102,35 @@ static OrthancPluginErrorCode StorageRead(void** content,
 }
 
 
+static OrthancPluginErrorCode StorageReadRange(void* target,
+                                               const char* uuid,
+                                               OrthancPluginContentType type,
+                                               uint64_t rangeStart,
+                                               uint64_t rangeSize)
+{
+  std::string path = GetPath(uuid);
+
+  FILE* fp = fopen(path.c_str(), "rb");
+  if (!fp)
+  {
+    return OrthancPluginErrorCode_StorageAreaPlugin;
+  }
+
+  if (fseek(fp, rangeStart, SEEK_SET) < 0)
+  {
+    fclose(fp);
+    return OrthancPluginErrorCode_StorageAreaPlugin;
+  }
+
+  bool ok = (rangeSize == 0 ||
+             fread(target, rangeSize, 1, fp) == 1);
+
+  fclose(fp);
+
+  return ok ? OrthancPluginErrorCode_Success : OrthancPluginErrorCode_StorageAreaPlugin;
+}
+
+
 static OrthancPluginErrorCode StorageRemove(const char* uuid,
                                             OrthancPluginContentType type)
 {
@@ -138,7 +167,7 @@ extern "C"
       return -1;
     }
 
-    OrthancPluginRegisterStorageArea(context, StorageCreate, StorageRead, StorageRemove);
+    OrthancPluginRegisterStorageArea2(context, StorageCreate, StorageRead, StorageReadRange, StorageRemove);
 
     return 0;
   }
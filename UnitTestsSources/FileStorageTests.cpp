@@ -34,6 +34,7 @@
 #include "gtest/gtest.h"
 
 #include <ctype.h>
+#include <boost/lexical_cast.hpp>
 
 #include "../Core/FileStorage/FilesystemStorage.h"
 #include "../Core/FileStorage/StorageAccessor.h"
@@ -41,6 +42,7 @@
 #include "../Core/HttpServer/FilesystemHttpSender.h"
 #include "../Core/Logging.h"
 #include "../Core/OrthancException.h"
+#include "../Core/RestApi/RestApiOutput.h"
 #include "../Core/Toolbox.h"
 #include "../Core/Uuid.h"
 #include "../OrthancServer/ServerIndex.h"
@@ -48,6 +50,38 @@
 using namespace Orthanc;
 
 
+namespace
+{
+  class HeaderAndBodyStream : public IHttpOutputStream
+  {
+  public:
+    std::string  header_;
+    std::string  body_;
+
+    virtual void OnHttpStatusReceived(HttpStatus status)
+    {
+    }
+
+    virtual void Send(bool isHeader, const void* buffer, size_t length)
+    {
+      (isHeader ? header_ : body_).append(reinterpret_cast<const char*>(buffer), length);
+    }
+  };
+}
+
+
+static void AnswerFileRange(HeaderAndBodyStream& stream,
+                            StorageAccessor& accessor,
+                            const FileInfo& info,
+                            const std::string& range)
+{
+  HttpOutput output(stream, false);
+  RestApiOutput restOutput(output, HttpMethod_Get);
+  accessor.AnswerFileRange(restOutput, info, "text/plain", range);
+  restOutput.Finalize();
+}
+
+
 static void StringToVector(std::vector<uint8_t>& v,
                            const std::string& s)
 {
@@ -86,6 +120,44 @@ TEST(FilesystemStorage, Basic2)
   ASSERT_EQ(s.GetSize(uid), data.size());
 }
 
+TEST(FilesystemStorage, ReadRange)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  ASSERT_TRUE(s.HasReadRange());
+
+  std::string data = "Hello world";
+  std::string uid = Toolbox::GenerateUuid();
+  s.Create(uid.c_str(), &data[0], data.size(), FileContentType_Unknown);
+
+  std::string d;
+  s.ReadRange(d, uid, FileContentType_Unknown, 0, 5);
+  ASSERT_EQ("Hello", d);
+  s.ReadRange(d, uid, FileContentType_Unknown, 6, 5);
+  ASSERT_EQ("world", d);
+  s.ReadRange(d, uid, FileContentType_Unknown, 11, 0);
+  ASSERT_TRUE(d.empty());
+
+  ASSERT_THROW(s.ReadRange(d, uid, FileContentType_Unknown, 6, 6), OrthancException);
+  ASSERT_THROW(s.ReadRange(d, uid, FileContentType_Unknown, 12, 0), OrthancException);
+
+  // The same parts, through one reader that keeps the file open
+  {
+    std::auto_ptr<IStorageArea::IRangeReader> reader(s.OpenRangeReader(uid, FileContentType_Unknown));
+    reader->Read(d, 0, 5);
+    ASSERT_EQ("Hello", d);
+    reader->Read(d, 5, 6);
+    ASSERT_EQ(" world", d);
+    reader->Read(d, 0, 11);
+    ASSERT_EQ(data, d);
+    ASSERT_THROW(reader->Read(d, 6, 6), OrthancException);
+    reader->Read(d, 6, 5);  // Still usable after an error
+    ASSERT_EQ("world", d);
+  }
+
+  s.Remove(uid, FileContentType_Unknown);
+  ASSERT_THROW(s.OpenRangeReader(uid, FileContentType_Unknown), OrthancException);
+}
+
 TEST(FilesystemStorage, EndToEnd)
 {
   FilesystemStorage s("UnitTestsStorage");
@@ -163,6 +235,98 @@ TEST(StorageAccessor, Compression)
 }
 
 
+TEST(StorageAccessor, Lz4)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  StorageAccessor accessor(s);
+
+  std::string data;
+  for (unsigned int i = 0; i < 10000; i++)
+  {
+    data += boost::lexical_cast<std::string>(i % 100) + " ";
+  }
+
+  FileInfo info = accessor.Write(data, FileContentType_Dicom, CompressionType_Lz4WithSize, true);
+  ASSERT_EQ(CompressionType_Lz4WithSize, info.GetCompressionType());
+  ASSERT_EQ(data.size(), info.GetUncompressedSize());
+
+  std::string r;
+  accessor.Read(r, info);
+  ASSERT_EQ(data, r);
+
+  std::string md5, compressed, compressedMD5;
+  Toolbox::ComputeMD5(md5, data);
+  s.Read(compressed, info.GetUuid(), FileContentType_Dicom);
+  Toolbox::ComputeMD5(compressedMD5, compressed);
+  ASSERT_EQ(md5, info.GetUncompressedMD5());
+  ASSERT_EQ(compressedMD5, info.GetCompressedMD5());
+  ASSERT_EQ(compressed.size(), info.GetCompressedSize());
+  ASSERT_LT(compressed.size(), data.size());
+
+  info = accessor.Write("", FileContentType_Dicom, CompressionType_Lz4WithSize, true);
+  ASSERT_EQ(0u, info.GetCompressedSize());
+  accessor.Read(r, info);
+  ASSERT_TRUE(r.empty());
+}
+
+
+TEST(StorageAccessor, CompressionLevel)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  StorageAccessor accessor(s);
+  ASSERT_THROW(accessor.SetCompressionLevel(10), OrthancException);
+
+  // More than one step of the incremental compression
+  std::string data;
+  for (unsigned int i = 0; i < 100000; i++)
+  {
+    data += boost::lexical_cast<std::string>(i % 1000) + " ";
+  }
+
+  std::string md5;
+  Toolbox::ComputeMD5(md5, data);
+
+  size_t previous = 0;
+
+  for (uint8_t level = 1; level <= 9; level += 4)
+  {
+    accessor.SetCompressionLevel(level);
+    FileInfo info = accessor.Write(data, FileContentType_Dicom, CompressionType_ZlibWithSize, true);
+
+    std::string r;
+    accessor.Read(r, info);
+    ASSERT_EQ(data, r);
+
+    // The MD5 must match those that are computed in separate passes
+    std::string compressed, compressedMD5;
+    s.Read(compressed, info.GetUuid(), FileContentType_Dicom);
+    Toolbox::ComputeMD5(compressedMD5, compressed);
+    ASSERT_EQ(md5, info.GetUncompressedMD5());
+    ASSERT_EQ(compressedMD5, info.GetCompressedMD5());
+    ASSERT_EQ(compressed.size(), info.GetCompressedSize());
+    ASSERT_LT(compressed.size(), data.size());
+
+    if (previous != 0)
+    {
+      ASSERT_LE(compressed.size(), previous);
+    }
+
+    previous = compressed.size();
+    accessor.Remove(info);
+  }
+
+  // Empty attachment
+  FileInfo info = accessor.Write("", FileContentType_Dicom, CompressionType_ZlibWithSize, true);
+  ASSERT_EQ(0u, info.GetCompressedSize());
+  ASSERT_EQ("d41d8cd98f00b204e9800998ecf8427e", info.GetUncompressedMD5());
+  ASSERT_EQ("d41d8cd98f00b204e9800998ecf8427e", info.GetCompressedMD5());
+
+  std::string r;
+  accessor.Read(r, info);
+  ASSERT_TRUE(r.empty());
+}
+
+
 TEST(StorageAccessor, Mix)
 {
   FilesystemStorage s("UnitTestsStorage");
@@ -188,3 +352,44 @@ TEST(StorageAccessor, Mix)
   ASSERT_THROW(accessor.Read(r, uncompressedInfo.GetUuid(), FileContentType_Unknown), OrthancException);
   */
 }
+
+
+TEST(StorageAccessor, AnswerFileRange)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  StorageAccessor accessor(s);
+
+  // The uncompressed file is streamed, the compressed one is not
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    FileInfo info = accessor.Write("hello world", FileContentType_Dicom, 
+                                   i == 0 ? CompressionType_None : CompressionType_ZlibWithSize, false);
+
+    {
+      HeaderAndBodyStream stream;
+      AnswerFileRange(stream, accessor, info, "");
+      ASSERT_EQ(0u, stream.header_.find("HTTP/1.1 200 OK\r\n"));
+      ASSERT_NE(std::string::npos, stream.header_.find("Accept-Ranges: bytes\r\n"));
+      ASSERT_EQ("hello world", stream.body_);
+    }
+
+    {
+      HeaderAndBodyStream stream;
+      AnswerFileRange(stream, accessor, info, "bytes=6-");
+      ASSERT_EQ(0u, stream.header_.find("HTTP/1.1 206 Partial Content\r\n"));
+      ASSERT_NE(std::string::npos, stream.header_.find("Accept-Ranges: bytes\r\n"));
+      ASSERT_NE(std::string::npos, stream.header_.find("Content-Range: bytes 6-10/11\r\n"));
+      ASSERT_EQ("world", stream.body_);
+    }
+
+    {
+      HeaderAndBodyStream stream;
+      AnswerFileRange(stream, accessor, info, "bytes=20-");
+      ASSERT_EQ(0u, stream.header_.find("HTTP/1.1 416 Requested Range Not Satisfiable\r\n"));
+      ASSERT_NE(std::string::npos, stream.header_.find("Content-Range: bytes */11\r\n"));
+      ASSERT_TRUE(stream.body_.empty());
+    }
+
+    accessor.Remove(info);
+  }
+}
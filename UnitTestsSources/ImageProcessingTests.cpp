@@ -35,7 +35,13 @@
 
 #include "../Core/DicomFormat/DicomImageInformation.h"
 #include "../Core/Images/ImageBuffer.h"
+#include "../Core/Images/Image.h"
 #include "../Core/Images/ImageProcessing.h"
+#include "../Core/OrthancException.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/math/special_functions/round.hpp>
+#include <limits>
 
 using namespace Orthanc;
 
@@ -78,3 +84,386 @@ TEST(DicomImageInformation, ExtractPixelFormat2)
   ASSERT_TRUE(info.ExtractPixelFormat(format, false));
   ASSERT_EQ(PixelFormat_SignedGrayscale16, format);
 }
+
+
+namespace
+{
+  // Deterministic generator, to make the tests reproducible
+  class RandomGenerator
+  {
+  private:
+    uint32_t state_;
+
+  public:
+    RandomGenerator() : state_(42)
+    {
+    }
+
+    uint16_t Next()
+    {
+      state_ = state_ * 1103515245u + 12345u;
+      return static_cast<uint16_t>(state_ >> 16);
+    }
+  };
+
+
+  // Reference implementation of the stretching of the dynamics
+  template <typename TargetType, typename SourceType>
+  TargetType ReferenceShiftScale(SourceType value,
+                                 float offset,
+                                 float scaling)
+  {
+    float v = (static_cast<float>(value) + offset) * scaling;
+
+    if (v > static_cast<float>(std::numeric_limits<TargetType>::max()))
+    {
+      return std::numeric_limits<TargetType>::max();
+    }
+    else if (v < static_cast<float>(std::numeric_limits<TargetType>::min()))
+    {
+      return std::numeric_limits<TargetType>::min();
+    }
+    else
+    {
+      return static_cast<TargetType>(boost::math::iround(v));
+    }
+  }
+
+
+  // Reference implementation of the previous "MultiplyConstant()"
+  template <typename PixelType>
+  PixelType ReferenceMultiply(PixelType value,
+                              float factor)
+  {
+    int64_t v = boost::math::llround(static_cast<float>(value) * factor);
+
+    if (v > static_cast<int64_t>(std::numeric_limits<PixelType>::max()))
+    {
+      return std::numeric_limits<PixelType>::max();
+    }
+    else if (v < static_cast<int64_t>(std::numeric_limits<PixelType>::min()))
+    {
+      return std::numeric_limits<PixelType>::min();
+    }
+    else
+    {
+      return static_cast<PixelType>(v);
+    }
+  }
+
+
+  template <typename PixelType>
+  void FillRandom(ImageAccessor& image,
+                  RandomGenerator& generator)
+  {
+    for (unsigned int y = 0; y < image.GetHeight(); y++)
+    {
+      PixelType* p = reinterpret_cast<PixelType*>(image.GetRow(y));
+      for (unsigned int x = 0; x < image.GetWidth(); x++, p++)
+      {
+        *p = static_cast<PixelType>(generator.Next());
+      }
+    }
+  }
+
+
+  template <typename PixelType>
+  PixelType GetPixel(const ImageAccessor& image,
+                     unsigned int x,
+                     unsigned int y)
+  {
+    return reinterpret_cast<const PixelType*>(image.GetConstRow(y)) [x];
+  }
+
+
+  template <typename PixelType>
+  void CheckMinMax(const ImageAccessor& image)
+  {
+    PixelType a = std::numeric_limits<PixelType>::max();
+    PixelType b = std::numeric_limits<PixelType>::min();
+
+    for (unsigned int y = 0; y < image.GetHeight(); y++)
+    {
+      for (unsigned int x = 0; x < image.GetWidth(); x++)
+      {
+        a = std::min(a, GetPixel<PixelType>(image, x, y));
+        b = std::max(b, GetPixel<PixelType>(image, x, y));
+      }
+    }
+
+    int64_t minValue, maxValue;
+    ImageProcessing::GetMinMaxValue(minValue, maxValue, image);
+    ASSERT_EQ(static_cast<int64_t>(a), minValue);
+    ASSERT_EQ(static_cast<int64_t>(b), maxValue);
+  }
+
+
+  template <typename TargetType, typename SourceType>
+  void CheckShiftScale(PixelFormat targetFormat,
+                       const ImageAccessor& source,
+                       float offset,
+                       float scaling)
+  {
+    Image target(targetFormat, source.GetWidth(), source.GetHeight());
+    ImageProcessing::ShiftScale(target, source, offset, scaling);
+
+    for (unsigned int y = 0; y < source.GetHeight(); y++)
+    {
+      for (unsigned int x = 0; x < source.GetWidth(); x++)
+      {
+        ASSERT_EQ(ReferenceShiftScale<TargetType>(GetPixel<SourceType>(source, x, y), offset, scaling),
+                  GetPixel<TargetType>(target, x, y));
+      }
+    }
+  }
+
+
+  template <typename PixelType>
+  void CheckInPlace(const ImageAccessor& source,
+                    float offset,
+                    float scaling)
+  {
+    Image image(source.GetFormat(), source.GetWidth(), source.GetHeight());
+    ImageProcessing::Copy(image, source);
+    ImageProcessing::ShiftScale(image, offset, scaling);
+
+    Image multiplied(source.GetFormat(), source.GetWidth(), source.GetHeight());
+    ImageProcessing::Copy(multiplied, source);
+    ImageProcessing::MultiplyConstant(multiplied, scaling);
+
+    for (unsigned int y = 0; y < source.GetHeight(); y++)
+    {
+      for (unsigned int x = 0; x < source.GetWidth(); x++)
+      {
+        PixelType v = GetPixel<PixelType>(source, x, y);
+        ASSERT_EQ(ReferenceShiftScale<PixelType>(v, offset, scaling), GetPixel<PixelType>(image, x, y));
+        ASSERT_EQ(ReferenceMultiply<PixelType>(v, scaling), GetPixel<PixelType>(multiplied, x, y));
+      }
+    }
+  }
+
+
+  template <typename SourceType>
+  void CheckConvertToGrayscale8(const ImageAccessor& source)
+  {
+    Image target(PixelFormat_Grayscale8, source.GetWidth(), source.GetHeight());
+    ImageProcessing::Convert(target, source);
+
+    for (unsigned int y = 0; y < source.GetHeight(); y++)
+    {
+      for (unsigned int x = 0; x < source.GetWidth(); x++)
+      {
+        int32_t v = GetPixel<SourceType>(source, x, y);
+        ASSERT_EQ(std::max(0, std::min(255, v)), GetPixel<uint8_t>(target, x, y));
+      }
+    }
+  }
+
+
+  template <typename PixelType>
+  void CheckKernels(PixelFormat format)
+  {
+    RandomGenerator generator;
+
+    // Widths that are not multiple of the size of the vectors, in
+    // order to test the scalar loops for the end of the rows
+    const unsigned int widths[] = { 1, 7, 8, 15, 16, 17, 33, 100 };
+
+    for (size_t i = 0; i < sizeof(widths) / sizeof(unsigned int); i++)
+    {
+      Image image(format, widths[i], 5);
+      FillRandom<PixelType>(image, generator);
+
+      CheckMinMax<PixelType>(image);
+
+      if (format != PixelFormat_Grayscale8)
+      {
+        CheckConvertToGrayscale8<PixelType>(image);
+      }
+
+      // A scaling of 0.5 produces halfway cases on odd values
+      const float offsets[] = { 0.0f, -1000.0f, 300.5f };
+      const float scalings[] = { 0.5f, 255.0f / 4095.0f, 1.7f, -3.0f };
+
+      for (size_t j = 0; j < sizeof(offsets) / sizeof(float); j++)
+      {
+        for (size_t k = 0; k < sizeof(scalings) / sizeof(float); k++)
+        {
+          CheckInPlace<PixelType>(image, offsets[j], scalings[k]);
+          CheckShiftScale<uint8_t, PixelType>(PixelFormat_Grayscale8, image, offsets[j], scalings[k]);
+        }
+      }
+    }
+  }
+}
+
+
+TEST(ImageProcessing, Kernels)
+{
+  CheckKernels<uint8_t>(PixelFormat_Grayscale8);
+  CheckKernels<uint16_t>(PixelFormat_Grayscale16);
+  CheckKernels<int16_t>(PixelFormat_SignedGrayscale16);
+}
+
+
+TEST(ImageProcessing, MinMaxValue)
+{
+  Image image(PixelFormat_SignedGrayscale16, 19, 2);
+  ImageProcessing::Set(image, -5);
+  reinterpret_cast<int16_t*>(image.GetRow(1)) [17] = -32768;
+  reinterpret_cast<int16_t*>(image.GetRow(0)) [3] = 32767;
+
+  int64_t a, b;
+  ImageProcessing::GetMinMaxValue(a, b, image);
+  ASSERT_EQ(-32768, a);
+  ASSERT_EQ(32767, b);
+
+  Image image2(PixelFormat_Grayscale16, 0, 0);
+  ImageProcessing::GetMinMaxValue(a, b, image2);
+  ASSERT_EQ(0, a);
+  ASSERT_EQ(0, b);
+}
+
+
+TEST(ImageAccessor, GetRegion)
+{
+  Image image(PixelFormat_Grayscale16, 10, 8);
+  for (unsigned int y = 0; y < 8; y++)
+  {
+    for (unsigned int x = 0; x < 10; x++)
+    {
+      reinterpret_cast<uint16_t*>(image.GetRow(y)) [x] = static_cast<uint16_t>(100 * y + x);
+    }
+  }
+
+  ImageAccessor region = image.GetRegion(3, 2, 4, 5);
+  ASSERT_EQ(PixelFormat_Grayscale16, region.GetFormat());
+  ASSERT_EQ(4u, region.GetWidth());
+  ASSERT_EQ(5u, region.GetHeight());
+  ASSERT_EQ(image.GetPitch(), region.GetPitch());
+  ASSERT_FALSE(region.IsReadOnly());
+  ASSERT_EQ(203, GetPixel<uint16_t>(region, 0, 0));
+  ASSERT_EQ(606, GetPixel<uint16_t>(region, 3, 4));
+
+  ASSERT_EQ(0u, image.GetRegion(10, 8, 0, 0).GetWidth());
+  ASSERT_THROW(image.GetRegion(7, 0, 4, 1), OrthancException);
+  ASSERT_THROW(image.GetRegion(0, 4, 1, 5), OrthancException);
+}
+
+
+TEST(ImageProcessing, Resize)
+{
+  Image source(PixelFormat_Grayscale8, 4, 2);
+  const uint8_t values[] = { 0, 10, 20, 31,
+                             2, 12, 100, 200 };
+  for (unsigned int y = 0; y < 2; y++)
+  {
+    memcpy(source.GetRow(y), values + 4 * y, 4);
+  }
+
+  // Area averaging: (0 + 10 + 2 + 12) / 4, (20 + 31 + 100 + 200) / 4
+  Image half(PixelFormat_Grayscale8, 2, 1);
+  ImageProcessing::Resize(half, source);
+  ASSERT_EQ(6, GetPixel<uint8_t>(half, 0, 0));
+  ASSERT_EQ(88, GetPixel<uint8_t>(half, 1, 0));
+
+  // Upsampling: Nearest neighbor
+  Image twice(PixelFormat_Grayscale8, 8, 4);
+  ImageProcessing::Resize(twice, source);
+  ASSERT_EQ(31, GetPixel<uint8_t>(twice, 7, 1));
+  ASSERT_EQ(100, GetPixel<uint8_t>(twice, 4, 2));
+  ASSERT_EQ(100, GetPixel<uint8_t>(twice, 5, 3));
+
+  // Rounding of the negative values away from zero
+  Image s16(PixelFormat_SignedGrayscale16, 2, 1);
+  reinterpret_cast<int16_t*>(s16.GetRow(0)) [0] = -3;
+  reinterpret_cast<int16_t*>(s16.GetRow(0)) [1] = -4;
+  Image s16b(PixelFormat_SignedGrayscale16, 1, 1);
+  ImageProcessing::Resize(s16b, s16);
+  ASSERT_EQ(-4, GetPixel<int16_t>(s16b, 0, 0));
+
+  // Channels are averaged separately
+  Image rgb(PixelFormat_RGB24, 2, 1);
+  const uint8_t colors[] = { 255, 0, 10, 0, 255, 20 };
+  memcpy(rgb.GetRow(0), colors, 6);
+  Image rgb2(PixelFormat_RGB24, 1, 1);
+  ImageProcessing::Resize(rgb2, rgb);
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(rgb2.GetConstRow(0));
+  ASSERT_EQ(128, p[0]);
+  ASSERT_EQ(128, p[1]);
+  ASSERT_EQ(15, p[2]);
+
+  ASSERT_THROW(ImageProcessing::Resize(rgb2, source), OrthancException);
+}
+
+
+TEST(ImageProcessing, ApplyWindowing)
+{
+  // CT-like image: Stored values with slope 1 and intercept -1024
+  Image source(PixelFormat_Grayscale16, 5, 1);
+  uint16_t* s = reinterpret_cast<uint16_t*>(source.GetRow(0));
+  s[0] = 0;       // -1024 HU
+  s[1] = 824;     // -200 HU
+  s[2] = 1064;    // 40 HU
+  s[3] = 1264;    // 240 HU
+  s[4] = 4095;    // 3071 HU
+
+  Image target(PixelFormat_Grayscale8, 5, 1);
+
+  // Soft tissue window: [40 - 0.5 - 199.5, 40 - 0.5 + 199.5]
+  ImageProcessing::ApplyWindowing(target, source, 40.0f, 400.0f, 1.0f, -1024.0f);
+  ASSERT_EQ(0, GetPixel<uint8_t>(target, 0, 0));
+  ASSERT_EQ(0, GetPixel<uint8_t>(target, 1, 0));
+  ASSERT_EQ(128, GetPixel<uint8_t>(target, 2, 0));
+  ASSERT_EQ(255, GetPixel<uint8_t>(target, 3, 0));
+  ASSERT_EQ(255, GetPixel<uint8_t>(target, 4, 0));
+
+  // Slope of 2: The stored values 824, 1064 and 1264 respectively
+  // correspond to 624, 1104 and 1504 in the units of the modality
+  ImageProcessing::ApplyWindowing(target, source, 1104.0f, 400.0f, 2.0f, -1024.0f);
+  ASSERT_EQ(0, GetPixel<uint8_t>(target, 1, 0));
+  ASSERT_EQ(128, GetPixel<uint8_t>(target, 2, 0));
+  ASSERT_EQ(255, GetPixel<uint8_t>(target, 3, 0));
+
+  Image wrong(PixelFormat_Grayscale16, 5, 1);
+  ASSERT_THROW(ImageProcessing::ApplyWindowing(wrong, source, 40.0f, 400.0f, 1.0f, 0.0f), OrthancException);
+  ASSERT_THROW(ImageProcessing::ApplyWindowing(target, source, 40.0f, 0.5f, 1.0f, 0.0f), OrthancException);
+}
+
+
+// Run with "--gtest_also_run_disabled_tests" to measure the speed
+// of the kernels that are used to generate the previews
+TEST(ImageProcessing, DISABLED_Benchmark)
+{
+  const unsigned int width = 4096;
+  const unsigned int height = 4096;
+
+  Image source(PixelFormat_Grayscale16, width, height);
+  RandomGenerator generator;
+  FillRandom<uint16_t>(source, generator);
+
+  Image target(PixelFormat_Grayscale8, width, height);
+  Image copy(PixelFormat_Grayscale16, width, height);
+
+  for (unsigned int i = 0; i < 5; i++)
+  {
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    int64_t a, b;
+    ImageProcessing::GetMinMaxValue(a, b, source);
+    boost::posix_time::ptime t1 = boost::posix_time::microsec_clock::universal_time();
+    ImageProcessing::ShiftScale(target, source, static_cast<float>(-a), 255.0f / static_cast<float>(b - a));
+    boost::posix_time::ptime t2 = boost::posix_time::microsec_clock::universal_time();
+    ImageProcessing::Copy(copy, source);
+    boost::posix_time::ptime t3 = boost::posix_time::microsec_clock::universal_time();
+    ImageProcessing::ShiftScale(copy, static_cast<float>(-a), 255.0f / static_cast<float>(b - a));
+    boost::posix_time::ptime t4 = boost::posix_time::microsec_clock::universal_time();
+    ImageProcessing::Convert(target, copy);
+    boost::posix_time::ptime t5 = boost::posix_time::microsec_clock::universal_time();
+
+    printf("MinMax: %d us, fused ShiftScale: %d us, in-place ShiftScale: %d us, Convert: %d us\n",
+           static_cast<int>((t1 - start).total_microseconds()),
+           static_cast<int>((t2 - t1).total_microseconds()),
+           static_cast<int>((t4 - t3).total_microseconds()),
+           static_cast<int>((t5 - t4).total_microseconds()));
+  }
+}
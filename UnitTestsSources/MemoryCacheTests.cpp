@@ -37,6 +37,7 @@
 #include <boost/thread.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include "../Core/Cache/ConcurrentMemoryCache.h"
 #include "../Core/Cache/MemoryCache.h"
 #include "../Core/Cache/SharedArchive.h"
 #include "../Core/IDynamicObject.h"
@@ -228,6 +229,110 @@ TEST(MemoryCache, Basic)
 
 
 
+namespace
+{
+  class SizedIntegerProvider : public Orthanc::ConcurrentMemoryCache::IPageProvider
+  {
+  public:
+    std::string log_;
+
+    Orthanc::IDynamicObject* Provide(size_t& size,
+                                     const std::string& s)
+    {
+      int value = boost::lexical_cast<int>(s);
+      size = static_cast<size_t>(value);
+      return new Integer(log_, value);
+    }
+  };
+
+
+  void AccessConcurrentCache(Orthanc::ConcurrentMemoryCache* cache,
+                             int seed)
+  {
+    for (int i = 0; i < 100; i++)
+    {
+      Orthanc::ConcurrentMemoryCache::Accessor accessor(*cache, boost::lexical_cast<std::string>((seed + i * 7) % 10 + 1));
+      ASSERT_TRUE(dynamic_cast<Integer*>(&accessor.GetItem()) != NULL);
+    }
+  }
+}
+
+
+TEST(ConcurrentMemoryCache, Basic)
+{
+  SizedIntegerProvider provider;
+  Orthanc::ConcurrentMemoryCache::Statistics s;
+
+  {
+    Orthanc::ConcurrentMemoryCache cache(provider, 10);
+    { Orthanc::ConcurrentMemoryCache::Accessor a(cache, "4"); }  // 4 -> size 4
+    { Orthanc::ConcurrentMemoryCache::Accessor a(cache, "5"); }  // 5, 4 -> size 9
+    { Orthanc::ConcurrentMemoryCache::Accessor a(cache, "4"); }  // 4, 5 -> size 9
+    ASSERT_EQ("", provider.log_);
+
+    { Orthanc::ConcurrentMemoryCache::Accessor a(cache, "3"); }  // 5 is removed; 3, 4 -> size 7
+    ASSERT_EQ("5 ", provider.log_);
+
+    {
+      // The pinned page "4" cannot be recycled
+      Orthanc::ConcurrentMemoryCache::Accessor a(cache, "4");
+      { Orthanc::ConcurrentMemoryCache::Accessor b(cache, "7"); }  // 3 and 7 are removed
+      ASSERT_EQ("5 3 7 ", provider.log_);
+    }
+
+    cache.GetStatistics(s);
+    ASSERT_EQ(2u, s.hits_);
+    ASSERT_EQ(4u, s.misses_);
+    ASSERT_EQ(3u, s.evictions_);
+    ASSERT_EQ(1u, s.countPages_);
+    ASSERT_EQ(4u, s.currentSize_);
+
+    ASSERT_THROW(Orthanc::ConcurrentMemoryCache::Accessor(cache, "nope"), std::exception);
+    cache.GetStatistics(s);
+    ASSERT_EQ(1u, s.countPages_);
+
+    {
+      Orthanc::ConcurrentMemoryCache::Accessor a(cache, "4");
+      cache.Invalidate("4");  // The page is deleted once released
+      cache.GetStatistics(s);
+      ASSERT_EQ(0u, s.countPages_);
+      ASSERT_EQ(0u, s.currentSize_);
+      ASSERT_EQ("5 3 7 ", provider.log_);
+    }
+
+    ASSERT_EQ("5 3 7 4 ", provider.log_);
+
+    { Orthanc::ConcurrentMemoryCache::Accessor a(cache, "2"); }
+    cache.SetMaximumSize(0);
+    ASSERT_EQ("5 3 7 4 2 ", provider.log_);
+  }
+}
+
+
+TEST(ConcurrentMemoryCache, Threads)
+{
+  SizedIntegerProvider provider;
+  Orthanc::ConcurrentMemoryCache cache(provider, 20);
+
+  std::vector<boost::thread*> threads;
+  for (int i = 0; i < 4; i++)
+  {
+    threads.push_back(new boost::thread(AccessConcurrentCache, &cache, i));
+  }
+
+  for (size_t i = 0; i < threads.size(); i++)
+  {
+    threads[i]->join();
+    delete threads[i];
+  }
+
+  Orthanc::ConcurrentMemoryCache::Statistics s;
+  cache.GetStatistics(s);
+  ASSERT_EQ(400u, s.hits_ + s.misses_);
+  ASSERT_GE(20u, s.currentSize_);
+}
+
+
 
 
 namespace
@@ -34,11 +34,14 @@
 #include "gtest/gtest.h"
 
 #include "../OrthancServer/Scheduler/ServerScheduler.h"
+#include "../OrthancServer/Scheduler/StorePeerCommand.h"
+#include "../Core/HttpServer/HttpToolbox.h"
 #include "../Core/OrthancException.h"
 #include "../Core/Toolbox.h"
 #include "../Core/MultiThreading/Locker.h"
 #include "../Core/MultiThreading/Mutex.h"
 #include "../Core/MultiThreading/ReaderWriterLock.h"
+#include "../Core/MultiThreading/Semaphore.h"
 
 using namespace Orthanc;
 
@@ -126,6 +129,87 @@ TEST(MultiThreading, ReaderWriterLock)
 }
 
 
+#include "../Core/MultiThreading/RunnableWorkersPool.h"
+
+namespace
+{
+  class BlockingRunnable : public IRunnableBySteps
+  {
+  private:
+    const bool& release_;
+
+  public:
+    BlockingRunnable(const bool& release) : release_(release)
+    {
+    }
+
+    virtual bool Step()
+    {
+      while (!release_)
+      {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+      }
+
+      return false;
+    }
+  };
+
+
+  bool WaitForPool(RunnableWorkersPool& pool,
+                   size_t countWorkers,
+                   size_t countRunnables,
+                   size_t countActive)
+  {
+    RunnableWorkersPool::Statistics statistics;
+
+    for (unsigned int i = 0; i < 5000; i++)
+    {
+      pool.GetStatistics(statistics);
+      if (statistics.countWorkers_ == countWorkers &&
+          statistics.countRunnables_ == countRunnables &&
+          statistics.countActive_ == countActive)
+      {
+        return true;
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+    return false;
+  }
+}
+
+
+TEST(MultiThreading, RunnableWorkersPoolElastic)
+{
+  ASSERT_THROW(RunnableWorkersPool(0), OrthancException);
+  ASSERT_THROW(RunnableWorkersPool(3, 2), OrthancException);
+
+  bool release = false;
+
+  RunnableWorkersPool pool(1, 3);
+  pool.SetIdleTimeout(200);
+
+  RunnableWorkersPool::Statistics statistics;
+  pool.GetStatistics(statistics);
+  ASSERT_EQ(1u, statistics.countWorkers_);
+  ASSERT_EQ(1u, statistics.minWorkers_);
+  ASSERT_EQ(3u, statistics.maxWorkers_);
+  ASSERT_EQ(0u, statistics.countRunnables_);
+
+  for (unsigned int i = 0; i < 5; i++)
+  {
+    pool.Add(new BlockingRunnable(release));
+  }
+
+  // The pool has grown to its maximum, 2 runnables are waiting
+  ASSERT_TRUE(WaitForPool(pool, 3, 5, 3));
+
+  release = true;
+  ASSERT_TRUE(WaitForPool(pool, 1, 0, 0));  // Shrinks back once idle
+}
+
+
 
 #include "../OrthancServer/DicomProtocol/ReusableDicomUserConnection.h"
 
@@ -257,3 +341,333 @@ TEST(MultiThreading, ServerScheduler)
     t.join();
   }
 }
+
+
+
+namespace
+{
+  // Counts the commands that run concurrently. The gate holds the
+  // commands until "threshold_" of them are running at the same time,
+  // which makes the maximum concurrency deterministic.
+  struct CommandGate
+  {
+    boost::mutex               mutex_;
+    boost::condition_variable  opened_;
+    unsigned int               threshold_;
+    unsigned int               running_;
+    unsigned int               maxRunning_;
+    bool                       isOpen_;
+
+    explicit CommandGate(unsigned int threshold) :
+      threshold_(threshold),
+      running_(0),
+      maxRunning_(0),
+      isOpen_(false)
+    {
+    }
+  };
+
+
+  class SlowCommand : public IServerCommand
+  {
+  private:
+    std::string   destination_;
+    CommandGate&  gate_;
+
+  public:
+    SlowCommand(const std::string& destination,
+                CommandGate& gate) :
+      destination_(destination),
+      gate_(gate)
+    {
+    }
+
+    virtual bool Apply(ListOfStrings& outputs,
+                       const ListOfStrings& inputs)
+    {
+      {
+        boost::mutex::scoped_lock lock(gate_.mutex_);
+        gate_.running_++;
+        gate_.maxRunning_ = std::max(gate_.maxRunning_, gate_.running_);
+
+        if (gate_.running_ >= gate_.threshold_)
+        {
+          gate_.isOpen_ = true;
+          gate_.opened_.notify_all();
+        }
+
+        // The timeout only prevents a deadlock if the scheduler does
+        // not reach the threshold, which makes the test fail below
+        const boost::system_time timeout = boost::get_system_time() + boost::posix_time::seconds(10);
+        while (!gate_.isOpen_)
+        {
+          if (!gate_.opened_.timed_wait(lock, timeout))
+          {
+            gate_.isOpen_ = true;
+          }
+        }
+      }
+
+      // Give the scheduler a chance to exceed its limit
+      Toolbox::USleep(20000);
+
+      {
+        boost::mutex::scoped_lock lock(gate_.mutex_);
+        gate_.running_--;
+      }
+
+      outputs = inputs;
+      return true;
+    }
+
+    virtual std::string GetDestination() const
+    {
+      return destination_;
+    }
+  };
+}
+
+
+TEST(MultiThreading, ServerSchedulerDestinations)
+{
+  ServerScheduler scheduler(10, 4);
+  scheduler.SetConcurrencyPerDestination(2);
+
+  CommandGate slow(2);   // Wait until the limit of the destination is reached
+  CommandGate local(1);  // Never wait
+
+  ServerJob job;
+  for (int i = 0; i < 6; i++)
+  {
+    ServerCommandInstance& a = job.AddCommand(new SlowCommand("slow", slow));
+    a.AddInput(boost::lexical_cast<std::string>(i));
+    a.SetConnectedToSink(true);
+
+    ServerCommandInstance& b = job.AddCommand(new SlowCommand("", local));
+    b.AddInput(boost::lexical_cast<std::string>(10 + i));
+    b.SetConnectedToSink(true);
+  }
+
+  IServerCommand::ListOfStrings l;
+  ASSERT_TRUE(scheduler.SubmitAndWait(l, job));
+  ASSERT_EQ(12u, l.size());
+
+  // The concurrency per destination is reached, but never exceeded
+  ASSERT_EQ(2u, slow.maxRunning_);
+  ASSERT_LE(local.maxRunning_, 4u);
+
+  Json::Value s;
+  scheduler.FormatStatistics(s);
+  ASSERT_EQ(4u, s["Threads"].asUInt());
+  ASSERT_EQ(0u, s["ActiveJobs"].asUInt());
+  ASSERT_EQ(0u, s["ReadyCommands"].asUInt());
+  ASSERT_EQ(0u, s["WaitingCommands"].asUInt());
+  ASSERT_EQ(6u, s["Destinations"]["slow"]["Commands"].asUInt());
+  ASSERT_EQ(6u, s["Destinations"]["slow"]["Items"].asUInt());
+  ASSERT_EQ(0u, s["Destinations"]["slow"]["Running"].asUInt());
+  ASSERT_EQ(0u, s["Destinations"]["slow"]["Queued"].asUInt());
+  ASSERT_FALSE(s["Destinations"].isMember(""));
+
+  scheduler.Stop();
+}
+
+
+static void AcquireSemaphore(Semaphore* semaphore, bool* acquired)
+{
+  semaphore->Acquire();
+  *acquired = true;
+}
+
+
+namespace
+{
+  // Emulates the "/instances" URI of an Orthanc peer. The files whose
+  // content is "bad" are not valid DICOM files.
+  class FakePeerConnection : public StorePeerCommand::IPeerConnection
+  {
+  public:
+    enum Mode
+    {
+      Mode_Bundles,     // Recent version of Orthanc
+      Mode_NoBundles,   // Older version of Orthanc
+      Mode_Failure,     // Internal error of the peer
+      Mode_BadAnswer    // Unexpected answer to the bundles
+    };
+
+  private:
+    Mode  mode_;
+
+  public:
+    std::vector<std::string>  stored_;
+    unsigned int              countRequests_;
+
+    FakePeerConnection(Mode mode) :
+      mode_(mode),
+      countRequests_(0)
+    {
+    }
+
+    virtual bool PostInstances(std::string& answer,
+                               HttpStatus& status,
+                               std::string& body,
+                               const std::string& contentType)
+    {
+      countRequests_++;
+
+      std::string boundary;
+      if (mode_ == Mode_Failure)
+      {
+        status = HttpStatus_500_InternalServerError;
+        return false;
+      }
+      else if (!HttpToolbox::ParseMultipartBoundary(boundary, contentType))
+      {
+        if (body == "bad")
+        {
+          status = HttpStatus_400_BadRequest;
+          return false;
+        }
+
+        stored_.push_back(body);
+        answer = "{}";
+        return true;
+      }
+      else if (mode_ == Mode_NoBundles)
+      {
+        // The bundle is not a valid DICOM file
+        status = HttpStatus_400_BadRequest;
+        return false;
+      }
+      else if (mode_ == Mode_BadAnswer)
+      {
+        answer = "[]";
+        return true;
+      }
+
+      std::vector<HttpToolbox::MultipartPart> parts;
+      HttpToolbox::ParseMultipartBody(parts, body.c_str(), body.size(), boundary);
+
+      Json::Value result = Json::arrayValue;
+      for (size_t i = 0; i < parts.size(); i++)
+      {
+        std::string part(parts[i].data_, parts[i].size_);
+
+        Json::Value item = Json::objectValue;
+        if (part == "bad")
+        {
+          item["Status"] = "Failure";
+        }
+        else
+        {
+          stored_.push_back(part);
+          item["ID"] = part;
+          item["Status"] = "Success";
+        }
+
+        result.append(item);
+      }
+
+      Json::FastWriter writer;
+      answer = writer.write(result);
+      return true;
+    }
+  };
+}
+
+
+TEST(StorePeerCommand, UploadBundle)
+{
+  std::vector<std::string> files;
+  files.push_back("a");
+  files.push_back("bad");
+  files.push_back("c");
+
+  std::vector<std::string> errors;
+
+  {
+    FakePeerConnection peer(FakePeerConnection::Mode_Bundles);
+    bool bundlesSupported = true;
+    StorePeerCommand::UploadBundle(errors, bundlesSupported, peer, files);
+    ASSERT_TRUE(bundlesSupported);
+    ASSERT_EQ(1u, peer.countRequests_);
+    ASSERT_EQ(2u, peer.stored_.size());
+    ASSERT_EQ("a", peer.stored_[0]);
+    ASSERT_EQ("c", peer.stored_[1]);
+    ASSERT_EQ(3u, errors.size());
+    ASSERT_TRUE(errors[0].empty());
+    ASSERT_FALSE(errors[1].empty());
+    ASSERT_TRUE(errors[2].empty());
+  }
+
+  {
+    // Fallback to one file per request
+    FakePeerConnection peer(FakePeerConnection::Mode_NoBundles);
+    bool bundlesSupported = true;
+    StorePeerCommand::UploadBundle(errors, bundlesSupported, peer, files);
+    ASSERT_FALSE(bundlesSupported);
+    ASSERT_EQ(4u, peer.countRequests_);
+    ASSERT_EQ(2u, peer.stored_.size());
+    ASSERT_TRUE(errors[0].empty());
+    ASSERT_FALSE(errors[1].empty());
+    ASSERT_TRUE(errors[2].empty());
+
+    // No bundle is tried anymore
+    StorePeerCommand::UploadBundle(errors, bundlesSupported, peer, files);
+    ASSERT_EQ(7u, peer.countRequests_);
+    ASSERT_EQ(4u, peer.stored_.size());
+  }
+
+  {
+    // Other errors are not retried, so that no file is sent twice
+    FakePeerConnection peer(FakePeerConnection::Mode_Failure);
+    bool bundlesSupported = true;
+    StorePeerCommand::UploadBundle(errors, bundlesSupported, peer, files);
+    ASSERT_TRUE(bundlesSupported);
+    ASSERT_EQ(1u, peer.countRequests_);
+    ASSERT_FALSE(errors[0].empty());
+    ASSERT_FALSE(errors[1].empty());
+    ASSERT_FALSE(errors[2].empty());
+  }
+
+  {
+    FakePeerConnection peer(FakePeerConnection::Mode_BadAnswer);
+    bool bundlesSupported = true;
+    StorePeerCommand::UploadBundle(errors, bundlesSupported, peer, files);
+    ASSERT_TRUE(bundlesSupported);
+    ASSERT_EQ(1u, peer.countRequests_);
+    ASSERT_FALSE(errors[0].empty());
+    ASSERT_FALSE(errors[2].empty());
+  }
+
+  {
+    // A single file is never bundled
+    FakePeerConnection peer(FakePeerConnection::Mode_NoBundles);
+    bool bundlesSupported = true;
+    StorePeerCommand::UploadBundle(errors, bundlesSupported, peer, std::vector<std::string>(1, "a"));
+    ASSERT_TRUE(bundlesSupported);
+    ASSERT_EQ(1u, peer.countRequests_);
+    ASSERT_EQ(1u, errors.size());
+    ASSERT_TRUE(errors[0].empty());
+  }
+}
+
+
+TEST(MultiThreading, Semaphore)
+{
+  ASSERT_THROW(Semaphore(0), OrthancException);
+
+  Semaphore semaphore(2);
+  semaphore.Acquire();
+  semaphore.Acquire();
+
+  bool acquired = false;
+  boost::thread t(AcquireSemaphore, &semaphore, &acquired);
+
+  // The third acquisition blocks until a release
+  Toolbox::USleep(50000);
+  ASSERT_FALSE(acquired);
+
+  semaphore.Release();
+  t.join();
+  ASSERT_TRUE(acquired);
+}
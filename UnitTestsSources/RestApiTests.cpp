@@ -45,7 +45,10 @@
 #include "../Core/OrthancException.h"
 #include "../Core/Compression/ZlibCompressor.h"
 #include "../Core/RestApi/RestApiHierarchy.h"
+#include "../Core/RestApi/RestApiJsonStream.h"
 #include "../Core/HttpServer/HttpContentNegociation.h"
+#include "../Core/HttpServer/BufferHttpSender.h"
+#include "../Core/HttpServer/HttpToolbox.h"
 
 using namespace Orthanc;
 
@@ -461,3 +464,330 @@ TEST(RestApi, HttpContentNegociation)
     ASSERT_EQ("plain", h.GetSubType());
   }
 }
+
+
+namespace
+{
+  class AccumulatorHttpOutputStream : public IHttpOutputStream
+  {
+  public:
+    std::string  header_;
+    std::string  body_;
+    std::string  raw_;
+
+    virtual void OnHttpStatusReceived(HttpStatus status)
+    {
+    }
+
+    virtual void Send(bool isHeader, const void* buffer, size_t length)
+    {
+      std::string s(reinterpret_cast<const char*>(buffer), length);
+      (isHeader ? header_ : body_).append(s);
+      raw_.append(s);
+    }
+  };
+}
+
+
+TEST(RestApi, HttpOutputStream)
+{
+  AccumulatorHttpOutputStream stream;
+
+  {
+    HttpOutput output(stream, false);
+    ASSERT_THROW(output.SendStreamItem("a", 1), OrthancException);
+
+    output.StartStream("application/zip");
+    ASSERT_TRUE(output.IsWritingStream());
+    ASSERT_THROW(output.StartStream("application/zip"), OrthancException);
+
+    output.SendStreamItem("hello", 5);
+    output.SendStreamItem("", 0);  // Ignored
+    output.SendStreamItem(std::string(26, 'x').c_str(), 26);
+    output.CloseStream();
+    ASSERT_FALSE(output.IsWritingStream());
+  }
+
+  // The framing of the chunks is not part of the body
+  ASSERT_EQ("hello" + std::string(26, 'x'), stream.body_);
+  ASSERT_NE(std::string::npos, stream.header_.find("Transfer-Encoding: chunked\r\n\r\n"));
+  ASSERT_NE(std::string::npos, stream.raw_.find("\r\n\r\n5\r\nhello\r\n1a\r\nxxxxxxxxxxxxxxxxxxxxxxxxxx\r\n0\r\n\r\n"));
+}
+
+
+TEST(RestApi, ParseRange)
+{
+  uint64_t start, length;
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(start, length, "bytes=0-499", 1000));
+  ASSERT_EQ(0u, start);
+  ASSERT_EQ(500u, length);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(start, length, "bytes=500-", 1000));
+  ASSERT_EQ(500u, start);
+  ASSERT_EQ(500u, length);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(start, length, "bytes=-100", 1000));
+  ASSERT_EQ(900u, start);
+  ASSERT_EQ(100u, length);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(start, length, "bytes=-2000", 1000));
+  ASSERT_EQ(0u, start);
+  ASSERT_EQ(1000u, length);
+
+  ASSERT_TRUE(HttpToolbox::ParseRange(start, length, " bytes=900-5000 ", 1000));
+  ASSERT_EQ(900u, start);
+  ASSERT_EQ(100u, length);
+
+  // Not satisfiable
+  ASSERT_TRUE(HttpToolbox::ParseRange(start, length, "bytes=1000-", 1000));
+  ASSERT_EQ(0u, length);
+  ASSERT_TRUE(HttpToolbox::ParseRange(start, length, "bytes=-0", 1000));
+  ASSERT_EQ(0u, length);
+
+  // Ignored
+  ASSERT_FALSE(HttpToolbox::ParseRange(start, length, "", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(start, length, "items=0-10", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(start, length, "bytes=10", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(start, length, "bytes=20-10", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(start, length, "bytes=0-10,20-30", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(start, length, "bytes=a-10", 1000));
+  ASSERT_FALSE(HttpToolbox::ParseRange(start, length, "bytes=-", 1000));
+}
+
+
+TEST(RestApi, Multipart)
+{
+  std::string boundary;
+  ASSERT_TRUE(HttpToolbox::ParseMultipartBoundary(boundary, "multipart/related; type=application/dicom; boundary=abc"));
+  ASSERT_EQ("abc", boundary);
+  ASSERT_TRUE(HttpToolbox::ParseMultipartBoundary(boundary, "multipart/form-data;boundary=\"x y\""));
+  ASSERT_EQ("x y", boundary);
+  ASSERT_FALSE(HttpToolbox::ParseMultipartBoundary(boundary, "application/dicom"));
+  ASSERT_FALSE(HttpToolbox::ParseMultipartBoundary(boundary, "multipart/related"));
+  ASSERT_FALSE(HttpToolbox::ParseMultipartBoundary(boundary, ""));
+
+  const std::string binary("a\r\n--bound\0b", 12);
+
+  // The bodies that are written by "HttpOutput" can be parsed back
+  AccumulatorHttpOutputStream stream;
+
+  {
+    std::map<std::string, std::string> headers;
+    HttpOutput output(stream, false);
+    output.StartMultipart("related", "application/dicom");
+    output.SendMultipartItem("hello", 5, headers);
+    output.SendMultipartItem(NULL, 0, headers);
+    output.SendMultipartItem(binary.c_str(), binary.size(), headers);
+    output.CloseMultipart();
+  }
+
+  const std::string prefix = "Content-Type: ";
+  size_t start = stream.header_.find(prefix) + prefix.size();
+  ASSERT_TRUE(HttpToolbox::ParseMultipartBoundary
+              (boundary, stream.header_.substr(start, stream.header_.find("\r\n", start) - start)));
+
+  std::string body = stream.body_;
+  std::vector<HttpToolbox::MultipartPart> parts;
+  HttpToolbox::ParseMultipartBody(parts, body.c_str(), body.size(), boundary);
+  ASSERT_EQ(3u, parts.size());
+  ASSERT_EQ("hello", std::string(parts[0].data_, parts[0].size_));
+  ASSERT_EQ(0u, parts[1].size_);
+  ASSERT_EQ(binary, std::string(parts[2].data_, parts[2].size_));
+
+  // Preamble and part without headers
+  body = "preamble\r\n--b\r\n\r\nworld\r\n--b--";
+  HttpToolbox::ParseMultipartBody(parts, body.c_str(), body.size(), "b");
+  ASSERT_EQ(1u, parts.size());
+  ASSERT_EQ("world", std::string(parts[0].data_, parts[0].size_));
+
+  // Truncated bodies
+  body = "--b\r\n\r\nworld";
+  ASSERT_THROW(HttpToolbox::ParseMultipartBody(parts, body.c_str(), body.size(), "b"), OrthancException);
+  body = "nothing";
+  ASSERT_THROW(HttpToolbox::ParseMultipartBody(parts, body.c_str(), body.size(), "b"), OrthancException);
+}
+
+
+TEST(RestApi, HttpOutputRange)
+{
+  AccumulatorHttpOutputStream stream;
+
+  {
+    BufferHttpSender sender;
+    sender.GetBuffer() = "world";
+
+    HttpOutput output(stream, false);
+    output.AnswerRange(sender, 6, 11);
+  }
+
+  ASSERT_EQ("world", stream.body_);
+  ASSERT_EQ(0u, stream.header_.find("HTTP/1.1 206 Partial Content\r\n"));
+  ASSERT_NE(std::string::npos, stream.header_.find("Content-Range: bytes 6-10/11\r\n"));
+  ASSERT_NE(std::string::npos, stream.header_.find("Content-Length: 5\r\n"));
+
+  {
+    BufferHttpSender sender;
+    sender.GetBuffer() = "world";
+
+    HttpOutput output(stream, false);
+    ASSERT_THROW(output.AnswerRange(sender, 7, 11), OrthancException);
+  }
+
+  {
+    AccumulatorHttpOutputStream stream2;
+    HttpOutput output(stream2, false);
+    output.AddHeader("Accept-Ranges", "bytes");  // Cleared
+    output.SendRangeNotSatisfiable(11);
+
+    ASSERT_EQ(0u, stream2.header_.find("HTTP/1.1 416 Requested Range Not Satisfiable\r\n"));
+    ASSERT_NE(std::string::npos, stream2.header_.find("Content-Range: bytes */11\r\n"));
+    ASSERT_EQ(std::string::npos, stream2.header_.find("Accept-Ranges"));
+    ASSERT_TRUE(stream2.body_.empty());
+  }
+}
+
+
+static void WriteJsonStreamSample(RestApiJsonStream& stream,
+                                  unsigned int countItems)
+{
+  // The keys are written in alphabetical order, as in "Json::Value"
+  stream.StartObject();
+  stream.WriteKey("Done");
+  stream.WriteValue(true);
+  stream.WriteKey("Empty");
+  stream.StartObject();
+  stream.EndObject();
+  stream.WriteKey("Items");
+  stream.StartArray();
+
+  for (unsigned int i = 0; i < countItems; i++)
+  {
+    Json::Value item = Json::objectValue;
+    item["ID"] = i;
+    item["Name"] = "item \"" + boost::lexical_cast<std::string>(i) + "\"";
+    item["Tags"] = Json::arrayValue;
+    item["Tags"].append("a");
+    item["Tags"].append(Json::nullValue);
+    stream.WriteValue(item);
+  }
+
+  stream.EndArray();
+  stream.EndObject();
+}
+
+
+TEST(RestApi, JsonStream)
+{
+  for (unsigned int k = 0; k < 3; k++)
+  {
+    const unsigned int countItems = (k == 0 ? 10 : 5000);
+    const bool pretty = (k == 2);
+
+    AccumulatorHttpOutputStream stream;
+
+    Json::Value expected;
+
+    {
+      HttpOutput output(stream, false);
+      RestApiOutput restOutput(output, HttpMethod_Get);
+      restOutput.SetPrettyPrint(pretty);
+
+      RestApiJsonStream json(restOutput);
+      ASSERT_EQ(!pretty, json.IsStreamed());
+      WriteJsonStreamSample(json, countItems);
+      json.Close();
+
+      ASSERT_THROW(json.Close(), OrthancException);
+      ASSERT_THROW(json.WriteValue(42), OrthancException);
+    }
+
+    Json::Value answer;
+    Json::Reader reader;
+    ASSERT_TRUE(reader.parse(stream.body_, answer));
+    ASSERT_EQ(countItems, answer["Items"].size());
+    ASSERT_EQ(Json::objectValue, answer["Empty"].type());
+    ASSERT_EQ(0u, answer["Empty"].size());
+    ASSERT_TRUE(answer["Done"].asBool());
+    ASSERT_EQ(static_cast<int>(countItems - 1), answer["Items"][countItems - 1]["ID"].asInt());
+    ASSERT_EQ("item \"3\"", answer["Items"][3]["Name"].asString());
+    ASSERT_EQ(Json::nullValue, answer["Items"][3]["Tags"][1].type());
+
+    const bool chunked = (stream.header_.find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+    if (pretty)
+    {
+      // The tree is built in memory and pretty-printed
+      ASSERT_FALSE(chunked);
+      Json::StyledWriter writer;
+      ASSERT_EQ(writer.write(answer), stream.body_);
+    }
+    else
+    {
+      // The output is compact, and only large answers are chunked
+      ASSERT_EQ(countItems > 10, chunked);
+      Json::FastWriter writer;
+      ASSERT_EQ(writer.write(answer), stream.body_ + "\n");
+    }
+  }
+
+  {
+    AccumulatorHttpOutputStream stream;
+    HttpOutput output(stream, false);
+    RestApiOutput restOutput(output, HttpMethod_Get);
+    RestApiJsonStream json(restOutput);
+
+    ASSERT_THROW(json.Close(), OrthancException);  // No value
+    ASSERT_THROW(json.WriteKey("a"), OrthancException);  // Not in an object
+    ASSERT_THROW(json.EndArray(), OrthancException);
+
+    json.StartArray();
+    ASSERT_THROW(json.WriteKey("a"), OrthancException);
+    ASSERT_THROW(json.EndObject(), OrthancException);
+    json.StartObject();
+    ASSERT_THROW(json.WriteValue(1), OrthancException);  // Missing key
+    json.WriteKey("a");
+    ASSERT_THROW(json.WriteKey("b"), OrthancException);
+    ASSERT_THROW(json.EndObject(), OrthancException);  // Missing value
+    json.WriteValue("hello");
+    json.EndObject();
+    ASSERT_THROW(json.Close(), OrthancException);  // Array not closed
+    json.EndArray();
+    ASSERT_THROW(json.StartArray(), OrthancException);  // Only one root
+    json.Close();
+
+    ASSERT_EQ("[{\"a\":\"hello\"}]", stream.body_);
+  }
+
+  {
+    // Error in the middle of a streamed answer: The chunked body is
+    // not terminated, and the output stays in the streaming state, so
+    // that the HTTP server closes the connection
+    AccumulatorHttpOutputStream stream;
+    HttpOutput output(stream, true);
+    RestApiOutput restOutput(output, HttpMethod_Get);
+
+    try
+    {
+      RestApiJsonStream json(restOutput);
+      json.StartArray();
+
+      for (unsigned int i = 0; i < 20000; i++)  // More than one chunk
+      {
+        json.WriteValue("item " + boost::lexical_cast<std::string>(i));
+      }
+
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+    catch (OrthancException&)
+    {
+    }
+
+    ASSERT_TRUE(output.IsWritingStream());
+    ASSERT_FALSE(stream.body_.empty());
+    ASSERT_EQ(std::string::npos, stream.raw_.find("\r\n0\r\n\r\n"));
+    ASSERT_THROW(output.SendStatus(HttpStatus_404_NotFound), OrthancException);
+
+    // A handler that returns without closing its stream is an error
+    ASSERT_THROW(restOutput.Finalize(), OrthancException);
+  }
+}
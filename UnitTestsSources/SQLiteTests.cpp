@@ -66,6 +66,28 @@ TEST(SQLite, Connection)
 }
 
 
+TEST(SQLite, ReadOnlyConnection)
+{
+  Toolbox::RemoveFile("UnitTestsResults/readonly");
+
+  SQLite::Connection reader;
+  ASSERT_THROW(reader.OpenReadOnly("UnitTestsResults/readonly"), OrthancException);
+
+  SQLite::Connection writer;
+  writer.Open("UnitTestsResults/readonly");
+  writer.Execute("CREATE TABLE c(k INTEGER PRIMARY KEY AUTOINCREMENT, v INTEGER)");
+  writer.Execute("INSERT INTO c VALUES(NULL, 42);");
+
+  reader.OpenReadOnly("UnitTestsResults/readonly");
+
+  SQLite::Statement s(reader, "SELECT v FROM c");
+  ASSERT_TRUE(s.Step());
+  ASSERT_EQ(42, s.ColumnInt(0));
+  ASSERT_FALSE(reader.Execute("INSERT INTO c VALUES(NULL, 43);"));
+  ASSERT_FALSE(s.Step());
+}
+
+
 TEST(SQLite, StatementReferenceBasic)
 {
   sqlite3* db;
@@ -129,6 +151,83 @@ TEST(SQLite, StatementBasic)
 }
 
 
+TEST(SQLite, DynamicStatements)
+{
+  SQLite::Connection c;
+  c.OpenInMemory();
+  c.Execute("CREATE TABLE t(v INTEGER)");
+  c.Execute("INSERT INTO t VALUES(1)");
+  c.Execute("INSERT INTO t VALUES(2)");
+
+  ASSERT_THROW(c.SetDynamicStatementsCacheSize(0), OrthancException);
+  c.SetDynamicStatementsCacheSize(3);
+  ASSERT_EQ(3u, c.GetDynamicStatementsCacheSize());
+
+  std::vector<std::string> sql;
+  for (unsigned int i = 0; i < 5; i++)
+  {
+    sql.push_back("SELECT COUNT(*) FROM t WHERE v>=? AND " + boost::lexical_cast<std::string>(i) + "=" +
+                  boost::lexical_cast<std::string>(i));
+  }
+
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    SQLite::Statement s(c, SQLITE_DYNAMIC, sql[i]);
+    s.BindInt(0, 2);
+    ASSERT_TRUE(s.Step());
+    ASSERT_EQ(1, s.ColumnInt(0));
+  }
+
+  ASSERT_EQ(3u, c.GetDynamicStatementsCount());
+
+  {
+    // The parameters of a cached statement are reset
+    SQLite::Statement s(c, SQLITE_DYNAMIC, sql[0]);
+    ASSERT_TRUE(s.Step());
+    ASSERT_EQ(0, s.ColumnInt(0));   // "v >= NULL" is never true
+  }
+
+  // "sql[1]" is the least recently used statement
+  {
+    SQLite::Statement s(c, SQLITE_DYNAMIC, sql[3]);
+  }
+
+  ASSERT_EQ(3u, c.GetDynamicStatementsCount());
+  ASSERT_TRUE(c.HasDynamicStatement(sql[0]));
+  ASSERT_FALSE(c.HasDynamicStatement(sql[1]));
+  ASSERT_TRUE(c.HasDynamicStatement(sql[2]));
+  ASSERT_TRUE(c.HasDynamicStatement(sql[3]));
+
+  {
+    // The statements in use are never evicted
+    SQLite::Statement s2(c, SQLITE_DYNAMIC, sql[2]);
+    SQLite::Statement s0(c, SQLITE_DYNAMIC, sql[0]);
+    SQLite::Statement s3(c, SQLITE_DYNAMIC, sql[3]);
+    ASSERT_THROW(SQLite::Statement(c, SQLITE_DYNAMIC, sql[3]), OrthancException);
+
+    SQLite::Statement s4(c, SQLITE_DYNAMIC, sql[4]);
+    ASSERT_EQ(4u, c.GetDynamicStatementsCount());
+  }
+
+  {
+    SQLite::Statement s(c, SQLITE_DYNAMIC, sql[1]);
+  }
+
+  ASSERT_EQ(3u, c.GetDynamicStatementsCount());
+  ASSERT_TRUE(c.HasDynamicStatement(sql[1]));
+  ASSERT_TRUE(c.HasDynamicStatement(sql[3]));
+  ASSERT_TRUE(c.HasDynamicStatement(sql[4]));
+
+  // Invalid SQL is not cached
+  ASSERT_THROW(SQLite::Statement(c, SQLITE_DYNAMIC, "SELECT nope FROM nope"), OrthancException);
+  ASSERT_EQ(3u, c.GetDynamicStatementsCount());
+
+  c.SetDynamicStatementsCacheSize(1);
+  ASSERT_EQ(1u, c.GetDynamicStatementsCount());
+  ASSERT_TRUE(c.HasDynamicStatement(sql[1]));
+}
+
+
 namespace
 {
   static bool destroyed;
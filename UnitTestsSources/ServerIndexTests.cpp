@@ -34,15 +34,25 @@
 #include "gtest/gtest.h"
 
 #include "../Core/FileStorage/FilesystemStorage.h"
+#include "../Core/HttpServer/StringHttpOutput.h"
 #include "../Core/Logging.h"
 #include "../Core/Uuid.h"
 #include "../OrthancServer/DatabaseWrapper.h"
+#include "../OrthancServer/OrthancRestApi/OrthancRestApi.h"
 #include "../OrthancServer/ServerContext.h"
 #include "../OrthancServer/ServerIndex.h"
+#include "../OrthancServer/PreviewCache.h"
+#include "../OrthancServer/ServerListenerQueue.h"
 #include "../OrthancServer/Search/LookupIdentifierQuery.h"
+#include "../OrthancServer/Search/LookupResource.h"
+#include "../OrthancServer/Search/WildcardConstraint.h"
+#include "../OrthancServer/Search/WildcardMatcher.h"
 
 #include <ctype.h>
 #include <algorithm>
+#include <limits>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/regex.hpp>
 
 using namespace Orthanc;
 
@@ -764,6 +774,178 @@ TEST_P(DatabaseWrapperTest, LookupIdentifier)
 }
 
 
+TEST_P(DatabaseWrapperTest, LookupIdentifiersCombined)
+{
+  // The combined query must match the intersection of the separate lookups
+  std::vector<int64_t> studies;
+  for (unsigned int i = 0; i < 20; i++)
+  {
+    int64_t id = index_->CreateResource("study-" + boost::lexical_cast<std::string>(i), ResourceType_Study);
+    index_->SetIdentifierTag(id, DICOM_TAG_PATIENT_ID, (i % 2 == 0) ? "EVEN" : "ODD");
+    index_->SetIdentifierTag(id, DICOM_TAG_STUDY_DATE, "201601" + boost::lexical_cast<std::string>(10 + i));
+    index_->SetIdentifierTag(id, DICOM_TAG_ACCESSION_NUMBER, "ACC" + boost::lexical_cast<std::string>(i % 5));
+    studies.push_back(id);
+  }
+
+  // A patient with the same identifier must not be returned
+  int64_t patient = index_->CreateResource("patient", ResourceType_Patient);
+  index_->SetIdentifierTag(patient, DICOM_TAG_PATIENT_ID, "EVEN");
+
+  for (unsigned int k = 0; k < 5; k++)
+  {
+    LookupIdentifierQuery query(ResourceType_Study);
+    query.AddConstraint(DICOM_TAG_PATIENT_ID, IdentifierConstraintType_Equal, "EVEN");
+
+    if (k >= 1)
+    {
+      query.AddConstraint(DICOM_TAG_STUDY_DATE, IdentifierConstraintType_GreaterOrEqual, "20160112");
+      query.AddConstraint(DICOM_TAG_STUDY_DATE, IdentifierConstraintType_SmallerOrEqual, "20160125");
+    }
+
+    if (k >= 2)
+    {
+      LookupIdentifierQuery::Disjunction& d = query.AddDisjunction();
+      d.Add(DICOM_TAG_ACCESSION_NUMBER, IdentifierConstraintType_Equal, "ACC0");
+      d.Add(DICOM_TAG_ACCESSION_NUMBER, IdentifierConstraintType_Wildcard, "*2");
+    }
+
+    if (k >= 3)
+    {
+      query.AddConstraint(DICOM_TAG_ACCESSION_NUMBER, IdentifierConstraintType_SmallerOrEqual, "ACC1");
+    }
+
+    if (k == 4)
+    {
+      query.AddDisjunction();  // Matches nothing
+    }
+
+    SetOfResources combined(*index_, ResourceType_Study);
+    query.Apply(combined, *index_);
+
+    SetOfResources separate(*index_, ResourceType_Study);
+    query.ApplySeparately(separate, *index_);
+
+    std::list<int64_t> a, b;
+    combined.Flatten(a);
+    separate.Flatten(b);
+    a.sort();
+    b.sort();
+
+    switch (k)
+    {
+      case 0:  ASSERT_EQ(10u, a.size());  break;
+      case 1:  ASSERT_EQ(7u, a.size());  break;   // 12, 14, ..., 24
+      case 2:  ASSERT_EQ(3u, a.size());  break;   // 12, 20, 22
+      case 3:  ASSERT_EQ(1u, a.size());  break;   // 20
+      case 4:  ASSERT_EQ(0u, a.size());  break;
+      default: break;
+    }
+
+    ASSERT_TRUE(a == b);
+  }
+}
+
+
+
+TEST_P(DatabaseWrapperTest, MainDicomTagsBulk)
+{
+  // More resources than the size of one SQL query
+  std::vector<int64_t> ids;
+  for (unsigned int i = 0; i < 150; i++)
+  {
+    std::string s = boost::lexical_cast<std::string>(i);
+    int64_t id = index_->CreateResource("study-" + s, ResourceType_Study);
+    index_->SetMainDicomTag(id, DICOM_TAG_STUDY_DESCRIPTION, "description-" + s);
+
+    if (i % 2 == 0)
+    {
+      index_->SetMainDicomTag(id, DICOM_TAG_ACCESSION_NUMBER, "accession-" + s);
+    }
+
+    ids.push_back(id);
+  }
+
+  std::reverse(ids.begin(), ids.end());
+
+  std::vector<DicomMap*> tags(ids.size());
+  for (size_t i = 0; i < ids.size(); i++)
+  {
+    tags[i] = new DicomMap;
+    tags[i]->SetValue(DICOM_TAG_PATIENT_ID, "garbage");
+  }
+
+  index_->GetMainDicomTags(tags, ids);
+
+  for (size_t i = 0; i < ids.size(); i++)
+  {
+    std::string s = boost::lexical_cast<std::string>(ids.size() - 1 - i);
+
+    DicomMap expected;
+    index_->GetMainDicomTags(expected, ids[i]);
+    ASSERT_EQ(expected.GetSize(), tags[i]->GetSize());
+    ASSERT_FALSE(tags[i]->HasTag(DICOM_TAG_PATIENT_ID));
+    ASSERT_EQ("description-" + s, tags[i]->GetValue(DICOM_TAG_STUDY_DESCRIPTION).GetContent());
+    ASSERT_EQ((ids.size() - 1 - i) % 2 == 0, tags[i]->HasTag(DICOM_TAG_ACCESSION_NUMBER));
+  }
+
+  // Identifiers must be distinct
+  ids[1] = ids[0];
+  ASSERT_THROW(index_->GetMainDicomTags(tags, ids), OrthancException);
+
+  ids.resize(2);
+  ASSERT_THROW(index_->GetMainDicomTags(tags, ids), OrthancException);
+
+  for (size_t i = 0; i < tags.size(); i++)
+  {
+    delete tags[i];
+  }
+
+  std::vector<DicomMap*> noTags;
+  std::vector<int64_t> noIds;
+  index_->GetMainDicomTags(noTags, noIds);
+}
+
+
+TEST_P(DatabaseWrapperTest, PublicIdsAfter)
+{
+  std::vector<int64_t> ids;
+  for (unsigned int i = 0; i < 10; i++)
+  {
+    std::string s = boost::lexical_cast<std::string>(i);
+    ids.push_back(index_->CreateResource("study-" + s, ResourceType_Study));
+    index_->CreateResource("series-" + s, ResourceType_Series);
+  }
+
+  std::list< std::pair<int64_t, std::string> > page;
+  index_->GetPublicIdsAfter(page, ResourceType_Study, -1, 0);
+  ASSERT_TRUE(page.empty());
+
+  index_->GetPublicIdsAfter(page, ResourceType_Study, -1, 4);
+  ASSERT_EQ(4u, page.size());
+  ASSERT_EQ(ids[0], page.front().first);
+  ASSERT_EQ("study-0", page.front().second);
+  ASSERT_EQ(ids[3], page.back().first);
+
+  // Removing resources does not shift the following pages
+  index_->DeleteResource(ids[2]);
+  index_->DeleteResource(ids[4]);
+
+  index_->GetPublicIdsAfter(page, ResourceType_Study, ids[3], 4);
+  ASSERT_EQ(4u, page.size());
+  ASSERT_EQ("study-5", page.front().second);
+  ASSERT_EQ("study-8", page.back().second);
+
+  index_->GetPublicIdsAfter(page, ResourceType_Study, ids[8], 4);
+  ASSERT_EQ(1u, page.size());
+  ASSERT_EQ("study-9", page.front().second);
+
+  index_->GetPublicIdsAfter(page, ResourceType_Study, ids[9], 4);
+  ASSERT_TRUE(page.empty());
+
+  index_->GetPublicIdsAfter(page, ResourceType_Patient, -1, 4);
+  ASSERT_TRUE(page.empty());
+}
+
 
 TEST(ServerIndex, AttachmentRecycling)
 {
@@ -831,8 +1013,1401 @@ TEST(ServerIndex, AttachmentRecycling)
 }
 
 
-TEST(LookupIdentifierQuery, NormalizeIdentifier)
+TEST(ServerIndex, MainDicomTagsWithParents)
 {
-  ASSERT_EQ("H^L.LO", LookupIdentifierQuery::NormalizeIdentifier("   Hé^l.LO  %_  "));
-  ASSERT_EQ("1.2.840.113619.2.176.2025", LookupIdentifierQuery::NormalizeIdentifier("   1.2.840.113619.2.176.2025  "));
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  DicomMap instance;
+  instance.SetValue(DICOM_TAG_PATIENT_ID, "patient");
+  instance.SetValue(DICOM_TAG_PATIENT_NAME, "name");
+  instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study");
+  instance.SetValue(DICOM_TAG_STUDY_DESCRIPTION, "description");
+  instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series");
+  instance.SetValue(DICOM_TAG_MODALITY, "CT");
+  instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance");
+  instance.SetValue(DICOM_TAG_SOP_CLASS_UID, "1.2.840.10008.5.1.4.1.1.2");
+
+  std::map<MetadataType, std::string> instanceMetadata;
+  ServerIndex::Attachments attachments;
+  DicomInstanceToStore toStore;
+  toStore.SetSummary(instance);
+  ASSERT_EQ(StoreStatus_Success, index.Store(instanceMetadata, toStore, attachments));
+
+  DicomInstanceHasher hasher(instance);
+
+  std::string s;
+  ASSERT_TRUE(index.LookupMetadata(s, hasher.HashInstance(), MetadataType_Instance_SopClassUid));
+  ASSERT_EQ("1.2.840.10008.5.1.4.1.1.2", s);
+
+  DicomMap tags;
+  ASSERT_FALSE(index.GetMainDicomTagsWithParents(tags, hasher.HashInstance(), ResourceType_Series));
+  ASSERT_FALSE(index.GetMainDicomTagsWithParents(tags, "nope", ResourceType_Series));
+
+  ASSERT_TRUE(index.GetMainDicomTagsWithParents(tags, hasher.HashSeries(), ResourceType_Series));
+  ASSERT_EQ("CT", tags.GetValue(DICOM_TAG_MODALITY).GetContent());
+  ASSERT_EQ("description", tags.GetValue(DICOM_TAG_STUDY_DESCRIPTION).GetContent());
+  ASSERT_EQ("name", tags.GetValue(DICOM_TAG_PATIENT_NAME).GetContent());
+  ASSERT_FALSE(tags.HasTag(DICOM_TAG_SOP_INSTANCE_UID));
+
+  ASSERT_TRUE(index.GetMainDicomTagsWithParents(tags, hasher.HashInstance(), ResourceType_Instance));
+  ASSERT_EQ("instance", tags.GetValue(DICOM_TAG_SOP_INSTANCE_UID).GetContent());
+  ASSERT_EQ("series", tags.GetValue(DICOM_TAG_SERIES_INSTANCE_UID).GetContent());
+  ASSERT_EQ("patient", tags.GetValue(DICOM_TAG_PATIENT_ID).GetContent());
+
+  ASSERT_TRUE(index.GetMainDicomTagsWithParents(tags, hasher.HashPatient(), ResourceType_Patient));
+  ASSERT_EQ("name", tags.GetValue(DICOM_TAG_PATIENT_NAME).GetContent());
+  ASSERT_FALSE(tags.HasTag(DICOM_TAG_STUDY_INSTANCE_UID));
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, ExpandResources)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  // Series "a" is complete with 100 instances, series "b" is missing
+  // 2 instances
+  std::string patient, study, seriesA, seriesB;
+  std::vector<std::string> instances;
+
+  for (unsigned int i = 0; i < 103; i++)
+  {
+    const bool a = (i < 100);
+
+    DicomMap instance;
+    instance.SetValue(DICOM_TAG_PATIENT_ID, "patient");
+    instance.SetValue(DICOM_TAG_PATIENT_NAME, "name");
+    instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study");
+    instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, a ? "a" : "b");
+    instance.SetValue(DICOM_TAG_CARDIAC_NUMBER_OF_IMAGES, a ? "100" : "5");
+    instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance-" + boost::lexical_cast<std::string>(i));
+    instance.SetValue(DICOM_TAG_INSTANCE_NUMBER, boost::lexical_cast<std::string>(a ? i + 1 : i - 99));
+
+    DicomInstanceHasher hasher(instance);
+    patient = hasher.HashPatient();
+    study = hasher.HashStudy();
+    (a ? seriesA : seriesB) = hasher.HashSeries();
+    instances.push_back(hasher.HashInstance());
+
+    std::map<MetadataType, std::string> instanceMetadata;
+    ServerIndex::Attachments attachments;
+    attachments.push_back(FileInfo(Toolbox::GenerateUuid(), FileContentType_Dicom, 10 + i, "md5"));
+    DicomInstanceToStore toStore;
+    toStore.SetSummary(instance);
+    ASSERT_EQ(StoreStatus_Success, index.Store(instanceMetadata, toStore, attachments));
+  }
+
+  Json::Value expanded;
+
+  {
+    std::list<std::string> ids;
+    ids.push_back("nope");   // Unknown resources are skipped
+    ids.push_back(patient);
+
+    index.ExpandResources(expanded, ids, ResourceType_Patient);
+    ASSERT_EQ(Json::arrayValue, expanded.type());
+    ASSERT_EQ(1u, expanded.size());
+
+    const Json::Value& p = expanded[0];
+    ASSERT_EQ(patient, p["ID"].asString());
+    ASSERT_EQ("Patient", p["Type"].asString());
+    ASSERT_EQ("patient", p["MainDicomTags"]["PatientID"].asString());
+    ASSERT_EQ("name", p["MainDicomTags"]["PatientName"].asString());
+    ASSERT_EQ(1u, p["Studies"].size());
+    ASSERT_EQ(study, p["Studies"][0].asString());
+    ASSERT_FALSE(p.isMember("ParentPatient"));
+  }
+
+  {
+    std::list<std::string> ids;
+    ids.push_back(study);
+
+    index.ExpandResources(expanded, ids, ResourceType_Study);
+    ASSERT_EQ(1u, expanded.size());
+
+    const Json::Value& s = expanded[0];
+    ASSERT_EQ(study, s["ID"].asString());
+    ASSERT_EQ("Study", s["Type"].asString());
+    ASSERT_EQ(patient, s["ParentPatient"].asString());
+    ASSERT_EQ("study", s["MainDicomTags"]["StudyInstanceUID"].asString());
+    ASSERT_EQ("patient", s["PatientMainDicomTags"]["PatientID"].asString());
+    ASSERT_FALSE(s["MainDicomTags"].isMember("PatientID"));
+
+    std::set<std::string> children;
+    for (Json::Value::ArrayIndex i = 0; i < s["Series"].size(); i++)
+    {
+      children.insert(s["Series"][i].asString());
+    }
+
+    ASSERT_EQ(2u, children.size());
+    ASSERT_TRUE(children.find(seriesA) != children.end());
+    ASSERT_TRUE(children.find(seriesB) != children.end());
+  }
+
+  {
+    // The answers follow the order of the request
+    std::list<std::string> ids;
+    ids.push_back(seriesB);
+    ids.push_back(seriesA);
+
+    index.ExpandResources(expanded, ids, ResourceType_Series);
+    ASSERT_EQ(2u, expanded.size());
+
+    const Json::Value& b = expanded[0];
+    ASSERT_EQ(seriesB, b["ID"].asString());
+    ASSERT_EQ("Series", b["Type"].asString());
+    ASSERT_EQ(study, b["ParentStudy"].asString());
+    ASSERT_EQ("b", b["MainDicomTags"]["SeriesInstanceUID"].asString());
+    ASSERT_EQ("Missing", b["Status"].asString());
+    ASSERT_EQ(5, b["ExpectedNumberOfInstances"].asInt());
+    ASSERT_EQ(3u, b["Instances"].size());
+
+    const Json::Value& a = expanded[1];
+    ASSERT_EQ(seriesA, a["ID"].asString());
+    ASSERT_EQ(study, a["ParentStudy"].asString());
+    ASSERT_EQ("a", a["MainDicomTags"]["SeriesInstanceUID"].asString());
+    ASSERT_EQ("Complete", a["Status"].asString());
+    ASSERT_EQ(100, a["ExpectedNumberOfInstances"].asInt());
+    ASSERT_EQ(100u, a["Instances"].size());
+
+    // Resources of another level are skipped
+    index.ExpandResources(expanded, ids, ResourceType_Study);
+    ASSERT_EQ(0u, expanded.size());
+  }
+
+  {
+    // Request the instances 3 times, so that the list spans more
+    // than one chunk of the bulk queries
+    std::list<std::string> ids;
+    for (unsigned int k = 0; k < 3; k++)
+    {
+      ids.insert(ids.end(), instances.begin(), instances.end());
+    }
+
+    index.ExpandResources(expanded, ids, ResourceType_Instance);
+    ASSERT_EQ(3 * instances.size(), expanded.size());
+
+    for (Json::Value::ArrayIndex k = 0; k < expanded.size(); k++)
+    {
+      const unsigned int i = k % instances.size();
+      const bool a = (i < 100);
+      const Json::Value& item = expanded[k];
+
+      ASSERT_EQ(instances[i], item["ID"].asString());
+      ASSERT_EQ("Instance", item["Type"].asString());
+      ASSERT_EQ(a ? seriesA : seriesB, item["ParentSeries"].asString());
+      ASSERT_EQ("instance-" + boost::lexical_cast<std::string>(i), 
+                item["MainDicomTags"]["SOPInstanceUID"].asString());
+      ASSERT_EQ(static_cast<int>(a ? i + 1 : i - 99), item["IndexInSeries"].asInt());
+      ASSERT_EQ(10 + i, item["FileSize"].asUInt());
+      ASSERT_FALSE(item.isMember("Instances"));
+    }
+  }
+
+  std::list<std::string> patients, descendants;
+  index.GetAllUuids(patients, ResourceType_Patient);
+  ASSERT_EQ(1u, patients.size());
+
+  ASSERT_TRUE(index.GetDescendants(descendants, patients.front(), ResourceType_Patient, ResourceType_Instance));
+  ASSERT_EQ(103u, descendants.size());
+  ASSERT_TRUE(index.GetDescendants(descendants, patients.front(), ResourceType_Patient, ResourceType_Series));
+  ASSERT_EQ(2u, descendants.size());
+  ASSERT_TRUE(index.GetDescendants(descendants, patients.front(), ResourceType_Patient, ResourceType_Patient));
+  ASSERT_EQ(1u, descendants.size());
+  ASSERT_FALSE(index.GetDescendants(descendants, patients.front(), ResourceType_Study, ResourceType_Series));
+  ASSERT_FALSE(index.GetDescendants(descendants, "nope", ResourceType_Patient, ResourceType_Series));
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, UuidsAfter)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+
+  std::set<std::string> expected;
+  for (unsigned int i = 0; i < 25; i++)
+  {
+    std::string s = "patient-" + boost::lexical_cast<std::string>(i);
+    db.CreateResource(s, ResourceType_Patient);
+    expected.insert(s);
+  }
+
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  std::list<std::string> page;
+  std::string next;
+  ASSERT_THROW(index.GetUuidsAfter(page, next, ResourceType_Patient, "", 0), OrthancException);
+  ASSERT_THROW(index.GetUuidsAfter(page, next, ResourceType_Patient, "nope", 10), OrthancException);
+
+  // Walk through the whole list, page by page
+  std::set<std::string> found;
+  std::string after;
+  unsigned int countPages = 0;
+
+  for (;;)
+  {
+    bool done = index.GetUuidsAfter(page, next, ResourceType_Patient, after, 10);
+    countPages++;
+
+    for (std::list<std::string>::const_iterator it = page.begin(); it != page.end(); ++it)
+    {
+      ASSERT_TRUE(found.insert(*it).second);
+    }
+
+    if (done)
+    {
+      ASSERT_TRUE(next.empty());
+      ASSERT_EQ(5u, page.size());
+      break;
+    }
+
+    ASSERT_EQ(10u, page.size());
+    ASSERT_FALSE(next.empty());
+    after = next;
+  }
+
+  ASSERT_EQ(3u, countPages);
+  ASSERT_EQ(expected, found);
+
+  // The last page is exactly full
+  ASSERT_TRUE(index.GetUuidsAfter(page, next, ResourceType_Patient, "", 25));
+  ASSERT_EQ(25u, page.size());
+
+  // No overflow while asking for one more resource than the limit
+  ASSERT_TRUE(index.GetUuidsAfter(page, next, ResourceType_Patient, "", std::numeric_limits<size_t>::max()));
+  ASSERT_EQ(25u, page.size());
+  ASSERT_TRUE(next.empty());
+
+  ASSERT_TRUE(index.GetUuidsAfter(page, next, ResourceType_Study, "", 10));
+  ASSERT_TRUE(page.empty());
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, FindCandidatesLimit)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  std::set<std::string> instances;
+
+  for (int i = 0; i < 10; i++)
+  {
+    std::string id = boost::lexical_cast<std::string>(i);
+    DicomMap instance;
+    instance.SetValue(DICOM_TAG_PATIENT_ID, "patient-" + id);
+    instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study-" + id);
+    instance.SetValue(DICOM_TAG_STUDY_DESCRIPTION, "description");
+    instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series-" + id);
+    instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance-" + id);
+
+    std::map<MetadataType, std::string> instanceMetadata;
+    ServerIndex::Attachments attachments;
+    DicomInstanceToStore toStore;
+    toStore.SetSummary(instance);
+    ASSERT_EQ(StoreStatus_Success, index.Store(instanceMetadata, toStore, attachments));
+
+    instances.insert(DicomInstanceHasher(instance).HashInstance());
+  }
+
+  std::vector<std::string> resources;
+
+  {
+    LookupResource lookup(ResourceType_Study);
+    index.FindCandidates(resources, lookup, 0);
+    ASSERT_EQ(10u, resources.size());
+    index.FindCandidates(resources, lookup, 3);
+    ASSERT_EQ(3u, resources.size());
+  }
+
+  {
+    LookupResource lookup(ResourceType_Study);
+    lookup.AddDicomConstraint(DICOM_TAG_STUDY_DESCRIPTION, "desc*", true);
+    ASSERT_FALSE(lookup.HasUnoptimizedConstraints());
+    index.FindCandidates(resources, lookup, 0);
+    ASSERT_EQ(10u, resources.size());
+    index.FindCandidates(resources, lookup, 4);
+    ASSERT_EQ(4u, resources.size());
+
+    for (size_t i = 0; i < resources.size(); i++)
+    {
+      std::string instance;
+      ASSERT_TRUE(index.LookupOneChildInstance(instance, resources[i]));
+      ASSERT_TRUE(instances.find(instance) != instances.end());
+    }
+  }
+
+  {
+    LookupResource lookup(ResourceType_Series);
+    lookup.AddDicomConstraint(DICOM_TAG_SERIES_INSTANCE_UID, "series-1", true);
+    index.FindCandidates(resources, lookup, 5);
+    ASSERT_EQ(1u, resources.size());
+  }
+
+  {
+    // The limit is ignored if there are unoptimized constraints
+    LookupResource lookup(ResourceType_Study);
+    lookup.AddDicomConstraint(DicomTag(0x0010, 0x1010) /* PatientAge */, "42", true);
+    ASSERT_TRUE(lookup.HasUnoptimizedConstraints());
+    index.FindCandidates(resources, lookup, 2);
+    ASSERT_EQ(10u, resources.size());
+  }
+
+  std::string s;
+  ASSERT_FALSE(index.LookupOneChildInstance(s, "nope"));
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerContext, ReadJson)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+
+  std::string buffer;
+
+  {
+    ParsedDicomFile dicom(true);
+    dicom.Replace(DICOM_TAG_PATIENT_NAME, "Hello^World");
+    dicom.SaveToMemoryBuffer(buffer);
+  }
+
+  Json::Value stored, derived, tmp;
+  std::string id, id2;
+
+  // The JSON summary is read from the storage area
+  context.SetStoreDicomAsJson(true);
+
+  {
+    DicomInstanceToStore toStore;
+    toStore.SetBuffer(buffer);
+    ASSERT_EQ(StoreStatus_Success, context.Store(id, toStore));
+  }
+
+  FileInfo info;
+  ASSERT_TRUE(context.GetIndex().LookupAttachment(info, id, FileContentType_DicomAsJson));
+  context.ReadJson(stored, id);
+  ASSERT_EQ("Hello^World", stored["0010,0010"]["Value"].asString());
+  ASSERT_TRUE(context.GetIndex().DeleteResource(tmp, id, ResourceType_Instance));
+
+  // The JSON summary is derived from the DICOM file
+  context.SetStoreDicomAsJson(false);
+
+  {
+    DicomInstanceToStore toStore;
+    toStore.SetBuffer(buffer);
+    ASSERT_EQ(StoreStatus_Success, context.Store(id2, toStore));
+  }
+
+  ASSERT_EQ(id, id2);
+  ASSERT_FALSE(context.GetIndex().LookupAttachment(info, id, FileContentType_DicomAsJson));
+  context.ReadJson(derived, id);
+  ASSERT_EQ(stored, derived);
+
+  context.ReadJson(derived, id);  // From the cache
+  ASSERT_EQ(stored, derived);
+
+  // The caches must not serve a deleted instance
+  ASSERT_TRUE(context.GetIndex().DeleteResource(tmp, id, ResourceType_Instance));
+  ASSERT_THROW(context.ReadJson(derived, id), OrthancException);
+
+  context.Stop();
+  db.Close();
+}
+
+
+static bool PostInstances(std::string& answer,
+                          OrthancRestApi& api,
+                          const std::string& contentType,
+                          const std::string& body)
+{
+  IHttpHandler::Arguments headers;
+  headers["content-type"] = contentType;
+
+  IHttpHandler::GetArguments getArguments;
+  UriComponents uri;
+  Toolbox::SplitUriComponents(uri, "/instances");
+
+  StringHttpOutput stream;
+
+  {
+    HttpOutput output(stream, false);
+    if (!api.Handle(output, RequestOrigin_Unknown, "127.0.0.1", "", HttpMethod_Post, uri,
+                    headers, getArguments, body.c_str(), body.size()))
+    {
+      return false;
+    }
+  }
+
+  stream.GetOutput(answer);
+  return true;
+}
+
+
+TEST(OrthancRestApi, UploadBundle)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+  OrthancRestApi api(context);
+
+  std::string dicom;
+
+  {
+    ParsedDicomFile f(true);
+    f.SaveToMemoryBuffer(dicom);
+  }
+
+  // A valid file, an invalid file, then the same valid file again
+  const std::string body = ("--b\r\nContent-Type: application/dicom\r\n\r\n" + dicom + "\r\n" +
+                            "--b\r\nContent-Type: application/dicom\r\n\r\nnope\r\n" +
+                            "--b\r\nContent-Type: application/dicom\r\n\r\n" + dicom + "\r\n" +
+                            "--b--\r\n");
+  const std::string contentType = "multipart/related; type=application/dicom; boundary=b";
+
+  std::string s;
+  ASSERT_TRUE(PostInstances(s, api, contentType, body));
+
+  Json::Value answer;
+  Json::Reader reader;
+  ASSERT_TRUE(reader.parse(s, answer));
+  ASSERT_EQ(Json::arrayValue, answer.type());
+  ASSERT_EQ(3u, answer.size());
+  ASSERT_EQ("Success", answer[0]["Status"].asString());
+  ASSERT_EQ("Failure", answer[1]["Status"].asString());
+  ASSERT_EQ("AlreadyStored", answer[2]["Status"].asString());
+  ASSERT_TRUE(answer[0].isMember("ID"));
+  ASSERT_FALSE(answer[1].isMember("ID"));
+  ASSERT_EQ(answer[0]["ID"], answer[2]["ID"]);
+
+  std::list<std::string> instances;
+  context.GetIndex().GetAllUuids(instances, ResourceType_Instance);
+  ASSERT_EQ(1u, instances.size());
+  ASSERT_EQ(answer[0]["ID"].asString(), instances.front());
+
+  // A truncated bundle is rejected as a whole (HTTP status 400),
+  // which lets the peers fall back to one file per request
+  ASSERT_THROW(PostInstances(s, api, contentType, body.substr(0, body.size() - 10)), OrthancException);
+
+  // The bundle is not a DICOM file for the older versions of Orthanc
+  // that ignore the "Content-Type"
+  ASSERT_THROW(PostInstances(s, api, "application/dicom", body), OrthancException);
+
+  context.GetIndex().GetAllUuids(instances, ResourceType_Instance);
+  ASSERT_EQ(1u, instances.size());
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, PreviewCache)
+{
+  const std::string path = "UnitTestsStorage";
+
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  DicomMap instance;
+  instance.SetValue(DICOM_TAG_PATIENT_ID, "patient");
+  instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study");
+  instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series");
+  instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance");
+
+  std::map<MetadataType, std::string> instanceMetadata;
+  ServerIndex::Attachments attachments;
+  DicomInstanceToStore toStore;
+  toStore.SetSummary(instance);
+  ASSERT_EQ(StoreStatus_Success, index.Store(instanceMetadata, toStore, attachments));
+
+  const std::string id = DicomInstanceHasher(instance).HashInstance();
+  const std::string k1 = PreviewCache::FormatKey(id, 0, ImageExtractionMode_Preview, "image/png", 0);
+  const std::string k2 = PreviewCache::FormatKey(id, 1, ImageExtractionMode_Preview, "image/png", 0);
+  const std::string k3 = PreviewCache::FormatKey(id, 0, ImageExtractionMode_Preview, "image/jpeg", 90);
+  ASSERT_NE(k1, k2);
+  ASSERT_NE(k1, k3);
+
+  PreviewCache cache(index, storage);
+  PreviewCache::Statistics s;
+  std::string content;
+
+  // The cache is disabled by default
+  cache.Store(k1, id, "hello");
+  ASSERT_FALSE(cache.Lookup(content, k1, id));
+
+  cache.SetMaximumSize(10);
+  cache.Store(k1, id, "hello");
+  cache.Store(k2, id, "world");
+  ASSERT_TRUE(cache.Lookup(content, k1, id));  ASSERT_EQ("hello", content);
+  ASSERT_TRUE(cache.Lookup(content, k2, id));  ASSERT_EQ("world", content);
+
+  cache.Store(k3, id, "!");  // "k1" is recycled
+  ASSERT_FALSE(cache.Lookup(content, k1, id));
+  ASSERT_TRUE(cache.Lookup(content, k3, id));  ASSERT_EQ("!", content);
+
+  cache.GetStatistics(s);
+  ASSERT_EQ(3u, s.hits_);
+  ASSERT_EQ(2u, s.misses_);
+  ASSERT_EQ(2u, s.countEntries_);
+  ASSERT_EQ(6u, s.currentSize_);
+
+  // Spill the recycled entries to the storage area
+  cache.SetSpillEnabled(true);
+  cache.Store(k1, id, "0123456789");  // "k2" and "k3" are spilled, then "k3" replaces "k2" on the disk
+  ASSERT_TRUE(cache.Lookup(content, k1, id));  ASSERT_EQ("0123456789", content);
+  ASSERT_FALSE(cache.Lookup(content, k2, id));
+
+  FileInfo info;
+  ASSERT_TRUE(index.LookupAttachment(info, id, FileContentType_Preview));
+
+  cache.SetMaximumSize(0);
+  ASSERT_TRUE(cache.Lookup(content, k3, id));  ASSERT_EQ("!", content);
+  cache.GetStatistics(s);
+  ASSERT_EQ(1u, s.spillHits_);
+  ASSERT_EQ(0u, s.countEntries_);
+
+  // Invalidating the instance removes its previews
+  cache.SetMaximumSize(10);
+  cache.SetSpillEnabled(false);
+  cache.Store(k1, id, "hello");
+  cache.Invalidate("nope");
+  ASSERT_TRUE(cache.Lookup(content, k1, id));
+  cache.Invalidate(id);
+  ASSERT_FALSE(cache.Lookup(content, k1, id));
+  cache.GetStatistics(s);
+  ASSERT_EQ(0u, s.countEntries_);
+  ASSERT_EQ(0u, s.currentSize_);
+
+  index.DeleteAttachment(id, FileContentType_Preview);
+
+  // A preview that is stored after the deletion of its instance
+  // (i.e. after its invalidation) is not kept
+  cache.Store(k1, id, "hello");
+  ASSERT_TRUE(cache.Lookup(content, k1, id));
+
+  Json::Value remaining;
+  ASSERT_TRUE(index.DeleteResource(remaining, id, ResourceType_Instance));
+  cache.Store(k2, id, "world");
+  ASSERT_FALSE(cache.Lookup(content, k2, id));
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(LookupIdentifierQuery, NormalizeIdentifier)
+{
+  ASSERT_EQ("H^L.LO", LookupIdentifierQuery::NormalizeIdentifier("   Hé^l.LO  %_  "));
+  ASSERT_EQ("1.2.840.113619.2.176.2025", LookupIdentifierQuery::NormalizeIdentifier("   1.2.840.113619.2.176.2025  "));
+}
+
+
+TEST(WildcardMatcher, Basic)
+{
+  ASSERT_TRUE(WildcardMatcher("", true).Match(""));
+  ASSERT_FALSE(WildcardMatcher("", true).Match("a"));
+  ASSERT_TRUE(WildcardMatcher("*", true).Match(""));
+  ASSERT_TRUE(WildcardMatcher("**", true).Match("abc"));
+  ASSERT_TRUE(WildcardMatcher("abc", true).Match("abc"));
+  ASSERT_FALSE(WildcardMatcher("abc", true).Match("abcd"));
+  ASSERT_FALSE(WildcardMatcher("abc", true).Match("ABC"));
+  ASSERT_TRUE(WildcardMatcher("abc", false).Match("ABC"));
+  ASSERT_TRUE(WildcardMatcher("aBc", false).Match("AbC"));
+  ASSERT_TRUE(WildcardMatcher("a?c", true).Match("abc"));
+  ASSERT_FALSE(WildcardMatcher("a?c", true).Match("ac"));
+  ASSERT_TRUE(WildcardMatcher("ab*", true).Match("ab"));
+  ASSERT_TRUE(WildcardMatcher("ab*", true).Match("abcd"));
+  ASSERT_FALSE(WildcardMatcher("ab*", true).Match("a"));
+  ASSERT_TRUE(WildcardMatcher("*cd", true).Match("abcd"));
+  ASSERT_FALSE(WildcardMatcher("*cd", true).Match("abcde"));
+  ASSERT_TRUE(WildcardMatcher("a*b?c*d", true).Match("aXXbYcZZd"));
+  ASSERT_TRUE(WildcardMatcher("a*b?c*d", true).Match("abbcd"));
+  ASSERT_FALSE(WildcardMatcher("a*b?c*d", true).Match("abcd"));
+  ASSERT_TRUE(WildcardMatcher("*aba*", true).Match("xabax"));
+  ASSERT_FALSE(WildcardMatcher("a*a", true).Match("a"));
+  ASSERT_TRUE(WildcardMatcher("a*a", true).Match("aa"));
+  ASSERT_TRUE(WildcardMatcher("a.{b]", true).Match("a.{b]"));
+  ASSERT_FALSE(WildcardMatcher("a.c", true).Match("abc"));
+  ASSERT_TRUE(WildcardMatcher("DOE^J*", false).Match("Doe^John"));
+
+  WildcardConstraint constraint("DOE^J*", false);
+  ASSERT_TRUE(constraint.Match("doe^jane"));
+  ASSERT_FALSE(constraint.Match("smith^john"));
+  ASSERT_EQ("DOE^J*", constraint.Format());
+
+  std::auto_ptr<IFindConstraint> clone(constraint.Clone());
+  ASSERT_TRUE(clone->Match("DOE^JOHN"));
+}
+
+
+static std::string GenerateWildcardString(unsigned int& seed,
+                                          size_t length,
+                                          bool wildcards)
+{
+  static const char alphabet[] = "abAB^*?";
+
+  std::string s;
+  for (size_t i = 0; i < length; i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    s.push_back(alphabet[(seed >> 16) % (wildcards ? 7 : 5)]);
+  }
+
+  return s;
+}
+
+
+TEST(WildcardMatcher, Regex)
+{
+  // Check against the former implementation based on regular expressions
+  unsigned int seed = 42;
+  std::vector<std::string> values;
+  for (unsigned int i = 0; i < 2000; i++)
+  {
+    values.push_back(GenerateWildcardString(seed, i % 12, false));
+  }
+
+  for (unsigned int i = 0; i < 200; i++)
+  {
+    std::string pattern = GenerateWildcardString(seed, i % 8, true);
+    bool caseSensitive = (i % 2 == 0);
+
+    WildcardMatcher matcher(pattern, caseSensitive);
+    boost::regex regex(Toolbox::WildcardToRegularExpression(pattern),
+                       caseSensitive ? boost::regex::normal : boost::regex::icase);
+
+    for (size_t j = 0; j < values.size(); j++)
+    {
+      ASSERT_EQ(boost::regex_match(values[j], regex), matcher.Match(values[j]));
+    }
+  }
+
+  // Patient names
+  values.clear();
+  for (unsigned int i = 0; i < 1000; i++)
+  {
+    values.push_back("PATIENT" + boost::lexical_cast<std::string>(i) + "^FIRSTNAME^MIDDLE");
+  }
+
+  const std::string pattern = "patient*9^first*";
+  WildcardMatcher matcher(pattern, false);
+  boost::regex regex(Toolbox::WildcardToRegularExpression(pattern), boost::regex::icase);
+
+  size_t count = 0;
+  for (size_t i = 0; i < values.size(); i++)
+  {
+    bool match = matcher.Match(values[i]);
+    ASSERT_EQ(boost::regex_match(values[i], regex), match);
+
+    if (match)
+    {
+      count++;
+    }
+  }
+
+  ASSERT_EQ(100u, count);
+}
+
+
+TEST(WildcardMatcher, DISABLED_Benchmark)
+{
+  std::vector<std::string> values;
+  for (unsigned int i = 0; i < 100000; i++)
+  {
+    values.push_back("PATIENT" + boost::lexical_cast<std::string>(i) + "^FIRSTNAME^MIDDLE");
+  }
+
+  const std::string pattern = "patient*9^first*";
+  WildcardMatcher matcher(pattern, false);
+  boost::regex regex(Toolbox::WildcardToRegularExpression(pattern), boost::regex::icase);
+
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+  size_t countRegex = 0;
+  for (size_t i = 0; i < values.size(); i++)
+  {
+    if (boost::regex_match(values[i], regex))
+    {
+      countRegex++;
+    }
+  }
+
+  boost::posix_time::ptime t1 = boost::posix_time::microsec_clock::universal_time();
+
+  size_t countMatcher = 0;
+  for (size_t i = 0; i < values.size(); i++)
+  {
+    if (matcher.Match(values[i]))
+    {
+      countMatcher++;
+    }
+  }
+
+  boost::posix_time::ptime t2 = boost::posix_time::microsec_clock::universal_time();
+
+  ASSERT_EQ(10000u, countRegex);
+  ASSERT_EQ(countRegex, countMatcher);
+
+  printf("Wildcard matching of %d values: regex: %d us, matcher: %d us\n",
+         static_cast<int>(values.size()),
+         static_cast<int>((t1 - start).total_microseconds()),
+         static_cast<int>((t2 - t1).total_microseconds()));
+}
+
+
+TEST(ServerIndex, IngestStatistics)
+{
+  IngestStatistics statistics;
+
+  Json::Value tmp;
+  statistics.Format(tmp);
+  ASSERT_EQ(4u, tmp.size());
+  ASSERT_EQ(0, tmp["Parsing"]["Count"].asInt());
+  ASSERT_EQ(0, tmp["IndexCommit"]["Count"].asInt());
+
+  statistics.Add(IngestStatistics::Stage_IndexCommit, 1000);
+  statistics.Add(IngestStatistics::Stage_IndexCommit, 3000);
+
+  {
+    IngestStatistics::Timer timer(statistics, IngestStatistics::Stage_StorageWrite);
+  }
+
+  statistics.Format(tmp);
+  ASSERT_EQ(0, tmp["Parsing"]["Count"].asInt());
+  ASSERT_EQ(1, tmp["StorageWrite"]["Count"].asInt());
+  ASSERT_EQ(2, tmp["IndexCommit"]["Count"].asInt());
+  ASSERT_FLOAT_EQ(4.0f, tmp["IndexCommit"]["TotalMilliseconds"].asFloat());
+  ASSERT_FLOAT_EQ(2.0f, tmp["IndexCommit"]["AverageMilliseconds"].asFloat());
+  ASSERT_FLOAT_EQ(500.0f, tmp["IndexCommit"]["InstancesPerSecond"].asFloat());
+
+  statistics.Reset();
+  statistics.Format(tmp);
+  ASSERT_EQ(0, tmp["IndexCommit"]["Count"].asInt());
+}
+
+
+namespace
+{
+  class GatedListener : public IServerListener
+  {
+  private:
+    boost::mutex  mutex_;
+    std::string   received_;
+
+  public:
+    boost::mutex  gate_;   // Locking this mutex stalls the listener
+
+    virtual void SignalStoredInstance(const std::string& publicId,
+                                      DicomInstanceToStore& instance,
+                                      const Json::Value& simplifiedTags)
+    {
+    }
+
+    virtual void SignalChange(const ServerIndexChange& change)
+    {
+      boost::mutex::scoped_lock gate(gate_);
+      boost::mutex::scoped_lock lock(mutex_);
+      received_ += change.GetPublicId();
+    }
+
+    virtual bool FilterIncomingInstance(const DicomInstanceToStore& instance,
+                                        const Json::Value& simplified)
+    {
+      return true;
+    }
+
+    std::string GetReceived()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return received_;
+    }
+  };
+
+
+  void EnqueueChange(ServerListenerQueue& queue,
+                     const std::string& publicId)
+  {
+    queue.Enqueue(ServerIndexChange(ChangeType_NewInstance, ResourceType_Instance, publicId));
+  }
+
+
+  void EnqueueAndWaitStalled(ServerListenerQueue& queue,
+                             const std::string& publicId)
+  {
+    // Wait for the worker to pick the change, and to be stalled
+    EnqueueChange(queue, publicId);
+
+    ServerListenerQueue::Statistics statistics;
+    for (;;)
+    {
+      queue.GetStatistics(statistics);
+      if (statistics.queueSize_ == 0)
+      {
+        return;
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+  }
+}
+
+
+TEST(ServerIndex, ListenerQueue)
+{
+  ASSERT_EQ(ListenerOverflowPolicy_Coalesce, StringToListenerOverflowPolicy("Coalesce"));
+  ASSERT_STREQ("Drop", EnumerationToString(ListenerOverflowPolicy_Drop));
+  ASSERT_THROW(StringToListenerOverflowPolicy("Nope"), OrthancException);
+
+  ServerListenerQueue::Statistics statistics;
+
+  {
+    GatedListener listener;
+    ServerListenerQueue queue(listener, "test", 2, ListenerOverflowPolicy_Drop);
+
+    {
+      boost::mutex::scoped_lock gate(listener.gate_);
+      EnqueueAndWaitStalled(queue, "a");
+      EnqueueChange(queue, "b");
+      EnqueueChange(queue, "c");
+      EnqueueChange(queue, "d");  // Drops "b"
+    }
+
+    queue.WaitEmpty();
+    ASSERT_EQ("acd", listener.GetReceived());
+
+    queue.GetStatistics(statistics);
+    ASSERT_EQ(0u, statistics.queueSize_);
+    ASSERT_EQ(2u, statistics.maximumQueueSize_);
+    ASSERT_EQ(3u, statistics.processed_);
+    ASSERT_EQ(1u, statistics.dropped_);
+    ASSERT_EQ(0u, statistics.coalesced_);
+  }
+
+  {
+    GatedListener listener;
+    ServerListenerQueue queue(listener, "test", 2, ListenerOverflowPolicy_Coalesce);
+
+    {
+      boost::mutex::scoped_lock gate(listener.gate_);
+      EnqueueAndWaitStalled(queue, "a");
+      EnqueueChange(queue, "b");
+      EnqueueChange(queue, "b");  // Coalesced
+      EnqueueChange(queue, "c");
+    }
+
+    queue.WaitEmpty();
+    ASSERT_EQ("abc", listener.GetReceived());
+
+    queue.GetStatistics(statistics);
+    ASSERT_EQ(3u, statistics.processed_);
+    ASSERT_EQ(0u, statistics.dropped_);
+    ASSERT_EQ(1u, statistics.coalesced_);
+
+    Json::Value tmp;
+    queue.Format(tmp);
+    ASSERT_EQ("Coalesce", tmp["OverflowPolicy"].asString());
+    ASSERT_EQ(3, tmp["Processed"].asInt());
+  }
+
+  {
+    GatedListener listener;
+    ServerListenerQueue queue(listener, "test", 1, ListenerOverflowPolicy_Block);
+
+    {
+      boost::mutex::scoped_lock gate(listener.gate_);
+      EnqueueAndWaitStalled(queue, "a");
+      EnqueueChange(queue, "b");
+
+      // The queue is full: This thread must wait for the listener
+      boost::thread blocked(EnqueueChange, boost::ref(queue), "c");
+      ASSERT_FALSE(blocked.timed_join(boost::posix_time::milliseconds(50)));
+
+      gate.unlock();
+      blocked.join();
+    }
+
+    queue.WaitEmpty();
+    ASSERT_EQ("abc", listener.GetReceived());
+
+    queue.GetStatistics(statistics);
+    ASSERT_EQ(3u, statistics.processed_);
+    ASSERT_EQ(0u, statistics.dropped_);
+  }
+
+  {
+    GatedListener listener;
+    ServerListenerQueue queue(listener, "test", 1, ListenerOverflowPolicy_Block);
+    queue.SetBlockTimeout(20);
+
+    {
+      boost::mutex::scoped_lock gate(listener.gate_);
+      EnqueueAndWaitStalled(queue, "a");
+      EnqueueChange(queue, "b");
+      EnqueueChange(queue, "c");  // Times out, then drops "b"
+      EnqueueChange(queue, "d");  // The listener is stalled: Drops "c" without waiting
+    }
+
+    queue.WaitEmpty();
+    ASSERT_EQ("ad", listener.GetReceived());
+
+    queue.GetStatistics(statistics);
+    ASSERT_EQ(2u, statistics.processed_);
+    ASSERT_EQ(2u, statistics.dropped_);
+
+    {
+      // The listener has caught up: The queue blocks again
+      boost::mutex::scoped_lock gate(listener.gate_);
+      EnqueueAndWaitStalled(queue, "e");
+      EnqueueChange(queue, "f");
+
+      boost::thread blocked(EnqueueChange, boost::ref(queue), "g");
+      ASSERT_FALSE(blocked.timed_join(boost::posix_time::milliseconds(5)));
+      blocked.join();
+    }
+
+    queue.WaitEmpty();
+    ASSERT_EQ("adeg", listener.GetReceived());
+  }
+}
+
+
+namespace
+{
+  class StoreInstancesThread : public boost::noncopyable
+  {
+  private:
+    ServerIndex&  index_;
+    unsigned int  first_;
+    unsigned int  count_;
+    unsigned int  countSuccess_;
+    unsigned int  countAlreadyStored_;
+    boost::thread thread_;
+
+    static void Worker(StoreInstancesThread* that)
+    {
+      for (unsigned int i = that->first_; i < that->first_ + that->count_; i++)
+      {
+        std::string id = boost::lexical_cast<std::string>(i);
+        DicomMap instance;
+        instance.SetValue(DICOM_TAG_PATIENT_ID, "patient-" + boost::lexical_cast<std::string>(i % 10));
+        instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study-" + boost::lexical_cast<std::string>(i % 10));
+        instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series-" + boost::lexical_cast<std::string>(i % 10));
+        instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "instance-" + id);
+
+        ServerIndex::Attachments attachments;
+        std::map<MetadataType, std::string> instanceMetadata;
+        DicomInstanceToStore toStore;
+        toStore.SetSummary(instance);
+
+        switch (that->index_.Store(instanceMetadata, toStore, attachments))
+        {
+          case StoreStatus_Success:
+            that->countSuccess_++;
+            break;
+
+          case StoreStatus_AlreadyStored:
+            that->countAlreadyStored_++;
+            break;
+
+          default:
+            break;
+        }
+      }
+    }
+
+  public:
+    StoreInstancesThread(ServerIndex& index,
+                         unsigned int first,
+                         unsigned int count) :
+      index_(index),
+      first_(first),
+      count_(count),
+      countSuccess_(0),
+      countAlreadyStored_(0)
+    {
+      thread_ = boost::thread(Worker, this);
+    }
+
+    void Join()
+    {
+      thread_.join();
+    }
+
+    unsigned int GetCountSuccess() const
+    {
+      return countSuccess_;
+    }
+
+    unsigned int GetCountAlreadyStored() const
+    {
+      return countAlreadyStored_;
+    }
+  };
+}
+
+
+// Returns the number of instances per second
+static double StoreConcurrently(ServerIndex& index,
+                                unsigned int countThreads,
+                                unsigned int countInstancesPerThread,
+                                unsigned int overlap,
+                                unsigned int& countSuccess,
+                                unsigned int& countAlreadyStored)
+{
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+  std::vector<StoreInstancesThread*> threads(countThreads);
+  for (unsigned int i = 0; i < countThreads; i++)
+  {
+    threads[i] = new StoreInstancesThread(index, i * (countInstancesPerThread - overlap),
+                                          countInstancesPerThread);
+  }
+
+  countSuccess = 0;
+  countAlreadyStored = 0;
+
+  for (unsigned int i = 0; i < countThreads; i++)
+  {
+    threads[i]->Join();
+    countSuccess += threads[i]->GetCountSuccess();
+    countAlreadyStored += threads[i]->GetCountAlreadyStored();
+    delete threads[i];
+  }
+
+  boost::posix_time::time_duration elapsed = 
+    boost::posix_time::microsec_clock::universal_time() - start;
+
+  return (static_cast<double>(countThreads * countInstancesPerThread) * 1000000.0 /
+          static_cast<double>(std::max(static_cast<int64_t>(1), 
+                                       static_cast<int64_t>(elapsed.total_microseconds()))));
+}
+
+
+TEST(ServerIndex, GroupCommit)
+{
+  const std::string path = "UnitTestsStorage";
+
+  Toolbox::RemoveFile(path + "/index");
+  FilesystemStorage storage(path);
+  DatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage);
+  ServerIndex& index = context.GetIndex();
+
+  index.SetGroupCommit(16, 5);
+  ASSERT_EQ(16u, index.GetGroupCommitSize());
+
+  // 8 threads, each storing 50 instances, 10 of which are also
+  // stored by the next thread
+  unsigned int countSuccess, countAlreadyStored;
+  StoreConcurrently(index, 8, 50, 10, countSuccess, countAlreadyStored);
+
+  ASSERT_EQ(8u * 40u + 10u, countSuccess);
+  ASSERT_EQ(7u * 10u, countAlreadyStored);
+
+  Json::Value tmp;
+  index.ComputeStatistics(tmp);
+  ASSERT_EQ(10, tmp["CountPatients"].asInt());
+  ASSERT_EQ(10, tmp["CountSeries"].asInt());
+  ASSERT_EQ(static_cast<int>(countSuccess), tmp["CountInstances"].asInt());
+
+  index.SetGroupCommit(1, 100);
+  ASSERT_EQ(1u, index.GetGroupCommitSize());
+
+  context.Stop();
+  db.Close();
+}
+
+
+TEST(ServerIndex, GroupCommitBenchmark)
+{
+  static const unsigned int COUNT_THREADS = 4;
+  static const unsigned int COUNT_INSTANCES = 100;   // Per thread
+
+  const std::string path = "UnitTestsStorage";
+  unsigned int groupSizes[] = { 1, 32 };
+
+  for (size_t i = 0; i < sizeof(groupSizes) / sizeof(unsigned int); i++)
+  {
+    Toolbox::RemoveFile(path + "/index");
+
+    {
+      // The SQLite DB is stored on the disk, so that the cost of the
+      // commits is taken into account
+      FilesystemStorage storage(path);
+      DatabaseWrapper db(path + "/index");
+      db.Open();
+      ServerContext context(db, storage);
+
+      context.GetIndex().SetGroupCommit(groupSizes[i], 0);
+
+      unsigned int countSuccess, countAlreadyStored;
+      double speed = StoreConcurrently(context.GetIndex(), COUNT_THREADS, COUNT_INSTANCES, 
+                                       0, countSuccess, countAlreadyStored);
+
+      ASSERT_EQ(COUNT_THREADS * COUNT_INSTANCES, countSuccess);
+      ASSERT_EQ(0u, countAlreadyStored);
+
+      LOG(WARNING) << "Group commit of at most " << groupSizes[i] << " instance(s): " 
+                   << speed << " instances per second";
+
+      context.Stop();
+      db.Close();
+    }
+
+    Toolbox::RemoveFile(path + "/index");
+  }
+}
+
+
+TEST(ServerIndex, ReadConnections)
+{
+  const std::string path = "UnitTestsStorage";
+
+  {
+    // In-memory databases cannot be shared between connections
+    FilesystemStorage storage(path);
+    DatabaseWrapper db;
+    db.Open();
+    ServerContext context(db, storage);
+    ASSERT_FALSE(context.GetIndex().SetReadConnections(2));
+    ASSERT_EQ(0u, context.GetIndex().GetReadConnectionsCount());
+    context.Stop();
+    db.Close();
+  }
+
+  Toolbox::RemoveFile(path + "/index");
+
+  {
+    // The database is locked in exclusive mode by default
+    FilesystemStorage storage(path);
+    DatabaseWrapper db(path + "/index");
+    db.Open();
+    ASSERT_THROW(db.SetExclusiveLocking(false), OrthancException);
+    ServerContext context(db, storage);
+    ASSERT_FALSE(context.GetIndex().SetReadConnections(2));
+    ASSERT_EQ(0u, context.GetIndex().GetReadConnectionsCount());
+    context.Stop();
+    db.Close();
+  }
+
+  Toolbox::RemoveFile(path + "/index");
+
+  {
+    FilesystemStorage storage(path);
+    DatabaseWrapper db(path + "/index");
+    db.SetExclusiveLocking(false);
+    db.Open();
+    ServerContext context(db, storage);
+    ServerIndex& index = context.GetIndex();
+
+    ASSERT_TRUE(index.SetReadConnections(2));
+    ASSERT_EQ(2u, index.GetReadConnectionsCount());
+
+    unsigned int countSuccess, countAlreadyStored;
+    StoreConcurrently(index, 4, 10, 0, countSuccess, countAlreadyStored);
+    ASSERT_EQ(40u, countSuccess);
+
+    // The read-only connections see the committed instances
+    std::list<std::string> patients;
+    index.GetAllUuids(patients, ResourceType_Patient);
+    ASSERT_EQ(10u, patients.size());
+
+    std::list<std::string> instances;
+    index.GetChildInstances(instances, patients.front());
+    ASSERT_EQ(4u, instances.size());
+
+    ResourceType type;
+    ASSERT_TRUE(index.LookupResourceType(type, instances.front()));
+    ASSERT_EQ(ResourceType_Instance, type);
+    ASSERT_FALSE(index.LookupResourceType(type, "nope"));
+
+    ASSERT_TRUE(index.SetReadConnections(0));
+    ASSERT_EQ(0u, index.GetReadConnectionsCount());
+
+    patients.clear();
+    index.GetAllUuids(patients, ResourceType_Patient);
+    ASSERT_EQ(10u, patients.size());
+
+    context.Stop();
+    db.Close();
+  }
+
+  Toolbox::RemoveFile(path + "/index");
+}
+
+
+namespace
+{
+  class StopFlag : public boost::noncopyable
+  {
+  private:
+    boost::mutex  mutex_;
+    bool          isSet_;
+
+  public:
+    StopFlag() : isSet_(false)
+    {
+    }
+
+    void Set()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      isSet_ = true;
+    }
+
+    bool IsSet()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return isSet_;
+    }
+  };
+
+
+  class ReadLatencyThread : public boost::noncopyable
+  {
+  private:
+    ServerIndex&         index_;
+    StopFlag&            done_;
+    std::vector<double>  latencies_;   // In milliseconds
+    boost::thread        thread_;
+
+    static void Worker(ReadLatencyThread* that)
+    {
+      while (!that->done_.IsSet())
+      {
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+        std::list<std::string> patients;
+        that->index_.GetAllUuids(patients, ResourceType_Patient);
+
+        if (!patients.empty())
+        {
+          std::list<std::string> children;
+          that->index_.GetChildren(children, patients.front());
+        }
+
+        boost::posix_time::time_duration elapsed = 
+          boost::posix_time::microsec_clock::universal_time() - start;
+        that->latencies_.push_back(static_cast<double>(elapsed.total_microseconds()) / 1000.0);
+      }
+    }
+
+  public:
+    ReadLatencyThread(ServerIndex& index,
+                      StopFlag& done) :
+      index_(index),
+      done_(done)
+    {
+      thread_ = boost::thread(Worker, this);
+    }
+
+    void Join()
+    {
+      thread_.join();
+    }
+
+    const std::vector<double>& GetLatencies() const
+    {
+      return latencies_;
+    }
+  };
+}
+
+
+TEST(ServerIndex, ReadConnectionsBenchmark)
+{
+  static const unsigned int COUNT_READERS = 4;
+
+  const std::string path = "UnitTestsStorage";
+  unsigned int readConnections[] = { 0, COUNT_READERS };
+
+  for (size_t i = 0; i < sizeof(readConnections) / sizeof(unsigned int); i++)
+  {
+    Toolbox::RemoveFile(path + "/index");
+
+    {
+      FilesystemStorage storage(path);
+      DatabaseWrapper db(path + "/index");
+      db.SetExclusiveLocking(false);
+      db.Open();
+      ServerContext context(db, storage);
+      ASSERT_TRUE(context.GetIndex().SetReadConnections(readConnections[i]));
+
+      StopFlag done;
+      std::vector<ReadLatencyThread*> readers(COUNT_READERS);
+      for (unsigned int j = 0; j < COUNT_READERS; j++)
+      {
+        readers[j] = new ReadLatencyThread(context.GetIndex(), done);
+      }
+
+      // Synthetic ingest load
+      unsigned int countSuccess, countAlreadyStored;
+      StoreConcurrently(context.GetIndex(), 2, 200, 0, countSuccess, countAlreadyStored);
+      ASSERT_EQ(400u, countSuccess);
+
+      done.Set();
+
+      std::vector<double> latencies;
+      for (unsigned int j = 0; j < COUNT_READERS; j++)
+      {
+        readers[j]->Join();
+        latencies.insert(latencies.end(), readers[j]->GetLatencies().begin(),
+                         readers[j]->GetLatencies().end());
+        delete readers[j];
+      }
+
+      ASSERT_FALSE(latencies.empty());
+      std::sort(latencies.begin(), latencies.end());
+
+      LOG(WARNING) << "Concurrent reads with " << readConnections[i] << " read-only connection(s): "
+                   << latencies.size() << " reads, p50 = " << latencies[latencies.size() / 2]
+                   << " ms, p99 = " << latencies[(latencies.size() * 99) / 100] << " ms";
+
+      context.Stop();
+      db.Close();
+    }
+
+    Toolbox::RemoveFile(path + "/index");
+  }
 }
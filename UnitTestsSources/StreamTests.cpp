@@ -40,8 +40,11 @@
 #include "../Core/HttpServer/FilesystemHttpSender.h"
 #include "../Core/HttpServer/HttpStreamTranscoder.h"
 #include "../Core/Compression/ZlibCompressor.h"
+#include "../Core/Compression/Lz4Compressor.h"
 #include "../Core/Compression/GzipCompressor.h"
 
+#include <boost/lexical_cast.hpp>
+
 
 using namespace Orthanc;
 
@@ -176,6 +179,144 @@ TEST(Zlib, Empty)
 }
 
 
+TEST(Lz4, Basic)
+{
+  std::string s = Toolbox::GenerateUuid();
+  s = s + s + s + s;
+ 
+  std::string compressed;
+  Lz4Compressor c;
+  IBufferCompressor::Compress(compressed, c, s);
+  ASSERT_LT(compressed.size(), s.size());
+
+  std::string uncompressed;
+  IBufferCompressor::Uncompress(uncompressed, c, compressed);
+  ASSERT_EQ(s, uncompressed);
+}
+
+
+TEST(Lz4, Sizes)
+{
+  Lz4Compressor c;
+
+  // Short buffers only contain literals, long ones contain matches
+  // whose lengths and offsets need extra bytes
+  for (size_t size = 1; size < 100000; size = size * 3 + 1)
+  {
+    std::string s;
+    s.reserve(size);
+    for (size_t i = 0; s.size() < size; i++)
+    {
+      s += boost::lexical_cast<std::string>(i % 317) + " ";
+    }
+
+    s.resize(size);
+
+    std::string compressed, uncompressed;
+    IBufferCompressor::Compress(compressed, c, s);
+    IBufferCompressor::Uncompress(uncompressed, c, compressed);
+    ASSERT_EQ(s, uncompressed);
+  }
+
+  // Incompressible data
+  std::string s;
+  for (unsigned int i = 0; i < 1000; i++)
+  {
+    s += Toolbox::GenerateUuid();
+  }
+
+  std::string compressed, uncompressed;
+  IBufferCompressor::Compress(compressed, c, s);
+  IBufferCompressor::Uncompress(uncompressed, c, compressed);
+  ASSERT_EQ(s, uncompressed);
+}
+
+
+TEST(Lz4, Reference)
+{
+  // Block that is produced by "LZ4_compress_default()" of the
+  // reference LZ4 library, prefixed with the uncompressed size
+  static const uint8_t BLOCK[] = {
+    0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xff, 0x00, 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x4f, 0x72, 0x74, 0x68,
+    0x61, 0x6e, 0x63, 0x2c, 0x20, 0x0f, 0x00, 0x56, 0x80, 0x74, 0x68, 0x65,
+    0x20, 0x65, 0x6e, 0x64, 0x2e
+  };
+
+  std::string expected;
+  for (unsigned int i = 0; i < 8; i++)
+  {
+    expected += "Hello Orthanc, ";
+  }
+
+  expected += "the end.";
+
+  Lz4Compressor c;
+  std::string uncompressed;
+  c.Uncompress(uncompressed, BLOCK, sizeof(BLOCK));
+  ASSERT_EQ(expected, uncompressed);
+}
+
+
+TEST(Lz4, Corrupted)
+{
+  std::string s;
+  for (unsigned int i = 0; i < 100; i++)
+  {
+    s += "Hello world " + boost::lexical_cast<std::string>(i % 7);
+  }
+
+  std::string compressed;
+  Lz4Compressor c;
+  IBufferCompressor::Compress(compressed, c, s);
+
+  std::string u;
+
+  // Truncated block
+  ASSERT_THROW(c.Uncompress(u, compressed.c_str(), compressed.size() - 1), OrthancException);
+  ASSERT_THROW(c.Uncompress(u, compressed.c_str(), sizeof(uint64_t)), OrthancException);
+
+  // Wrong uncompressed size
+  std::string t = compressed;
+  t[0] = t[0] + 1;
+  ASSERT_THROW(IBufferCompressor::Uncompress(u, c, t), OrthancException);
+
+  // Offset that points before the beginning of the buffer
+  static const uint8_t BAD[] = {
+    0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x10, 0x61, 0x10, 0x00, 0x50, 0x61, 0x61, 0x61, 0x61, 0x61
+  };
+  ASSERT_THROW(c.Uncompress(u, BAD, sizeof(BAD)), OrthancException);
+
+  // Random damage must never crash
+  for (size_t i = sizeof(uint64_t); i < compressed.size(); i++)
+  {
+    t = compressed;
+    t[i] = static_cast<char>(t[i] ^ 0x5a);
+
+    try
+    {
+      IBufferCompressor::Uncompress(u, c, t);
+    }
+    catch (OrthancException&)
+    {
+    }
+  }
+}
+
+
+TEST(Lz4, Empty)
+{
+  std::string compressed, uncompressed;
+  Lz4Compressor c;
+  IBufferCompressor::Compress(compressed, c, "");
+  ASSERT_TRUE(compressed.empty());
+
+  IBufferCompressor::Uncompress(uncompressed, c, compressed);
+  ASSERT_TRUE(uncompressed.empty());
+}
+
+
 static bool ReadAllStream(std::string& result,
                           IHttpStreamAnswer& stream,
                           bool allowGzip = false,
@@ -327,3 +468,37 @@ TEST(HttpStreamTranscoder, Basic)
     ASSERT_EQ(0u, u.size());
   }
 }
+
+
+TEST(HttpStreamTranscoder, Lz4)
+{
+  Lz4Compressor compressor;
+
+  const std::string s = "Hello world " + Toolbox::GenerateUuid();
+
+  std::string t;
+  IBufferCompressor::Compress(t, compressor, s);
+
+  // LZ4 is always uncompressed, even if the client accepts deflate
+  for (int cs = 0; cs < 5; cs++)
+  {
+    BufferHttpSender sender;
+    sender.SetChunkSize(cs);
+    sender.GetBuffer() = t;
+
+    HttpStreamTranscoder transcode(sender, CompressionType_Lz4WithSize);
+    
+    std::string u;
+    ASSERT_TRUE(ReadAllStream(u, transcode, true, true));
+    
+    ASSERT_EQ(s, u);
+  }
+
+  {
+    BufferHttpSender sender;
+    HttpStreamTranscoder transcode(sender, CompressionType_Lz4WithSize);
+    std::string u;
+    ASSERT_TRUE(ReadAllStream(u, transcode, false, true));
+    ASSERT_EQ(0u, u.size());
+  }
+}
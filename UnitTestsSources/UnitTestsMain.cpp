@@ -332,6 +332,17 @@ TEST(Toolbox, ComputeMD5)
   ASSERT_EQ("8b1a9953c4611296a827abf8c47804d7", s);
   Toolbox::ComputeMD5(s, "");
   ASSERT_EQ("d41d8cd98f00b204e9800998ecf8427e", s);
+
+  {
+    Toolbox::IncrementalMD5 md5;
+    md5.Append("He", 2);
+    md5.Append("", 0);
+    md5.Append("llo", 3);
+    md5.Finish(s);
+    ASSERT_EQ("8b1a9953c4611296a827abf8c47804d7", s);
+    ASSERT_THROW(md5.Finish(s), OrthancException);
+    ASSERT_THROW(md5.Append("a", 1), OrthancException);
+  }
 }
 
 TEST(Toolbox, ComputeSHA1)
@@ -532,6 +543,12 @@ TEST(EnumerationDictionary, ServerEnumerations)
   ASSERT_STREQ("AgfaImpax", EnumerationToString(StringToModalityManufacturer("AgfaImpax")));
   ASSERT_STREQ("EFilm2", EnumerationToString(StringToModalityManufacturer("EFilm2")));
   ASSERT_STREQ("Vitrea", EnumerationToString(StringToModalityManufacturer("Vitrea")));
+
+  ASSERT_EQ(CompressionType_None, StringToCompressionType("None"));
+  ASSERT_EQ(CompressionType_ZlibWithSize, StringToCompressionType("zlib"));
+  ASSERT_EQ(CompressionType_Lz4WithSize, StringToCompressionType("LZ4"));
+  ASSERT_STREQ("Lz4", EnumerationToString(CompressionType_Lz4WithSize));
+  ASSERT_THROW(StringToCompressionType("zstd"), OrthancException);
 }
 
 
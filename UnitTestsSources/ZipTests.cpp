@@ -186,3 +186,91 @@ TEST(HierarchicalZipWriter, Basic)
 
   **/
 }
+
+
+namespace
+{
+  class StringZipStream : public Orthanc::ZipWriter::IOutputStream
+  {
+  public:
+    std::string  content_;
+    unsigned int countChunks_;
+
+    StringZipStream() : countChunks_(0)
+    {
+    }
+
+    virtual void Write(const std::string& chunk)
+    {
+      content_.append(chunk);
+      countChunks_++;
+    }
+  };
+
+
+  uint32_t ReadUint32(const std::string& s,
+                      size_t pos)
+  {
+    return (static_cast<uint32_t>(static_cast<uint8_t>(s[pos])) |
+            (static_cast<uint32_t>(static_cast<uint8_t>(s[pos + 1])) << 8) |
+            (static_cast<uint32_t>(static_cast<uint8_t>(s[pos + 2])) << 16) |
+            (static_cast<uint32_t>(static_cast<uint8_t>(s[pos + 3])) << 24));
+  }
+}
+
+
+TEST(ZipWriter, Stream)
+{
+  for (unsigned int zip64 = 0; zip64 <= 1; zip64++)
+  {
+    StringZipStream stream;
+
+    {
+      HierarchicalZipWriter w(stream);
+      w.SetZip64(zip64 == 1);
+
+      w.OpenFile("hello");
+      w.Write("Hello world");
+      w.OpenDirectory("world");
+      w.OpenFile("hello");
+      w.Write(std::string(100000, 'a'));
+      w.CloseDirectory();
+
+      ASSERT_THROW(w.SetZip64(zip64 == 0), OrthancException);
+      ASSERT_TRUE(stream.content_.empty());   // Buffered
+      w.Close();
+    }
+
+    const std::string& s = stream.content_;
+    ASSERT_GT(s.size(), 22u);
+    ASSERT_EQ(0x04034b50u, ReadUint32(s, 0));        // Local file header
+    ASSERT_EQ(0x06054b50u, ReadUint32(s, s.size() - 22 - 18));  // End of central directory
+
+    std::string path = "UnitTestsResults/stream" + std::string(zip64 ? "64" : "") + ".zip";
+    Toolbox::WriteFile(s, path);
+  }
+
+  {
+    // Empty archive
+    StringZipStream stream;
+    Orthanc::ZipWriter w;
+    w.SetOutputStream(stream);
+    w.Close();
+    ASSERT_EQ(22u + 18u, stream.content_.size());
+    ASSERT_EQ(1u, stream.countChunks_);
+  }
+
+  {
+    // If not explicitly closed, the stream is left truncated
+    StringZipStream stream;
+
+    {
+      Orthanc::ZipWriter w;
+      w.SetOutputStream(stream);
+      w.OpenFile("hello");
+      w.Write("Hello world");
+    }
+
+    ASSERT_TRUE(stream.content_.empty());
+  }
+}